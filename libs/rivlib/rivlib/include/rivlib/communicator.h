@@ -74,6 +74,31 @@ namespace rivlib {
          */
         virtual size_t public_uri(provider::ptr prov, size_t idx, char *buf, size_t buflen) = 0;
 
+        /**
+         * Sets the maximum egress rate of the image data of all client
+         * connections of this communicator together
+         *
+         * @param bytes_per_second The maximum rate or zero for unlimited
+         */
+        virtual void set_egress_rate(uint64_t bytes_per_second) = 0;
+
+        /**
+         * Sets the range of IPv4 multicast groups clients of this
+         * communicator may request their image streams to be sent to.
+         * Requests for other groups are refused. Multicast is disabled
+         * until a range is set. The range applies to connections accepted
+         * afterwards.
+         *
+         * @param first The first group of the range, e.g. "239.192.0.0",
+         *              or nullptr to disable multicast
+         * @param last The last group of the range, e.g. "239.192.0.255",
+         *             or nullptr to only permit 'first'
+         *
+         * @throw the::argument_exception if an address is no multicast group
+         *        or 'last' is lower than 'first'
+         */
+        virtual void set_multicast_groups(const char *first, const char *last = nullptr) = 0;
+
     protected:
 
         /** ctor */
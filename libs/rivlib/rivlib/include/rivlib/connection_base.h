@@ -84,6 +84,26 @@ namespace rivlib {
          */
         virtual const wchar_t *get_uri_wstr(void) const = 0;
 
+        /**
+         * Answer the capabilities negotiated with the connected riv provider
+         * service. Features and codecs can thus be used only with services
+         * supporting them.
+         *
+         * @return The 'ip_capability' bit mask; zero if not connected or if
+         *         the service does not negotiate capabilities
+         */
+        virtual uint32_t get_peer_capabilities(void) const = 0;
+
+        /**
+         * Answer whether the connected riv provider service supports an
+         * image stream subtype
+         *
+         * @param subtype The image stream subtype
+         *
+         * @return True if the subtype is supported
+         */
+        virtual bool is_peer_subtype_supported(uint16_t subtype) const = 0;
+
         /** Dtor */
         virtual ~connection_base(void);
 
@@ -18,6 +18,7 @@
 #include "rivlib/common.h"
 #include "rivlib/api_ptr.h"
 #include "rivlib/connection_base.h"
+#include "rivlib/provider.h"
 
 
 #ifdef __cplusplus
@@ -35,6 +36,36 @@ namespace rivlib {
     RIVLIB_APIEXT template class RIVLIB_API api_ptr<control_connection>;
 
 
+    /**
+     * Optional parameters of the image stream of a data channel
+     */
+    typedef struct _data_channel_options_t {
+
+        /**
+         * The maximum frame rate the provider should send (frames per
+         * second). Zero means unlimited.
+         */
+        unsigned int max_fps;
+
+        /**
+         * The multicast group "address:port" the provider should send the
+         * images to, or nullptr to receive them through the connection. All
+         * clients using the same group share one image stream. The group
+         * must be within the range permitted by the provider's
+         * communicator ('communicator::set_multicast_groups') and must not
+         * be used by another data channel or subtype.
+         */
+        const char *multicast_group;
+
+        /**
+         * The maximum egress rate the provider should send the images with
+         * (bytes per second). Zero means unlimited.
+         */
+        uint64_t max_rate;
+
+    } data_channel_options;
+
+
     /**
      * The control connection channel to a rivlib server
      */
@@ -101,13 +132,48 @@ namespace rivlib {
         virtual void remove_all_listeners(void) = 0;
 
         /**
-         * Sends a message to the connected riv provider service
+         * Sends a message to the connected riv provider service. If a send
+         * window is set, the message is queued and sent together with all
+         * other messages queued within the window.
          *
          * @param id The message id
          * @param size The message data size (in bytes)
          * @param data The message data
+         * @param coalesce If true, the message replaces a queued message
+         *                 with the same id also sent with 'coalesce', e.g.
+         *                 for camera updates of which only the latest
+         *                 matters. Ignored without a send window.
+         */
+        virtual void send(unsigned int id, unsigned int size, const void *data, bool coalesce = false) = 0;
+
+        /**
+         * Sets the send window. Messages sent within the window are batched
+         * into a single frame, sent at the end of the window, which keeps
+         * high-rate steering input from flooding the provider. A window of
+         * zero sends every message immediately (the default) and flushes
+         * queued messages.
+         *
+         * @param window_ms The send window in milliseconds
+         */
+        virtual void set_send_window(unsigned int window_ms) = 0;
+
+        /**
+         * Immediately sends all messages queued within the send window
+         */
+        virtual void flush(void) = 0;
+
+        /**
+         * Queries the runtime metrics of the connected provider and waits
+         * for the answer
+         *
+         * @param metrics Receives the metrics
+         * @param timeout_ms The time to wait for the answer in milliseconds
+         *
+         * @return True if the metrics were received, false if not connected,
+         *         if the service does not support 'ip_capability::metrics'
+         *         or if the timeout expired
          */
-        virtual void send(unsigned int id, unsigned int size, const void *data) = 0;
+        virtual bool query_metrics(provider_metrics& metrics, unsigned int timeout_ms = 1000) = 0;
 
         /**
          * Constructs the uri to a data channel of the connected provider
@@ -124,6 +190,23 @@ namespace rivlib {
          */
         virtual size_t make_data_channel_uri(const char *name, uint16_t type, uint16_t subtype, char *uri, size_t uri_size) = 0;
 
+        /**
+         * Constructs the uri to a data channel of the connected provider
+         * including optional parameters of the image stream
+         *
+         * @param name The name of the data channel
+         * @param type The type of the data channel
+         * @param subtype The subtype of the data channel
+         * @param uri Points to the memory to receive the constructed uri
+         * @param uri_size The size of 'uri' in bytes
+         * @param options The parameters of the image stream
+         *
+         * @return If 'uri' is nullptr, returns the size required to store the
+         *         constructred uri, excluding the terminating zero. If 'uri'
+         *         is not nullptr, returns the number of bytes written.
+         */
+        size_t make_data_channel_uri(const char *name, uint16_t type, uint16_t subtype, char *uri, size_t uri_size, const data_channel_options& options);
+
         /** Dtor */
         virtual ~control_connection(void);
 
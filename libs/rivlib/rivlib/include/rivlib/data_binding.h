@@ -46,7 +46,10 @@ namespace rivlib {
         /**
          * Informs the data_binding that new data is now available.
          * The provider object will start reading this data asynchronously,
-         * if possible.
+         * if possible. Data nobody is waiting for is read on demand, i.e.
+         * it may be read at any time until 'wait_async_data_completed' or
+         * 'wait_async_data_abort' is called. Call one of these before
+         * changing the data.
          */
         virtual void async_data_available(void) = 0;
 
@@ -36,6 +36,32 @@ namespace rivlib {
     RIVLIB_APIEXT template class RIVLIB_API api_ptr<image_stream_connection>;
 
 
+    /**
+     * An image acquired from an image stream connection
+     */
+    typedef struct _image_frame_t {
+
+        /** The width of the image in pixel */
+        uint32_t width;
+
+        /** The height of the image in pixel */
+        uint32_t height;
+
+        /** The uncompressed rgb pixel data (no padding!) */
+        const void *rgbpix;
+
+        /**
+         * The number of the image, counting all images received since the
+         * first call to 'acquire_latest_frame'
+         */
+        uint64_t sequence;
+
+        /** False if the image is an intermediate level of a progressive image stream */
+        bool is_final;
+
+    } image_frame;
+
+
     /**
      * The control connection channel to a rivlib server
      */
@@ -67,6 +93,16 @@ namespace rivlib {
              */
             virtual void on_image_data(ptr comm, uint32_t width, uint32_t height, const void* rgbpix) throw() = 0;
 
+            /**
+             * Answer whether this listener wants to receive the intermediate
+             * levels of progressive image streams. If false, only the final
+             * full resolution level of each frame is passed to
+             * 'on_image_data'. The default implementation returns true.
+             *
+             * @return True if intermediate levels should be received
+             */
+            virtual bool wants_intermediate_levels(void) throw();
+
         };
 
         /**
@@ -88,7 +124,10 @@ namespace rivlib {
         virtual void add_listener(listener* l) = 0;
 
         /**
-         * Removes a listener from this object.
+         * Removes a listener from this object. Images are passed to the
+         * listeners without holding the lock of the connection, so a
+         * listener removed by another thread may still receive the image
+         * being dispatched.
          *
          * @param l The listener to be removed
          */
@@ -109,6 +148,54 @@ namespace rivlib {
          */
         virtual bool is_supported(data_channel_image_stream_subtype subtype) = 0;
 
+        /**
+         * Sets the regions of interest of the image stream. Encoders
+         * supporting regions of interest keep the full quality in these
+         * regions and reduce the quality of the remaining image. The regions
+         * are sent to the provider together with the next image request.
+         *
+         * @param regions The regions of interest in pixel coordinates of
+         *                the full resolution image
+         * @param count The number of regions. Zero clears the regions of
+         *              interest. At most 64 regions are used.
+         */
+        virtual void set_regions_of_interest(const image_region *regions, unsigned int count) = 0;
+
+        /**
+         * Sets the request window of the image stream, i.e. the number of
+         * images the provider may send before the client has received the
+         * first of them. Values larger than one hide the network round trip
+         * time on high latency links. The default is one.
+         *
+         * @param frames The number of images in flight [1..32]
+         */
+        virtual void set_request_window(unsigned int frames) = 0;
+
+        /**
+         * Acquires the newest completely received image without blocking,
+         * e.g. once per iteration of a render loop. The connection keeps
+         * three image buffers, so it always receives into a free buffer
+         * and never waits for the caller. Images are only buffered after
+         * this method has been called for the first time; the listeners are
+         * called regardless.
+         *
+         * The pixel data remains valid until 'release_frame' or the next
+         * call to 'acquire_latest_frame', which implicitly releases the
+         * previous image. Both methods must be called by the same thread.
+         *
+         * @param frame Receives the image. Its 'sequence' equals the one of
+         *              the previous call if no newer image has been received.
+         *
+         * @return False if no image has been received yet
+         */
+        virtual bool acquire_latest_frame(image_frame& frame) = 0;
+
+        /**
+         * Releases the image acquired by 'acquire_latest_frame'. The pixel
+         * data must not be accessed afterwards.
+         */
+        virtual void release_frame(void) = 0;
+
         /** Dtor */
         virtual ~image_stream_connection(void);
 
@@ -42,6 +42,85 @@ namespace rivlib {
     } ip_handshake_id;
 
 
+    /** The version of the ip protocol announced in 'ip_hello' */
+    const uint16_t ip_protocol_version = 1;
+
+
+    /**
+     * Optional protocol features negotiated with 'ip_hello' (32 bit mask)
+     */
+    enum class ip_capability : uint32_t {
+
+        /** Initial requests in the binary encoding */
+        binary_request = 0x01,
+
+        /** Image request windows (image request id 4) */
+        request_window = 0x02,
+
+        /** Regions of interest (image request id 3) */
+        regions_of_interest = 0x04,
+
+        /** Images passed through shared memory to same-host clients ('l' query key) */
+        shared_memory = 0x08,
+
+        /** Image streams sent to UDP multicast groups ('m' query key) */
+        multicast = 0x10,
+
+        /** Limited egress rates of image streams ('r' query key) */
+        rate_limit = 0x20,
+
+        /** Control messages batched by clients ('message_id::multiple') */
+        message_batch = 0x40,
+
+        /** Runtime metrics queried by clients ('message_id::query_metrics') */
+        metrics = 0x80,
+
+    };
+
+
+    /**
+     * Capabilities and limits exchanged after the 'ip_handshake_id'.
+     *
+     * A client supporting the negotiation sends a probe in place of the
+     * initial request: the string request 'ip_request::hello_request', a
+     * zero byte and its hello. Servers predating the negotiation refuse the
+     * request with answer 500, since they do not serve fragments, and close
+     * the connection; the client then connects again as protocol version 0.
+     * Other servers answer 'ip_request::hello_answer' followed by their own
+     * hello, prefixed by its 32-bit length, holding the capabilities
+     * supported by both peers. Afterwards the client sends the initial
+     * request on the same connection. Clients not sending a hello are
+     * served as protocol version 0, without the limits announced in the
+     * server's hello. Peers must ignore bytes beyond the
+     * struct they know, and treat missing fields as zero.
+     * The size of the struct must be 20 bytes.
+     */
+    typedef struct _ip_hello_t {
+
+        /** The protocol version of the sender */
+        uint16_t version;
+
+        /** The size of this struct as known to the sender */
+        uint16_t size;
+
+        /** The 'ip_capability' bit mask */
+        uint32_t capabilities;
+
+        /** The supported image stream subtypes (bit n for subtype n) */
+        uint32_t image_stream_subtypes;
+
+        /** The largest image request window accepted */
+        uint16_t max_request_window;
+
+        /** The largest number of regions of interest accepted */
+        uint16_t max_regions_of_interest;
+
+        /** The largest message body accepted in bytes (0 for unlimited) */
+        uint32_t max_message_size;
+
+    } ip_hello;
+
+
     /**
      * Possible data channel types (16 bit)
      */
@@ -75,9 +154,37 @@ namespace rivlib {
         rgb_mjpeg = 3,
 #endif
 
+        /**
+         * zlib-compressed rgb image pyramids, sending a coarse level first
+         * followed by refinement levels up to the full resolution
+         */
+        rgb_progressive = 4,
+
     };
 
 
+    /**
+     * A rectangular region of an image in pixel coordinates. The origin is
+     * the top left corner of the image.
+     * The size of the struct must be 16 bytes.
+     */
+    typedef struct _image_region_t {
+
+        /** The left edge in pixel */
+        uint32_t x;
+
+        /** The top edge in pixel */
+        uint32_t y;
+
+        /** The width in pixel */
+        uint32_t width;
+
+        /** The height in pixel */
+        uint32_t height;
+
+    } image_region;
+
+
     /**
      * RIV lib ip_communicator message ids (32 bit)
      */
@@ -108,6 +215,67 @@ namespace rivlib {
         /** Internal message of image blobs */
         image_data_blob,
 
+        /**
+         * Internal message announcing the shared memory ring of a same-host
+         * image stream. Replaces any previously announced ring. The images
+         * are sent in-band until the client confirmed that it opened the
+         * ring (image request id 6).
+         *
+         * 1x uint32  number of slots
+         * 1x uint32  size of each slot in bytes
+         * nx char    ASCII name of the shared memory segment
+         */
+        image_data_shm_ring,
+
+        /**
+         * Internal message of an image blob stored in a slot of the shared
+         * memory ring. The slot holds the body of an 'image_data_blob'
+         * message and stays reserved until the client releases it.
+         *
+         * 1x uint32  slot index
+         * 1x uint32  size of the image blob in bytes
+         */
+        image_data_shm_slot,
+
+        /**
+         * Internal message of an image blob passed as sealed memory file
+         * through a Unix domain socket connection. The file descriptor is
+         * attached to the first byte of the message and the file holds the
+         * body of an 'image_data_blob' message.
+         *
+         * 1x uint32  size of the image blob in bytes
+         */
+        image_data_fd,
+
+        /**
+         * Control message of a client batching several messages into one
+         * frame. Only sent to servers announcing 'ip_capability::message_batch'.
+         * Batches must not be nested.
+         *
+         * n times:
+         * 1x SimpleMessageHeader  header of the message
+         * mx char                 body of the message
+         */
+        multiple,
+
+        /**
+         * Call a control connection for the runtime metrics of the connected
+         * provider. Only sent to servers announcing 'ip_capability::metrics'.
+         *
+         * No data.
+         */
+        query_metrics,
+
+        /**
+         * Answer from provider through control connection with its runtime
+         * metrics. Fields appended to 'provider_metrics' by later versions
+         * follow the known fields, so clients must use the transmitted size.
+         *
+         * 1x uint32            size of the metrics in bytes
+         * 1x provider_metrics  the metrics
+         */
+        metrics,
+
     };
 
 
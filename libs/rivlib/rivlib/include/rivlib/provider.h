@@ -37,6 +37,152 @@ namespace rivlib {
      */
     RIVLIB_APIEXT template class RIVLIB_API api_ptr<provider>;
 
+    /**
+     * Send statistics of one client connection of a provider
+     */
+    typedef struct _connection_statistics_t {
+
+        /** The number of images sent completely */
+        uint64_t images_sent;
+
+        /**
+         * The number of images dropped because the client did not receive
+         * them fast enough
+         */
+        uint64_t images_dropped;
+
+        /**
+         * The number of other messages dropped because the client did not
+         * receive them fast enough
+         */
+        uint64_t messages_dropped;
+
+        /** The number of bytes waiting to be sent to the client */
+        uint64_t queued_bytes;
+
+        /**
+         * The number of bytes written to the connection. Images passed
+         * through shared memory are not included.
+         */
+        uint64_t bytes_sent;
+
+    } connection_statistics;
+
+    /**
+     * Histogram of durations with logarithmic buckets
+     */
+    typedef struct _latency_histogram_t {
+
+        /** The number of buckets */
+        static const unsigned int bucket_count = 16;
+
+        /** The number of samples */
+        uint64_t count;
+
+        /** The sum of all samples in milliseconds */
+        double sum_ms;
+
+        /** The largest sample in milliseconds */
+        double max_ms;
+
+        /**
+         * The number of samples per bucket. Bucket 0 counts the samples
+         * below 1 ms, bucket i counts the samples from 2^(i-1) ms up to
+         * 2^i ms, and the last bucket also counts all longer samples.
+         */
+        uint64_t buckets[bucket_count];
+
+    } latency_histogram;
+
+    /**
+     * Runtime metrics of one data binding, summed over the image encoders
+     * serving it
+     */
+    typedef struct _data_binding_metrics_t {
+
+        /** The number of frames the application announced as available */
+        uint64_t frames_available;
+
+        /** The number of frames the encoders copied from the binding */
+        uint64_t frames_captured;
+
+        /** The number of frames encoded */
+        uint64_t frames_encoded;
+
+        /** The number of refinements encoded by progressive encoders */
+        uint64_t refinements_encoded;
+
+        /** The number of bytes of all encoded frames and refinements */
+        uint64_t bytes_encoded;
+
+        /** The number of image encoders currently serving the binding */
+        uint64_t encoders;
+
+        /** The number of image streams currently served */
+        uint64_t image_streams;
+
+        /** The durations of encoding the frames */
+        latency_histogram encode_time;
+
+    } data_binding_metrics;
+
+    /**
+     * Runtime metrics of a provider. Counters are summed over all data
+     * bindings and client connections; counters of connections already
+     * closed are not included.
+     */
+    typedef struct _provider_metrics_t {
+
+        /** The number of data bindings */
+        uint64_t data_bindings;
+
+        /** The number of image encoders */
+        uint64_t encoders;
+
+        /** The number of control connections */
+        uint64_t control_connections;
+
+        /** The number of image streams */
+        uint64_t image_streams;
+
+        /** The number of frames the application announced as available */
+        uint64_t frames_available;
+
+        /** The number of frames the encoders copied from the bindings */
+        uint64_t frames_captured;
+
+        /** The number of frames encoded */
+        uint64_t frames_encoded;
+
+        /** The number of refinements encoded by progressive encoders */
+        uint64_t refinements_encoded;
+
+        /** The number of bytes of all encoded frames and refinements */
+        uint64_t bytes_encoded;
+
+        /** The number of images sent completely */
+        uint64_t images_sent;
+
+        /** The number of images dropped for slow clients */
+        uint64_t images_dropped;
+
+        /** The number of other messages dropped for slow clients */
+        uint64_t messages_dropped;
+
+        /** The number of bytes written to the client connections */
+        uint64_t bytes_sent;
+
+        /** The number of bytes waiting to be sent to the clients */
+        uint64_t queued_bytes;
+
+        /** The durations of encoding the frames */
+        latency_histogram encode_time;
+
+        /** The number of threads of the process wide worker pool */
+        uint64_t pooled_threads;
+
+    } provider_metrics;
+
     /**
      * Implements a provider for remote, interative visualizations
      */
@@ -46,6 +192,63 @@ namespace rivlib {
         /** The pointer type to be used by the applications */
         typedef api_ptr<provider> ptr;
 
+        /**
+         * Possible coalescing of broadcast messages a client has not
+         * received yet
+         */
+        enum class message_coalescing {
+
+            /** Every message is sent */
+            none,
+
+            /**
+             * The message replaces an unsent message with the same id
+             * broadcast with this option, e.g. for steering state updates
+             */
+            latest_per_id
+
+        };
+
+        /**
+         * Possible ways of delivering received user messages to the user
+         * message callbacks
+         */
+        enum class message_delivery {
+
+            /**
+             * The callbacks are called by the I/O thread receiving the
+             * message, possibly concurrently for different clients
+             */
+            immediate,
+
+            /**
+             * The messages are queued and delivered in batches by a
+             * dispatcher thread of the provider
+             */
+            dispatcher_thread,
+
+            /**
+             * The messages are queued until the application calls
+             * 'poll_user_messages'
+             */
+            poll
+
+        };
+
+        /**
+         * Possible policies for user messages received while the inbox of
+         * the provider is full
+         */
+        enum class inbox_overflow {
+
+            /** The received message is dropped */
+            drop_newest,
+
+            /** The oldest queued message is dropped */
+            drop_oldest
+
+        };
+
         /**
          * Type for enumerator functions for enumerating data bindings
          *
@@ -66,6 +269,29 @@ namespace rivlib {
          */
         typedef void (*user_message_callback_delegate)(unsigned int id, unsigned int size, const char *data, void *ctxt);
 
+        /**
+         * Type for enumerator functions for enumerating the send statistics
+         * of the client connections
+         *
+         * @param stats The statistics of the current connection
+         * @param ctxt The context pointer provided when invoking the enumeration
+         *
+         * @return True if the enumeration should continue, false if the enumeration should abort now
+         */
+        typedef bool (*connection_statistics_enumerator)(const connection_statistics& stats, void* ctxt);
+
+        /**
+         * Type for enumerator functions for enumerating the runtime metrics
+         * of the data bindings
+         *
+         * @param binding The current data binding
+         * @param metrics The metrics of the current data binding
+         * @param ctxt The context pointer provided when invoking the enumeration
+         *
+         * @return True if the enumeration should continue, false if the enumeration should abort now
+         */
+        typedef bool (*data_binding_metrics_enumerator)(data_binding::ptr binding, const data_binding_metrics& metrics, void* ctxt);
+
         /**
          * Creates a new rivlib provider object
          *
@@ -171,13 +397,75 @@ namespace rivlib {
         virtual void remove_user_message_callback(user_message_callback_delegate func, void *ctxt = nullptr) = 0;
 
         /**
-         * Broadcasts a message to all connected control clients
+         * Sets how received user messages are delivered to the user message
+         * callbacks. Except for 'immediate' the messages are queued in a
+         * bounded inbox, so slow callbacks do not stall the I/O of the
+         * clients, and the callbacks are never called concurrently.
+         *
+         * @param delivery The delivery mode
+         * @param capacity The maximum number of queued messages
+         * @param overflow The policy for messages received while the inbox is full
+         */
+        virtual void set_user_message_delivery(message_delivery delivery,
+            unsigned int capacity = 1024, inbox_overflow overflow = inbox_overflow::drop_oldest) = 0;
+
+        /**
+         * Delivers queued user messages to the user message callbacks on the
+         * calling thread. Only has an effect with 'message_delivery::poll'.
+         *
+         * @param max_count The maximum number of messages to deliver, or
+         *                  zero for all queued messages
+         *
+         * @return The number of messages delivered
+         */
+        virtual unsigned int poll_user_messages(unsigned int max_count = 0) = 0;
+
+        /**
+         * Broadcasts a message to all connected control clients. The message
+         * is copied once and queued for all clients; the call does not wait
+         * for the message to be sent.
          *
          * @param id The id of the message (should normally be a user message using RIVLIB_USERMSG)
          * @param size The size of the message data in byte
          * @param data The message data
+         * @param coalescing The coalescing with unsent messages
+         */
+        virtual void broadcast_message(unsigned int id, unsigned int size, const char *data,
+            message_coalescing coalescing = message_coalescing::none) = 0;
+
+        /**
+         * Enumerates the send statistics of all client connections, i.e.
+         * control connections and image streams of the data bindings
+         *
+         * @param enumerator The enumerator function called for each connection
+         * @param ctxt The context pointer used when calling the enumerator function
+         */
+        virtual void enumerate_connection_statistics(connection_statistics_enumerator enumerator, void *ctxt = nullptr) = 0;
+
+        /**
+         * Enumerates the runtime metrics of all data bindings
+         *
+         * @param enumerator The enumerator function called for each data binding
+         * @param ctxt The context pointer used when calling the enumerator function
+         */
+        virtual void enumerate_data_binding_metrics(data_binding_metrics_enumerator enumerator, void *ctxt = nullptr) = 0;
+
+        /**
+         * Answer the runtime metrics of the provider. Clients query the same
+         * metrics with 'message_id::query_metrics'.
+         *
+         * @param metrics Receives the metrics
+         */
+        virtual void get_metrics(provider_metrics& metrics) = 0;
+
+        /**
+         * Sets the maximum egress rate of the image data of all client
+         * connections of the provider together. Images are paced to the
+         * rate and dropped if the connections exceed it.
+         *
+         * @param bytes_per_second The maximum rate or zero for unlimited
          */
-        virtual void broadcast_message(unsigned int id, unsigned int size, const char *data) = 0;
+        virtual void set_egress_rate(uint64_t bytes_per_second) = 0;
 
         /** dtor */
         virtual ~provider(void);
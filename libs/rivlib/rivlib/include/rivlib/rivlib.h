@@ -40,6 +40,7 @@
 #include "rivlib/data_binding.h"
 #include "rivlib/raw_image_data_binding.h"
 #include "rivlib/ip_communicator.h"
+#include "rivlib/unix_communicator.h"
 #if defined(VICCI_RIVLIB_WITH_JNI) && (VICCI_RIVLIB_WITH_JNI != 0)
 #include "rivlib/vicci_middleware_broker.h"
 #endif /* defined(VICCI_RIVLIB_WITH_JNI) && (VICCI_RIVLIB_WITH_JNI != 0) */
@@ -0,0 +1,77 @@
+/*
+ * rivlib API
+ * unix_communicator.h
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+
+#ifndef VICCI_RIVLIB_UNIX_COMMUNICATOR_H_INCLUDED
+#define VICCI_RIVLIB_UNIX_COMMUNICATOR_H_INCLUDED
+#if (defined(_MSC_VER) && (_MSC_VER > 1000))
+#pragma once
+#endif /* (defined(_MSC_VER) && (_MSC_VER > 1000)) */
+#if defined(_WIN32) && defined(_MANAGED)
+#pragma managed(push, off)
+#endif /* defined(_WIN32) && defined(_MANAGED) */
+
+#include "rivlib/common.h"
+#include "rivlib/communicator.h"
+
+
+#ifdef __cplusplus
+
+namespace eu_vicci {
+namespace rivlib {
+
+
+    /**
+     * The communication connection using Unix domain sockets for clients
+     * on the same host. The handshake and the messages are the same as
+     * of the ip_communicator. Large images are passed as memory files
+     * instead of being copied through the socket.
+     *
+     * Clients connect through uris with the query key 'u' holding the url
+     * encoded socket name, e.g. "riv://localhost/name?u=%40rivlib".
+     */
+    class RIVLIB_API unix_communicator : public communicator {
+    public:
+
+        /**
+         * Creates a unix_communicator
+         *
+         * @param name The socket name to listen on. Names starting with
+         *             '@' are abstract names, all other names are file
+         *             system paths.
+         *
+         * @throws the::not_supported_exception on Windows
+         */
+        static communicator::ptr create(const char *name);
+
+        /** dtor */
+        virtual ~unix_communicator(void);
+
+    protected:
+
+        /** ctor */
+        unix_communicator(void);
+
+    private:
+
+    };
+
+
+} /* end namespace rivlib */
+} /* end namespace eu_vicci */
+
+#else /* __cplusplus */
+
+#error C API not implemented yet
+
+#endif /* __cplusplus */
+
+
+#if defined(_WIN32) && defined(_MANAGED)
+#pragma managed(pop)
+#endif /* defined(_WIN32) && defined(_MANAGED) */
+#endif /* VICCI_RIVLIB_UNIX_COMMUNICATOR_H_INCLUDED */
@@ -7,6 +7,9 @@
 #include "stdafx.h"
 #include "rivlib/control_connection.h"
 #include "api_impl/control_connection_impl.h"
+#include "the/math/functions.h"
+#include "the/text/string_builder.h"
+#include <vector>
 
 using namespace eu_vicci::rivlib;
 
@@ -35,6 +38,34 @@ control_connection::ptr control_connection::create(void) {
 }
 
 
+/*
+ * control_connection::make_data_channel_uri
+ */
+size_t control_connection::make_data_channel_uri(const char *name, uint16_t type, uint16_t subtype, char *uri, size_t uri_size, const data_channel_options& options) {
+    size_t len = this->make_data_channel_uri(name, type, subtype, nullptr, 0);
+    std::vector<char> base(len + 1, 0);
+    this->make_data_channel_uri(name, type, subtype, base.data(), len);
+
+    // the query parameters of the data channel are not ordered
+    the::text::astring_builder u(base.data());
+    if (options.max_fps > 0) {
+        u.append_formatted("&f=%u", options.max_fps);
+    }
+    if (options.multicast_group != nullptr) {
+        u.append_formatted("&m=%s", options.multicast_group);
+    }
+    if (options.max_rate > 0) {
+        u.append_formatted("&r=%llu", static_cast<unsigned long long>(options.max_rate));
+    }
+
+    if (uri != nullptr) {
+        ::memcpy(uri, u.to_string().c_str(), the::math::minimum<size_t>(uri_size, u.length()));
+    }
+
+    return u.length();
+}
+
+
 /*
  * control_connection::~control_connection
  */
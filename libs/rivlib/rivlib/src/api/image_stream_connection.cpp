@@ -27,6 +27,14 @@ image_stream_connection::listener::~listener(void) {
 }
 
 
+/*
+ * image_stream_connection::listener::wants_intermediate_levels
+ */
+bool image_stream_connection::listener::wants_intermediate_levels(void) throw() {
+    return true;
+}
+
+
 /*
  * image_stream_connection::create
  */
@@ -0,0 +1,40 @@
+/*
+ * unix_communicator.cpp
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+#include "stdafx.h"
+#include "rivlib/unix_communicator.h"
+#include "api_impl/unix_communicator_impl.h"
+#include "the/not_supported_exception.h"
+
+using namespace eu_vicci::rivlib;
+
+
+/*
+ * unix_communicator::create
+ */
+communicator::ptr unix_communicator::create(const char *name) {
+#ifndef _WIN32
+    return new unix_communicator_impl(name);
+#else /* !_WIN32 */
+    throw the::not_supported_exception("unix_communicator::create", __FILE__, __LINE__);
+#endif /* !_WIN32 */
+}
+
+
+/*
+ * unix_communicator::~unix_communicator
+ */
+unix_communicator::~unix_communicator(void) {
+    // intentionally empty
+}
+
+
+/*
+ * unix_communicator::unix_communicator
+ */
+unix_communicator::unix_communicator(void) {
+    // intentionally empty
+}
@@ -6,6 +6,8 @@
  */
 #include "stdafx.h"
 #include "api_impl/control_connection_impl.h"
+#include "the/memory.h"
+#include "the/math/functions.h"
 #include "the/system/threading/auto_lock.h"
 #include "the/text/string_builder.h"
 #include "vislib/SimpleMessage.h"
@@ -17,8 +19,11 @@ using namespace the::system::threading;
 /*
  * control_connection_impl::self_impl::self_impl
  */
-control_connection_impl::self_impl::self_impl(void) : connection_base_impl<control_connection_impl>() {
-    // intentionally empty
+control_connection_impl::self_impl::self_impl(void) : connection_base_impl<control_connection_impl>(),
+        send_window(0), queue(), queued_size(0), send_lock(), queued_event(),
+        terminating(false), worker(nullptr), worker_thread(nullptr),
+        metrics_query_lock(), metrics_lock(), metrics_event() {
+    ::memset(&this->metrics, 0, sizeof(provider_metrics));
 }
 
 
@@ -26,7 +31,7 @@ control_connection_impl::self_impl::self_impl(void) : connection_base_impl<contr
  * control_connection_impl::self_impl::~self_impl
  */
 control_connection_impl::self_impl::~self_impl(void) {
-    // intentionally empty
+    this->stop_flusher();
 }
 
 
@@ -80,6 +85,11 @@ void control_connection_impl::self_impl::communication_core(void) {
             }
 
             // message complete
+            if (msg.GetHeader().GetMessageID() == static_cast<uint32_t>(message_id::metrics)) {
+                // internal answer to 'query_metrics'
+                this->process_metrics(msg.GetBody(), msg.GetHeader().GetBodySize());
+                continue;
+            }
             {
                 auto_lock<self_impl>(*this);
                 size_t l_s = this->get_listeners().size();
@@ -101,22 +111,251 @@ void control_connection_impl::self_impl::communication_core(void) {
 /*
  * control_connection_impl::self_impl::send_message
  */
-void control_connection_impl::self_impl::send_message(unsigned int id, unsigned int size, const void *data) {
-    auto_lock<self_impl>(*this);
-    if (this->get_status() == connection_base::status::connected) {
-        vislib::net::SimpleMessageHeader head;
-        head.SetMessageID(id);
-        head.SetBodySize(size);
-        if (this->send(head.PeekData(), head.GetHeaderSize()) != head.GetHeaderSize()) {
-            throw the::exception("failed to send header package", __FILE__, __LINE__);
-        }
+void control_connection_impl::self_impl::send_message(unsigned int id, unsigned int size, const void *data, bool coalesce) {
+    vislib::net::SimpleMessageHeader head;
+    head.SetMessageID(id);
+    head.SetBodySize(size);
+
+    auto_lock<critical_section> lock(this->send_lock);
+    if (this->get_status() != connection_base::status::connected) return;
+
+    if (this->send_window == 0) {
+        this->flush_queue();
+        this->write(head.PeekData(), head.GetHeaderSize());
         if (size > 0) {
-            if (this->send(data, size) != size) {
-                throw the::exception("failed to send data package", __FILE__, __LINE__);
+            this->write(data, size);
+        }
+        return;
+    }
+
+    size_t msg_size = head.GetHeaderSize() + size;
+    queued_message *m = nullptr;
+    if (coalesce) {
+        for (std::vector<queued_message>::iterator i = this->queue.begin(); i != this->queue.end(); ++i) {
+            if (i->coalesce && (i->id == id)) {
+                // only the latest message matters; replaced in place
+                this->queued_size -= i->data.size();
+                m = &*i;
+                break;
             }
         }
     }
+    if ((m == nullptr) && (this->queued_size + msg_size > max_batch_size)) {
+        this->flush_queue();
+    }
+    if (m == nullptr) {
+        if (this->queue.empty()) {
+            // first message of a new batch starts the send window
+            this->queued_event.set();
+        }
+        this->queue.push_back(queued_message());
+        m = &this->queue.back();
+        m->id = id;
+        m->coalesce = coalesce;
+    }
 
+    m->data.enforce_size(msg_size);
+    ::memcpy(m->data, head.PeekData(), head.GetHeaderSize());
+    if (size > 0) {
+        ::memcpy(m->data.at(head.GetHeaderSize()), data, size);
+    }
+    this->queued_size += msg_size;
+}
+
+
+/*
+ * control_connection_impl::self_impl::set_send_window
+ */
+void control_connection_impl::self_impl::set_send_window(unsigned int window_ms) {
+    if (window_ms == 0) {
+        {
+            auto_lock<critical_section> lock(this->send_lock);
+            this->send_window = 0;
+            this->flush_queue();
+        }
+        this->stop_flusher();
+        return;
+    }
+
+    auto_lock<critical_section> lock(this->send_lock);
+    this->send_window = window_ms;
+    if (this->worker_thread == nullptr) {
+        this->terminating = false;
+        this->worker = new flusher(*this);
+        this->worker_thread = new thread(this->worker);
+        this->worker_thread->start();
+    }
+}
+
+
+/*
+ * control_connection_impl::self_impl::flush
+ */
+void control_connection_impl::self_impl::flush(void) {
+    auto_lock<critical_section> lock(this->send_lock);
+    this->flush_queue();
+}
+
+
+/*
+ * control_connection_impl::self_impl::query_metrics
+ */
+bool control_connection_impl::self_impl::query_metrics(provider_metrics& metrics, unsigned int timeout_ms) {
+    if (!this->has_peer_capability(ip_capability::metrics)) return false;
+
+    auto_lock<critical_section> query_lock(this->metrics_query_lock);
+    this->metrics_event.reset();
+    this->send_message(static_cast<unsigned int>(message_id::query_metrics), 0, nullptr, false);
+    this->flush();
+    if (!this->metrics_event.wait(timeout_ms)) return false;
+
+    auto_lock<critical_section> lock(this->metrics_lock);
+    metrics = this->metrics;
+    return true;
+}
+
+
+/*
+ * control_connection_impl::self_impl::process_metrics
+ */
+void control_connection_impl::self_impl::process_metrics(const void *data, size_t size) {
+    if (size < sizeof(uint32_t)) {
+        throw the::exception("Metrics message truncated", __FILE__, __LINE__);
+    }
+    uint32_t metrics_size = *static_cast<const uint32_t*>(data);
+    if (metrics_size > size - sizeof(uint32_t)) {
+        throw the::exception("Metrics message truncated", __FILE__, __LINE__);
+    }
+
+    {
+        // fields appended by later versions are ignored, missing ones are zero
+        auto_lock<critical_section> lock(this->metrics_lock);
+        ::memset(&this->metrics, 0, sizeof(provider_metrics));
+        ::memcpy(&this->metrics, static_cast<const uint8_t*>(data) + sizeof(uint32_t),
+            the::math::minimum<size_t>(metrics_size, sizeof(provider_metrics)));
+    }
+    this->metrics_event.set();
+}
+
+
+/*
+ * control_connection_impl::self_impl::flusher::flusher
+ */
+control_connection_impl::self_impl::flusher::flusher(self_impl& owner) : runnable(), owner(owner) {
+    // intentionally empty
+}
+
+
+/*
+ * control_connection_impl::self_impl::flusher::~flusher
+ */
+control_connection_impl::self_impl::flusher::~flusher(void) {
+    // intentionally empty
+}
+
+
+/*
+ * control_connection_impl::self_impl::flusher::run
+ */
+int control_connection_impl::self_impl::flusher::run(void) {
+    return this->owner.run_flusher();
+}
+
+
+/*
+ * control_connection_impl::self_impl::flusher::on_thread_terminating
+ */
+thread::termination_behaviour control_connection_impl::self_impl::flusher::on_thread_terminating(void) throw() {
+    return thread::termination_behaviour::graceful;
+}
+
+
+/*
+ * control_connection_impl::self_impl::run_flusher
+ */
+int control_connection_impl::self_impl::run_flusher(void) {
+    while (!this->terminating) {
+        this->queued_event.wait();
+        if (this->terminating) break;
+        thread::sleep(this->send_window);
+        try {
+            this->flush();
+        } catch(...) {
+            // the receiving thread notices the broken connection
+        }
+    }
+    return 0;
+}
+
+
+/*
+ * control_connection_impl::self_impl::stop_flusher
+ */
+void control_connection_impl::self_impl::stop_flusher(void) {
+    thread *t;
+    flusher *w;
+    {
+        auto_lock<critical_section> lock(this->send_lock);
+        t = this->worker_thread;
+        w = this->worker;
+        this->worker_thread = nullptr;
+        this->worker = nullptr;
+        if (t == nullptr) return;
+        this->terminating = true;
+        this->queued_event.set();
+    }
+
+    if (t->is_running()) {
+        t->join();
+    }
+    the::safe_delete(t);
+    the::safe_delete(w);
+}
+
+
+/*
+ * control_connection_impl::self_impl::flush_queue
+ */
+void control_connection_impl::self_impl::flush_queue(void) {
+    if (this->queue.empty()) return;
+    if (this->get_status() != connection_base::status::connected) {
+        this->queue.clear();
+        this->queued_size = 0;
+        return;
+    }
+
+    vislib::net::SimpleMessageHeader head;
+    uint32_t max_msg = this->get_peer_hello().max_message_size;
+    bool batch = (this->queue.size() > 1)
+        && this->has_peer_capability(ip_capability::message_batch)
+        && ((max_msg == 0) || (this->queued_size <= max_msg));
+
+    // servers not supporting batches still receive all messages in one write
+    size_t pos = batch ? head.GetHeaderSize() : 0;
+    the::blob frame(pos + this->queued_size);
+    if (batch) {
+        head.SetMessageID(static_cast<unsigned int>(message_id::multiple));
+        head.SetBodySize(static_cast<vislib::net::SimpleMessageSize>(this->queued_size));
+        ::memcpy(frame, head.PeekData(), head.GetHeaderSize());
+    }
+    for (std::vector<queued_message>::iterator i = this->queue.begin(); i != this->queue.end(); ++i) {
+        ::memcpy(frame.at(pos), i->data, i->data.size());
+        pos += i->data.size();
+    }
+    this->queue.clear();
+    this->queued_size = 0;
+
+    this->write(frame, frame.size());
+}
+
+
+/*
+ * control_connection_impl::self_impl::write
+ */
+void control_connection_impl::self_impl::write(const void *data, size_t size) {
+    if (this->send(data, size) != size) {
+        throw the::exception("failed to send message", __FILE__, __LINE__);
+    }
 }
 
 
@@ -209,11 +448,51 @@ const wchar_t *control_connection_impl::get_uri_wstr(void) const {
 }
 
 
+/*
+ * control_connection_impl::get_peer_capabilities
+ */
+uint32_t control_connection_impl::get_peer_capabilities(void) const {
+    return this->impl.get_peer_capabilities();
+}
+
+
+/*
+ * control_connection_impl::is_peer_subtype_supported
+ */
+bool control_connection_impl::is_peer_subtype_supported(uint16_t subtype) const {
+    return this->impl.is_peer_subtype_supported(subtype);
+}
+
+
 /*
  * control_connection_impl::send
  */
-void control_connection_impl::send(unsigned int id, unsigned int size, const void *data) {
-    this->impl.send_message(id, size, data);
+void control_connection_impl::send(unsigned int id, unsigned int size, const void *data, bool coalesce) {
+    this->impl.send_message(id, size, data, coalesce);
+}
+
+
+/*
+ * control_connection_impl::set_send_window
+ */
+void control_connection_impl::set_send_window(unsigned int window_ms) {
+    this->impl.set_send_window(window_ms);
+}
+
+
+/*
+ * control_connection_impl::flush
+ */
+void control_connection_impl::flush(void) {
+    this->impl.flush();
+}
+
+
+/*
+ * control_connection_impl::query_metrics
+ */
+bool control_connection_impl::query_metrics(provider_metrics& metrics, unsigned int timeout_ms) {
+    return this->impl.query_metrics(metrics, timeout_ms);
 }
 
 
@@ -258,6 +537,10 @@ size_t control_connection_impl::make_data_channel_uri(const char *name, uint16_t
 
     uri_utility::parse_uri(this->get_uri_astr(), uri_scheme, uri_username, uri_host, uri_is_host_v6, uri_host_port, uri_is_port_set, uri_path, uri_query, uri_fragment);
 
+    // the data channel uses the same unix_communicator socket
+    std::string unix_name;
+    bool is_unix = uri_utility::extract_query_value(uri_query, "u", unix_name);
+
     if (!uri_query.empty()) {
         throw the::exception("Uri of control_connection must not include 'query'", __FILE__, __LINE__);
     }
@@ -280,6 +563,9 @@ size_t control_connection_impl::make_data_channel_uri(const char *name, uint16_t
     }
     u.append_formatted("%s?n=%s&t=%u&s=%u", uri_path.c_str(), name,
         static_cast<unsigned int>(type), static_cast<unsigned int>(subtype));
+    if (is_unix) {
+        u.append_formatted("&u=%s", the::text::string_utility::url_encode(unix_name).c_str());
+    }
 
     if (uri != nullptr) {
         ::memcpy(uri, u.to_string().c_str(), the::math::minimum<size_t>(uri_size, u.length()));
@@ -16,8 +16,14 @@
 #include "rivlib/control_connection.h"
 #include "node.h"
 #include "connection_base_impl.h"
+#include "the/blob.h"
 #include "the/string.h"
 #include "the/types.h"
+#include "the/system/threading/critical_section.h"
+#include "the/system/threading/event.h"
+#include "the/system/threading/runnable.h"
+#include "the/system/threading/thread.h"
+#include <vector>
 
 
 namespace eu_vicci {
@@ -102,14 +108,57 @@ namespace rivlib {
          */
         virtual const wchar_t *get_uri_wstr(void) const;
 
+        /**
+         * Answer the capabilities negotiated with the connected riv provider
+         * service
+         *
+         * @return The 'ip_capability' bit mask; zero if not connected or if
+         *         the service does not negotiate capabilities
+         */
+        virtual uint32_t get_peer_capabilities(void) const;
+
+        /**
+         * Answer whether the connected riv provider service supports an
+         * image stream subtype
+         *
+         * @param subtype The image stream subtype
+         *
+         * @return True if the subtype is supported
+         */
+        virtual bool is_peer_subtype_supported(uint16_t subtype) const;
+
         /**
          * Sends a message to the connected riv provider service
          *
          * @param id The message id
          * @param size The message data size (in bytes)
          * @param data The message data
+         * @param coalesce If true, the message replaces a queued message
+         *                 with the same id also sent with 'coalesce'
+         */
+        virtual void send(unsigned int id, unsigned int size, const void *data, bool coalesce = false);
+
+        /**
+         * Sets the send window
+         *
+         * @param window_ms The send window in milliseconds
+         */
+        virtual void set_send_window(unsigned int window_ms);
+
+        /**
+         * Immediately sends all messages queued within the send window
          */
-        virtual void send(unsigned int id, unsigned int size, const void *data);
+        virtual void flush(void);
+
+        /**
+         * Queries the runtime metrics of the connected provider
+         *
+         * @param metrics Receives the metrics
+         * @param timeout_ms The time to wait for the answer in milliseconds
+         *
+         * @return True if the metrics were received
+         */
+        virtual bool query_metrics(provider_metrics& metrics, unsigned int timeout_ms);
 
         /**
          * Locks this node
@@ -193,13 +242,164 @@ namespace rivlib {
             virtual void communication_core(void);
 
             /**
-             * Sends a message to the connected riv provider service
+             * Sends or queues a message to the connected riv provider service
              *
              * @param id The message id
              * @param size The message data size (in bytes)
              * @param data The message data
+             * @param coalesce If true, the message replaces a queued message
+             *                 with the same id also sent with 'coalesce'
+             */
+            void send_message(unsigned int id, unsigned int size, const void *data, bool coalesce);
+
+            /**
+             * Sets the send window, starting or stopping the flusher thread
+             *
+             * @param window_ms The send window in milliseconds
+             */
+            void set_send_window(unsigned int window_ms);
+
+            /**
+             * Sends all queued messages
+             */
+            void flush(void);
+
+            /**
+             * Queries the runtime metrics of the connected provider
+             *
+             * @param metrics Receives the metrics
+             * @param timeout_ms The time to wait for the answer in milliseconds
+             *
+             * @return True if the metrics were received
+             */
+            bool query_metrics(provider_metrics& metrics, unsigned int timeout_ms);
+
+        private:
+
+            /**
+             * Stores the metrics answered by the server and wakes the
+             * waiting query
+             *
+             * @param data The body of the 'message_id::metrics' message
+             * @param size The size of 'data' in bytes
+             */
+            void process_metrics(const void *data, size_t size);
+
+            /** The largest batch sent in bytes */
+            static const size_t max_batch_size = 0x10000;
+
+            /** A message queued within the send window */
+            typedef struct _queued_message_t {
+
+                /** The message id */
+                unsigned int id;
+
+                /** Flag whether the message may be replaced */
+                bool coalesce;
+
+                /** The message header and data */
+                the::blob data;
+
+            } queued_message;
+
+            /** Utility runnable class for the flusher thread */
+            class flusher : public the::system::threading::runnable {
+            public:
+
+                /**
+                 * ctor
+                 *
+                 * @param owner The owning object
+                 */
+                flusher(self_impl& owner);
+
+                /** dtor */
+                virtual ~flusher(void);
+
+                /**
+                 * Perform the work of a thread.
+                 *
+                 * @return The application dependent return code of the thread. This
+                 *         must not be STILL_ACTIVE (259).
+                 */
+                virtual int run(void);
+
+                /**
+                 * Requests the runnable to be terminated
+                 *
+                 * @return graceful
+                 */
+                virtual the::system::threading::thread::termination_behaviour on_thread_terminating(void) throw();
+
+            private:
+
+                /** The owning object */
+                self_impl& owner;
+
+            };
+
+            /**
+             * The flusher thread function
+             *
+             * @return 0
+             */
+            int run_flusher(void);
+
+            /**
+             * Stops the flusher thread if it is running. The caller must not
+             * hold 'send_lock'.
              */
-            void send_message(unsigned int id, unsigned int size, const void *data);
+            void stop_flusher(void);
+
+            /**
+             * Sends the queued messages, as one 'message_id::multiple' frame
+             * if the server supports it. The caller must hold 'send_lock'.
+             */
+            void flush_queue(void);
+
+            /**
+             * Sends data to the server. The caller must hold 'send_lock'.
+             *
+             * @param data The data
+             * @param size The size of the data in bytes
+             */
+            void write(const void *data, size_t size);
+
+            /** The send window in milliseconds */
+            volatile unsigned int send_window;
+
+            /** The messages queued within the send window */
+            std::vector<queued_message> queue;
+
+            /** The number of bytes of the queued messages */
+            size_t queued_size;
+
+            /** Serialises the sending of messages */
+            the::system::threading::critical_section send_lock;
+
+            /** Event set when a new batch starts or the flusher should stop */
+            the::system::threading::event queued_event;
+
+            /** Flag that the flusher thread should terminate */
+            volatile bool terminating;
+
+            /** The runnable of the flusher thread */
+            flusher *worker;
+
+            /** The flusher thread */
+            the::system::threading::thread *worker_thread;
+
+            /** Serialises the metrics queries */
+            the::system::threading::critical_section metrics_query_lock;
+
+            /** Protects 'metrics' */
+            the::system::threading::critical_section metrics_lock;
+
+            /** Event set when the metrics have been received */
+            the::system::threading::event metrics_event;
+
+            /** The metrics last received */
+            provider_metrics metrics;
 
         };
 
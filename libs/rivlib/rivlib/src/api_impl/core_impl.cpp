@@ -6,6 +6,7 @@
  */
 #include "stdafx.h"
 #include "api_impl/core_impl.h"
+#include "the/system/threading/auto_lock.h"
 //#include "the/assert.h"
 //#include <algorithm>
 //#include "the/argument_exception.h"
@@ -18,7 +19,8 @@ using namespace eu_vicci::rivlib;
 /*
  * core_impl::core_impl
  */
-core_impl::core_impl(void) : core(), node(), lock_obj(), log_obj(true) {
+core_impl::core_impl(void) : core(), node(), providers_by_name(),
+        provider_lock(), lock_obj(), log_obj(true) {
     // intentionally empty
 }
 
@@ -197,3 +199,47 @@ void core_impl::unlock(void) {
 error_log& core_impl::log(void) {
     return this->log_obj;
 }
+
+
+/*
+ * core_impl::find_provider
+ */
+api_ptr_base core_impl::find_provider(const std::string& name) {
+    the::system::threading::auto_lock<the::system::threading::critical_section> lock(this->provider_lock);
+    std::unordered_multimap<std::string, api_ptr_base>::iterator i = this->providers_by_name.find(name);
+    return (i != this->providers_by_name.end()) ? i->second : api_ptr_base();
+}
+
+
+/*
+ * core_impl::on_connected
+ */
+void core_impl::on_connected(api_ptr_base peer) {
+    provider *p = dynamic_cast<provider*>(peer.get());
+    if (p != nullptr) {
+        // provider names never change, so the name is a stable key
+        the::system::threading::auto_lock<the::system::threading::critical_section> lock(this->provider_lock);
+        this->providers_by_name.insert(std::make_pair(std::string(p->get_name_astr()), peer));
+    }
+    node::on_connected(peer);
+}
+
+
+/*
+ * core_impl::on_disconnected
+ */
+void core_impl::on_disconnected(api_ptr_base peer) {
+    provider *p = dynamic_cast<provider*>(peer.get());
+    if (p != nullptr) {
+        the::system::threading::auto_lock<the::system::threading::critical_section> lock(this->provider_lock);
+        typedef std::unordered_multimap<std::string, api_ptr_base>::iterator iterator;
+        std::pair<iterator, iterator> range = this->providers_by_name.equal_range(p->get_name_astr());
+        for (iterator i = range.first; i != range.second; ++i) {
+            if (i->second == peer) {
+                this->providers_by_name.erase(i);
+                break;
+            }
+        }
+    }
+    node::on_disconnected(peer);
+}
@@ -16,6 +16,8 @@
 #include "rivlib/core.h"
 #include "node.h"
 #include "the/system/threading/critical_section.h"
+#include <string>
+#include <unordered_map>
 
 
 namespace eu_vicci {
@@ -136,10 +138,40 @@ namespace rivlib {
          */
         virtual error_log& log(void);
 
+        /**
+         * Finds a provider connected to the core by its name in constant
+         * time. If several providers share the name, one of them is returned.
+         *
+         * @param name The name of the provider
+         *
+         * @return The provider or an invalid pointer if none is found
+         */
+        api_ptr_base find_provider(const std::string& name);
+
+        /**
+         * Called to fire the 'connected' event
+         *
+         * @param peer The new peer
+         */
+        virtual void on_connected(api_ptr_base peer);
+
+        /**
+         * Called to fire the 'disconnected' event
+         *
+         * @param peer The peer
+         */
+        virtual void on_disconnected(api_ptr_base peer);
+
     protected:
 
     private:
 
+        /** The providers connected to the core by name */
+        std::unordered_multimap<std::string, api_ptr_base> providers_by_name;
+
+        /** The lock for 'providers_by_name' */
+        the::system::threading::critical_section provider_lock;
+
         /** The thread lock object */
         the::system::threading::critical_section lock_obj;
 
@@ -14,8 +14,21 @@
 #include "data/buffer.h"
 #include "data/image_buffer_metadata.h"
 #include "data/buffer_type.h"
+#include "multicast_frame.h"
+#include "shm_ring.h"
+#include "vislib/IPAddress.h"
+#include "vislib/IPCommEndPoint.h"
+#include "vislib/IPEndPoint.h"
+#include "vislib/SocketException.h"
+#include "vislib/UdpCommChannel.h"
 #include <sstream>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif /* !_WIN32 */
 #include "encoder/image_encoder_rgb_zip.h"
+#include "encoder/image_encoder_rgb_progressive.h"
 #if(USE_MJPEG == 1)
 #  include "encoder/image_encoder_rgb_mjpeg.h"
 #endif
@@ -27,7 +40,9 @@ using namespace the::system::threading;
 /*
  * image_stream_connection_impl::self_impl::self_impl
  */
-image_stream_connection_impl::self_impl::self_impl(void) : connection_base_impl<image_stream_connection_impl>() {
+image_stream_connection_impl::self_impl::self_impl(void) : connection_base_impl<image_stream_connection_impl>(),
+        rois(), rois_changed(false), req_window(1), req_window_changed(false),
+        multicast_group(), frames() {
     // intentionally empty
 }
 
@@ -52,6 +67,8 @@ void image_stream_connection_impl::self_impl::check_uri(std::string &scheme,
     bool has_n = false;
     bool has_t = false;
     bool has_s = false;
+    bool has_l = false;
+    std::string multicast;
 
     std::stringstream stream(query);
     std::string q;
@@ -60,11 +77,22 @@ void image_stream_connection_impl::self_impl::check_uri(std::string &scheme,
         if (the::text::string_utility::starts_with(q, "n=")) has_n = true;
         else if (the::text::string_utility::starts_with(q, "t=")) has_t = true;
         else if (the::text::string_utility::starts_with(q, "s=")) has_s = true;
+        else if (the::text::string_utility::starts_with(q, "m=")) multicast = q.substr(2);
+        else if (the::text::string_utility::starts_with(q, "l=")) has_l = true;
     }
 
     if (!has_n || !has_t || !has_s) {
         throw the::exception("Query incomplete", __FILE__, __LINE__);
     }
+    if (!multicast.empty() && (multicast.rfind(':') == std::string::npos)) {
+        throw the::exception("Multicast group must be 'address:port'", __FILE__, __LINE__);
+    }
+    this->multicast_group = multicast;
+
+    if (multicast.empty() && !has_l) {
+        // the provider uses shared memory if it runs on the same host
+        query += "&l=1";
+    }
 
     if (!fragment.empty()) throw the::exception("Fragments are not allowed for image_stream_connections", __FILE__, __LINE__);
 }
@@ -95,6 +123,9 @@ void image_stream_connection_impl::self_impl::evaluate_answer(unsigned short cod
  */
 void image_stream_connection_impl::self_impl::communication_core(void) {
     vislib::net::SimpleMessage msg;
+    data::buffer::shared_ptr recv_buf;
+    shm_ring shm; // closed when the connection ends
+    uint32_t shm_rings = 0;
     size_t rec = 1;
     the::system::performance_counter timer;
     size_t dat_cnt = 0;
@@ -111,6 +142,18 @@ void image_stream_connection_impl::self_impl::communication_core(void) {
     THE_ASSERT(req_message.bytes[4] = 0x12);
 
     this->send(&req_message.bytes, 5);
+    {
+        // the server starts with a window of one image
+        auto_lock<self_impl> lock(*this);
+        this->req_window_changed = (this->req_window != 1);
+    }
+    this->send_request_window();
+    this->send_regions_of_interest();
+
+    if (!this->multicast_group.empty()) {
+        this->receive_multicast();
+        return;
+    }
 
     while (rec != 0) {
 
@@ -121,32 +164,101 @@ void image_stream_connection_impl::self_impl::communication_core(void) {
             dat_cnt += msg.GetHeader().GetHeaderSize();
             frm_cnt++;
 
-            if (msg.GetHeader().GetBodySize() > 0) {
-                msg.AssertBodySize();
-                rec = this->receive(msg.GetBody(), msg.GetHeader().GetBodySize());
-                if (rec != msg.GetHeader().GetBodySize()) {
+            if (msg.GetHeader().GetMessageID() != static_cast<vislib::net::SimpleMessageID>(message_id::image_data_blob)) {
+                if (msg.GetHeader().GetBodySize() > 0) {
+                    msg.AssertBodySize();
+                    rec = this->receive(msg.GetBody(), msg.GetHeader().GetBodySize());
+                    if (rec != msg.GetHeader().GetBodySize()) {
+                        if (rec == 0) break;
+                        throw the::exception("Incomplete message body", __FILE__, __LINE__);
+                    }
+                    dat_cnt += msg.GetHeader().GetBodySize();
+                }
+
+                if (msg.GetHeader().GetMessageID() == static_cast<vislib::net::SimpleMessageID>(message_id::image_data_shm_ring)) {
+                    if (msg.GetHeader().GetBodySize() < 2 * sizeof(uint32_t)) {
+                        throw the::exception("Shared memory ring message truncated", __FILE__, __LINE__);
+                    }
+
+                    // the provider passes images through the ring only after
+                    // it is confirmed, and keeps sending them in-band if not
+                    message_image_request shm_message;
+                    shm_message.req.id = 6; // shared memory ring answer
+                    shm_message.req.time_code = ++shm_rings;
+                    try {
+                        shm.open(std::string(msg.GetBodyAsAt<char>(2 * sizeof(uint32_t)),
+                                msg.GetHeader().GetBodySize() - 2 * sizeof(uint32_t)),
+                            msg.GetBodyAs<uint32_t>()[0], msg.GetBodyAs<uint32_t>()[1]);
+                    } catch(vislib::Exception) {
+                        // e.g. the provider runs in another container
+                        shm.close();
+                        shm_message.req.time_code = 0;
+                    }
+                    this->send(&shm_message.bytes, 5);
+
+                } else if (msg.GetHeader().GetMessageID() == static_cast<vislib::net::SimpleMessageID>(message_id::image_data_shm_slot)) {
+                    if (msg.GetHeader().GetBodySize() < 2 * sizeof(uint32_t)) {
+                        throw the::exception("Shared memory slot message truncated", __FILE__, __LINE__);
+                    }
+                    this->process_shm_slot(shm, msg.GetBodyAs<uint32_t>()[0], msg.GetBodyAs<uint32_t>()[1]);
+
+                } else if (msg.GetHeader().GetMessageID() == static_cast<vislib::net::SimpleMessageID>(message_id::image_data_fd)) {
+                    if (msg.GetHeader().GetBodySize() < sizeof(uint32_t)) {
+                        throw the::exception("Memory file message truncated", __FILE__, __LINE__);
+                    }
+                    this->process_image_fd(msg.GetBodyAs<uint32_t>()[0]);
+                }
+                // other messages are not interpreted
+
+            } else {
+                // image data is received directly into the buffer blobs
+                size_t body_size = msg.GetHeader().GetBodySize();
+                uint32_t bytes[2];
+                if (body_size < (2 * sizeof(uint32_t) + sizeof(data::image_buffer_metadata))) {
+                    throw the::exception("Image data missing", __FILE__, __LINE__);
+                }
+                rec = this->receive(bytes, 2 * sizeof(uint32_t));
+                if (rec != 2 * sizeof(uint32_t)) {
                     if (rec == 0) break;
                     throw the::exception("Incomplete message body", __FILE__, __LINE__);
                 }
-                // printf("Received %d bytes\n", (int)msg.GetHeader().GetBodySize());
-                dat_cnt += msg.GetHeader().GetBodySize();
-            }
 
-            // message complete
-            if (msg.GetHeader().GetMessageID() == static_cast<vislib::net::SimpleMessageID>(message_id::image_data_blob)) {
-                if (msg.GetHeader().GetBodySize() < (2 * sizeof(uint32_t) + sizeof(data::image_buffer_metadata))) {
+                // reuse the receive buffer if nobody holds on to it anymore
+                if (!recv_buf || !recv_buf.unique()) {
+                    recv_buf = data::buffer::create();
+                }
+                data::buffer::shared_ptr buf = recv_buf;
+                buf->set_type(static_cast<data::buffer_type>(bytes[0]));
+                buf->set_time_code(bytes[1]);
+                size_t meta_size = (buf->type() == data::buffer_type::progressive_rgb_bytes)
+                    ? sizeof(data::progressive_image_buffer_metadata)
+                    : sizeof(data::image_buffer_metadata);
+                if (body_size < (2 * sizeof(uint32_t) + meta_size)) {
                     throw the::exception("Image data missing", __FILE__, __LINE__);
                 }
+                size_t data_size = body_size - (2 * sizeof(uint32_t) + meta_size);
+                if (buf->metadata().size() != meta_size) {
+                    buf->metadata().enforce_size(meta_size);
+                }
+                if (buf->data().size() != data_size) {
+                    buf->data().enforce_size(data_size);
+                }
 
-                // could all be nicer using shallow simple message
-                data::buffer::shared_ptr buf = data::buffer::create();
-                buf->set_type(static_cast<data::buffer_type>(msg.GetBodyAs<uint32_t>()[0]));
-                buf->set_time_code(msg.GetBodyAs<uint32_t>()[1]);
-                buf->metadata().assert_size(sizeof(data::image_buffer_metadata));
-                ::memcpy(buf->metadata(), msg.GetBodyAsAt<void>(sizeof(uint32_t) * 2), sizeof(data::image_buffer_metadata));
-                size_t data_size = msg.GetHeader().GetBodySize() - (2 * sizeof(uint32_t) + sizeof(data::image_buffer_metadata));
-                buf->data().assert_size(data_size);
-                ::memcpy(buf->data(), msg.GetBodyAsAt<void>(2 * sizeof(uint32_t) + sizeof(data::image_buffer_metadata)), data_size);
+                rec = this->receive(buf->metadata(), meta_size);
+                if (rec != meta_size) {
+                    if (rec == 0) break;
+                    throw the::exception("Incomplete message body", __FILE__, __LINE__);
+                }
+                if (data_size > 0) {
+                    rec = this->receive(buf->data(), data_size);
+                    if (rec != data_size) {
+                        if (rec == 0) break;
+                        throw the::exception("Incomplete message body", __FILE__, __LINE__);
+                    }
+                }
+                dat_cnt += body_size;
+
+                bool is_final = encoder::image_encoder_rgb_progressive::is_final_level(buf);
 
                 if (timer.elapsed_milliseconds() >= 1000.0) {
                     // transfer in bit/sec
@@ -175,45 +287,13 @@ void image_stream_connection_impl::self_impl::communication_core(void) {
                 }
 
 
-                if (buf->type() != data::buffer_type::raw_rgb_bytes) {
-                    // decoding!
-                    switch (buf->type()) {
-                    case data::buffer_type::zip_rgb_bytes: {
-                        static encoder::image_encoder_rgb_zip codec; // uck
-                        buf = codec.decode(buf);
-
-                    } break;
-#if(USE_MJPEG == 1)
-                    case data::buffer_type::mjpeg_rgb_bytes: {
-                        static encoder::image_encoder_rgb_mjpeg codec; // uck
-                        buf = codec.decode(buf);
-
-                    } break;
-#endif
-                    default:
-                        throw the::exception("Data conversion is strange", __FILE__, __LINE__);
-                        break;
-                    }
-                }
+                buf = this->decode_image(buf);
 
                 // buffer now completely interpreted
                 // request next frame before decoding (even faster requesting would be nice)
-                req_message.req.id = 2; // follow up frame
-                req_message.req.time_code = buf->time_code();
-                //printf("req(%u, %u)\n", req_message.req.id, req_message.req.time_code);
-                this->send(&req_message.bytes, 5);
-
-                THE_ASSERT(buf->type() == data::buffer_type::raw_rgb_bytes);
-                {
-                    auto_lock<self_impl> lock(*this);
-                    size_t l_s = this->get_listeners().size();
-                    for (size_t i = 0; i < l_s; ++i) {
-                        this->get_listeners()[i]->on_image_data(this->get_owner(), 
-                            buf->metadata().as<data::image_buffer_metadata>()->width,
-                            buf->metadata().as<data::image_buffer_metadata>()->height,
-                            buf->data());
-                    }
-                }
+                this->request_next_image(buf->time_code());
+
+                this->notify_listeners(buf, is_final);
 
             }
 
@@ -224,6 +304,336 @@ void image_stream_connection_impl::self_impl::communication_core(void) {
 }
 
 
+/*
+ * image_stream_connection_impl::self_impl::process_shm_slot
+ */
+void image_stream_connection_impl::self_impl::process_shm_slot(shm_ring& shm, uint32_t slot, uint32_t size) {
+    if (!shm.is_open() || (slot >= shm.slot_count()) || (size > shm.slot_size())
+            || (size < 2 * sizeof(uint32_t) + sizeof(data::image_buffer_metadata))) {
+        throw the::exception("Shared memory slot invalid", __FILE__, __LINE__);
+    }
+
+    message_image_request release_message;
+    release_message.req.id = 5; // release slot
+    release_message.req.time_code = slot;
+
+    // encoded images are copied out so the slot is released before decoding
+    data::buffer::shared_ptr buf = this->process_image_memory(shm.slot(slot), size);
+    this->send(&release_message.bytes, 5);
+    if (!buf) return;
+
+    bool is_final = encoder::image_encoder_rgb_progressive::is_final_level(buf);
+    buf = this->decode_image(buf);
+    this->request_next_image(buf->time_code());
+    this->notify_listeners(buf, is_final);
+}
+
+
+/*
+ * image_stream_connection_impl::self_impl::process_image_fd
+ */
+void image_stream_connection_impl::self_impl::process_image_fd(uint32_t size) {
+#ifndef _WIN32
+    int fd = this->take_received_fd();
+    if (fd < 0) {
+        throw the::exception("Memory file missing", __FILE__, __LINE__);
+    }
+
+    // the provider seals the file, so its size cannot change anymore
+    struct stat st;
+    if ((::fstat(fd, &st) != 0) || (static_cast<uint64_t>(st.st_size) < size)
+            || (size < 2 * sizeof(uint32_t) + sizeof(data::image_buffer_metadata))) {
+        ::close(fd);
+        throw the::exception("Memory file invalid", __FILE__, __LINE__);
+    }
+    void *mem = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mem == MAP_FAILED) {
+        throw the::exception("Failed to map memory file", __FILE__, __LINE__);
+    }
+
+    data::buffer::shared_ptr buf;
+    try {
+        buf = this->process_image_memory(static_cast<const uint8_t*>(mem), size);
+    } catch(...) {
+        ::munmap(mem, size);
+        throw;
+    }
+    ::munmap(mem, size);
+    if (!buf) return;
+
+    bool is_final = encoder::image_encoder_rgb_progressive::is_final_level(buf);
+    buf = this->decode_image(buf);
+    this->request_next_image(buf->time_code());
+    this->notify_listeners(buf, is_final);
+
+#else /* !_WIN32 */
+    throw the::exception("Memory files are not supported", __FILE__, __LINE__);
+#endif /* !_WIN32 */
+}
+
+
+/*
+ * image_stream_connection_impl::self_impl::process_image_memory
+ */
+data::buffer::shared_ptr image_stream_connection_impl::self_impl::process_image_memory(
+        const uint8_t *mem, size_t size) {
+    data::buffer_type type = static_cast<data::buffer_type>(reinterpret_cast<const uint32_t*>(mem)[0]);
+    uint32_t time_code = reinterpret_cast<const uint32_t*>(mem)[1];
+
+    if (type == data::buffer_type::raw_rgb_bytes) {
+        // raw images are handed to the listeners directly from the memory
+        const data::image_buffer_metadata *meta = reinterpret_cast<const data::image_buffer_metadata*>(
+            mem + 2 * sizeof(uint32_t));
+        if (size < 2 * sizeof(uint32_t) + sizeof(data::image_buffer_metadata)
+                + static_cast<size_t>(meta->width) * meta->height * 3) {
+            throw the::exception("Image data missing", __FILE__, __LINE__);
+        }
+        this->request_next_image(time_code);
+        this->notify_listeners(meta->width, meta->height,
+            mem + 2 * sizeof(uint32_t) + sizeof(data::image_buffer_metadata), true);
+        return nullptr;
+    }
+
+    data::buffer::shared_ptr buf = data::buffer::create();
+    buf->set_type(type);
+    buf->set_time_code(time_code);
+    size_t meta_size = (type == data::buffer_type::progressive_rgb_bytes)
+        ? sizeof(data::progressive_image_buffer_metadata)
+        : sizeof(data::image_buffer_metadata);
+    if (size < 2 * sizeof(uint32_t) + meta_size) {
+        throw the::exception("Image data missing", __FILE__, __LINE__);
+    }
+    buf->metadata().assert_size(meta_size);
+    ::memcpy(buf->metadata(), mem + 2 * sizeof(uint32_t), meta_size);
+    size_t data_size = size - (2 * sizeof(uint32_t) + meta_size);
+    buf->data().assert_size(data_size);
+    ::memcpy(buf->data(), mem + 2 * sizeof(uint32_t) + meta_size, data_size);
+
+    return buf;
+}
+
+
+/*
+ * image_stream_connection_impl::self_impl::request_next_image
+ */
+void image_stream_connection_impl::self_impl::request_next_image(unsigned int time_code) {
+    message_image_request req_message;
+
+    this->send_regions_of_interest();
+    this->send_request_window();
+    req_message.req.id = 2; // follow up frame
+    req_message.req.time_code = time_code;
+    //printf("req(%u, %u)\n", req_message.req.id, req_message.req.time_code);
+    this->send(&req_message.bytes, 5);
+}
+
+
+/*
+ * image_stream_connection_impl::self_impl::receive_multicast
+ */
+void image_stream_connection_impl::self_impl::receive_multicast(void) {
+    using namespace vislib::net;
+
+    size_t colon = this->multicast_group.rfind(':');
+    IPAddress group = IPAddress::Create(this->multicast_group.substr(0, colon).c_str());
+    unsigned short port = static_cast<unsigned short>(
+        the::text::string_utility::parse_int(this->multicast_group.c_str() + colon + 1));
+
+    vislib::SmartRef<UdpCommChannel> udp = UdpCommChannel::Create(UdpCommChannel::FLAG_REUSE_ADDRESS);
+    udp->Bind(IPCommEndPoint::Create(IPEndPoint(IPAddress::ANY, port)));
+    udp->GetSocket().SetRcvBuf(multicast_receive_buffer_size);
+    udp->GetSocket().JoinMulticastGroup(group);
+
+    multicast_frame_assembler assembler;
+    the::blob datagram(sizeof(multicast_fragment_header) + multicast_fragment_payload);
+
+    try {
+        // the tcp connection stays open to keep the subscription alive
+        while (this->get_status() == connection_base::status::connected) {
+            SIZE_T size;
+            try {
+                size = udp->GetSocket().Receive(datagram, datagram.size(),
+                    multicast_poll_timeout, 0, false);
+            } catch(SocketException ex) {
+                if (ex.IsTimeout()) continue;
+                throw;
+            }
+
+            data::buffer::shared_ptr buf = assembler.add(datagram, size);
+            if (!buf) continue;
+
+            bool is_final = encoder::image_encoder_rgb_progressive::is_final_level(buf);
+            try {
+                buf = this->decode_image(buf);
+            } catch(the::exception) {
+                continue; // malformed frame, the datagrams are not authenticated
+            }
+            this->notify_listeners(buf, is_final);
+        }
+
+    } catch(...) {
+        try {
+            udp->GetSocket().LeaveMulticastGroup(group);
+            udp->Close();
+        } catch(...) {
+        }
+        throw;
+    }
+
+    udp->GetSocket().LeaveMulticastGroup(group);
+    udp->Close();
+}
+
+
+/*
+ * image_stream_connection_impl::self_impl::decode_image
+ */
+data::buffer::shared_ptr image_stream_connection_impl::self_impl::decode_image(data::buffer::shared_ptr buf) {
+    if (buf->type() != data::buffer_type::raw_rgb_bytes) {
+        // decoding!
+        switch (buf->type()) {
+        case data::buffer_type::zip_rgb_bytes: {
+            static encoder::image_encoder_rgb_zip codec; // uck
+            buf = codec.decode(buf);
+
+        } break;
+        case data::buffer_type::progressive_rgb_bytes: {
+            static encoder::image_encoder_rgb_progressive codec; // uck
+            buf = codec.decode(buf);
+
+        } break;
+#if(USE_MJPEG == 1)
+        case data::buffer_type::mjpeg_rgb_bytes: {
+            static encoder::image_encoder_rgb_mjpeg codec; // uck
+            buf = codec.decode(buf);
+
+        } break;
+#endif
+        default:
+            throw the::exception("Data conversion is strange", __FILE__, __LINE__);
+            break;
+        }
+    }
+
+    // the listeners and the frame buffer copy width * height * 3 bytes
+    if ((buf->type() != data::buffer_type::raw_rgb_bytes)
+            || (buf->metadata().size() < sizeof(data::image_buffer_metadata))
+            || (static_cast<uint64_t>(buf->metadata().as<data::image_buffer_metadata>()->width)
+                * buf->metadata().as<data::image_buffer_metadata>()->height * 3 > buf->data().size())) {
+        throw the::exception("Image data missing", __FILE__, __LINE__);
+    }
+    return buf;
+}
+
+
+/*
+ * image_stream_connection_impl::self_impl::notify_listeners
+ */
+void image_stream_connection_impl::self_impl::notify_listeners(data::buffer::shared_ptr buf, bool is_final) {
+    THE_ASSERT(buf->type() == data::buffer_type::raw_rgb_bytes);
+    this->notify_listeners(
+        buf->metadata().as<data::image_buffer_metadata>()->width,
+        buf->metadata().as<data::image_buffer_metadata>()->height,
+        buf->data(), is_final);
+}
+
+
+/*
+ * image_stream_connection_impl::self_impl::notify_listeners
+ */
+void image_stream_connection_impl::self_impl::notify_listeners(unsigned int width, unsigned int height,
+        const void *rgb, bool is_final) {
+    // written before the listeners are called, which may be slow
+    this->frames.write(width, height, rgb, is_final);
+
+    // slow listeners must not block the application calling into this
+    // connection, so they are called outside of the lock
+    std::vector<image_stream_connection::listener*> listeners;
+    {
+        auto_lock<self_impl> lock(*this);
+        listeners = this->get_listeners();
+    }
+    for (size_t i = 0, l_s = listeners.size(); i < l_s; ++i) {
+        if (!is_final && !listeners[i]->wants_intermediate_levels()) continue;
+        listeners[i]->on_image_data(this->get_owner(), width, height, rgb);
+    }
+}
+
+
+/*
+ * image_stream_connection_impl::self_impl::set_regions_of_interest
+ */
+void image_stream_connection_impl::self_impl::set_regions_of_interest(const image_region *regions, unsigned int count) {
+    auto_lock<self_impl> lock(*this);
+    if (count > max_image_regions_of_interest) count = max_image_regions_of_interest;
+    if (regions == nullptr) count = 0;
+    this->rois.assign(regions, regions + count);
+    this->rois_changed = true;
+}
+
+
+/*
+ * image_stream_connection_impl::self_impl::send_regions_of_interest
+ */
+void image_stream_connection_impl::self_impl::send_regions_of_interest(void) {
+    std::vector<image_region> regions;
+    {
+        auto_lock<self_impl> lock(*this);
+        if (!this->rois_changed) return;
+        regions = this->rois;
+        this->rois_changed = false;
+    }
+    if (!this->has_peer_capability(ip_capability::regions_of_interest)) return;
+    if (regions.size() > this->get_peer_hello().max_regions_of_interest) {
+        regions.resize(this->get_peer_hello().max_regions_of_interest);
+    }
+
+    message_image_request req_message;
+    req_message.req.id = 3;
+    req_message.req.time_code = static_cast<uint32_t>(regions.size());
+    this->send(&req_message.bytes, 5);
+    if (!regions.empty()) {
+        this->send(regions.data(), regions.size() * sizeof(image_region));
+    }
+}
+
+
+/*
+ * image_stream_connection_impl::self_impl::set_request_window
+ */
+void image_stream_connection_impl::self_impl::set_request_window(unsigned int frames) {
+    auto_lock<self_impl> lock(*this);
+    if (frames < 1) frames = 1;
+    if (frames > max_image_request_window) frames = max_image_request_window;
+    if (this->req_window != frames) {
+        this->req_window = frames;
+        this->req_window_changed = true;
+    }
+}
+
+
+/*
+ * image_stream_connection_impl::self_impl::send_request_window
+ */
+void image_stream_connection_impl::self_impl::send_request_window(void) {
+    message_image_request req_message;
+    {
+        auto_lock<self_impl> lock(*this);
+        if (!this->req_window_changed) return;
+        req_message.req.time_code = this->req_window;
+        this->req_window_changed = false;
+    }
+    if (!this->has_peer_capability(ip_capability::request_window)) return;
+    if (req_message.req.time_code > this->get_peer_hello().max_request_window) {
+        req_message.req.time_code = this->get_peer_hello().max_request_window;
+    }
+
+    req_message.req.id = 4;
+    this->send(&req_message.bytes, 5);
+}
+
+
 /*
  * image_stream_connection_impl::image_stream_connection_impl
  */
@@ -313,6 +723,22 @@ const wchar_t *image_stream_connection_impl::get_uri_wstr(void) const {
 }
 
 
+/*
+ * image_stream_connection_impl::get_peer_capabilities
+ */
+uint32_t image_stream_connection_impl::get_peer_capabilities(void) const {
+    return this->impl.get_peer_capabilities();
+}
+
+
+/*
+ * image_stream_connection_impl::is_peer_subtype_supported
+ */
+bool image_stream_connection_impl::is_peer_subtype_supported(uint16_t subtype) const {
+    return this->impl.is_peer_subtype_supported(subtype);
+}
+
+
 /*
  * image_stream_connection_impl::lock
  */
@@ -343,9 +769,42 @@ error_log& image_stream_connection_impl::log(void) {
 bool image_stream_connection_impl::is_supported(data_channel_image_stream_subtype subtype) {
     return (subtype == data_channel_image_stream_subtype::rgb_raw)
         || (subtype == data_channel_image_stream_subtype::rgb_zip)
+        || (subtype == data_channel_image_stream_subtype::rgb_progressive)
 #if(USE_MJPEG == 1)
         || (subtype == data_channel_image_stream_subtype::rgb_mjpeg)
 #endif
         ;
     // TODO: support more ...
 }
+
+
+/*
+ * image_stream_connection_impl::set_regions_of_interest
+ */
+void image_stream_connection_impl::set_regions_of_interest(const image_region *regions, unsigned int count) {
+    this->impl.set_regions_of_interest(regions, count);
+}
+
+
+/*
+ * image_stream_connection_impl::set_request_window
+ */
+void image_stream_connection_impl::set_request_window(unsigned int frames) {
+    this->impl.set_request_window(frames);
+}
+
+
+/*
+ * image_stream_connection_impl::acquire_latest_frame
+ */
+bool image_stream_connection_impl::acquire_latest_frame(image_frame& frame) {
+    return this->impl.get_frames().acquire(frame);
+}
+
+
+/*
+ * image_stream_connection_impl::release_frame
+ */
+void image_stream_connection_impl::release_frame(void) {
+    this->impl.get_frames().release();
+}
@@ -15,6 +15,9 @@
 #include "rivlib/image_stream_connection.h"
 #include "node.h"
 #include "connection_base_impl.h"
+#include "data/buffer.h"
+#include "frame_triple_buffer.h"
+#include "shm_ring.h"
 #include "the/string.h"
 #include "the/types.h"
 
@@ -101,6 +104,25 @@ namespace rivlib {
          */
         virtual const wchar_t *get_uri_wstr(void) const;
 
+        /**
+         * Answer the capabilities negotiated with the connected riv provider
+         * service
+         *
+         * @return The 'ip_capability' bit mask; zero if not connected or if
+         *         the service does not negotiate capabilities
+         */
+        virtual uint32_t get_peer_capabilities(void) const;
+
+        /**
+         * Answer whether the connected riv provider service supports an
+         * image stream subtype
+         *
+         * @param subtype The image stream subtype
+         *
+         * @return True if the subtype is supported
+         */
+        virtual bool is_peer_subtype_supported(uint16_t subtype) const;
+
         /**
          * Locks this node
          */
@@ -128,6 +150,37 @@ namespace rivlib {
          */
         virtual bool is_supported(data_channel_image_stream_subtype subtype);
 
+        /**
+         * Sets the regions of interest of the image stream
+         *
+         * @param regions The regions of interest in pixel coordinates of
+         *                the full resolution image
+         * @param count The number of regions. Zero clears the regions of
+         *              interest.
+         */
+        virtual void set_regions_of_interest(const image_region *regions, unsigned int count);
+
+        /**
+         * Sets the request window of the image stream
+         *
+         * @param frames The number of images in flight
+         */
+        virtual void set_request_window(unsigned int frames);
+
+        /**
+         * Acquires the newest completely received image without blocking
+         *
+         * @param frame Receives the image
+         *
+         * @return False if no image has been received yet
+         */
+        virtual bool acquire_latest_frame(image_frame& frame);
+
+        /**
+         * Releases the image acquired by 'acquire_latest_frame'
+         */
+        virtual void release_frame(void);
+
     private:
 
         /**
@@ -177,6 +230,135 @@ namespace rivlib {
              */
             virtual void communication_core(void);
 
+            /**
+             * Sets the regions of interest to be sent with the next request
+             *
+             * @param regions The regions of interest
+             * @param count The number of regions
+             */
+            void set_regions_of_interest(const image_region *regions, unsigned int count);
+
+            /**
+             * Sets the request window to be sent with the next request
+             *
+             * @param frames The number of images in flight
+             */
+            void set_request_window(unsigned int frames);
+
+            /**
+             * Answer the buffer of the newest images
+             *
+             * @return The buffer of the newest images
+             */
+            inline frame_triple_buffer& get_frames(void) {
+                return this->frames;
+            }
+
+        private:
+
+            /** The timeout for polling the multicast socket in milliseconds */
+            static const int multicast_poll_timeout = 250;
+
+            /** The receive buffer size of the multicast socket in bytes */
+            static const int multicast_receive_buffer_size = 0x400000;
+
+            /**
+             * Receives the images from the multicast group until the
+             * connection is closed
+             */
+            void receive_multicast(void);
+
+            /**
+             * Decodes an image buffer to raw rgb bytes
+             *
+             * @param buf The received image buffer
+             *
+             * @return The decoded image buffer
+             */
+            data::buffer::shared_ptr decode_image(data::buffer::shared_ptr buf);
+
+            /**
+             * Passes a decoded image to the listeners
+             *
+             * @param buf The decoded image buffer
+             * @param is_final False if the image is an intermediate level
+             */
+            void notify_listeners(data::buffer::shared_ptr buf, bool is_final);
+
+            /**
+             * Passes a decoded image to the listeners
+             *
+             * @param width The width of the image in pixel
+             * @param height The height of the image in pixel
+             * @param rgb The rgb bytes of the image
+             * @param is_final False if the image is an intermediate level
+             */
+            void notify_listeners(unsigned int width, unsigned int height, const void *rgb, bool is_final);
+
+            /**
+             * Processes an image stored in the shared memory ring and
+             * releases its slot
+             *
+             * @param shm The shared memory ring
+             * @param slot The slot index
+             * @param size The size of the image blob in bytes
+             */
+            void process_shm_slot(shm_ring& shm, uint32_t slot, uint32_t size);
+
+            /**
+             * Processes an image passed as memory file
+             *
+             * @param size The size of the image blob in bytes
+             */
+            void process_image_fd(uint32_t size);
+
+            /**
+             * Passes a raw image blob in shared memory directly to the
+             * listeners or copies an encoded one into a new buffer
+             *
+             * @param mem The image blob (type, time code, metadata and data)
+             * @param size The size of the image blob in bytes
+             *
+             * @return The buffer to be decoded or nullptr if the image has
+             *         already been passed to the listeners
+             */
+            data::buffer::shared_ptr process_image_memory(const uint8_t *mem, size_t size);
+
+            /**
+             * Requests the next image from the server
+             *
+             * @param time_code The time code of the last image received
+             */
+            void request_next_image(unsigned int time_code);
+
+            /**
+             * Sends the request window to the server if it changed
+             */
+            void send_request_window(void);
+
+            /**
+             * Sends the regions of interest to the server if they changed
+             */
+            void send_regions_of_interest(void);
+
+            /** The regions of interest */
+            std::vector<image_region> rois;
+
+            /** Flag whether the regions of interest need to be sent */
+            bool rois_changed;
+
+            /** The request window */
+            unsigned int req_window;
+
+            /** Flag whether the request window needs to be sent */
+            bool req_window_changed;
+
+            /** The multicast group "address:port" or empty to receive through the connection */
+            std::string multicast_group;
+
+            /** The buffer of the newest images for 'acquire_latest_frame' */
+            frame_triple_buffer frames;
+
         };
 
         /**
@@ -10,13 +10,11 @@
 #include "the/assert.h"
 #include "the/memory.h"
 #include "the/math/functions.h"
-#include "the/system/system_information.h"
 #include "the/text/string_builder.h"
 #include "vislib/IPCommEndPoint.h"
 #include "vislib/SocketException.h"
 #include "vislib/PeerDisconnectedException.h"
 #include "vislib/Trace.h"
-#include "vislib/NetworkInformation.h"
 
 using namespace eu_vicci::rivlib;
 
@@ -26,8 +24,9 @@ using namespace eu_vicci::rivlib;
  */
 ip_communicator_impl::ip_communicator_impl(unsigned short port)
         : ip_communicator(), element_node(), runnable(), port(port), comm(),
-        worker(nullptr), public_uri_cache_src(), public_uri_cache(),
-        public_uri_cache_lock() {
+        worker(nullptr), egress(new token_bucket()), multicast_groups(),
+        multicast_groups_lock(), public_uri_cache(), public_uri_cache_lock() {
+    this->multicast_groups = multicast_sender::parse_group_range(nullptr, nullptr);
     vislib::net::Socket::Startup();
     this->worker = new the::system::threading::thread(this);
 }
@@ -37,7 +36,6 @@ ip_communicator_impl::ip_communicator_impl(unsigned short port)
  * ip_communicator_impl::~ip_communicator_impl
  */
 ip_communicator_impl::~ip_communicator_impl(void) {
-    this->public_uri_cache_src = nullptr; // do not delete
     THE_ASSERT(this->worker != nullptr);
     if (this->worker->is_running()) {
         this->worker->terminate(true);
@@ -113,8 +111,15 @@ int ip_communicator_impl::run(void) {
                 this->log().info("ip_communicator: incoming connection request");
 
                 {
-                    api_ptr_base conn(new ip_connection(client));
+                    ip_connection *c = new ip_connection(client);
+                    api_ptr_base conn(c);
+                    c->set_communicator_egress(this->egress);
+                    {
+                        the::system::threading::auto_lock<the::system::threading::critical_section> lock(this->multicast_groups_lock);
+                        c->set_multicast_groups(this->multicast_groups);
+                    }
                     this->connect(conn);
+                    c->start();
                 }
                 client.Release();
 
@@ -179,9 +184,8 @@ int ip_communicator_impl::run(void) {
  * ip_communicator_impl::count_public_uris
  */
 size_t ip_communicator_impl::count_public_uris(provider::ptr prov) {
-    the::system::threading::auto_lock<the::system::threading::critical_section>(this->public_uri_cache_lock);
-    this->assert_public_uri_cache(prov);
-    return this->public_uri_cache.size();
+    the::system::threading::auto_lock<the::system::threading::critical_section> lock(this->public_uri_cache_lock);
+    return this->assert_public_uri_cache(prov).size();
 }
 
 
@@ -189,11 +193,11 @@ size_t ip_communicator_impl::count_public_uris(provider::ptr prov) {
  * ip_communicator_impl::public_uri
  */
 size_t ip_communicator_impl::public_uri(provider::ptr prov, size_t idx, char *buf, size_t buflen) {
-    the::system::threading::auto_lock<the::system::threading::critical_section>(this->public_uri_cache_lock);
-    this->assert_public_uri_cache(prov);
+    the::system::threading::auto_lock<the::system::threading::critical_section> lock(this->public_uri_cache_lock);
+    const std::vector<std::string>& uris = this->assert_public_uri_cache(prov);
 
-    if (idx >= this->public_uri_cache.size()) return 0;
-    std::string& s = this->public_uri_cache[idx];
+    if (idx >= uris.size()) return 0;
+    const std::string& s = uris[idx];
     if (buf == nullptr) return s.size();
 
     size_t l = the::math::minimum<size_t>(s.size(), buflen);
@@ -203,80 +207,63 @@ size_t ip_communicator_impl::public_uri(provider::ptr prov, size_t idx, char *bu
 }
 
 
+/*
+ * ip_communicator_impl::set_egress_rate
+ */
+void ip_communicator_impl::set_egress_rate(uint64_t bytes_per_second) {
+    this->egress->set_rate(bytes_per_second);
+}
+
+
+/*
+ * ip_communicator_impl::set_multicast_groups
+ */
+void ip_communicator_impl::set_multicast_groups(const char *first, const char *last) {
+    multicast_group_range range = multicast_sender::parse_group_range(first, last);
+    the::system::threading::auto_lock<the::system::threading::critical_section> lock(this->multicast_groups_lock);
+    this->multicast_groups = range;
+}
+
+
 /*
  * ip_communicator_impl::assert_public_uri_cache
  */
-void ip_communicator_impl::assert_public_uri_cache(provider::ptr prov) {
+const std::vector<std::string>& ip_communicator_impl::assert_public_uri_cache(provider::ptr prov) {
     THE_ASSERT(prov.get() != nullptr);
-    if (this->public_uri_cache_src == prov.get()) return;
-    this->public_uri_cache_src = prov.get();
-    this->public_uri_cache.clear();
+    network_interfaces::snapshot_ptr net = network_interfaces::instance().get();
+
+    std::map<const provider*, public_uri_entry>::iterator i = this->public_uri_cache.find(prov.get());
+    if ((i != this->public_uri_cache.end())
+            && (i->second.generation == net->generation)
+            && (i->second.name == prov->get_name_wstr())) {
+        return i->second.uris;
+    }
+
+    if ((i == this->public_uri_cache.end())
+            && (this->public_uri_cache.size() >= max_public_uri_cache_size)) {
+        // entries of deleted providers are never looked up again
+        this->public_uri_cache.clear();
+    }
+    public_uri_entry& e = this->public_uri_cache[prov.get()];
+    e.name = prov->get_name_wstr();
+    e.generation = net->generation;
+    e.uris.clear();
 
     // names always as global uris with port
     std::string safe_name(the::text::string_utility::url_encode(prov->get_name_wstr()));
 
     // 1: network name
-    std::string comp_name;
-    the::system::system_information::computer_name(comp_name);
-    this->public_uri_cache.push_back(the::text::astring_builder::format("riv://%s:%u/%s", comp_name.c_str(), this->port, safe_name.c_str()));
+    e.uris.push_back(the::text::astring_builder::format("riv://%s:%u/%s", net->computer_name.c_str(), this->port, safe_name.c_str()));
 
     // 2: IPv4
-    vislib::net::NetworkInformation::AdapterList ads;
-    vislib::net::NetworkInformation::GetAdaptersForType(ads, vislib::net::NetworkInformation::Adapter::Type::TYPE_ETHERNET);
-    vislib::net::NetworkInformation::AdapterList ads2;
-    vislib::net::NetworkInformation::GetAdaptersForType(ads2, vislib::net::NetworkInformation::Adapter::Type::TYPE_IEEE80211);
-    for (size_t i = 0; i < ads2.Count(); i++) ads.Add(ads2[i]);
-    // TYPE_LOOPBACK etc. does not make any sense here, because I want address how I can be found
-
-    for (size_t i = 0; i < ads.Count(); i++) {
-        const vislib::net::NetworkInformation::Adapter &a = ads[i];
-
-        vislib::net::NetworkInformation::Confidence conf;
-        vislib::net::NetworkInformation::Adapter::OperStatus stat = a.GetStatus(&conf);
-        if (conf != vislib::net::NetworkInformation::INVALID) {
-            if ((stat != vislib::net::NetworkInformation::Adapter::OperStatus::OPERSTATUS_UP)
-                    && (stat != vislib::net::NetworkInformation::Adapter::OperStatus::OPERSTATUS_UNKNOWN)) {
-                // skip adapters which are most likely down
-                continue;
-            }
-        }
-
-        try {
-            vislib::net::IPAgnosticAddress addr = a.GetUnicastAddress(vislib::net::IPAgnosticAddress::AddressFamily::FAMILY_INET);
-            if (!addr.IsV4()) continue;
-            vislib::StringA addrStr(addr.ToStringA());
-            if (!addrStr.IsEmpty()) {
-                this->public_uri_cache.push_back(the::text::astring_builder::format("riv://%s:%u/%s", addrStr.PeekBuffer(), this->port, safe_name.c_str()));
-            }
-
-        } catch(...) {
-        }
+    for (size_t j = 0, cnt = net->ipv4.size(); j < cnt; ++j) {
+        e.uris.push_back(the::text::astring_builder::format("riv://%s:%u/%s", net->ipv4[j].c_str(), this->port, safe_name.c_str()));
     }
 
     // 3: IPv6
-    for (size_t i = 0; i < ads.Count(); i++) {
-        const vislib::net::NetworkInformation::Adapter &a = ads[i];
-
-        vislib::net::NetworkInformation::Confidence conf;
-        vislib::net::NetworkInformation::Adapter::OperStatus stat = a.GetStatus(&conf);
-        if (conf != vislib::net::NetworkInformation::INVALID) {
-            if ((stat != vislib::net::NetworkInformation::Adapter::OperStatus::OPERSTATUS_UP)
-                    && (stat != vislib::net::NetworkInformation::Adapter::OperStatus::OPERSTATUS_UNKNOWN)) {
-                // skip adapters which are most likely down
-                continue;
-            }
-        }
-
-        try {
-            vislib::net::IPAgnosticAddress addr = a.GetUnicastAddress(vislib::net::IPAgnosticAddress::AddressFamily::FAMILY_INET6);
-            if (!addr.IsV6()) continue;
-            vislib::StringA addrStr(addr.ToStringA());
-            if (!addrStr.IsEmpty()) {
-                this->public_uri_cache.push_back(the::text::astring_builder::format("riv://[%s]:%u/%s", addrStr.PeekBuffer(), this->port, safe_name.c_str()));
-            }
-
-        } catch(...) {
-        }
+    for (size_t j = 0, cnt = net->ipv6.size(); j < cnt; ++j) {
+        e.uris.push_back(the::text::astring_builder::format("riv://[%s]:%u/%s", net->ipv6[j].c_str(), this->port, safe_name.c_str()));
     }
 
+    return e.uris;
 }
@@ -15,11 +15,17 @@
 #include "rivlib/common.h"
 #include "rivlib/ip_communicator.h"
 #include "element_node.h"
+#include "multicast_sender.h"
+#include "network_interfaces.h"
+#include "token_bucket.h"
 #include "the/system/threading/runnable.h"
 #include "the/system/threading/thread.h"
 #include "vislib/Socket.h"
 #include "vislib/SmartRef.h"
 #include "vislib/TcpCommChannel.h"
+#include <map>
+#include <string>
+#include <vector>
 
 
 namespace eu_vicci {
@@ -95,17 +101,56 @@ namespace rivlib {
          */
         virtual size_t public_uri(provider::ptr prov, size_t idx, char *buf, size_t buflen);
 
+        /**
+         * Sets the maximum egress rate of the image data of all client
+         * connections of this communicator together
+         *
+         * @param bytes_per_second The maximum rate or zero for unlimited
+         */
+        virtual void set_egress_rate(uint64_t bytes_per_second);
+
+        /**
+         * Sets the range of IPv4 multicast groups clients of this
+         * communicator may request their image streams to be sent to
+         *
+         * @param first The first group of the range or nullptr to disable
+         *              multicast
+         * @param last The last group of the range or nullptr to only
+         *             permit 'first'
+         */
+        virtual void set_multicast_groups(const char *first, const char *last = nullptr);
+
     protected:
 
     private:
 
+        /** The public uris of one provider */
+        typedef struct _public_uri_entry_t {
+
+            /** The name of the provider the uris were built for */
+            std::wstring name;
+
+            /** The generation of the interface snapshot the uris were built from */
+            uint64_t generation;
+
+            /** The public uris */
+            std::vector<std::string> uris;
+
+        } public_uri_entry;
+
+        /** The maximum number of providers in the public uri cache */
+        static const size_t max_public_uri_cache_size = 64;
+
         /**
-         * Rebuilds the public uri cache is the specified provider is not the
-         * one the current public uri cache was built for
+         * Answer the public uris of a provider, building them if they are
+         * not cached or if the network interfaces changed. The caller must
+         * hold 'public_uri_cache_lock'.
          *
-         * @param prov The provided to use the public uri cache on next
+         * @param prov The provider
+         *
+         * @return The public uris of the provider
          */
-        void assert_public_uri_cache(provider::ptr prov);
+        const std::vector<std::string>& assert_public_uri_cache(provider::ptr prov);
 
         /** The tcp port to listen at */
         unsigned short port;
@@ -116,11 +161,17 @@ namespace rivlib {
         /** The server worker thread */
         the::system::threading::thread *worker;
 
-        /** The provider the public uri cache was built for */
-        provider* public_uri_cache_src;
+        /** The egress token bucket of all client connections */
+        token_bucket::shared_ptr egress;
+
+        /** The range of multicast groups the clients may request */
+        multicast_group_range multicast_groups;
+
+        /** The lock for 'multicast_groups' */
+        the::system::threading::critical_section multicast_groups_lock;
 
         /** The public uri cache */
-        std::vector<std::string> public_uri_cache;
+        std::map<const provider*, public_uri_entry> public_uri_cache;
 
         /** The lock object when accessing the public uri cache */
         the::system::threading::critical_section public_uri_cache_lock;
@@ -8,9 +8,14 @@
 #include "api_impl/provider_impl.h"
 #include "the/text/string_converter.h"
 #include "the/assert.h"
+#include "the/blob.h"
 #include "the/text/string_builder.h"
 #include "raw_image_data_binding_impl.h"
 #include "ip_connection.h"
+#include "rivlib/image_data_binding.h"
+#include "encoder/image_encoder_base.h"
+#include "executor.h"
+#include "metrics_utility.h"
 
 using namespace eu_vicci::rivlib;
 
@@ -19,7 +24,8 @@ using namespace eu_vicci::rivlib;
  * provider_impl::provider_impl
  */
 provider_impl::provider_impl(const the::wstring& name) : provider(), element_node(),
-        name_astr(), name_wstr(name), on_user_msg() {
+        name_astr(), name_wstr(name), on_user_msg(), egress(new token_bucket()),
+        inbox(message_inbox::target_delegate(*this, &provider_impl::deliver_user_message)) {
     the::text::string_converter::convert(this->name_astr, this->name_wstr);
 }
 
@@ -28,6 +34,7 @@ provider_impl::provider_impl(const the::wstring& name) : provider(), element_nod
  * provider_impl::~provider_impl
  */
 provider_impl::~provider_impl(void) {
+    this->inbox.stop();
     this->disconnect_all();
 }
 
@@ -121,18 +128,118 @@ void provider_impl::remove_user_message_callback(user_message_callback_delegate
 }
 
 
+/*
+ * provider_impl::set_user_message_delivery
+ */
+void provider_impl::set_user_message_delivery(message_delivery delivery,
+        unsigned int capacity, inbox_overflow overflow) {
+    this->inbox.configure(delivery, capacity, overflow);
+}
+
+
+/*
+ * provider_impl::poll_user_messages
+ */
+unsigned int provider_impl::poll_user_messages(unsigned int max_count) {
+    return this->inbox.poll(max_count);
+}
+
+
 /*
  * provider_impl::broadcast_message
  */
-void provider_impl::broadcast_message(unsigned int id, unsigned int size, const char *data) {
-    std::vector<api_ptr_base> peers = this->select<rivlib::ip_connection>();
+void provider_impl::broadcast_message(unsigned int id, unsigned int size, const char *data,
+        message_coalescing coalescing) {
+    peer_range<ip_connection> peers = this->peers_of<ip_connection>();
+    if (peers.empty()) return;
+
+    // serialise once, all connections share the body
+    std::shared_ptr<the::blob> body = std::make_shared<the::blob>(size);
+    if (size > 0) {
+        ::memcpy(body->at(0), data, size);
+    }
+    bool replace = (coalescing == message_coalescing::latest_per_id);
+
+    for (size_t i = 0, cnt = peers.size(); i < cnt; ++i) {
+        ip_connection* p = peers[i];
+        if (!p->is_control_channel()) continue;
+        p->post_message(id, body, replace);
+    }
+
+}
+
+
+/*
+ * provider_impl::enumerate_connection_statistics
+ */
+void provider_impl::enumerate_connection_statistics(connection_statistics_enumerator enumerator, void *ctxt) {
+    // control connections are peers of the provider, image streams are
+    // peers of the encoders connected to the data bindings
+    std::vector<api_ptr_base> conns = this->select<ip_connection>();
+    std::vector<api_ptr_base> bindings = this->select<image_data_binding>();
+    for (size_t i = 0, bcnt = bindings.size(); i < bcnt; ++i) {
+        node *b = dynamic_cast<node*>(bindings[i].get());
+        if (b == nullptr) continue;
+        std::vector<api_ptr_base> encs = b->select<encoder::image_encoder_base>();
+        for (size_t j = 0, ecnt = encs.size(); j < ecnt; ++j) {
+            node *e = dynamic_cast<node*>(encs[j].get());
+            if (e == nullptr) continue;
+            std::vector<api_ptr_base> ec = e->select<ip_connection>();
+            conns.insert(conns.end(), ec.begin(), ec.end());
+        }
+    }
+
+    for (size_t i = 0, cnt = conns.size(); i < cnt; ++i) {
+        ip_connection* p = dynamic_cast<ip_connection*>(conns[i].get());
+        if (p == nullptr) continue;
+        if (!enumerator(p->get_statistics(), ctxt)) break;
+    }
+}
+
+
+/*
+ * provider_impl::enumerate_data_binding_metrics
+ */
+void provider_impl::enumerate_data_binding_metrics(data_binding_metrics_enumerator enumerator, void *ctxt) {
+    std::vector<api_ptr_base> peers = this->select<data_binding>();
     size_t peer_cnt = peers.size();
     for (size_t i = 0; i < peer_cnt; ++i) {
-        ip_connection* p = dynamic_cast<ip_connection*>(peers[i].get());
-        if (p == nullptr) continue;
-        p->send_message(id, size, data);
+        // 'select' answers plain api_ptr_base objects
+        raw_image_data_binding_impl *b = dynamic_cast<raw_image_data_binding_impl*>(peers[i].get());
+        if (b == nullptr) continue;
+        data_binding_metrics m;
+        b->get_metrics(m);
+        if (!enumerator(data_binding::ptr(b), m, ctxt)) break;
+    }
+}
+
+
+/*
+ * provider_impl::get_metrics
+ */
+void provider_impl::get_metrics(provider_metrics& metrics) {
+    ::memset(&metrics, 0, sizeof(provider_metrics));
+
+    std::vector<api_ptr_base> bindings = this->select<image_data_binding>();
+    for (size_t i = 0, cnt = bindings.size(); i < cnt; ++i) {
+        raw_image_data_binding_impl *b = dynamic_cast<raw_image_data_binding_impl*>(bindings[i].get());
+        if (b == nullptr) continue;
+        data_binding_metrics m;
+        b->get_metrics(m);
+        metrics_utility::add(metrics, m);
     }
 
+    metrics.control_connections = this->peers_of<ip_connection>().size();
+    this->enumerate_connection_statistics(&provider_impl::add_connection_statistics, &metrics);
+    metrics.pooled_threads = executor::instance().count();
+}
+
+
+/*
+ * provider_impl::set_egress_rate
+ */
+void provider_impl::set_egress_rate(uint64_t bytes_per_second) {
+    this->egress->set_rate(bytes_per_second);
 }
 
 
@@ -180,6 +287,16 @@ std::vector<data_channel_info> provider_impl::query_channels(void) {
 
             rv.push_back(dci);
 
+            ptr = reinterpret_cast<uintptr_t>(dbs[i].get());
+            ::memcpy(buf, &ptr, sizeof(uintptr_t));
+            dci.name = the::text::string_utility::to_hex_astring(buf, sizeof(uintptr_t));
+
+            dci.type = data_channel_type::image_stream;
+            dci.subtype.image_stream = data_channel_image_stream_subtype::rgb_progressive;
+            dci.quality = 20; // compressed, coarse images arrive early on slow links
+
+            rv.push_back(dci);
+
 #if(USE_MJPEG == 1)
             ptr = reinterpret_cast<uintptr_t>(dbs[i].get());
             ::memcpy(buf, &ptr, sizeof(uintptr_t));
@@ -203,5 +320,22 @@ std::vector<data_channel_info> provider_impl::query_channels(void) {
  * provider_impl::on_user_message_received
  */
 void provider_impl::on_user_message_received(unsigned int id, unsigned int size, const char *data) {
+    this->inbox.push(id, size, data);
+}
+
+
+/*
+ * provider_impl::deliver_user_message
+ */
+void provider_impl::deliver_user_message(unsigned int id, unsigned int size, const char *data) {
     this->on_user_msg(id, size, data);
 }
+
+
+/*
+ * provider_impl::add_connection_statistics
+ */
+bool provider_impl::add_connection_statistics(const connection_statistics& stats, void *ctxt) {
+    metrics_utility::add(*static_cast<provider_metrics*>(ctxt), stats);
+    return true;
+}
@@ -18,6 +18,8 @@
 #include "the/string.h"
 #include "the/multicast_delegate.h"
 #include "data_channel_info.h"
+#include "token_bucket.h"
+#include "message_inbox.h"
 #include <vector>
 
 
@@ -103,13 +105,81 @@ namespace rivlib {
         virtual void remove_user_message_callback(user_message_callback_delegate func, void *ctxt = nullptr);
 
         /**
-         * Broadcasts a message to all connected control clients
+         * Sets how received user messages are delivered to the user message
+         * callbacks
+         *
+         * @param delivery The delivery mode
+         * @param capacity The maximum number of queued messages
+         * @param overflow The policy for messages received while the inbox is full
+         */
+        virtual void set_user_message_delivery(message_delivery delivery,
+            unsigned int capacity = 1024, inbox_overflow overflow = inbox_overflow::drop_oldest);
+
+        /**
+         * Delivers queued user messages to the user message callbacks on the
+         * calling thread
+         *
+         * @param max_count The maximum number of messages to deliver, or
+         *                  zero for all queued messages
+         *
+         * @return The number of messages delivered
+         */
+        virtual unsigned int poll_user_messages(unsigned int max_count = 0);
+
+        /**
+         * Broadcasts a message to all connected control clients. The message
+         * is copied once and queued for all clients; the call does not wait
+         * for the message to be sent.
          *
          * @param id The id of the message (should normally be a user message using RIVLIB_USERMSG)
          * @param size The size of the message data in byte
          * @param data The message data
+         * @param coalescing The coalescing with unsent messages
+         */
+        virtual void broadcast_message(unsigned int id, unsigned int size, const char *data,
+            message_coalescing coalescing = message_coalescing::none);
+
+        /**
+         * Enumerates the send statistics of all client connections, i.e.
+         * control connections and image streams of the data bindings
+         *
+         * @param enumerator The enumerator function called for each connection
+         * @param ctxt The context pointer used when calling the enumerator function
+         */
+        virtual void enumerate_connection_statistics(connection_statistics_enumerator enumerator, void *ctxt = nullptr);
+
+        /**
+         * Enumerates the runtime metrics of all data bindings
+         *
+         * @param enumerator The enumerator function called for each data binding
+         * @param ctxt The context pointer used when calling the enumerator function
+         */
+        virtual void enumerate_data_binding_metrics(data_binding_metrics_enumerator enumerator, void *ctxt = nullptr);
+
+        /**
+         * Answer the runtime metrics of the provider
+         *
+         * @param metrics Receives the metrics
+         */
+        virtual void get_metrics(provider_metrics& metrics);
+
+        /**
+         * Sets the maximum egress rate of the image data of all client
+         * connections of the provider together. Images are paced to the
+         * rate and dropped if the connections exceed it.
+         *
+         * @param bytes_per_second The maximum rate or zero for unlimited
          */
-        virtual void broadcast_message(unsigned int id, unsigned int size, const char *data);
+        virtual void set_egress_rate(uint64_t bytes_per_second);
+
+        /**
+         * Answer the egress token bucket shared by all client connections
+         *
+         * @return The egress token bucket
+         */
+        inline token_bucket::shared_ptr get_egress_bucket(void) const {
+            return this->egress;
+        }
 
         /**
          * Answer all data channels available at this provider
@@ -131,6 +201,25 @@ namespace rivlib {
 
     private:
 
+        /**
+         * Adds the statistics of a connection to the metrics of the provider
+         *
+         * @param stats The statistics of the connection
+         * @param ctxt The metrics of the provider
+         *
+         * @return true
+         */
+        static bool add_connection_statistics(const connection_statistics& stats, void *ctxt);
+
+        /**
+         * Calls the user message callbacks
+         *
+         * @param id The id of the message
+         * @param size The size of the message data in byte
+         * @param data The message data
+         */
+        void deliver_user_message(unsigned int id, unsigned int size, const char *data);
+
         /** the name of the provider */
         the::astring name_astr;
 
@@ -140,6 +229,12 @@ namespace rivlib {
         /** Delegate fired when a user message is received */
         the::multicast_delegate<the::delegate<void, unsigned int, unsigned int, const char *> > on_user_msg;
 
+        /** The egress token bucket of all client connections */
+        token_bucket::shared_ptr egress;
+
+        /** The inbox of the received user messages */
+        message_inbox inbox;
+
     };
 
 
@@ -8,6 +8,7 @@
 #include "api_impl/raw_image_data_binding_impl.h"
 #include "encoder/image_encoder_base.h"
 #include "the/assert.h"
+#include "the/system/threading/auto_lock.h"
 
 using namespace eu_vicci::rivlib;
 
@@ -20,7 +21,8 @@ raw_image_data_binding_impl::raw_image_data_binding_impl(const void *data,
         image_data_type dat_type, image_orientation img_ori,
         unsigned int scan_width)
         : raw_image_data_binding(width, height, col_type, dat_type, img_ori, scan_width),
-        element_node(), data_ptr(data), raw_buffer() {
+        element_node(), data_ptr(data), raw_buffer(), frames_available(0),
+        metrics_lock() {
     THE_ASSERT(this->data_ptr != nullptr);
     // intentionally empty
 }
@@ -36,14 +38,26 @@ raw_image_data_binding_impl::~raw_image_data_binding_impl(void) {
 }
 
 
+/*
+ * raw_image_data_binding_impl::get_kind
+ */
+node_kind raw_image_data_binding_impl::get_kind(void) const {
+    return kind;
+}
+
+
 /*
  * raw_image_data_binding_impl::async_data_available
  */
 void raw_image_data_binding_impl::async_data_available(void) {
-    std::vector<api_ptr_base> consumers = this->select<encoder::image_encoder_base>();
+    this->metrics_lock.lock();
+    this->frames_available++;
+    this->metrics_lock.unlock();
+
+    // called per frame; uses the typed peer index without allocating
+    peer_range<encoder::image_encoder_base> consumers = this->peers_of<encoder::image_encoder_base>();
     for (size_t i = 0, cnt = consumers.size(); i < cnt; ++i) {
-        encoder::image_encoder_base* encoder = dynamic_cast<encoder::image_encoder_base*>(consumers[i].get());
-        encoder->start_new_input_encoding();
+        consumers[i]->start_new_input_encoding();
     }
 }
 
@@ -52,10 +66,9 @@ void raw_image_data_binding_impl::async_data_available(void) {
  * raw_image_data_binding_impl::is_async_operation_running
  */
 bool raw_image_data_binding_impl::is_async_operation_running(void) {
-    std::vector<api_ptr_base> consumers = this->select<encoder::image_encoder_base>();
+    peer_range<encoder::image_encoder_base> consumers = this->peers_of<encoder::image_encoder_base>();
     for (size_t i = 0, cnt = consumers.size(); i < cnt; ++i) {
-        encoder::image_encoder_base* encoder = dynamic_cast<encoder::image_encoder_base*>(consumers[i].get());
-        if (encoder->is_input_encoding_running()) return true;
+        if (consumers[i]->is_input_encoding_running()) return true;
     }
     return false;
 }
@@ -65,10 +78,9 @@ bool raw_image_data_binding_impl::is_async_operation_running(void) {
  * raw_image_data_binding_impl::wait_async_data_completed
  */
 void raw_image_data_binding_impl::wait_async_data_completed(void) {
-    std::vector<api_ptr_base> consumers = this->select<encoder::image_encoder_base>();
+    peer_range<encoder::image_encoder_base> consumers = this->peers_of<encoder::image_encoder_base>();
     for (size_t i = 0, cnt = consumers.size(); i < cnt; ++i) {
-        encoder::image_encoder_base* encoder = dynamic_cast<encoder::image_encoder_base*>(consumers[i].get());
-        encoder->wait_input_encoding(false);
+        consumers[i]->wait_input_encoding(false);
     }
 }
 
@@ -77,9 +89,24 @@ void raw_image_data_binding_impl::wait_async_data_completed(void) {
  * raw_image_data_binding_impl::wait_async_data_abort
  */
 void raw_image_data_binding_impl::wait_async_data_abort(void) {
-    std::vector<api_ptr_base> consumers = this->select<encoder::image_encoder_base>();
+    peer_range<encoder::image_encoder_base> consumers = this->peers_of<encoder::image_encoder_base>();
+    for (size_t i = 0, cnt = consumers.size(); i < cnt; ++i) {
+        consumers[i]->wait_input_encoding(true);
+    }
+}
+
+
+/*
+ * raw_image_data_binding_impl::get_metrics
+ */
+void raw_image_data_binding_impl::get_metrics(data_binding_metrics& metrics) {
+    ::memset(&metrics, 0, sizeof(data_binding_metrics));
+    this->metrics_lock.lock();
+    metrics.frames_available = this->frames_available;
+    this->metrics_lock.unlock();
+
+    peer_range<encoder::image_encoder_base> consumers = this->peers_of<encoder::image_encoder_base>();
     for (size_t i = 0, cnt = consumers.size(); i < cnt; ++i) {
-        encoder::image_encoder_base* encoder = dynamic_cast<encoder::image_encoder_base*>(consumers[i].get());
-        encoder->wait_input_encoding(true);
+        consumers[i]->add_metrics(metrics);
     }
 }
@@ -14,8 +14,10 @@
 
 
 #include "rivlib/raw_image_data_binding.h"
+#include "rivlib/provider.h"
 #include "element_node.h"
 #include "data/buffer.h"
+#include "the/system/threading/critical_section.h"
 
 
 namespace eu_vicci {
@@ -27,6 +29,9 @@ namespace rivlib {
     class raw_image_data_binding_impl : public raw_image_data_binding, public element_node {
     public:
 
+        /** The kind of this node in the peer indexes */
+        static const node_kind kind = node_kind::image_data_binding;
+
         /**
          * ctor
          *
@@ -49,6 +54,13 @@ namespace rivlib {
         /** dtor */
         virtual ~raw_image_data_binding_impl(void);
 
+        /**
+         * Answer the kind of this node
+         *
+         * @return node_kind::image_data_binding
+         */
+        virtual node_kind get_kind(void) const;
+
         /**
          * Informs the data_binding that new data is now available.
          * The provider object will start reading this data asynchronously,
@@ -75,6 +87,14 @@ namespace rivlib {
          */
         virtual void wait_async_data_abort(void);
 
+        /**
+         * Answer the runtime metrics of the binding and of the image
+         * encoders serving it
+         *
+         * @param metrics Receives the metrics
+         */
+        void get_metrics(data_binding_metrics& metrics);
+
         /**
          * Answer the data buffer with a specified offset (in bytes) and in a
          * specified pointer type
@@ -100,6 +120,12 @@ namespace rivlib {
         /** The raw image data buffer */
         data::buffer::shared_ptr raw_buffer;
 
+        /** The number of frames announced by 'async_data_available' */
+        uint64_t frames_available;
+
+        /** The lock for the metrics */
+        the::system::threading::critical_section metrics_lock;
+
     };
 
 
@@ -0,0 +1,205 @@
+/*
+ * unix_communicator_impl.cpp
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+#include "stdafx.h"
+#include "api_impl/unix_communicator_impl.h"
+
+#ifndef _WIN32
+
+#include "ip_connection.h"
+#include "unix_socket.h"
+#include "the/assert.h"
+#include "the/memory.h"
+#include "the/math/functions.h"
+#include "the/text/string_builder.h"
+#include "the/text/string_utility.h"
+#include "vislib/SocketException.h"
+#include "vislib/TcpCommChannel.h"
+#include <cerrno>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace eu_vicci::rivlib;
+
+
+/*
+ * unix_communicator_impl::unix_communicator_impl
+ */
+unix_communicator_impl::unix_communicator_impl(const char *name)
+        : unix_communicator(), element_node(), runnable(), name(name),
+        server(), worker(nullptr), egress(new token_bucket()), multicast_groups(),
+        multicast_groups_lock() {
+    THE_ASSERT(name != nullptr);
+    this->multicast_groups = multicast_sender::parse_group_range(nullptr, nullptr);
+    vislib::net::Socket::Startup();
+    this->worker = new the::system::threading::thread(this);
+}
+
+
+/*
+ * unix_communicator_impl::~unix_communicator_impl
+ */
+unix_communicator_impl::~unix_communicator_impl(void) {
+    THE_ASSERT(this->worker != nullptr);
+    if (this->worker->is_running()) {
+        this->worker->terminate(true);
+    }
+    the::safe_delete(this->worker);
+    vislib::net::Socket::Cleanup();
+}
+
+
+/*
+ * unix_communicator_impl::on_core_discovered
+ */
+void unix_communicator_impl::on_core_discovered(void) {
+    element_node::on_core_discovered();
+    if (this->worker->is_running()) {
+        this->worker->terminate(true);
+    }
+    this->worker->start();
+}
+
+
+/*
+ * unix_communicator_impl::on_core_lost
+ */
+void unix_communicator_impl::on_core_lost(void) {
+    element_node::on_core_lost();
+    if (this->worker->is_running()) {
+        this->worker->terminate(true);
+    }
+}
+
+
+/*
+ * unix_communicator_impl::on_thread_terminating
+ */
+the::system::threading::thread::termination_behaviour
+unix_communicator_impl::on_thread_terminating(void) throw() {
+    if (this->server.IsValid()) {
+        // wakes the thread blocking in 'accept'
+        ::shutdown(this->server.GetHandle(), SHUT_RDWR);
+        return the::system::threading::thread::termination_behaviour::graceful;
+    }
+    return the::system::threading::thread::termination_behaviour::forceful;
+}
+
+
+/*
+ * unix_communicator_impl::run
+ */
+int unix_communicator_impl::run(void) {
+    using namespace vislib::net;
+
+    this->log().info("unix_communicator: started");
+
+    try {
+        this->server = Socket(unix_socket::listen(this->name));
+
+        while (true) {
+            SOCKET s = ::accept4(this->server.GetHandle(), nullptr, nullptr, SOCK_CLOEXEC);
+            if (s < 0) {
+                if ((errno == EINTR) || (errno == ECONNABORTED)) continue;
+                if (errno == EINVAL) break; // expected behaviour when server is closed
+                throw SocketException(__FILE__, __LINE__);
+            }
+            this->log().info("unix_communicator: incoming connection request");
+
+            vislib::SmartRef<TcpCommChannel> client;
+            try {
+                Socket socket(s);
+                client = TcpCommChannel::Attach(socket);
+                {
+                    ip_connection *c = new ip_connection(client);
+                    api_ptr_base conn(c);
+                    c->enable_fd_passing();
+                    c->set_communicator_egress(this->egress);
+                    {
+                        the::system::threading::auto_lock<the::system::threading::critical_section> lock(this->multicast_groups_lock);
+                        c->set_multicast_groups(this->multicast_groups);
+                    }
+                    this->connect(conn);
+                    c->start();
+                }
+                client.Release();
+
+            } catch(...) {
+                try {
+                    if (!client.IsNull()) client->Close();
+                    else ::close(s);
+                } catch(...) {
+                }
+                client.Release();
+            }
+        }
+
+    } catch(vislib::Exception ex) {
+        this->log().error("unix_communicator server closed: %s (%s, %d)\n",
+            ex.GetMsgA(), ex.GetFile(), ex.GetLine());
+
+    } catch(...) {
+        this->log().error("unix_communicator server closed: unexpected exception\n");
+
+    }
+
+    try {
+        if (this->server.IsValid()) this->server.Close();
+    } catch(...) {
+    }
+    unix_socket::unlink(this->name);
+
+    this->log().info("unix_communicator: stopped");
+
+    return 0;
+}
+
+
+/*
+ * unix_communicator_impl::count_public_uris
+ */
+size_t unix_communicator_impl::count_public_uris(provider::ptr prov) {
+    THE_ASSERT(prov.get() != nullptr);
+    return 1;
+}
+
+
+/*
+ * unix_communicator_impl::public_uri
+ */
+size_t unix_communicator_impl::public_uri(provider::ptr prov, size_t idx, char *buf, size_t buflen) {
+    THE_ASSERT(prov.get() != nullptr);
+    if (idx > 0) return 0;
+
+    std::string s = the::text::astring_builder::format("riv://localhost/%s?u=%s",
+        the::text::string_utility::url_encode(prov->get_name_wstr()).c_str(),
+        the::text::string_utility::url_encode(this->name).c_str());
+    if (buf == nullptr) return s.size();
+    size_t l = the::math::minimum<size_t>(s.size(), buflen);
+    ::memcpy(buf, s.c_str(), l);
+
+    return l;
+}
+
+
+/*
+ * unix_communicator_impl::set_egress_rate
+ */
+void unix_communicator_impl::set_egress_rate(uint64_t bytes_per_second) {
+    this->egress->set_rate(bytes_per_second);
+}
+
+
+/*
+ * unix_communicator_impl::set_multicast_groups
+ */
+void unix_communicator_impl::set_multicast_groups(const char *first, const char *last) {
+    multicast_group_range range = multicast_sender::parse_group_range(first, last);
+    the::system::threading::auto_lock<the::system::threading::critical_section> lock(this->multicast_groups_lock);
+    this->multicast_groups = range;
+}
+
+#endif /* !_WIN32 */
@@ -0,0 +1,150 @@
+/*
+ * rivlib
+ * unix_communicator_impl.h
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+
+#ifndef VICCI_RIVLIB_UNIX_COMMUNICATOR_IMPL_H_INCLUDED
+#define VICCI_RIVLIB_UNIX_COMMUNICATOR_IMPL_H_INCLUDED
+#if (defined(_MSC_VER) && (_MSC_VER > 1000))
+#pragma once
+#endif /* (defined(_MSC_VER) && (_MSC_VER > 1000)) */
+
+#ifndef _WIN32
+
+#include "rivlib/common.h"
+#include "rivlib/unix_communicator.h"
+#include "element_node.h"
+#include "multicast_sender.h"
+#include "token_bucket.h"
+#include "the/system/threading/runnable.h"
+#include "the/system/threading/thread.h"
+#include "vislib/Socket.h"
+#include <string>
+
+
+namespace eu_vicci {
+namespace rivlib {
+
+
+    /**
+     * The communication connection using Unix domain sockets
+     */
+    class unix_communicator_impl : public unix_communicator, public element_node,
+        public the::system::threading::runnable {
+    public:
+
+        /**
+         * ctor
+         *
+         * @param name The socket name to listen on
+         */
+        unix_communicator_impl(const char *name);
+
+        /** dtor */
+        virtual ~unix_communicator_impl(void);
+
+        /**
+         * Called to fire the 'core_discovered' event
+         */
+        virtual void on_core_discovered(void);
+
+        /**
+         * Called to fire the 'core_lost' event
+         */
+        virtual void on_core_lost(void);
+
+        /**
+         * Terminates the server thread
+         *
+         * @return termination_behaviour::graceful
+         */
+        virtual the::system::threading::thread::termination_behaviour
+            on_thread_terminating(void) throw();
+
+        /**
+         * The thread main method
+         *
+         * @return The thread return value
+         */
+        virtual int run(void);
+
+        /**
+         * Answer the number of public uris the specified provider will be
+         * available through this communicator
+         *
+         * @param prov The provider
+         *
+         * @return The number of public uris
+         */
+        virtual size_t count_public_uris(provider::ptr prov);
+
+        /**
+         * Copies one public uri to 'buf' under which the specified provider
+         * will be available through this communicator
+         *
+         * @param prov The provider
+         * @param idx The zero-based index of the public uri to be returned
+         * @param buf The buffer to write the uri to. If 'nullptr' no data
+         *            will be written
+         * @param buflen The number of bytes that can safely be written to
+         *            'buf'
+         *
+         * @return If 'buf' is nullptr, returns the length of the requested
+         *         uri in bytes/characters. If 'buf' is not nullptr, return
+         *         the number of bytes/characters written.
+         */
+        virtual size_t public_uri(provider::ptr prov, size_t idx, char *buf, size_t buflen);
+
+        /**
+         * Sets the maximum egress rate of the image data of all client
+         * connections of this communicator together
+         *
+         * @param bytes_per_second The maximum rate or zero for unlimited
+         */
+        virtual void set_egress_rate(uint64_t bytes_per_second);
+
+        /**
+         * Sets the range of IPv4 multicast groups clients of this
+         * communicator may request their image streams to be sent to
+         *
+         * @param first The first group of the range or nullptr to disable
+         *              multicast
+         * @param last The last group of the range or nullptr to only
+         *             permit 'first'
+         */
+        virtual void set_multicast_groups(const char *first, const char *last = nullptr);
+
+    protected:
+
+    private:
+
+        /** The socket name to listen on */
+        std::string name;
+
+        /** The listening socket */
+        vislib::net::Socket server;
+
+        /** The server worker thread */
+        the::system::threading::thread *worker;
+
+        /** The egress token bucket of all client connections */
+        token_bucket::shared_ptr egress;
+
+        /** The range of multicast groups the clients may request */
+        multicast_group_range multicast_groups;
+
+        /** The lock for 'multicast_groups' */
+        the::system::threading::critical_section multicast_groups_lock;
+
+    };
+
+
+} /* end namespace rivlib */
+} /* end namespace eu_vicci */
+
+#endif /* !_WIN32 */
+
+#endif /* VICCI_RIVLIB_UNIX_COMMUNICATOR_IMPL_H_INCLUDED */
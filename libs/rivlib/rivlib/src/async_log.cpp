@@ -0,0 +1,685 @@
+/*
+ * rivlib
+ * async_log.cpp
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+#include "stdafx.h"
+#include "async_log.h"
+#include "the/memory.h"
+#include "the/system/performance_counter.h"
+#include "the/system/threading/auto_lock.h"
+#include "the/text/string_builder.h"
+#include "the/text/string_converter.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cwchar>
+
+using namespace eu_vicci::rivlib;
+using namespace the::system::threading;
+
+
+namespace {
+
+    /**
+     * Appends a value to the arguments of a record
+     *
+     * @param dst The write position
+     * @param end The end of the arguments
+     * @param tag The tag of the value
+     * @param value The value
+     *
+     * @return False if the value does not fit
+     */
+    template<class T>
+    bool put_value(char *&dst, char *end, char tag, T value) {
+        if (static_cast<size_t>(end - dst) < 1 + sizeof(T)) return false;
+        *dst++ = tag;
+        ::memcpy(dst, &value, sizeof(T));
+        dst += sizeof(T);
+        return true;
+    }
+
+    /**
+     * Takes a value from the arguments of a record
+     *
+     * @param src The read position
+     * @param end The end of the arguments
+     * @param tag The expected tag of the value
+     * @param value Receives the value
+     *
+     * @return False if the value is missing
+     */
+    template<class T>
+    bool take_value(const char *&src, const char *end, char tag, T& value) {
+        if (static_cast<size_t>(end - src) < 1 + sizeof(T)) return false;
+        if (*src != tag) return false;
+        ::memcpy(&value, src + 1, sizeof(T));
+        src += 1 + sizeof(T);
+        return true;
+    }
+
+    /**
+     * Formats one argument
+     *
+     * @param dst Receives the formatted argument
+     * @param spec The conversion specification
+     * @param stars The number of '*' arguments
+     * @param star The '*' arguments
+     * @param value The argument
+     */
+    template<class T>
+    void format_value(the::astring& dst, const the::astring& spec, int stars,
+            const int *star, T value) {
+        switch (stars) {
+        case 0:
+            the::text::astring_builder::format_to(dst, spec.c_str(), value);
+            break;
+        case 1:
+            the::text::astring_builder::format_to(dst, spec.c_str(), star[0], value);
+            break;
+        default:
+            the::text::astring_builder::format_to(dst, spec.c_str(), star[0], star[1], value);
+            break;
+        }
+    }
+
+}
+
+
+/*
+ * async_log::ring::ring
+ */
+async_log::ring::ring(void) : head(0), tail(0), dropped(0), abandoned(false),
+        window(0), window_cnt(0), thread_id() {
+    the::text::string_converter::convert(this->thread_id,
+        thread::get_current_id().to_astring());
+}
+
+
+/*
+ * async_log::ring::~ring
+ */
+async_log::ring::~ring(void) {
+    // intentionally empty
+}
+
+
+/*
+ * async_log::flusher::flusher
+ */
+async_log::flusher::flusher(async_log& owner) : runnable(), owner(owner) {
+    // intentionally empty
+}
+
+
+/*
+ * async_log::flusher::~flusher
+ */
+async_log::flusher::~flusher(void) {
+    // intentionally empty
+}
+
+
+/*
+ * async_log::flusher::run
+ */
+int async_log::flusher::run(void) {
+    return this->owner.run_flusher();
+}
+
+
+/*
+ * async_log::flusher::on_thread_terminating
+ */
+thread::termination_behaviour async_log::flusher::on_thread_terminating(void) throw() {
+    return thread::termination_behaviour::graceful;
+}
+
+
+/*
+ * async_log::instance
+ */
+async_log& async_log::instance(void) {
+    static async_log inst;
+    return inst;
+}
+
+
+/*
+ * async_log::post
+ */
+void async_log::post(error_log::msg_type t, const char *fmt, va_list args) {
+    ring *r = this->reserve(t);
+    if (r == nullptr) return;
+    record& rec = r->records[r->head.load(std::memory_order_relaxed) % ring_capacity];
+    rec.format = fmt;
+    encode(rec, args);
+    this->publish(r, t);
+}
+
+
+/*
+ * async_log::post_text
+ */
+void async_log::post_text(error_log::msg_type t, const char *text) {
+    ring *r = this->reserve(t);
+    if (r == nullptr) return;
+    record& rec = r->records[r->head.load(std::memory_order_relaxed) % ring_capacity];
+    rec.format = "%s";
+    char *dst = rec.args;
+    size_t len = ::strlen(text);
+    if (len > max_args_size - 2) len = max_args_size - 2;
+    *dst++ = 's';
+    ::memcpy(dst, text, len);
+    dst[len] = 0;
+    rec.size = static_cast<uint16_t>(len + 2);
+    this->publish(r, t);
+}
+
+
+/*
+ * async_log::set_sink
+ */
+void async_log::set_sink(error_log::sink_callback sink, void *ctxt) {
+    auto_lock<critical_section> lock(this->sink_lock);
+    this->drain();
+    this->sink = sink;
+    this->sink_ctxt = ctxt;
+}
+
+
+/*
+ * async_log::set_rate_limit
+ */
+void async_log::set_rate_limit(unsigned int per_second) {
+    this->rate_limit = per_second;
+}
+
+
+/*
+ * async_log::flush
+ */
+void async_log::flush(void) {
+    auto_lock<critical_section> lock(this->sink_lock);
+    this->drain();
+}
+
+
+/*
+ * async_log::parse_conversion
+ */
+bool async_log::parse_conversion(const char *f, conversion& c) {
+    c.begin = f++;
+    c.stars = 0;
+    c.length = length_modifier::none;
+
+    while ((*f != 0) && (::strchr("-+ #0'", *f) != nullptr)) ++f;
+    if (*f == '*') {
+        ++c.stars;
+        ++f;
+    } else {
+        while ((*f >= '0') && (*f <= '9')) ++f;
+    }
+    if (*f == '.') {
+        ++f;
+        if (*f == '*') {
+            ++c.stars;
+            ++f;
+        } else {
+            while ((*f >= '0') && (*f <= '9')) ++f;
+        }
+    }
+    c.flags_end = f;
+
+    switch (*f) {
+    case 'h':
+        if (f[1] == 'h') {
+            c.length = length_modifier::hh;
+            f += 2;
+        } else {
+            c.length = length_modifier::h;
+            ++f;
+        }
+        break;
+    case 'l':
+        if (f[1] == 'l') {
+            c.length = length_modifier::ll;
+            f += 2;
+        } else {
+            c.length = length_modifier::l;
+            ++f;
+        }
+        break;
+    case 'w': c.length = length_modifier::l; ++f; break;
+    case 'j': c.length = length_modifier::j; ++f; break;
+    case 'z': c.length = length_modifier::z; ++f; break;
+    case 't': c.length = length_modifier::t; ++f; break;
+    case 'L': c.length = length_modifier::L; ++f; break;
+    case 'I':
+        if ((f[1] == '6') && (f[2] == '4')) {
+            c.length = length_modifier::I64;
+            f += 3;
+        } else if ((f[1] == '3') && (f[2] == '2')) {
+            c.length = length_modifier::I32;
+            f += 3;
+        } else {
+            c.length = length_modifier::I;
+            ++f;
+        }
+        break;
+    default: break;
+    }
+
+    c.type = *f;
+    if ((c.type == 0) || (::strchr("diouxXcCeEfFgGaAsSpn%", c.type) == nullptr)) {
+        return false;
+    }
+    c.end = f + 1;
+    return true;
+}
+
+
+/*
+ * async_log::encode
+ */
+void async_log::encode(record& r, va_list args) {
+    char *dst = r.args;
+    char *end = r.args + max_args_size;
+    bool fits = true;
+
+    for (const char *f = r.format; fits && (*f != 0); ++f) {
+        if (*f != '%') continue;
+        conversion c;
+        if (!parse_conversion(f, c)) break; // the rest is printed verbatim
+        f = c.end - 1;
+
+        for (int i = 0; i < c.stars; ++i) {
+            fits = fits && put_value<int64_t>(dst, end, 'i', va_arg(args, int));
+        }
+        if (!fits) break;
+
+        switch (c.type) {
+        case 'd': case 'i': {
+            int64_t v;
+            switch (c.length) {
+            case length_modifier::l: v = va_arg(args, long); break;
+            case length_modifier::ll:
+            case length_modifier::j:
+            case length_modifier::I64: v = va_arg(args, long long); break;
+            case length_modifier::z:
+            case length_modifier::t:
+            case length_modifier::I: v = va_arg(args, ptrdiff_t); break;
+            default: v = va_arg(args, int); break;
+            }
+            fits = put_value(dst, end, 'i', v);
+        } break;
+        case 'o': case 'u': case 'x': case 'X': {
+            uint64_t v;
+            switch (c.length) {
+            case length_modifier::hh: v = static_cast<unsigned char>(va_arg(args, unsigned int)); break;
+            case length_modifier::h: v = static_cast<unsigned short>(va_arg(args, unsigned int)); break;
+            case length_modifier::l: v = va_arg(args, unsigned long); break;
+            case length_modifier::ll:
+            case length_modifier::j:
+            case length_modifier::I64: v = va_arg(args, unsigned long long); break;
+            case length_modifier::z:
+            case length_modifier::t:
+            case length_modifier::I: v = va_arg(args, size_t); break;
+            default: v = va_arg(args, unsigned int); break;
+            }
+            fits = put_value(dst, end, 'i', static_cast<int64_t>(v));
+        } break;
+        case 'c': case 'C':
+            fits = put_value<int64_t>(dst, end, 'i', va_arg(args, int));
+            break;
+        case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+            if (c.length == length_modifier::L) {
+                fits = put_value(dst, end, 'f', static_cast<double>(va_arg(args, long double)));
+            } else {
+                fits = put_value(dst, end, 'f', va_arg(args, double));
+            }
+            break;
+        case 'p':
+            fits = put_value(dst, end, 'p', reinterpret_cast<uint64_t>(va_arg(args, void*)));
+            break;
+        case 'n':
+            (void)va_arg(args, void*); // never written
+            break;
+        case 's': case 'S': {
+            size_t avail = static_cast<size_t>(end - dst);
+            if (avail < 2) {
+                fits = false;
+                break;
+            }
+            *dst++ = 's';
+            size_t max_len = avail - 2;
+            size_t len = 0;
+            if ((c.type == 'S') || (c.length == length_modifier::l)) {
+                // wide strings are narrowed; non-ascii characters become '?'
+                const wchar_t *s = va_arg(args, const wchar_t*);
+                if (s == nullptr) s = L"(null)";
+                for (; (len < max_len) && (s[len] != 0); ++len) {
+                    dst[len] = (static_cast<unsigned long>(s[len]) < 0x80) ? static_cast<char>(s[len]) : '?';
+                }
+            } else {
+                const char *s = va_arg(args, const char*);
+                if (s == nullptr) s = "(null)";
+                len = ::strlen(s);
+                if (len > max_len) len = max_len;
+                ::memcpy(dst, s, len);
+            }
+            dst[len] = 0;
+            dst += len + 1;
+        } break;
+        default: break; // '%%'
+        }
+    }
+
+    r.size = static_cast<uint16_t>(dst - r.args);
+}
+
+
+/*
+ * async_log::format
+ */
+void async_log::format(const record& r, const the::astring& thread_id,
+        the::astring& line) {
+    char tc = 'x';
+    switch (r.type) {
+    case error_log::msg_type::error: tc = 'E'; break;
+    case error_log::msg_type::warning: tc = 'W'; break;
+    case error_log::msg_type::info: tc = 'I'; break;
+    }
+
+    struct tm *now_tm;
+#if defined(THE_WINDOWS)
+    struct tm now_time_tm_storage;
+    localtime_s(&now_time_tm_storage, &r.time);
+    now_tm = &now_time_tm_storage;
+#else /* THE_WINDOWS */
+    struct tm now_time_tm_storage;
+    now_tm = localtime_r(&r.time, &now_time_tm_storage);
+#endif /* THE_WINDOWS */
+    int now_millis = static_cast<int>(std::fmod(std::fabs(r.millis), 1000.0));
+
+    // ISO 8601: 2004-02-12T15:19:21+00:00
+    the::text::astring_builder::format_to(line,
+        "%c(%.4d-%.2d-%.2dT%.2d:%.2d:%.2d.%.3d; %s): ", tc,
+        1900 + now_tm->tm_year, now_tm->tm_mon + 1, now_tm->tm_mday,
+        now_tm->tm_hour, now_tm->tm_min, now_tm->tm_sec, now_millis,
+        thread_id.c_str());
+
+    const char *src = r.args;
+    const char *src_end = r.args + r.size;
+    the::astring part;
+    the::astring spec;
+    const char *f = r.format;
+    while (*f != 0) {
+        if (*f != '%') {
+            const char *next = ::strchr(f, '%');
+            if (next == nullptr) next = f + ::strlen(f);
+            line.append(f, next - f);
+            f = next;
+            continue;
+        }
+
+        conversion c;
+        if (!parse_conversion(f, c)) {
+            line.append(f);
+            break;
+        }
+
+        bool ok = true;
+        int star[2] = { 0, 0 };
+        for (int i = 0; i < c.stars; ++i) {
+            int64_t v = 0;
+            ok = ok && take_value(src, src_end, 'i', v);
+            star[i] = static_cast<int>(v);
+        }
+
+        spec.assign(c.begin, c.flags_end);
+        part.clear();
+        switch (ok ? c.type : 0) {
+        case 0:
+            break;
+        case 'd': case 'i': case 'o': case 'u': case 'x': case 'X': {
+            int64_t v;
+            ok = take_value(src, src_end, 'i', v);
+            if (!ok) break;
+            spec += "ll";
+            spec += c.type;
+            format_value(part, spec, c.stars, star, static_cast<long long>(v));
+        } break;
+        case 'c': case 'C': {
+            int64_t v;
+            ok = take_value(src, src_end, 'i', v);
+            if (!ok) break;
+            spec += 'c';
+            format_value(part, spec, c.stars, star, static_cast<int>(v));
+        } break;
+        case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A': {
+            double v;
+            ok = take_value(src, src_end, 'f', v);
+            if (!ok) break;
+            spec += c.type;
+            format_value(part, spec, c.stars, star, v);
+        } break;
+        case 'p': {
+            uint64_t v;
+            ok = take_value(src, src_end, 'p', v);
+            if (!ok) break;
+            spec += 'p';
+            format_value(part, spec, c.stars, star, reinterpret_cast<void*>(static_cast<uintptr_t>(v)));
+        } break;
+        case 's': case 'S': {
+            ok = (src < src_end) && (*src == 's');
+            if (!ok) break;
+            const char *s = src + 1;
+            src = s + ::strlen(s) + 1;
+            spec += 's';
+            format_value(part, spec, c.stars, star, s);
+        } break;
+        case '%':
+            part = "%";
+            break;
+        default: break; // 'n'
+        }
+
+        if (!ok) {
+            // the arguments did not fit into the record
+            line += "...";
+            break;
+        }
+        line += part;
+        f = c.end;
+    }
+
+    if (line.empty() || (line[line.size() - 1] != '\n')) {
+        line += "\n";
+    }
+}
+
+
+/*
+ * async_log::async_log
+ */
+async_log::async_log(void) : rings(), rings_lock(), sink(nullptr),
+        sink_ctxt(nullptr), sink_lock(), rate_limit(default_rate_limit),
+        flush_event(), terminating(false), worker(nullptr), worker_thread(nullptr) {
+    // the destructor callback tells when the rings of exited threads can go
+#ifdef _WIN32
+    this->ring_slot = ::FlsAlloc(&async_log::abandon_ring);
+    if (this->ring_slot == FLS_OUT_OF_INDEXES) {
+        throw the::exception("Failed to allocate the log ring slot", __FILE__, __LINE__);
+    }
+#else /* _WIN32 */
+    if (::pthread_key_create(&this->ring_slot, &async_log::abandon_ring) != 0) {
+        throw the::exception("Failed to allocate the log ring slot", __FILE__, __LINE__);
+    }
+#endif /* _WIN32 */
+    this->worker = new flusher(*this);
+    this->worker_thread = new thread(this->worker);
+    this->worker_thread->start();
+}
+
+
+/*
+ * async_log::~async_log
+ */
+async_log::~async_log(void) {
+    this->terminating = true;
+    this->flush_event.set();
+    if (this->worker_thread->is_running()) {
+        this->worker_thread->join();
+    }
+    the::safe_delete(this->worker_thread);
+    the::safe_delete(this->worker);
+
+    this->flush();
+    // no abandon_ring calls after this point
+#ifdef _WIN32
+    ::FlsFree(this->ring_slot);
+#else /* _WIN32 */
+    ::pthread_key_delete(this->ring_slot);
+#endif /* _WIN32 */
+    for (size_t i = 0, cnt = this->rings.size(); i < cnt; ++i) {
+        the::safe_delete(this->rings[i]);
+    }
+    this->rings.clear();
+}
+
+
+/*
+ * async_log::abandon_ring
+ */
+#ifdef _WIN32
+void WINAPI async_log::abandon_ring(void *r) {
+#else /* _WIN32 */
+void async_log::abandon_ring(void *r) {
+#endif /* _WIN32 */
+    if (r == nullptr) return;
+    static_cast<ring*>(r)->abandoned.store(true, std::memory_order_release);
+}
+
+
+/*
+ * async_log::reserve
+ */
+async_log::ring *async_log::reserve(error_log::msg_type t) {
+#ifdef _WIN32
+    ring *r = static_cast<ring*>(::FlsGetValue(this->ring_slot));
+#else /* _WIN32 */
+    ring *r = static_cast<ring*>(::pthread_getspecific(this->ring_slot));
+#endif /* _WIN32 */
+    if (r == nullptr) {
+        // first message of this thread; the ring is freed by 'drain' after
+        // the thread exited
+        r = new ring();
+#ifdef _WIN32
+        ::FlsSetValue(this->ring_slot, r);
+#else /* _WIN32 */
+        ::pthread_setspecific(this->ring_slot, r);
+#endif /* _WIN32 */
+        auto_lock<critical_section> lock(this->rings_lock);
+        this->rings.push_back(r);
+    }
+
+    std::time_t now = std::time(NULL);
+    if (now != r->window) {
+        r->window = now;
+        r->window_cnt = 0;
+    }
+    unsigned int limit = this->rate_limit;
+    uint32_t head = r->head.load(std::memory_order_relaxed);
+    if (((limit > 0) && (r->window_cnt >= limit))
+            || (head - r->tail.load(std::memory_order_acquire) >= ring_capacity)) {
+        r->dropped.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    r->window_cnt++;
+
+    record& rec = r->records[head % ring_capacity];
+    rec.time = now;
+    rec.millis = the::system::performance_counter::query_millis();
+    rec.type = t;
+    return r;
+}
+
+
+/*
+ * async_log::publish
+ */
+void async_log::publish(ring *r, error_log::msg_type t) {
+    r->head.fetch_add(1, std::memory_order_release);
+    if (t == error_log::msg_type::error) {
+        // errors are written promptly
+        this->flush_event.set();
+    }
+}
+
+
+/*
+ * async_log::run_flusher
+ */
+int async_log::run_flusher(void) {
+    while (!this->terminating) {
+        this->flush_event.wait(flush_interval);
+        if (this->terminating) break;
+        this->flush();
+    }
+    return 0;
+}
+
+
+/*
+ * async_log::drain
+ */
+void async_log::drain(void) {
+    this->rings_lock.lock();
+    std::vector<ring*> all(this->rings);
+    this->rings_lock.unlock();
+
+    the::astring line;
+    for (size_t i = 0, cnt = all.size(); i < cnt; ++i) {
+        ring *r = all[i];
+        // read before 'head', so all records of an exited thread are drained
+        bool abandoned = r->abandoned.load(std::memory_order_acquire);
+        uint32_t tail = r->tail.load(std::memory_order_relaxed);
+        uint32_t head = r->head.load(std::memory_order_acquire);
+        for (; tail != head; ++tail) {
+            const record& rec = r->records[tail % ring_capacity];
+            format(rec, r->thread_id, line);
+            this->write(rec.type, line.c_str());
+        }
+        r->tail.store(tail, std::memory_order_release);
+
+        uint32_t dropped = r->dropped.exchange(0, std::memory_order_relaxed);
+        if (dropped > 0) {
+            the::text::astring_builder::format_to(line,
+                "W(%s): %u log messages dropped\n", r->thread_id.c_str(), dropped);
+            this->write(error_log::msg_type::warning, line.c_str());
+        }
+
+        if (abandoned) {
+            this->rings_lock.lock();
+            this->rings.erase(std::find(this->rings.begin(), this->rings.end(), r));
+            this->rings_lock.unlock();
+            the::safe_delete(r);
+        }
+    }
+}
+
+
+/*
+ * async_log::write
+ */
+void async_log::write(error_log::msg_type t, const char *line) {
+    if (this->sink != nullptr) {
+        this->sink(t, line, this->sink_ctxt);
+    } else {
+        ::fputs(line, (t == error_log::msg_type::error) ? stderr : stdout);
+    }
+}
@@ -0,0 +1,370 @@
+/*
+ * rivlib
+ * async_log.h
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+
+#ifndef VICCI_RIVLIB_ASYNC_LOG_H_INCLUDED
+#define VICCI_RIVLIB_ASYNC_LOG_H_INCLUDED
+#if (defined(_MSC_VER) && (_MSC_VER > 1000))
+#pragma once
+#endif /* (defined(_MSC_VER) && (_MSC_VER > 1000)) */
+
+#include "error_log.h"
+#include "the/string.h"
+#include "the/types.h"
+#include "the/system/threading/critical_section.h"
+#include "the/system/threading/event.h"
+#include "the/system/threading/runnable.h"
+#include "the/system/threading/thread.h"
+#include <atomic>
+#include <ctime>
+#include <stdarg.h>
+#include <vector>
+#ifndef _WIN32
+#include <pthread.h>
+#endif /* !_WIN32 */
+
+
+namespace eu_vicci {
+namespace rivlib {
+
+    /**
+     * Process-wide backend of the error logs.
+     *
+     * Logging threads do not format their messages. They store the format
+     * string, which identifies the message, and a binary copy of the format
+     * arguments in a ring buffer of their own, which is lock-free between
+     * the logging thread and the flusher thread. The flusher thread formats
+     * the records and passes the lines to the sink. Records are dropped if
+     * the ring is full or if a thread exceeds the rate limit; the flusher
+     * reports the number of dropped records.
+     */
+    class async_log {
+    public:
+
+        /** The number of records of the ring of each thread */
+        static const unsigned int ring_capacity = 256;
+
+        /** The size of the arguments of a record in bytes */
+        static const unsigned int max_args_size = 224;
+
+        /** The interval in which the flusher thread runs in milliseconds */
+        static const unsigned int flush_interval = 100;
+
+        /** The default maximum number of records per second and thread */
+        static const unsigned int default_rate_limit = 1000;
+
+        /**
+         * Answer the only instance of the class
+         *
+         * @return The only instance of the class
+         */
+        static async_log& instance(void);
+
+        /**
+         * Records a log message of the calling thread
+         *
+         * @param t The log message type
+         * @param fmt The printf format string, which must remain valid
+         *            until the record is flushed, e.g. a string literal
+         * @param args The format arguments
+         */
+        void post(error_log::msg_type t, const char *fmt, va_list args);
+
+        /**
+         * Records an already formatted log message of the calling thread
+         *
+         * @param t The log message type
+         * @param text The log message
+         */
+        void post_text(error_log::msg_type t, const char *text);
+
+        /**
+         * Sets the sink receiving the formatted log lines
+         *
+         * @param sink The sink, or nullptr for stdout and stderr
+         * @param ctxt The context pointer passed to the sink
+         */
+        void set_sink(error_log::sink_callback sink, void *ctxt);
+
+        /**
+         * Sets the maximum number of records per second and thread
+         *
+         * @param per_second The maximum or zero for unlimited
+         */
+        void set_rate_limit(unsigned int per_second);
+
+        /**
+         * Passes all records to the sink on the calling thread
+         */
+        void flush(void);
+
+    private:
+
+        /** Possible length modifiers of conversions */
+        enum class length_modifier {
+            none,
+            hh,
+            h,
+            l,
+            ll,
+            j,
+            z,
+            t,
+            L,
+            I64,
+            I32,
+            I
+        };
+
+        /** A parsed conversion specification of a format string */
+        typedef struct _conversion_t {
+
+            /** The '%' starting the conversion */
+            const char *begin;
+
+            /** The end of the flags, the width and the precision */
+            const char *flags_end;
+
+            /** The end of the conversion */
+            const char *end;
+
+            /** The number of arguments taken by '*' width and precision */
+            int stars;
+
+            /** The length modifier */
+            length_modifier length;
+
+            /** The conversion character */
+            char type;
+
+        } conversion;
+
+        /** A binary log record */
+        typedef struct _record_t {
+
+            /** The format string identifying the message */
+            const char *format;
+
+            /** The wall clock time */
+            std::time_t time;
+
+            /** The performance counter time in milliseconds */
+            double millis;
+
+            /** The log message type */
+            error_log::msg_type type;
+
+            /** The number of bytes of 'args' used */
+            uint16_t size;
+
+            /** The encoded format arguments */
+            char args[max_args_size];
+
+        } record;
+
+        /** The record ring of one logging thread */
+        class ring {
+        public:
+
+            /** ctor */
+            ring(void);
+
+            /** dtor */
+            ~ring(void);
+
+            /** The records */
+            record records[ring_capacity];
+
+            /** The number of records written; only written by the owner thread */
+            std::atomic<uint32_t> head;
+
+            /** The number of records flushed; only written by the flusher */
+            std::atomic<uint32_t> tail;
+
+            /** The number of records dropped since the last report */
+            std::atomic<uint32_t> dropped;
+
+            /** Set when the owner thread exited; the ring is freed once empty */
+            std::atomic<bool> abandoned;
+
+            /** The second of the rate limit window; owner thread only */
+            std::time_t window;
+
+            /** The number of records in the rate limit window; owner thread only */
+            unsigned int window_cnt;
+
+            /** The id of the owner thread */
+            the::astring thread_id;
+
+        };
+
+        /** Utility runnable class for the flusher thread */
+        class flusher : public the::system::threading::runnable {
+        public:
+
+            /**
+             * ctor
+             *
+             * @param owner The owning object
+             */
+            flusher(async_log& owner);
+
+            /** dtor */
+            virtual ~flusher(void);
+
+            /**
+             * Perform the work of a thread.
+             *
+             * @return The application dependent return code of the thread. This
+             *         must not be STILL_ACTIVE (259).
+             */
+            virtual int run(void);
+
+            /**
+             * Requests the runnable to be terminated
+             *
+             * @return graceful
+             */
+            virtual the::system::threading::thread::termination_behaviour on_thread_terminating(void) throw();
+
+        private:
+
+            /** The owning object */
+            async_log& owner;
+
+        };
+
+        /**
+         * Parses a conversion specification
+         *
+         * @param f Points to the '%' starting the conversion
+         * @param c Receives the conversion
+         *
+         * @return False if the conversion is not supported
+         */
+        static bool parse_conversion(const char *f, conversion& c);
+
+        /**
+         * Encodes the format arguments into a record
+         *
+         * @param r The record
+         * @param args The format arguments
+         */
+        static void encode(record& r, va_list args);
+
+        /**
+         * Formats a record
+         *
+         * @param r The record
+         * @param thread_id The id of the logging thread
+         * @param line Receives the log line
+         */
+        static void format(const record& r, const the::astring& thread_id,
+            the::astring& line);
+
+        /**
+         * Marks the ring of an exiting thread as abandoned. Called by the
+         * thread local storage on thread exit.
+         *
+         * @param r The ring of the exiting thread
+         */
+#ifdef _WIN32
+        static void WINAPI abandon_ring(void *r);
+#else /* _WIN32 */
+        static void abandon_ring(void *r);
+#endif /* _WIN32 */
+
+        /** ctor */
+        async_log(void);
+
+        /** dtor */
+        ~async_log(void);
+
+        /**
+         * Reserves the next record of the ring of the calling thread
+         *
+         * @param t The log message type
+         *
+         * @return The ring, or nullptr if the record is dropped
+         */
+        ring *reserve(error_log::msg_type t);
+
+        /**
+         * Publishes the reserved record of a ring
+         *
+         * @param r The ring of the calling thread
+         * @param t The log message type
+         */
+        void publish(ring *r, error_log::msg_type t);
+
+        /**
+         * The flusher thread function
+         *
+         * @return 0
+         */
+        int run_flusher(void);
+
+        /**
+         * Passes the records of all rings to the sink and frees the empty
+         * rings of exited threads. The caller must hold 'sink_lock'.
+         */
+        void drain(void);
+
+        /**
+         * Passes a log line to the sink. The caller must hold 'sink_lock'.
+         *
+         * @param t The log message type
+         * @param line The log line
+         */
+        void write(error_log::msg_type t, const char *line);
+
+#ifdef _WIN32
+        /** The fiber local storage slot of the ring of the calling thread */
+        DWORD ring_slot;
+#else /* _WIN32 */
+        /** The thread local storage key of the ring of the calling thread */
+        pthread_key_t ring_slot;
+#endif /* _WIN32 */
+
+        /** The rings of all threads which logged */
+        std::vector<ring*> rings;
+
+        /** The lock for 'rings' */
+        the::system::threading::critical_section rings_lock;
+
+        /** The sink */
+        error_log::sink_callback sink;
+
+        /** The context pointer of the sink */
+        void *sink_ctxt;
+
+        /** Serialises the sink and the draining of the rings */
+        the::system::threading::critical_section sink_lock;
+
+        /** The maximum number of records per second and thread */
+        volatile unsigned int rate_limit;
+
+        /** Event set when errors should be flushed or the flusher should stop */
+        the::system::threading::event flush_event;
+
+        /** Flag that the flusher thread should terminate */
+        volatile bool terminating;
+
+        /** The runnable of the flusher thread */
+        flusher *worker;
+
+        /** The flusher thread */
+        the::system::threading::thread *worker_thread;
+
+    };
+
+
+} /* end namespace rivlib */
+} /* end namespace eu_vicci */
+
+
+#endif /* VICCI_RIVLIB_ASYNC_LOG_H_INCLUDED */
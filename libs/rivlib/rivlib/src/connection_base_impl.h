@@ -19,16 +19,25 @@
 #include "the/system/threading/runnable.h"
 #include "vislib/SmartRef.h"
 #include "vislib/TcpCommChannel.h"
+#include <deque>
 #include <vector>
 #include <algorithm>
 #include "rivlib/ip_communicator.h"
 #include "uri_utility.h"
+#include "ip_request.h"
 #include "rivlib/ip_utilities.h"
+#include "the/blob.h"
 #include "the/math/functions.h"
 #include "the/text/string_builder.h"
+#include "the/text/string_utility.h"
 #include "vislib/PeerDisconnectedException.h"
 #include "vislib/IPCommEndPoint.h"
 #include "vislib/Trace.h"
+#include "unix_socket.h"
+#include "the/not_supported_exception.h"
+#ifndef _WIN32
+#include <unistd.h>
+#endif /* !_WIN32 */
 
 
 namespace eu_vicci {
@@ -119,6 +128,24 @@ namespace rivlib {
          */
         virtual const wchar_t *get_uri_wstr(void) const;
 
+        /**
+         * Answer the capabilities negotiated with the connected riv provider
+         * service
+         *
+         * @return The 'ip_capability' bit mask
+         */
+        uint32_t get_peer_capabilities(void) const;
+
+        /**
+         * Answer whether the connected riv provider service supports an
+         * image stream subtype
+         *
+         * @param subtype The image stream subtype
+         *
+         * @return True if the subtype is supported
+         */
+        bool is_peer_subtype_supported(uint16_t subtype) const;
+
         /**
          * Locks this node
          */
@@ -170,6 +197,35 @@ namespace rivlib {
          */
         size_t receive(void *data, size_t size);
 
+        /**
+         * Answer whether a capability has been negotiated with the connected
+         * riv provider service
+         *
+         * @param c The capability
+         *
+         * @return True if both peers support the capability
+         */
+        inline bool has_peer_capability(ip_capability c) const {
+            return (this->peer_hello.capabilities & static_cast<uint32_t>(c)) != 0;
+        }
+
+        /**
+         * Answer the hello of the connected riv provider service
+         *
+         * @return The hello with the negotiated capabilities
+         */
+        inline const ip_hello& get_peer_hello(void) const {
+            return this->peer_hello;
+        }
+
+        /**
+         * Answer the next memory file received through a Unix domain socket
+         * connection. The caller takes ownership of the file descriptor.
+         *
+         * @return The file descriptor or -1 if no file has been received
+         */
+        int take_received_fd(void);
+
         /**
          * Checks if the uri conforms to the specific channel type
          *
@@ -227,6 +283,33 @@ namespace rivlib {
 
     private:
 
+        /** The time the server has to send the handshake and the answer in milliseconds */
+        static const unsigned int handshake_timeout = 5000;
+
+        /** The maximum size of the hello of the server in bytes */
+        static const uint32_t max_hello_size = 0x1000;
+
+        /**
+         * Connects to the server and checks its handshake id
+         *
+         * @param uri_scheme The scheme of the uri
+         * @param uri_host The host to connect to
+         * @param uri_is_host_v6 Flag whether 'uri_host' is an IPv6 address
+         * @param uri_host_port The port to connect to
+         * @param unix_name The socket name if 'unix_comm' is set
+         */
+        void open_comm(const std::string& uri_scheme, const std::string& uri_host,
+            bool uri_is_host_v6, unsigned short uri_host_port, const std::string& unix_name);
+
+        /**
+         * Sends the hello probe and stores the negotiated capabilities if
+         * the server answers it
+         *
+         * @return False if the server refused the probe. The server then
+         *         closes the connection.
+         */
+        bool negotiate(void);
+
         /**
          * Closes the comm channel
          */
@@ -268,6 +351,21 @@ namespace rivlib {
         /** The communcation channel */
         vislib::SmartRef<vislib::net::TcpCommChannel> comm;
 
+        /** Flag whether 'comm' is a Unix domain socket */
+        bool unix_comm;
+
+        /** The memory files received through the Unix domain socket */
+        std::deque<int> received_fds;
+
+        /** The hello of the server with the negotiated capabilities */
+        ip_hello peer_hello;
+
+        /**
+         * Flag whether the server refused the hello probe, i.e. predates
+         * the negotiation. Kept when reconnecting.
+         */
+        bool hello_refused;
+
     };
 
 
@@ -429,6 +527,24 @@ namespace rivlib {
     }
 
 
+    /*
+     * connection_base_impl<T>::get_peer_capabilities
+     */
+    template<class T>
+    uint32_t connection_base_impl<T>::get_peer_capabilities(void) const {
+        return this->peer_hello.capabilities;
+    }
+
+
+    /*
+     * connection_base_impl<T>::is_peer_subtype_supported
+     */
+    template<class T>
+    bool connection_base_impl<T>::is_peer_subtype_supported(uint16_t subtype) const {
+        return (subtype < 32) && ((this->peer_hello.image_stream_subtypes & (1u << subtype)) != 0);
+    }
+
+
     /*
      * connection_base_impl<T>::lock
      */
@@ -491,6 +607,8 @@ namespace rivlib {
         if (!uri_is_port_set) {
             uri_host_port = ip_communicator::DEFAULT_PORT;
         }
+        std::string unix_name; // connect through a unix_communicator
+        this->unix_comm = uri_utility::extract_query_value(uri_query, "u", unix_name);
 
         try {
             this->check_uri(uri_scheme, uri_username, uri_host, uri_is_host_v6, uri_host_port, uri_path, uri_query, uri_fragment);
@@ -507,57 +625,63 @@ namespace rivlib {
         // std::string host;
         // the::text::astring_builder::format_to(host, "%s:%u", uri_host.c_str(), uri_host_port);
 
-        this->comm = TcpCommChannel::Create(TcpCommChannel::FLAG_NODELAY);
         try {
 
 //fprintf(stderr, "Arglhfitz: %s:%d (%d)\n", uri_host.c_str(), (int)uri_host_port, (int)uri_is_host_v6);
 //vislib::Trace::GetInstance().SetLevel(vislib::Trace::LEVEL_ALL);
 
-            this->comm->Connect(IPCommEndPoint::Create(
-                uri_is_host_v6 ? IPCommEndPoint::IPV6 : IPCommEndPoint::IPV4,
-                uri_host.c_str(), uri_host_port));
-
-//fprintf(stderr, "hugo\n");
-
-            rivlib::ip_handshake_id id;
-            rivlib::ip_handshake_id id_ref;
-
-            uri_scheme += "\x13\x57\x9B\xDF";
-
-            ::memset(id_ref.id_str, 0, 8);
-            ::memcpy(id_ref.id_str, uri_scheme.c_str(), the::math::minimum<size_t>(8, uri_scheme.length()));
-            id_ref.tst_dword = 0x12345678;
-            id_ref.tst_float = 2.71828175f;
-
-            THE_ASSERT(sizeof(rivlib::ip_handshake_id) == 16);
-
-            if (this->comm->Receive(&id, sizeof(rivlib::ip_handshake_id)) != sizeof(rivlib::ip_handshake_id)) {
-                throw the::exception("handshake id truncated", __FILE__, __LINE__);
+            this->open_comm(uri_scheme, uri_host, uri_is_host_v6, uri_host_port, unix_name);
+
+            if (!this->hello_refused && !this->negotiate()) {
+                // servers predating the hello answer the probe with an error
+                // and close the connection; continue as protocol version 0
+                this->hello_refused = true;
+                try {
+                    this->comm->Close();
+                } catch(...) {
+                }
+                this->comm.Release();
+                this->open_comm(uri_scheme, uri_host, uri_is_host_v6, uri_host_port, unix_name);
             }
 
-            if (::memcmp(&id, &id_ref, sizeof(rivlib::ip_handshake_id)) != 0) {
-                throw the::exception("Connection handshake failed on magic_id", __FILE__, __LINE__);
+            // requests without user name, fragment and unknown query keys
+            // are sent in the binary encoding if the server negotiated it,
+            // sparing the server the parsing
+            ip_request bin_req;
+            bin_req.path = the::text::string_utility::url_decode<std::string>(uri_path);
+            bool binary = uri_username.empty() && uri_fragment.empty()
+                && this->has_peer_capability(ip_capability::binary_request);
+            if (binary && !uri_query.empty()) {
+                binary = bin_req.parse_query(the::text::string_utility::url_decode<std::string>(uri_query))
+                    && bin_req.is_complete();
             }
 
-            std::string request = uri_path; // syntax: "username@path?query#fragment"
-            if (!uri_username.empty()) {
-                request = uri_username + "@" + request;
-            }
-            if (!uri_query.empty()) {
-                request += "?";
-                request += uri_query;
-            }
-            if (!uri_fragment.empty()) {
-                request += "#";
-                request += uri_fragment;
+            if (binary) {
+                the::blob request;
+                size_t requestLen = bin_req.encode(request);
+                this->comm->Send(request, requestLen);
+
+            } else {
+                std::string request = uri_path; // syntax: "username@path?query#fragment"
+                if (!uri_username.empty()) {
+                    request = uri_username + "@" + request;
+                }
+                if (!uri_query.empty()) {
+                    request += "?";
+                    request += uri_query;
+                }
+                if (!uri_fragment.empty()) {
+                    request += "#";
+                    request += uri_fragment;
+                }
+
+                unsigned int requestLen = static_cast<unsigned int>(request.length());
+                this->comm->Send(&requestLen, 4);
+                this->comm->Send(request.c_str(), requestLen);
             }
 
-            unsigned int requestLen = static_cast<unsigned int>(request.length());
-            this->comm->Send(&requestLen, 4);
-            this->comm->Send(request.c_str(), requestLen);
-
             unsigned short answer;
-            if (this->comm->Receive(&answer, 2) != 2) {
+            if (this->comm->Receive(&answer, 2, handshake_timeout) != 2) {
                 throw the::exception("Request answer truncated", __FILE__, __LINE__);
             }
 
@@ -610,7 +734,9 @@ namespace rivlib {
     template<class T>
     connection_base_impl<T>::connection_base_impl(void) : runnable(), owner(nullptr),
             uri_astr(), uri_wstr(), stat(connection_base::status::not_connected),
-            lock_obj(), listeners(), worker_thread(nullptr), comm() {
+            lock_obj(), listeners(), worker_thread(nullptr), comm(),
+            unix_comm(false), received_fds(), hello_refused(false) {
+        ::memset(&this->peer_hello, 0, sizeof(ip_hello));
         vislib::net::Socket::Startup();
         this->worker_thread = new the::system::threading::thread(this);
 
@@ -635,10 +761,117 @@ namespace rivlib {
      */
     template<class T>
     size_t connection_base_impl<T>::receive(void *data, size_t size) {
+#ifndef _WIN32
+        if (this->unix_comm) {
+            // memory files passed along are only seen by 'recvmsg'
+            return unix_socket::receive(this->comm->GetSocket().GetHandle(),
+                data, size, this->received_fds);
+        }
+#endif /* !_WIN32 */
         return static_cast<size_t>(this->comm->Receive(data, size));
     }
 
 
+    /*
+     * connection_base_impl<T>::take_received_fd
+     */
+    template<class T>
+    int connection_base_impl<T>::take_received_fd(void) {
+        if (this->received_fds.empty()) return -1;
+        int fd = this->received_fds.front();
+        this->received_fds.pop_front();
+        return fd;
+    }
+
+
+    /*
+     * connection_base_impl<T>::open_comm
+     */
+    template<class T>
+    void connection_base_impl<T>::open_comm(const std::string& uri_scheme, const std::string& uri_host,
+            bool uri_is_host_v6, unsigned short uri_host_port, const std::string& unix_name) {
+        using namespace vislib::net;
+
+        if (this->unix_comm) {
+#ifndef _WIN32
+            Socket socket(unix_socket::connect(unix_name));
+            this->comm = TcpCommChannel::Attach(socket);
+#else /* !_WIN32 */
+            throw the::not_supported_exception("Unix domain socket connections", __FILE__, __LINE__);
+#endif /* !_WIN32 */
+        } else {
+            this->comm = TcpCommChannel::Create(TcpCommChannel::FLAG_NODELAY);
+            this->comm->Connect(IPCommEndPoint::Create(
+                uri_is_host_v6 ? IPCommEndPoint::IPV6 : IPCommEndPoint::IPV4,
+                uri_host.c_str(), uri_host_port));
+        }
+
+        rivlib::ip_handshake_id id;
+        rivlib::ip_handshake_id id_ref;
+
+        std::string id_str = uri_scheme + "\x13\x57\x9B\xDF";
+
+        ::memset(id_ref.id_str, 0, 8);
+        ::memcpy(id_ref.id_str, id_str.c_str(), the::math::minimum<size_t>(8, id_str.length()));
+        id_ref.tst_dword = 0x12345678;
+        id_ref.tst_float = 2.71828175f;
+
+        THE_ASSERT(sizeof(rivlib::ip_handshake_id) == 16);
+
+        if (this->comm->Receive(&id, sizeof(rivlib::ip_handshake_id), handshake_timeout)
+                != sizeof(rivlib::ip_handshake_id)) {
+            throw the::exception("handshake id truncated", __FILE__, __LINE__);
+        }
+
+        if (::memcmp(&id, &id_ref, sizeof(rivlib::ip_handshake_id)) != 0) {
+            throw the::exception("Connection handshake failed on magic_id", __FILE__, __LINE__);
+        }
+    }
+
+
+    /*
+     * connection_base_impl<T>::negotiate
+     */
+    template<class T>
+    bool connection_base_impl<T>::negotiate(void) {
+        ip_hello hello;
+        ip_request::make_hello(hello, 0);
+
+        // a short string request, which older servers refuse
+        size_t probe_len = ::strlen(ip_request::hello_request) + 1;
+        the::blob probe(sizeof(uint32_t) + probe_len + sizeof(ip_hello));
+        *probe.as<uint32_t>() = static_cast<uint32_t>(probe_len + sizeof(ip_hello));
+        ::memcpy(probe.as_at<char>(sizeof(uint32_t)), ip_request::hello_request, probe_len);
+        ::memcpy(probe.as_at<char>(sizeof(uint32_t) + probe_len), &hello, sizeof(ip_hello));
+        this->comm->Send(probe, probe.size());
+
+        unsigned short code = 0;
+        try {
+            if (this->comm->Receive(&code, 2, handshake_timeout) != 2) return false;
+        } catch(vislib::Exception) {
+            return false; // closed without an answer
+        }
+        if (code != ip_request::hello_answer) return false;
+
+        uint32_t len;
+        if (this->comm->Receive(&len, sizeof(uint32_t), handshake_timeout) != sizeof(uint32_t)) {
+            throw the::exception("Hello answer truncated", __FILE__, __LINE__);
+        }
+        if (len > max_hello_size) {
+            throw the::exception("Hello answer too long", __FILE__, __LINE__);
+        }
+        the::blob answer(len);
+        if ((len > 0) && (this->comm->Receive(answer, len, handshake_timeout) != len)) {
+            throw the::exception("Hello answer truncated", __FILE__, __LINE__);
+        }
+        ip_request::read_hello(answer, len, this->peer_hello);
+
+        // never use a capability this side does not know
+        this->peer_hello.capabilities &= hello.capabilities;
+        return true;
+    }
+
+
     /*
      * connection_base_impl<T>::close_comm
      */
@@ -653,6 +886,14 @@ namespace rivlib {
             } catch(...) {
             }
             this->comm.Release();
+            ::memset(&this->peer_hello, 0, sizeof(ip_hello));
+
+#ifndef _WIN32
+            while (!this->received_fds.empty()) {
+                ::close(this->received_fds.front());
+                this->received_fds.pop_front();
+            }
+#endif /* !_WIN32 */
 
             this->stat = connection_base::status::not_connected;
             size_t s = this->listeners.size();
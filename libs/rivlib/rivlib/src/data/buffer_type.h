@@ -23,6 +23,8 @@ namespace data {
         ,
         mjpeg_rgb_bytes
 #endif
+        ,
+        progressive_rgb_bytes = 5
     };
 
 
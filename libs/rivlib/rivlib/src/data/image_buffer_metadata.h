@@ -30,6 +30,36 @@ namespace data {
     } image_buffer_metadata;
 
 
+    /**
+     * struct storing the metadata of one level of a progressive image
+     *
+     * @remarks
+     *  'width' and 'height' are the dimensions of the level, which allows
+     *  the struct to be used where an image_buffer_metadata is expected.
+     */
+    typedef struct _progressive_image_buffer_metadata_t {
+
+        /** The width in pixel of this level */
+        unsigned int width;
+
+        /** The height in pixel of this level */
+        unsigned int height;
+
+        /** The width in pixel of the full resolution image */
+        unsigned int full_width;
+
+        /** The height in pixel of the full resolution image */
+        unsigned int full_height;
+
+        /** The index of this level (0 is the coarsest level) */
+        unsigned int level;
+
+        /** The number of levels of the image (the last one is full resolution) */
+        unsigned int level_count;
+
+    } progressive_image_buffer_metadata;
+
+
 } /* end namespace data */
 } /* end namespace rivlib */
 } /* end namespace eu_vicci */
@@ -10,6 +10,8 @@
 #include "api_impl/raw_image_data_binding_impl.h"
 #include "data/buffer_type.h"
 #include "data/image_buffer_metadata.h"
+#include "ip_connection.h"
+#include "metrics_utility.h"
 
 using namespace eu_vicci::rivlib;
 
@@ -56,9 +58,13 @@ encoder::image_encoder_base::runnable::on_thread_terminating(void) throw() {
  * encoder::image_encoder_base::image_encoder_base
  */
 encoder::image_encoder_base::image_encoder_base(void) : element_node(),
-        input_worker(), input_new_data_event(), input_data_lock(), input_worker_abort(false), input_worker_running(false), raw_input(),
+        input_worker(), input_new_data_event(), input_done_event(), input_data_lock(), input_worker_abort(false), input_worker_running(false),
+        input_capture_requested(false), input_pending(false), raw_input(),
         encoder_worker(), encoder_new_data_event(), encoder_terminate(false), encoded_data(),
-        output_worker(), output_update_event(), out_reqs() {
+        handed_time_code(0), output_worker(), output_update_event(), out_reqs(), rois(), rois_lock(),
+        frames_captured(0), frames_encoded(0), refinements_encoded(0),
+        bytes_encoded(0), encode_time(), metrics_lock() {
+    ::memset(&this->encode_time, 0, sizeof(latency_histogram));
 
     this->input_worker.set_run(the::delegate<int>(*this, &image_encoder_base::run_input_collector));
     this->input_worker.set_terminate_event(&this->input_new_data_event);
@@ -92,6 +98,14 @@ encoder::image_encoder_base::~image_encoder_base(void) {
 }
 
 
+/*
+ * encoder::image_encoder_base::get_kind
+ */
+node_kind encoder::image_encoder_base::get_kind(void) const {
+    return kind;
+}
+
+
 /*
  * encoder::image_encoder_base::start_new_input_encoding
  */
@@ -109,7 +123,14 @@ void encoder::image_encoder_base::start_new_input_encoding(void) {
         throw new the::invalid_operation_exception("encoder cannot be started when already running", __FILE__, __LINE__);
     }
     this->input_worker_abort = false;
-    this->input_new_data_event.set();
+
+    the::system::threading::auto_lock<the::system::threading::critical_section> lock(this->input_data_lock);
+    if (!this->has_due_requests()) {
+        // nobody is waiting for an image right now, so read the data on demand
+        this->input_pending = true;
+    } else {
+        this->trigger_input_capture();
+    }
 }
 
 
@@ -118,7 +139,16 @@ void encoder::image_encoder_base::start_new_input_encoding(void) {
  */
 void encoder::image_encoder_base::wait_input_encoding(bool abort) {
     this->input_worker_abort |= abort;
-    this->input_data_lock.lock();
+    while (true) {
+        this->input_data_lock.lock();
+        // the application will change the data now, so it must not be read on demand anymore
+        this->input_pending = false;
+        if (abort) this->input_capture_requested = false;
+        if (!this->input_capture_requested || !this->input_worker.is_running()) break;
+        // the input worker has been triggered but has not finished reading yet
+        this->input_data_lock.unlock();
+        this->input_done_event.wait();
+    }
     this->input_data_lock.unlock();
     THE_ASSERT(this->input_worker_running == false);
 }
@@ -128,7 +158,7 @@ void encoder::image_encoder_base::wait_input_encoding(bool abort) {
  * encoder::image_encoder_base::is_input_encoding_running
  */
 bool encoder::image_encoder_base::is_input_encoding_running(void) {
-    return this->input_worker_running;
+    return this->input_worker_running || this->input_capture_requested;
 }
 
 
@@ -136,6 +166,7 @@ bool encoder::image_encoder_base::is_input_encoding_running(void) {
  * encoder::image_encoder_base::request_output
  */
 void encoder::image_encoder_base::request_output(image_request::ptr req) {
+    // the output worker reads skipped input data when the request becomes due
     this->out_reqs.add(req);
     this->output_update_event.set();
 }
@@ -165,16 +196,98 @@ void encoder::image_encoder_base::remove_pending_requests(image_request::output_
 }
 
 
+/*
+ * encoder::image_encoder_base::set_regions_of_interest
+ */
+void encoder::image_encoder_base::set_regions_of_interest(const std::vector<image_region>& regions) {
+    the::system::threading::auto_lock<the::system::threading::critical_section> lock(this->rois_lock);
+    this->rois = regions;
+}
+
+
+/*
+ * encoder::image_encoder_base::get_regions_of_interest
+ */
+std::vector<image_region> encoder::image_encoder_base::get_regions_of_interest(void) {
+    the::system::threading::auto_lock<the::system::threading::critical_section> lock(this->rois_lock);
+    return this->rois;
+}
+
+
+/*
+ * encoder::image_encoder_base::add_metrics
+ */
+void encoder::image_encoder_base::add_metrics(data_binding_metrics& metrics) {
+    metrics.encoders++;
+    metrics.image_streams += this->peers_of<ip_connection>().size();
+
+    the::system::threading::auto_lock<the::system::threading::critical_section> lock(this->metrics_lock);
+    metrics.frames_captured += this->frames_captured;
+    metrics.frames_encoded += this->frames_encoded;
+    metrics.refinements_encoded += this->refinements_encoded;
+    metrics.bytes_encoded += this->bytes_encoded;
+    metrics_utility::add(metrics.encode_time, this->encode_time);
+}
+
+
+/*
+ * encoder::image_encoder_base::encode_refinement
+ */
+data::buffer::shared_ptr encoder::image_encoder_base::encode_refinement(void) {
+    return nullptr;
+}
+
+
+/*
+ * encoder::image_encoder_base::has_due_requests
+ */
+bool encoder::image_encoder_base::has_due_requests(void) {
+    the::system::threading::auto_lock<the::collections::fast_forward_list<image_request::ptr, the::system::threading::critical_section> > lock(this->out_reqs);
+    if (this->out_reqs.is_empty()) return false;
+    double now = the::system::performance_counter::query_millis();
+    the::collections::fast_forward_list<image_request::ptr, the::system::threading::critical_section>::enumerator i = this->out_reqs.get_enumerator();
+    while (i.has_next()) {
+        if (i.next()->due_time() <= now) return true;
+    }
+    return false;
+}
+
+
+/*
+ * encoder::image_encoder_base::trigger_input_capture
+ */
+void encoder::image_encoder_base::trigger_input_capture(void) {
+    this->input_pending = false;
+    this->input_capture_requested = true;
+    this->input_new_data_event.set();
+}
+
+
 /*
  * encoder::image_encoder_base::run_input_collector
  */
 int encoder::image_encoder_base::run_input_collector(void) {
+    int rv = this->collect_input_data();
+
+    // the worker stopped, so release 'wait_input_encoding'
+    this->input_data_lock.lock();
+    this->input_capture_requested = false;
+    this->input_data_lock.unlock();
+    this->input_done_event.set();
+
+    return rv;
+}
+
+
+/*
+ * encoder::image_encoder_base::collect_input_data
+ */
+int encoder::image_encoder_base::collect_input_data(void) {
     bool terminate = false;
     unsigned int frame_cnt = 0;
-    std::vector<api_ptr_base> src = this->select<image_data_binding>();
+    peer_range<raw_image_data_binding_impl> src = this->peers_of<raw_image_data_binding_impl>();
     if (src.size() != 1) return -1;
-    raw_image_data_binding_impl *ridbi = dynamic_cast<raw_image_data_binding_impl*>(src[0].get());
-    if (ridbi == nullptr) return -2;
+    raw_image_data_binding_impl *ridbi = src[0];
 
     if ((ridbi->get_colour_type() != image_colour_type::rgb)
         && (ridbi->get_colour_type() != image_colour_type::bgr)) return -3; // unsupported colour type
@@ -193,6 +306,11 @@ int encoder::image_encoder_base::run_input_collector(void) {
         data::buffer::shared_ptr buf;
 
         this->input_data_lock.lock();
+        if (!this->input_capture_requested) {
+            // reading has been aborted before it started
+            this->input_data_lock.unlock();
+            continue;
+        }
         this->input_worker_running = true;
 
         frame_cnt++;
@@ -221,11 +339,17 @@ int encoder::image_encoder_base::run_input_collector(void) {
 
             this->raw_input.set_buffer(buf);
 
+            this->metrics_lock.lock();
+            this->frames_captured++;
+            this->metrics_lock.unlock();
+
         } catch(...) {
         }
 
+        this->input_capture_requested = false;
         this->input_worker_running = false;
         this->input_data_lock.unlock();
+        this->input_done_event.set();
 
     }
 
@@ -239,17 +363,47 @@ int encoder::image_encoder_base::run_input_collector(void) {
 int encoder::image_encoder_base::run_encoder(void) {
     this->encoder_terminate = false;
     this->encoder_worker.set_terminate_flag(&this->encoder_terminate);
+    unsigned int refining = 0; // time code of the last result, if it may be refined
 
     while (!this->encoder_terminate) {
+        // set for new input data and when the output worker handed encoded data out
         this->encoder_new_data_event.wait();
         if (this->encoder_terminate) break;
 
         data::buffer::shared_ptr buf = this->raw_input.get_buffer();
-        this->raw_input.set_buffer(nullptr);
+        if (buf) {
+            this->raw_input.set_buffer(nullptr);
+
+            // here, the actual encoding takes place!
+            double start = the::system::performance_counter::query_millis();
+            buf = this->encode(buf);
+            if (buf) {
+                double duration = the::system::performance_counter::query_millis() - start;
+                the::system::threading::auto_lock<the::system::threading::critical_section> lock(this->metrics_lock);
+                this->frames_encoded++;
+                this->bytes_encoded += buf->data().size();
+                metrics_utility::record(this->encode_time, duration);
+            }
 
-        // here, the actual encoding takes place!
-        buf = this->encode(buf);
+        } else if ((refining != 0) && (this->handed_time_code >= refining)) {
+            // progressive encoders refine the frame only after the previous
+            // level was sent, as it would be overwritten otherwise
+            buf = this->encode_refinement();
+            if (!buf) {
+                refining = 0;
+                continue;
+            }
+            this->metrics_lock.lock();
+            this->refinements_encoded++;
+            this->bytes_encoded += buf->data().size();
+            this->metrics_lock.unlock();
+
+        } else {
+            // the last result has not been handed out yet
+            continue;
+        }
 
+        refining = buf ? buf->time_code() : 0;
         this->encoded_data.set_buffer(buf);
         this->output_update_event.set();
     }
@@ -265,20 +419,25 @@ int encoder::image_encoder_base::run_output(void) {
     bool terminate = false;
     this->output_worker.set_terminate_flag(&terminate);
     the::collections::fast_forward_list<image_request::ptr> pending_requests;
+    the::system::threading::event::timeout_type timeout = the::system::threading::event::timeout_infinite;
 
     while (!terminate) {
-        this->output_update_event.wait();
+        this->output_update_event.wait(timeout);
         if (terminate) break;
+        timeout = the::system::threading::event::timeout_infinite;
 
         data::buffer::shared_ptr buf = this->encoded_data.get_buffer();
-        if (!buf) continue; // no data, so there is nothing to output
-        //printf("pre-out: %u\n", buf->time_code());
+        //if (buf) printf("pre-out: %u\n", buf->time_code());
 
         THE_ASSERT(pending_requests.is_empty());
 
+        double now = the::system::performance_counter::query_millis();
+        double next_due = -1.0;
+        bool waiting_for_data = false;
+        bool handed_out = false;
+
         this->out_reqs.lock();
 
-        // data is available
         // now check if there are output requests which can be fulfilled
         while (!this->out_reqs.is_empty()) {
 
@@ -286,14 +445,23 @@ int encoder::image_encoder_base::run_output(void) {
             image_request::ptr rq = this->out_reqs.first();
             this->out_reqs.remove_first();
 
+            if (rq->due_time() > now) {
+                // request is paced to a lower frame rate. Keep for later
+                if ((next_due < 0.0) || (rq->due_time() < next_due)) {
+                    next_due = rq->due_time();
+                }
+                pending_requests.add(rq);
+
             // overflow will occure on 1.5 months update. ... meh
-            if (rq->last_time() < buf->time_code()) {
+            } else if (buf && (rq->last_time() < buf->time_code())) {
                 //printf("out: %u\n", buf->time_code());
                 // request fulfillable
                 rq->call(buf);
+                handed_out = true;
 
             } else {
                 // request cannot be fulfilled at the moment. Keep for later
+                waiting_for_data = true;
                 pending_requests.add(rq);
             }
         }
@@ -304,6 +472,26 @@ int encoder::image_encoder_base::run_output(void) {
         }
 
         this->out_reqs.unlock();
+
+        if (handed_out && (this->handed_time_code < buf->time_code())) {
+            // let the encoder produce the next refinement of this frame
+            this->handed_time_code = buf->time_code();
+            this->encoder_new_data_event.set();
+        }
+
+        if (next_due >= 0.0) {
+            // wake up when the next paced request becomes due
+            timeout = static_cast<the::system::threading::event::timeout_type>(next_due - now) + 1;
+        }
+
+        if (waiting_for_data) {
+            // a due request might be waiting for input data which has been skipped,
+            // so read the latest input data now
+            the::system::threading::auto_lock<the::system::threading::critical_section> lock(this->input_data_lock);
+            if (this->input_pending) {
+                this->trigger_input_capture();
+            }
+        }
     }
 
     return 0;
@@ -8,18 +8,23 @@
 #pragma once
 
 #include "rivlib/image_data_types.h"
+#include "rivlib/ip_utilities.h"
+#include "rivlib/provider.h"
 #include "element_node.h"
+#include "executor.h"
 #include "encoder/image_request.h"
 #include "data/slot.h"
 #include "data/buffer.h"
 #include "the/system/threading/thread.h"
 #include "the/system/threading/runnable.h"
-#include "the/system/threading/runnable_thread.h"
 #include "the/delegate.h"
 #include "the/blob.h"
 #include "the/system/threading/critical_section.h"
 #include "the/collections/fast_forward_list.h"
 #include "the/system/threading/event.h"
+#include "the/system/performance_counter.h"
+#include <atomic>
+#include <vector>
 
 
 namespace eu_vicci {
@@ -32,6 +37,9 @@ namespace encoder {
     class image_encoder_base : public element_node {
     public:
 
+        /** The kind of this node in the peer indexes */
+        static const node_kind kind = node_kind::image_encoder;
+
         /** ctor */
         image_encoder_base(void);
 
@@ -39,7 +47,16 @@ namespace encoder {
         virtual ~image_encoder_base(void);
 
         /**
-         * Starts the encoding of new input data
+         * Answer the kind of this node
+         *
+         * @return node_kind::image_encoder
+         */
+        virtual node_kind get_kind(void) const;
+
+        /**
+         * Starts the encoding of new input data. If no output request is
+         * pending, the input data is not read now but marked as available
+         * and will be read as soon as an output request arrives.
          */
         void start_new_input_encoding(void);
 
@@ -72,8 +89,32 @@ namespace encoder {
          */
         void remove_pending_requests(image_request::output_callback cb, void* ctxt);
 
+        /**
+         * Sets the regions of interest of the encoded images. Encoders
+         * supporting regions of interest spend more bits on these regions
+         * than on the remaining image. An empty list disables this.
+         *
+         * @param regions The regions of interest in pixel coordinates
+         */
+        void set_regions_of_interest(const std::vector<image_region>& regions);
+
+        /**
+         * Adds the runtime metrics of this encoder to the metrics of the
+         * data binding it serves
+         *
+         * @param metrics The metrics of the data binding
+         */
+        void add_metrics(data_binding_metrics& metrics);
+
     protected:
 
+        /**
+         * Answer the current regions of interest
+         *
+         * @return The current regions of interest
+         */
+        std::vector<image_region> get_regions_of_interest(void);
+
         /**
          * Answer whether or not the encoder should terminate as fast as possible
          *
@@ -92,6 +133,17 @@ namespace encoder {
          */
         virtual data::buffer::shared_ptr encode(data::buffer::shared_ptr data) = 0;
 
+        /**
+         * Produces a refinement of the data most recently returned by
+         * 'encode'. The encoder calls this method each time the previous
+         * result has been handed to a client, until it returns nullptr or
+         * until new input data becomes available, in which case the
+         * remaining refinements are dropped.
+         *
+         * @return The encoded refinement or nullptr if there is none
+         */
+        virtual data::buffer::shared_ptr encode_refinement(void);
+
     private:
 
         /** Utility runnable class */
@@ -171,6 +223,20 @@ namespace encoder {
 
         };
 
+        /**
+         * Answer whether any pending output request may be fulfilled now,
+         * i.e. whether a new image is currently in demand
+         *
+         * @return True if at least one pending request is due
+         */
+        bool has_due_requests(void);
+
+        /**
+         * Starts reading the input data.
+         * The caller must hold 'input_data_lock'.
+         */
+        void trigger_input_capture(void);
+
         /**
          * Perform the work of the input encoding
          *
@@ -179,6 +245,13 @@ namespace encoder {
          */
         int run_input_collector(void);
 
+        /**
+         * Reads the input data each time 'input_new_data_event' is set
+         *
+         * @return The return code of 'run_input_collector'
+         */
+        int collect_input_data(void);
+
         /**
          * Signals that new input data is now available
          */
@@ -218,11 +291,14 @@ namespace encoder {
         int run_output(void);
 
         /** The input data worker thread */
-        the::system::threading::runnable_thread<runnable> input_worker;
+        pooled_thread<runnable> input_worker;
 
         /** The event that new input data is available */
         the::system::threading::event input_new_data_event;
 
+        /** The event that the input worker finished reading the input data */
+        the::system::threading::event input_done_event;
+
         /** The lock for the input data */
         the::system::threading::critical_section input_data_lock;
 
@@ -232,11 +308,17 @@ namespace encoder {
         /** Flag showing if the processing of the input_worker is computing */
         bool input_worker_running;
 
+        /** Flag showing that the input_worker has been asked to read the input data */
+        bool input_capture_requested;
+
+        /** Flag showing that valid input data is available but has not been read */
+        bool input_pending;
+
         /** Slot for the raw input data */
         data::slot raw_input;
 
         /** The worker performing the actual encoding */
-        the::system::threading::runnable_thread<runnable> encoder_worker;
+        pooled_thread<runnable> encoder_worker;
 
         /** Signal that new data is available for the encoder */
         the::system::threading::event encoder_new_data_event;
@@ -247,8 +329,11 @@ namespace encoder {
         /** Slot for the encoded frame data */
         data::slot encoded_data;
 
+        /** The time code of the encoded data most recently handed to a client */
+        std::atomic<unsigned int> handed_time_code;
+
         /** The worker sending the output data */
-        the::system::threading::runnable_thread<runnable> output_worker;
+        pooled_thread<runnable> output_worker;
 
         /** Event fired when new data for the output or new output requests are available */
         the::system::threading::event output_update_event;
@@ -256,6 +341,30 @@ namespace encoder {
         /** pending output requests */
         the::collections::fast_forward_list<image_request::ptr, the::system::threading::critical_section> out_reqs;
 
+        /** The regions of interest */
+        std::vector<image_region> rois;
+
+        /** The lock for the regions of interest */
+        the::system::threading::critical_section rois_lock;
+
+        /** The number of frames copied from the data binding */
+        uint64_t frames_captured;
+
+        /** The number of frames encoded */
+        uint64_t frames_encoded;
+
+        /** The number of refinements encoded */
+        uint64_t refinements_encoded;
+
+        /** The number of bytes of all encoded frames and refinements */
+        uint64_t bytes_encoded;
+
+        /** The durations of encoding the frames */
+        latency_histogram encode_time;
+
+        /** The lock for the metrics */
+        the::system::threading::critical_section metrics_lock;
+
     };
 
 
@@ -13,6 +13,7 @@
 #include "data/buffer_type.h"
 #include "data/image_buffer_metadata.h"
 #include "the/text/string_builder.h"
+#include "the/math/functions.h"
 #include <algorithm>
 #include "vislib/types.h"
 #define XMD_H
@@ -153,6 +154,11 @@ data::buffer::shared_ptr encoder::image_encoder_rgb_mjpeg::encode(data::buffer::
     }
     ASSERT(data->type() == data::buffer_type::raw_rgb_bytes);
 
+    std::vector<image_region> rois = this->get_regions_of_interest();
+    if (!rois.empty()) {
+        this->degrade_periphery(data, rois);
+    }
+
     o->set_time_code(data->time_code());
     o->set_type(data::buffer_type::mjpeg_rgb_bytes);
     o->metadata() = data->metadata();
@@ -199,5 +205,71 @@ data::buffer::shared_ptr encoder::image_encoder_rgb_mjpeg::encode(data::buffer::
     return o;
 }
 
+
+/*
+ * encoder::image_encoder_rgb_mjpeg::degrade_periphery
+ */
+void encoder::image_encoder_rgb_mjpeg::degrade_periphery(data::buffer::shared_ptr data, const std::vector<image_region>& regions) {
+    // size of the jpeg minimum coded unit (16x16 for the default 4:2:0 sampling)
+    const unsigned int mcu_size = 16;
+    // size of the pixel cells averaged outside of the regions of interest
+    const unsigned int cell_size = 4;
+
+    data::image_buffer_metadata *ibm = data->metadata().as<data::image_buffer_metadata>();
+    unsigned int w = ibm->width;
+    unsigned int h = ibm->height;
+    unsigned char *pix = data->data().as<unsigned char>();
+    size_t rcnt = regions.size();
+
+    for (unsigned int by = 0; by < h; by += mcu_size) {
+        unsigned int bh = the::math::minimum(mcu_size, h - by);
+        for (unsigned int bx = 0; bx < w; bx += mcu_size) {
+            unsigned int bw = the::math::minimum(mcu_size, w - bx);
+
+            bool in_roi = false;
+            for (size_t i = 0; i < rcnt; i++) {
+                const image_region& r = regions[i];
+                if ((bx < r.x + r.width) && (r.x < bx + bw)
+                        && (by < r.y + r.height) && (r.y < by + bh)) {
+                    in_roi = true;
+                    break;
+                }
+            }
+            if (in_roi) continue;
+
+            // replace each cell by its average colour
+            for (unsigned int cy = by; cy < by + bh; cy += cell_size) {
+                unsigned int ch = the::math::minimum(cell_size, by + bh - cy);
+                for (unsigned int cx = bx; cx < bx + bw; cx += cell_size) {
+                    unsigned int cw = the::math::minimum(cell_size, bx + bw - cx);
+                    unsigned int sum[3] = { 0, 0, 0 };
+                    for (unsigned int y = cy; y < cy + ch; y++) {
+                        const unsigned char *p = pix + (y * w + cx) * 3;
+                        for (unsigned int x = 0; x < cw; x++, p += 3) {
+                            sum[0] += p[0];
+                            sum[1] += p[1];
+                            sum[2] += p[2];
+                        }
+                    }
+                    unsigned int area = cw * ch;
+                    unsigned char avg[3] = {
+                        static_cast<unsigned char>(sum[0] / area),
+                        static_cast<unsigned char>(sum[1] / area),
+                        static_cast<unsigned char>(sum[2] / area) };
+                    for (unsigned int y = cy; y < cy + ch; y++) {
+                        unsigned char *p = pix + (y * w + cx) * 3;
+                        for (unsigned int x = 0; x < cw; x++, p += 3) {
+                            p[0] = avg[0];
+                            p[1] = avg[1];
+                            p[2] = avg[2];
+                        }
+                    }
+                }
+            }
+        }
+        if (this->encoder_should_terminate()) return;
+    }
+}
+
 #endif
 // if(USE_MJPEG==1) end
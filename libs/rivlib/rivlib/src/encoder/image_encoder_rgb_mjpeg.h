@@ -69,6 +69,16 @@ namespace encoder {
 
     private:
 
+        /**
+         * Removes fine detail from all blocks outside the regions of
+         * interest, so that the jpeg compression spends its bits on the
+         * regions of interest while keeping the quality setting there.
+         *
+         * @param data The raw rgb input data (top-down)
+         * @param regions The regions of interest
+         */
+        void degrade_periphery(data::buffer::shared_ptr data, const std::vector<image_region>& regions);
+
         /** The compression quality setting [0..100] */
         unsigned int quality;
 
@@ -0,0 +1,199 @@
+/*
+ * rivlib
+ * encoder/image_encoder_rgb_progressive.cpp
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+#include "stdafx.h"
+#include "encoder/image_encoder_rgb_progressive.h"
+#include "data/buffer_type.h"
+#include "data/image_buffer_metadata.h"
+#include <algorithm>
+
+using namespace eu_vicci::rivlib;
+
+
+/*
+ * encoder::image_encoder_rgb_progressive::image_encoder_rgb_progressive
+ */
+encoder::image_encoder_rgb_progressive::image_encoder_rgb_progressive(void)
+        : image_encoder_rgb_zip(), frame(), frame_cnt(0), next_level(0),
+        level_count(default_level_count) {
+    // intentionally empty
+}
+
+
+/*
+ * encoder::image_encoder_rgb_progressive::~image_encoder_rgb_progressive
+ */
+encoder::image_encoder_rgb_progressive::~image_encoder_rgb_progressive(void) {
+    // intentionally empty
+}
+
+
+/*
+ * encoder::image_encoder_rgb_progressive::decode
+ */
+data::buffer::shared_ptr encoder::image_encoder_rgb_progressive::decode(data::buffer::shared_ptr data) {
+    if (data->type() != data::buffer_type::progressive_rgb_bytes) throw the::exception(__FILE__, __LINE__);
+    if (data->metadata().size() < sizeof(data::progressive_image_buffer_metadata)) throw the::exception(__FILE__, __LINE__);
+    data::progressive_image_buffer_metadata pibm = *data->metadata().as<data::progressive_image_buffer_metadata>();
+
+    // the level itself is a zip-compressed image
+    data->set_type(data::buffer_type::zip_rgb_bytes);
+    data::buffer::shared_ptr lvl = image_encoder_rgb_zip::decode(data);
+    data->set_type(data::buffer_type::progressive_rgb_bytes);
+
+    if ((pibm.width == pibm.full_width) && (pibm.height == pibm.full_height)) {
+        lvl->metadata().enforce_size(sizeof(data::image_buffer_metadata), true);
+        return lvl;
+    }
+    if ((pibm.width == 0) || (pibm.height == 0)) throw the::exception(__FILE__, __LINE__);
+
+    // upsample to full resolution (nearest neighbour)
+    data::buffer::shared_ptr o = data::buffer::create();
+    o->set_time_code(data->time_code());
+    o->set_type(data::buffer_type::raw_rgb_bytes);
+    o->metadata().assert_size(sizeof(data::image_buffer_metadata));
+    o->metadata().as<data::image_buffer_metadata>()->width = pibm.full_width;
+    o->metadata().as<data::image_buffer_metadata>()->height = pibm.full_height;
+    o->data().assert_size(pibm.full_width * pibm.full_height * 3);
+
+    const unsigned char *src = lvl->data().as<unsigned char>();
+    unsigned char *dst = o->data().as<unsigned char>();
+    for (unsigned int y = 0; y < pibm.full_height; y++) {
+        unsigned int sy = std::min<unsigned int>((y * pibm.height) / pibm.full_height, pibm.height - 1);
+        const unsigned char *srow = src + sy * pibm.width * 3;
+        for (unsigned int x = 0; x < pibm.full_width; x++, dst += 3) {
+            unsigned int sx = std::min<unsigned int>((x * pibm.width) / pibm.full_width, pibm.width - 1);
+            dst[0] = srow[sx * 3 + 0];
+            dst[1] = srow[sx * 3 + 1];
+            dst[2] = srow[sx * 3 + 2];
+        }
+    }
+
+    return o;
+}
+
+
+/*
+ * encoder::image_encoder_rgb_progressive::is_final_level
+ */
+bool encoder::image_encoder_rgb_progressive::is_final_level(data::buffer::shared_ptr data) {
+    if (data->type() != data::buffer_type::progressive_rgb_bytes) return true;
+    if (data->metadata().size() < sizeof(data::progressive_image_buffer_metadata)) return true;
+    const data::progressive_image_buffer_metadata *pibm = data->metadata().as<data::progressive_image_buffer_metadata>();
+    return (pibm->level + 1 >= pibm->level_count);
+}
+
+
+/*
+ * encoder::image_encoder_rgb_progressive::encode
+ */
+data::buffer::shared_ptr encoder::image_encoder_rgb_progressive::encode(data::buffer::shared_ptr data) {
+    if (data == nullptr) return nullptr;
+
+    if (data->type() == data::buffer_type::raw_bgr_bytes) {
+        data::image_buffer_metadata *ibm = data->metadata().as<data::image_buffer_metadata>();
+        unsigned int cnt = ibm->width * ibm->height;
+        unsigned char *d = data->data().as<unsigned char>();
+        for (unsigned int i = 0; i < cnt; i++, d += 3) {
+            std::swap(d[0], d[2]);
+        }
+        data->set_type(data::buffer_type::raw_rgb_bytes);
+    }
+
+    this->frame = data;
+    this->frame_cnt++;
+    this->next_level = 0;
+
+    return this->encode_refinement();
+}
+
+
+/*
+ * encoder::image_encoder_rgb_progressive::encode_refinement
+ */
+data::buffer::shared_ptr encoder::image_encoder_rgb_progressive::encode_refinement(void) {
+    if (!this->frame || (this->next_level >= this->level_count)) {
+        this->frame.reset();
+        return nullptr;
+    }
+    return this->encode_level(this->next_level++);
+}
+
+
+/*
+ * encoder::image_encoder_rgb_progressive::encode_level
+ */
+data::buffer::shared_ptr encoder::image_encoder_rgb_progressive::encode_level(unsigned int level) {
+    const data::image_buffer_metadata *ibm = this->frame->metadata().as<data::image_buffer_metadata>();
+    unsigned int fw = ibm->width;
+    unsigned int fh = ibm->height;
+    unsigned int scale = 1u << (this->level_count - 1 - level);
+
+    // skip levels which would be smaller than one pixel
+    while ((scale > 1) && ((fw < scale) || (fh < scale))) {
+        scale >>= 1;
+        level++;
+    }
+    this->next_level = level + 1;
+
+    data::buffer::shared_ptr lvl;
+    unsigned int lw = fw;
+    unsigned int lh = fh;
+
+    if (scale == 1) {
+        lvl = this->frame;
+
+    } else {
+        // box filter downsampling
+        lw = fw / scale;
+        lh = fh / scale;
+        lvl = data::buffer::create();
+        lvl->set_type(data::buffer_type::raw_rgb_bytes);
+        lvl->metadata().assert_size(sizeof(data::image_buffer_metadata));
+        lvl->metadata().as<data::image_buffer_metadata>()->width = lw;
+        lvl->metadata().as<data::image_buffer_metadata>()->height = lh;
+        lvl->data().assert_size(lw * lh * 3);
+
+        const unsigned char *src = this->frame->data().as<unsigned char>();
+        unsigned char *dst = lvl->data().as<unsigned char>();
+        unsigned int area = scale * scale;
+        for (unsigned int y = 0; y < lh; y++) {
+            for (unsigned int x = 0; x < lw; x++, dst += 3) {
+                unsigned int sum[3] = { 0, 0, 0 };
+                for (unsigned int sy = y * scale; sy < (y + 1) * scale; sy++) {
+                    const unsigned char *s = src + (sy * fw + x * scale) * 3;
+                    for (unsigned int sx = 0; sx < scale; sx++, s += 3) {
+                        sum[0] += s[0];
+                        sum[1] += s[1];
+                        sum[2] += s[2];
+                    }
+                }
+                dst[0] = static_cast<unsigned char>(sum[0] / area);
+                dst[1] = static_cast<unsigned char>(sum[1] / area);
+                dst[2] = static_cast<unsigned char>(sum[2] / area);
+            }
+            if (this->encoder_should_terminate()) return nullptr;
+        }
+    }
+
+    data::buffer::shared_ptr o = image_encoder_rgb_zip::encode(lvl);
+    if (!o) return nullptr;
+
+    // levels of one frame use consecutive time codes
+    o->set_time_code(this->frame_cnt * this->level_count + level);
+    o->set_type(data::buffer_type::progressive_rgb_bytes);
+    o->metadata().enforce_size(sizeof(data::progressive_image_buffer_metadata));
+    data::progressive_image_buffer_metadata *pibm = o->metadata().as<data::progressive_image_buffer_metadata>();
+    pibm->width = lw;
+    pibm->height = lh;
+    pibm->full_width = fw;
+    pibm->full_height = fh;
+    pibm->level = level;
+    pibm->level_count = this->level_count;
+
+    return o;
+}
@@ -0,0 +1,105 @@
+/*
+ * rivlib
+ * encoder/image_encoder_rgb_progressive.h
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+#pragma once
+#include "encoder/image_encoder_rgb_zip.h"
+#include "data/buffer.h"
+
+
+namespace eu_vicci {
+namespace rivlib {
+namespace encoder {
+
+
+    /**
+     * The rgb_progressive image encoder
+     *
+     * Each frame is sent as an image pyramid. The coarsest level is sent
+     * first and each following level doubles the resolution until the full
+     * resolution is reached. Each level is zlib-compressed. The levels of a
+     * frame use consecutive time codes, so the output request mechanism
+     * streams the refinements without further protocol changes.
+     */
+    class image_encoder_rgb_progressive : public image_encoder_rgb_zip {
+    public:
+
+        /** The default number of levels of the image pyramid */
+        static const unsigned int default_level_count = 3;
+
+        /** ctor */
+        image_encoder_rgb_progressive(void);
+
+        /** dtor */
+        virtual ~image_encoder_rgb_progressive(void);
+
+        /**
+         * Performs data decoding to rgb_raw. The decoded image is always
+         * scaled to the full resolution.
+         *
+         * @param data The encoded input data
+         *
+         * @return The raw_rgb output data
+         */
+        data::buffer::shared_ptr decode(data::buffer::shared_ptr data);
+
+        /**
+         * Answer whether the encoded data is the last (full resolution)
+         * level of its frame
+         *
+         * @param data The encoded input data
+         *
+         * @return True if 'data' is the final level of its frame
+         */
+        static bool is_final_level(data::buffer::shared_ptr data);
+
+    protected:
+
+        /**
+         * Performs the actual encoding of the coarsest level
+         *
+         * @param data The raw input data
+         *
+         * @return The encoded data
+         */
+        virtual data::buffer::shared_ptr encode(data::buffer::shared_ptr data);
+
+        /**
+         * Encodes the next level of the current frame
+         *
+         * @return The encoded level or nullptr if the frame is complete
+         */
+        virtual data::buffer::shared_ptr encode_refinement(void);
+
+    private:
+
+        /**
+         * Encodes one level of the current frame
+         *
+         * @param level The level to be encoded
+         *
+         * @return The encoded level
+         */
+        data::buffer::shared_ptr encode_level(unsigned int level);
+
+        /** The raw rgb data of the current frame */
+        data::buffer::shared_ptr frame;
+
+        /** The number of frames encoded so far */
+        unsigned int frame_cnt;
+
+        /** The next level to be encoded */
+        unsigned int next_level;
+
+        /** The number of levels of the image pyramid */
+        unsigned int level_count;
+
+    };
+
+
+} /* end namespace encoder */
+} /* end namespace rivlib */
+} /* end namespace eu_vicci */
@@ -14,8 +14,8 @@ using namespace eu_vicci::rivlib;
 /*
  * encoder::image_request::image_request
  */
-encoder::image_request::image_request(output_callback func, void *ctxt, unsigned int last_time_id) 
-        : func(func), ctxt(ctxt), last_time_id(last_time_id) {
+encoder::image_request::image_request(output_callback func, void *ctxt, unsigned int last_time_id, double not_before) 
+        : func(func), ctxt(ctxt), last_time_id(last_time_id), not_before(not_before) {
     // intentionally empty
 }
 
@@ -45,4 +45,5 @@ void encoder::image_request::reset(void) {
     this->func = nullptr;
     this->ctxt = nullptr;
     this->last_time_id = 0;
+    this->not_before = 0.0;
 }
@@ -38,8 +38,10 @@ namespace encoder {
          * @param func The callback function for the output
          * @param ctxt The context pointer for the output callback function
          * @param last_time_id The time id of the last frame
+         * @param not_before The earliest time (performance counter
+         *                   milliseconds) the request may be fulfilled
          */
-        image_request(output_callback func = nullptr, void *ctxt = nullptr, unsigned int last_time_id = 0);
+        image_request(output_callback func = nullptr, void *ctxt = nullptr, unsigned int last_time_id = 0, double not_before = 0.0);
 
         /** dtor */
         ~image_request(void);
@@ -62,11 +64,14 @@ namespace encoder {
          * @param func The callback function for the output
          * @param ctxt The context pointer for the output callback function
          * @param last_time_id The time id of the last frame
+         * @param not_before The earliest time (performance counter
+         *                   milliseconds) the request may be fulfilled
          */
-        inline void set(output_callback func, void *ctxt, unsigned int last_time_id) {
+        inline void set(output_callback func, void *ctxt, unsigned int last_time_id, double not_before = 0.0) {
             this->func = func;
             this->ctxt = ctxt;
             this->last_time_id = last_time_id;
+            this->not_before = not_before;
         }
 
         /**
@@ -78,6 +83,15 @@ namespace encoder {
             return this->last_time_id;
         }
 
+        /**
+         * Answer the earliest time the request may be fulfilled
+         *
+         * @return The earliest time in performance counter milliseconds
+         */
+        inline double due_time(void) const {
+            return this->not_before;
+        }
+
         /**
          * Checks if this request uses the specified callback target
          *
@@ -100,6 +114,9 @@ namespace encoder {
         /** The time id of the last frame */
         unsigned int last_time_id;
 
+        /** The earliest time the request may be fulfilled */
+        double not_before;
+
     };
 
 
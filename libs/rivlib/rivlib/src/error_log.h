@@ -15,14 +15,15 @@
 #include <string>
 #include <stdarg.h>
 #include "the/string.h"
-#include "the/system/threading/critical_section.h"
 
 
 namespace eu_vicci {
 namespace rivlib {
 
     /**
-     * Simple error log facade
+     * Simple error log facade. Messages are recorded by the calling thread
+     * and formatted and written asynchronously (see 'async_log'), so format
+     * strings must remain valid, e.g. be string literals.
      */
     class error_log {
     public:
@@ -34,9 +35,41 @@ namespace rivlib {
             info
         };
 
+        /**
+         * Function pointer type for sinks receiving the formatted log lines
+         *
+         * @param t The log message type
+         * @param line The log line, terminated by a new line
+         * @param ctxt The sink context
+         */
+        typedef void (*sink_callback)(msg_type t, const char *line, void *ctxt);
+
         /** The null_log object not to be used */
         static error_log null_log;
 
+        /**
+         * Sets the sink receiving the log lines of all logs. The lines are
+         * passed to the sink by a background thread, one at a time.
+         *
+         * @param sink The sink, or nullptr to write errors to stderr and
+         *             all other messages to stdout
+         * @param ctxt The context pointer passed to the sink
+         */
+        static void set_sink(sink_callback sink, void *ctxt = nullptr);
+
+        /**
+         * Sets the maximum number of messages per second each thread may
+         * log. Surplus messages are dropped and counted.
+         *
+         * @param per_second The maximum or zero for unlimited
+         */
+        static void set_rate_limit(unsigned int per_second);
+
+        /**
+         * Passes all logged messages to the sink before returning
+         */
+        static void flush(void);
+
         /**
          * Ctor
          *
@@ -147,82 +180,6 @@ namespace rivlib {
 
     private:
 
-        /** The message string type */
-        typedef the::astring msg_string_type;
-
-        /**
-         * message
-         */
-        class msg {
-        public:
-
-            /** Ctor */
-            msg(void);
-
-            /**
-             * Copy ctor
-             *
-             * @param src The object to clone from
-             */
-            msg(const msg& src);
-
-            /** Dtor */
-            ~msg(void);
-
-            /**
-             * Assignment operator
-             *
-             * @param rhs The right hand side operand
-             *
-             * @return A reference to this
-             */
-            msg& operator=(const msg& rhs);
-
-            /**
-             * Test for equality
-             *
-             * @param rhs The right hand side operand
-             *
-             * @return true if this and rhs are equal
-             */
-            bool operator==(const msg& rhs) const;
-
-            /**
-             * Fixes the message text
-             */
-            void fix_text(void);
-
-            /**
-             * Sets the current thread id
-             */
-            void set_thread_id(void);
-
-            /**
-             * Sets 'now' as time stamp
-             */
-            void set_time_stamp(void);
-
-            /**
-             * Prints the message to a stream
-             *
-             * @param stream The stream to write to
-             */
-            void print(FILE *stream);
-
-            /** the message type */
-            msg_type type;
-
-            /** the message text */
-            msg_string_type text;
-
-            /** the id of the tread */
-            msg_string_type thread_id;
-
-            /** the message time_stamp */
-            msg_string_type time_stamp;
-
-        };
-
         /**
          * Writes a log message
          *
@@ -244,9 +201,6 @@ namespace rivlib {
         /** the enable flag */
         bool enable;
 
-        /** The thread-lock object */
-        the::system::threading::critical_section lock_obj;
-
     };
 
 
@@ -0,0 +1,220 @@
+/*
+ * executor.cpp
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+#include "stdafx.h"
+#include "executor.h"
+#include "the/exception.h"
+#include "the/memory.h"
+#include "the/system/threading/auto_lock.h"
+
+using namespace eu_vicci::rivlib;
+using namespace the::system::threading;
+
+
+/*
+ * executor::task::task
+ */
+executor::task::task(runnable& r) : r(r), running(false), done(true, true) {
+    // intentionally empty
+}
+
+
+/*
+ * executor::task::~task
+ */
+executor::task::~task(void) {
+    // intentionally empty
+}
+
+
+/*
+ * executor::task::wait
+ */
+void executor::task::wait(void) {
+    this->done.wait();
+}
+
+
+/*
+ * executor::instance
+ */
+executor& executor::instance(void) {
+    static executor inst;
+    return inst;
+}
+
+
+/*
+ * executor::execute
+ */
+void executor::execute(task& t) {
+    auto_lock<critical_section> lock(this->lock_obj);
+    if (t.running) {
+        throw the::exception("Task already running", __FILE__, __LINE__);
+    }
+    if (this->terminating) {
+        throw the::exception("Executor terminated", __FILE__, __LINE__);
+    }
+    t.running = true;
+    t.done.reset();
+    this->queue.push_back(&t);
+
+    this->reap();
+    if (this->queue.size() > this->idle) {
+        // every task gets a thread of its own
+        pool_worker *w = new pool_worker(*this);
+        thread *th = new thread(w);
+        this->workers.push_back(w);
+        this->threads.push_back(th);
+        th->start();
+    } else {
+        this->work_event.set();
+    }
+}
+
+
+/*
+ * executor::count
+ */
+size_t executor::count(void) {
+    auto_lock<critical_section> lock(this->lock_obj);
+    this->reap();
+    return this->threads.size();
+}
+
+
+/*
+ * executor::pool_worker::pool_worker
+ */
+executor::pool_worker::pool_worker(executor& owner) : runnable(), finished(false),
+        owner(owner) {
+    // intentionally empty
+}
+
+
+/*
+ * executor::pool_worker::~pool_worker
+ */
+executor::pool_worker::~pool_worker(void) {
+    // intentionally empty
+}
+
+
+/*
+ * executor::pool_worker::run
+ */
+int executor::pool_worker::run(void) {
+    return this->owner.run_pool(*this);
+}
+
+
+/*
+ * executor::pool_worker::on_thread_terminating
+ */
+thread::termination_behaviour executor::pool_worker::on_thread_terminating(void) throw() {
+    return thread::termination_behaviour::graceful;
+}
+
+
+/*
+ * executor::executor
+ */
+executor::executor(void) : threads(), workers(), queue(), idle(0), lock_obj(),
+        work_event(), terminating(false) {
+    // intentionally empty
+}
+
+
+/*
+ * executor::~executor
+ */
+executor::~executor(void) {
+    this->lock_obj.lock();
+    this->terminating = true;
+    this->lock_obj.unlock();
+
+    // each terminating thread wakes the next one
+    this->work_event.set();
+    for (size_t i = 0, cnt = this->threads.size(); i < cnt; ++i) {
+        if (this->threads[i]->is_running()) {
+            this->threads[i]->join();
+        }
+        the::safe_delete(this->threads[i]);
+        the::safe_delete(this->workers[i]);
+    }
+    this->threads.clear();
+    this->workers.clear();
+}
+
+
+/*
+ * executor::run_pool
+ */
+int executor::run_pool(pool_worker& w) {
+    while (true) {
+        task *t = nullptr;
+
+        this->lock_obj.lock();
+        if (!this->queue.empty()) {
+            t = this->queue.front();
+            this->queue.pop_front();
+            if (!this->queue.empty() && (this->idle > 0)) {
+                // the auto-reset event wakes one thread per set
+                this->work_event.set();
+            }
+        } else if (this->terminating) {
+            this->lock_obj.unlock();
+            this->work_event.set();
+            break;
+        } else {
+            ++this->idle;
+        }
+        this->lock_obj.unlock();
+
+        if (t == nullptr) {
+            bool signalled = this->work_event.wait(idle_timeout);
+            this->lock_obj.lock();
+            --this->idle;
+            bool leave = !signalled && this->queue.empty()
+                && (this->idle >= max_idle_threads);
+            if (leave) w.finished = true;
+            this->lock_obj.unlock();
+            if (leave) break;
+            continue;
+        }
+
+        try {
+            t->r.run();
+        } catch(...) {
+        }
+        this->lock_obj.lock();
+        t->running = false;
+        t->done.set(); // 't' may be restarted or deleted from now on
+        this->lock_obj.unlock();
+    }
+
+    return 0;
+}
+
+
+/*
+ * executor::reap
+ */
+void executor::reap(void) {
+    for (size_t i = 0; i < this->threads.size();) {
+        if (!this->workers[i]->finished) {
+            ++i;
+            continue;
+        }
+        if (this->threads[i]->is_running()) {
+            this->threads[i]->join();
+        }
+        the::safe_delete(this->threads[i]);
+        the::safe_delete(this->workers[i]);
+        this->threads.erase(this->threads.begin() + i);
+        this->workers.erase(this->workers.begin() + i);
+    }
+}
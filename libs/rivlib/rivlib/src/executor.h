@@ -0,0 +1,266 @@
+/*
+ * executor.h
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+
+#ifndef VICCI_RIVLIB_EXECUTOR_H_INCLUDED
+#define VICCI_RIVLIB_EXECUTOR_H_INCLUDED
+#if (defined(_MSC_VER) && (_MSC_VER > 1000))
+#pragma once
+#endif /* (defined(_MSC_VER) && (_MSC_VER > 1000)) */
+
+#include "the/system/threading/critical_section.h"
+#include "the/system/threading/event.h"
+#include "the/system/threading/runnable.h"
+#include "the/system/threading/thread.h"
+#include <deque>
+#include <vector>
+
+
+namespace eu_vicci {
+namespace rivlib {
+
+    /**
+     * Process-wide pool of reusable threads running runnables.
+     *
+     * Every runnable gets a thread of its own for as long as it runs, so
+     * long-running worker loops never starve each other. Threads becoming
+     * idle wait for the next runnable instead of terminating, and only
+     * terminate after 'idle_timeout' if more than 'max_idle_threads' are
+     * idle. Thus setting up and tearing down connections and encoders does
+     * not create and destroy threads.
+     */
+    class executor {
+    public:
+
+        /**
+         * A runnable scheduled to a pooled thread. The object must outlive
+         * the execution of the runnable.
+         */
+        class task {
+        public:
+
+            /**
+             * ctor
+             *
+             * @param r The runnable to be run
+             */
+            task(the::system::threading::runnable& r);
+
+            /** dtor */
+            ~task(void);
+
+            /**
+             * Answer whether the runnable is scheduled or running
+             *
+             * @return True if the runnable is scheduled or running
+             */
+            inline bool is_running(void) const {
+                return this->running;
+            }
+
+            /**
+             * Waits until the runnable returned. Returns immediately if the
+             * task is not running.
+             */
+            void wait(void);
+
+        private:
+
+            /** The executor schedules and completes the task */
+            friend class executor;
+
+            /** The runnable to be run */
+            the::system::threading::runnable& r;
+
+            /** Flag whether the runnable is scheduled or running */
+            volatile bool running;
+
+            /** Event set when the runnable returned */
+            the::system::threading::event done;
+
+        };
+
+        /** The number of idle threads kept without timeout */
+        static const unsigned int max_idle_threads = 8;
+
+        /** The time after which surplus idle threads terminate in milliseconds */
+        static const unsigned int idle_timeout = 10000;
+
+        /**
+         * Answer the only instance of the class
+         *
+         * @return The only instance of the class
+         */
+        static executor& instance(void);
+
+        /**
+         * Runs a task on a pooled thread
+         *
+         * @param t The task
+         *
+         * @throws the::exception if the task is already running
+         */
+        void execute(task& t);
+
+        /**
+         * Answer the number of pooled threads
+         *
+         * @return The number of pooled threads
+         */
+        size_t count(void);
+
+    private:
+
+        /** Utility runnable class for the pooled threads */
+        class pool_worker : public the::system::threading::runnable {
+        public:
+
+            /**
+             * ctor
+             *
+             * @param owner The owning executor
+             */
+            pool_worker(executor& owner);
+
+            /** dtor */
+            virtual ~pool_worker(void);
+
+            /**
+             * Perform the work of a thread.
+             *
+             * @return The application dependent return code of the thread. This
+             *         must not be STILL_ACTIVE (259).
+             */
+            virtual int run(void);
+
+            /**
+             * Requests the runnable to be terminated
+             *
+             * @return graceful
+             */
+            virtual the::system::threading::thread::termination_behaviour on_thread_terminating(void) throw();
+
+            /** Flag set when the thread left the pool */
+            volatile bool finished;
+
+        private:
+
+            /** The owning executor */
+            executor& owner;
+
+        };
+
+        /** ctor */
+        executor(void);
+
+        /** dtor */
+        ~executor(void);
+
+        /**
+         * The function of the pooled threads
+         *
+         * @param w The runnable of the calling thread
+         *
+         * @return 0
+         */
+        int run_pool(pool_worker& w);
+
+        /**
+         * Joins and deletes the threads which left the pool. The caller
+         * must hold 'lock_obj'.
+         */
+        void reap(void);
+
+        /** The pooled threads */
+        std::vector<the::system::threading::thread*> threads;
+
+        /** The runnables of the pooled threads */
+        std::vector<pool_worker*> workers;
+
+        /** The tasks waiting for a thread */
+        std::deque<task*> queue;
+
+        /** The number of idle threads */
+        unsigned int idle;
+
+        /** The lock for all members */
+        the::system::threading::critical_section lock_obj;
+
+        /** Event set when tasks are queued or the threads should terminate */
+        the::system::threading::event work_event;
+
+        /** Flag that the threads should terminate */
+        volatile bool terminating;
+
+    };
+
+
+    /**
+     * Drop-in replacement of 'runnable_thread' running the runnable on a
+     * thread of the executor
+     *
+     * @param T The runnable class
+     */
+    template<class T>
+    class pooled_thread : public T {
+    public:
+
+        /** ctor */
+        pooled_thread(void) : T(), t(*this) {
+            // intentionally empty
+        }
+
+        /** dtor */
+        ~pooled_thread(void) {
+            this->t.wait();
+        }
+
+        /**
+         * Starts running the runnable
+         */
+        inline void start(void) {
+            executor::instance().execute(this->t);
+        }
+
+        /**
+         * Answer whether the runnable is running
+         *
+         * @return True if the runnable is running
+         */
+        inline bool is_running(void) const {
+            return this->t.is_running();
+        }
+
+        /**
+         * Requests the runnable to terminate
+         *
+         * @param wait If true, returns after the runnable returned
+         */
+        inline void terminate(bool wait) {
+            if (!this->t.is_running()) return;
+            this->on_thread_terminating();
+            if (wait) this->t.wait();
+        }
+
+        /**
+         * Waits until the runnable returned
+         */
+        inline void join(void) {
+            this->t.wait();
+        }
+
+    private:
+
+        /** The task running the runnable */
+        executor::task t;
+
+    };
+
+
+} /* end namespace rivlib */
+} /* end namespace eu_vicci */
+
+#endif /* VICCI_RIVLIB_EXECUTOR_H_INCLUDED */
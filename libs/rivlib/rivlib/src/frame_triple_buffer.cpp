@@ -0,0 +1,86 @@
+/*
+ * frame_triple_buffer.cpp
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+#include "stdafx.h"
+#include "frame_triple_buffer.h"
+#include <cstring>
+
+using namespace eu_vicci::rivlib;
+
+
+/*
+ * frame_triple_buffer::frame_triple_buffer
+ */
+frame_triple_buffer::frame_triple_buffer(void) : write_idx(0), read_idx(2),
+        ready(1), written(0), enabled(false) {
+    for (unsigned int i = 0; i < 3; ++i) {
+        this->slots[i].width = 0;
+        this->slots[i].height = 0;
+        this->slots[i].sequence = 0;
+        this->slots[i].is_final = true;
+    }
+}
+
+
+/*
+ * frame_triple_buffer::~frame_triple_buffer
+ */
+frame_triple_buffer::~frame_triple_buffer(void) {
+    // intentionally empty
+}
+
+
+/*
+ * frame_triple_buffer::write
+ */
+void frame_triple_buffer::write(unsigned int width, unsigned int height,
+        const void *rgb, bool is_final) {
+    if (!this->enabled) return;
+
+    frame_slot& s = this->slots[this->write_idx];
+    size_t size = static_cast<size_t>(width) * height * 3;
+    s.data.assert_size(size);
+    ::memcpy(s.data, rgb, size);
+    s.width = width;
+    s.height = height;
+    s.is_final = is_final;
+    s.sequence = ++this->written;
+
+    // publish the image and continue with the buffer it replaces
+    this->write_idx = this->ready.exchange(this->write_idx | fresh_flag,
+        std::memory_order_acq_rel) & index_mask;
+}
+
+
+/*
+ * frame_triple_buffer::acquire
+ */
+bool frame_triple_buffer::acquire(image_frame& frame) {
+    this->enabled = true;
+
+    if ((this->ready.load(std::memory_order_acquire) & fresh_flag) != 0) {
+        this->read_idx = this->ready.exchange(this->read_idx,
+            std::memory_order_acq_rel) & index_mask;
+    }
+
+    const frame_slot& s = this->slots[this->read_idx];
+    if (s.sequence == 0) return false;
+
+    frame.width = s.width;
+    frame.height = s.height;
+    frame.rgbpix = s.data;
+    frame.sequence = s.sequence;
+    frame.is_final = s.is_final;
+    return true;
+}
+
+
+/*
+ * frame_triple_buffer::release
+ */
+void frame_triple_buffer::release(void) {
+    // intentionally empty
+}
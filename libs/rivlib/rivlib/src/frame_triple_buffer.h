@@ -0,0 +1,129 @@
+/*
+ * frame_triple_buffer.h
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+
+#ifndef VICCI_RIVLIB_FRAME_TRIPLE_BUFFER_H_INCLUDED
+#define VICCI_RIVLIB_FRAME_TRIPLE_BUFFER_H_INCLUDED
+#if (defined(_MSC_VER) && (_MSC_VER > 1000))
+#pragma once
+#endif /* (defined(_MSC_VER) && (_MSC_VER > 1000)) */
+
+#include "rivlib/image_stream_connection.h"
+#include "the/blob.h"
+#include "the/types.h"
+#include <atomic>
+
+
+namespace eu_vicci {
+namespace rivlib {
+
+    /**
+     * Triple buffer of decoded images between one writing thread (the
+     * connection) and one reading thread (the application).
+     *
+     * The writer owns one buffer, the reader owns one buffer, and the third
+     * buffer holds the newest complete image. Both sides exchange their
+     * buffer with the third one through an atomic index, so neither side
+     * ever waits for the other.
+     */
+    class frame_triple_buffer {
+    public:
+
+        /** ctor */
+        frame_triple_buffer(void);
+
+        /** dtor */
+        ~frame_triple_buffer(void);
+
+        /**
+         * Answer whether the reader requested images
+         *
+         * @return True if images should be written
+         */
+        inline bool is_enabled(void) const {
+            return this->enabled;
+        }
+
+        /**
+         * Copies an image into the buffer of the writer and publishes it as
+         * newest image. Does nothing until the reader called 'acquire'.
+         *
+         * @param width The width of the image in pixel
+         * @param height The height of the image in pixel
+         * @param rgb The rgb bytes of the image
+         * @param is_final False if the image is an intermediate level
+         */
+        void write(unsigned int width, unsigned int height, const void *rgb, bool is_final);
+
+        /**
+         * Takes the newest image as buffer of the reader, if there is a
+         * newer one, and enables writing
+         *
+         * @param frame Receives the image of the buffer of the reader
+         *
+         * @return False if no image has been written yet
+         */
+        bool acquire(image_frame& frame);
+
+        /**
+         * Ends the access of the reader to its buffer. The buffer of the
+         * reader is never touched by the writer, so this is for symmetry.
+         */
+        void release(void);
+
+    private:
+
+        /** Flag in 'ready' marking an image not taken by the reader yet */
+        static const unsigned int fresh_flag = 0x4;
+
+        /** The mask of the buffer index in 'ready' */
+        static const unsigned int index_mask = 0x3;
+
+        /** One image buffer */
+        typedef struct _frame_slot_t {
+
+            /** The rgb bytes */
+            the::blob data;
+
+            /** The width in pixel */
+            unsigned int width;
+
+            /** The height in pixel */
+            unsigned int height;
+
+            /** The number of the image, or zero if empty */
+            uint64_t sequence;
+
+            /** False if the image is an intermediate level */
+            bool is_final;
+
+        } frame_slot;
+
+        /** The three image buffers */
+        frame_slot slots[3];
+
+        /** The buffer of the writer; writer only */
+        unsigned int write_idx;
+
+        /** The buffer of the reader; reader only */
+        unsigned int read_idx;
+
+        /** The buffer holding the newest image, and 'fresh_flag' */
+        std::atomic<unsigned int> ready;
+
+        /** The number of images written; writer only */
+        uint64_t written;
+
+        /** Flag whether the reader requested images */
+        volatile bool enabled;
+
+    };
+
+
+} /* end namespace rivlib */
+} /* end namespace eu_vicci */
+
+#endif /* VICCI_RIVLIB_FRAME_TRIPLE_BUFFER_H_INCLUDED */
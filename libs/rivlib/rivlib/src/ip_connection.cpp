@@ -10,25 +10,35 @@
 #include "message_image_request.h"
 #include "rivlib/ip_utilities.h"
 #include "rivlib/image_data_binding.h"
+#include "api_impl/core_impl.h"
 #include "api_impl/provider_impl.h"
 #include "encoder/image_encoder_rgb_raw.h"
 #include "encoder/image_encoder_rgb_zip.h"
+#include "encoder/image_encoder_rgb_progressive.h"
 #if(USE_MJPEG == 1)
 #  include "encoder/image_encoder_rgb_mjpeg.h"
 #endif
 #include "encoder/image_request.h"
-#include "thread_scrubber.h"
 #include "the/assert.h"
 #include "the/blob.h"
 #include "the/math/functions.h"
 #include "the/text/string_builder.h"
+#include "the/system/performance_counter.h"
 #include "vislib/PeerDisconnectedException.h"
 #include "vislib/SocketException.h"
 #include "vislib/SimpleMessage.h"
 #include "uri_utility.h"
+#include "unix_socket.h"
+#include "vislib/IPAddress.h"
+#include "vislib/IPEndPoint.h"
 #include <string>
 #include <sstream>
 #include <climits>
+#include <algorithm>
+#include <cerrno>
+#ifndef _WIN32
+#include <unistd.h>
+#endif /* !_WIN32 */
 
 using namespace eu_vicci::rivlib;
 using namespace the::system::threading;
@@ -38,8 +48,20 @@ using namespace the::system::threading;
  * ip_connection::ip_connection
  */
 ip_connection::ip_connection(comm_channel_type comm) : element_node(),
-        runnable(), comm(comm), worker_thread(nullptr), is_terminating(false) {
-    this->worker_thread = new thread(this);
+        handler(), comm(comm), send_lock(), is_terminating(false),
+        state(receive_state::request_length), in_data(), in_size(0),
+        request_len(0), binary_request(false), ctrl_provider(nullptr), err_cnt(0), zerocopy(false),
+        zerocopy_sends(0), zerocopy_completed(UINT32_MAX), out_queue(),
+        out_sent_cnt(0), out_queued_bytes(0), out_queued_images(0),
+        min_frame_interval(0.0), last_frame_time(0.0), image_encoder(nullptr), multicast(nullptr), shm_enabled(false), shm(),
+        shm_rings(0), shm_confirmed(false), fd_passing(false),
+        credit_lock(), credits(0), request_window(1), request_queued(false),
+        last_sent_time_code(0), egress(), provider_egress(),
+        communicator_egress() {
+    ::memset(&this->stats, 0, sizeof(connection_statistics));
+    ::memset(&this->peer_hello, 0, sizeof(ip_hello));
+    this->multicast_groups.first = 1; // empty range: multicast is disabled
+    this->multicast_groups.last = 0;
     vislib::net::Socket::Startup();
 }
 
@@ -48,50 +70,79 @@ ip_connection::ip_connection(comm_channel_type comm) : element_node(),
  * ip_connection::~ip_connection
  */
 ip_connection::~ip_connection(void) {
-    THE_ASSERT(!this->worker_thread->is_running());
-    //if (this->worker_thread->is_running()) {
-    //    this->worker_thread->terminate(true);
-    //}
-    THE_ASSERT(this->comm.IsNull());
-    the::safe_delete(this->worker_thread);
+    if (!this->comm.IsNull()) {
+        // never started
+        try {
+            this->comm->Close();
+        } catch(...) {
+        }
+        this->comm.Release();
+    }
 
     vislib::net::Socket::Cleanup();
 }
 
 
 /*
- * ip_connection::on_thread_terminating
+ * ip_connection::get_kind
  */
-thread::termination_behaviour ip_connection::on_thread_terminating(void) throw() {
-    try {
-        if (!this->comm.IsNull()) {
-            this->comm->Close();
-            return thread::termination_behaviour::graceful;
-        }
-    } catch(...) {
+node_kind ip_connection::get_kind(void) const {
+    return kind;
+}
+
+
+/*
+ * ip_connection::create_image_encoder
+ */
+encoder::image_encoder_base *ip_connection::create_image_encoder(uint16_t subtype) {
+    switch (subtype) {
+    case static_cast<uint16_t>(data_channel_image_stream_subtype::rgb_raw):
+        return new encoder::image_encoder_rgb_raw();
+    case static_cast<uint16_t>(data_channel_image_stream_subtype::rgb_zip):
+        return new encoder::image_encoder_rgb_zip();
+    case static_cast<uint16_t>(data_channel_image_stream_subtype::rgb_progressive):
+        return new encoder::image_encoder_rgb_progressive();
+#if(USE_MJPEG == 1)
+    case static_cast<uint16_t>(data_channel_image_stream_subtype::rgb_mjpeg):
+        return new encoder::image_encoder_rgb_mjpeg();
+#endif
+    default:
+        return nullptr;
     }
-    return thread::termination_behaviour::forceful;
 }
 
 
 /*
- * ip_connection::on_thread_terminated
+ * ip_connection::enable_fd_passing
  */
-void ip_connection::on_thread_terminated(const thread::exit_reason reason) throw() {
-    this->is_terminating = true;
-    std::shared_ptr<node_base> self = this->get_api_ptr();
-    this->disconnect_all();
-    thread_scrubber::cleanup_object<ip_connection>(self);
+void ip_connection::enable_fd_passing(void) {
+#ifndef _WIN32
+    this->fd_passing = true;
+#endif /* !_WIN32 */
 }
 
 
 /*
- * ip_connection::run
+ * ip_connection::set_communicator_egress
  */
-int ip_connection::run(void) {
-    THE_ASSERT(!this->comm.IsNull());
+void ip_connection::set_communicator_egress(token_bucket::shared_ptr bucket) {
+    this->communicator_egress = bucket;
+}
 
-    thread_scrubber::register_object<ip_connection>(this->get_api_ptr());
+
+/*
+ * ip_connection::set_multicast_groups
+ */
+void ip_connection::set_multicast_groups(const multicast_group_range& range) {
+    this->multicast_groups = range;
+}
+
+
+/*
+ * ip_connection::start
+ */
+void ip_connection::start(void) {
+    THE_ASSERT(!this->comm.IsNull());
 
     ip_handshake_id id;
     ::memcpy(id.id_str, "RIV\x13\x57\x9B\xDF\x00", 8);
@@ -100,60 +151,96 @@ int ip_connection::run(void) {
     THE_ASSERT(sizeof(ip_handshake_id) == 16);
 
     try {
+        bool flushed;
+        {
+            auto_lock<critical_section> lock(this->send_lock);
+            // the reactor never waits for a single connection
+            this->comm->GetSocket().SetBlocking(false);
+            this->zerocopy = this->comm->GetSocket().SetZeroCopy(true);
+            this->enqueue_message(nullptr, 0, &id, sizeof(ip_handshake_id));
+            flushed = this->flush_send_queue();
+        }
+        ip_reactor::instance().add(this, api_ptr_base(this));
+        ip_reactor::instance().set_deadline(this,
+            the::system::performance_counter::query_millis() + request_length_timeout);
+        if (!flushed) {
+            ip_reactor::instance().set_write_interest(this);
+        }
 
-        this->comm->Send(&id, sizeof(ip_handshake_id));
+    } catch(vislib::Exception ex) {
+        this->log().error("ip_connection failed to start: %s (%s, %d)\n",
+            ex.GetMsgA(), ex.GetFile(), ex.GetLine());
+        this->on_reactor_closed();
 
-        unsigned int requestLen = 0;
-        if (this->comm->Receive(&requestLen, 4) != 4) {
-            throw the::exception("Unable to receive request", __FILE__, __LINE__);
-        }
-        char *request = new char[requestLen + 1];
-        ::memset(request, 0, requestLen + 1);
-        try {
+    } catch(the::exception ex) {
+        this->log().error("ip_connection failed to start: %s (%s, %d)\n",
+            ex.get_msg_astr(), ex.get_file(), ex.get_line());
+        this->on_reactor_closed();
 
-            if (this->comm->Receive(request, requestLen) != requestLen) {
-                throw the::exception("Unable to receive request", __FILE__, __LINE__);
-            }
+    } catch(...) {
+        this->log().error("ip_connection failed to start: unexpected exception\n");
+        this->on_reactor_closed();
 
-        } catch(...) {
-            delete[] request;
-            throw;
-        }
-        std::string req(request);
-        delete[] request;
+    }
+}
 
-        this->log().info("ip_connection: request to \"%s\"", req.c_str());
 
-        // avoid seqfaults on empty req strings
-        if( req.empty() )
-            return 1;
+/*
+ * ip_connection::get_reactor_handle
+ */
+SOCKET ip_connection::get_reactor_handle(void) {
+    THE_ASSERT(!this->comm.IsNull());
+    return this->comm->GetSocket().GetHandle();
+}
 
-        std::string scheme, req_user, host, req_path, req_query, req_fragment;
-        bool is_host_v6, is_host_port_set;
-        unsigned short host_port;
-        uri_utility::parse_uri(req, scheme, req_user, host, is_host_v6, host_port, is_host_port_set, req_path, req_query, req_fragment);
 
-        //req_user = the::text::string_utility::url_decode<std::string>(req_user); not used ATM
-        req_path = the::text::string_utility::url_decode<std::string>(req_path);
-        req_query = the::text::string_utility::url_decode<std::string>(req_query);
-        req_fragment = the::text::string_utility::url_decode<std::string>(req_fragment);
+/*
+ * ip_connection::on_readable
+ */
+bool ip_connection::on_readable(void) {
+    try {
 
-        if (req_query.empty() && req_fragment.empty()) {
-            // direct request for providers
-            this->ctrl_chan_receiver(req_path);
+        this->in_data.assert_size(this->in_size + receive_chunk_size, true);
+        if (this->zerocopy) {
+            // zero-copy completions wake the reactor, too
+            auto_lock<critical_section> lock(this->send_lock);
+            this->reap_zerocopy_completions();
+        }
 
-        } else if (req_fragment.empty()) {
-            // direct request with query for providers
-            this->data_chan_receiver(req_path, req_query);
+        // the socket is non-blocking ('start'); another I/O thread might have
+        // taken the data already, or the wakeup was a zero-copy completion
+        size_t rec = 0;
+        try {
+            rec = this->comm->GetSocket().Receive(this->in_data.at(this->in_size),
+                receive_chunk_size, vislib::net::Socket::TIMEOUT_INFINITE, 0, false);
+        } catch(vislib::net::SocketException ex) {
+            if (is_would_block(ex)) return true;
+            throw;
+        }
+        if (rec == 0) {
+            // peer disconnected
+            this->state = receive_state::closed;
+            return false;
+        }
+        this->in_size += rec;
 
-        } else {
-            // now conditions met
-            unsigned short answer = 500;
-            this->comm->Send(&answer, 2);
+        size_t pos = 0;
+        while (this->state != receive_state::closed) {
+            size_t used = this->process_input(this->in_data.as_at<char>(pos), this->in_size - pos);
+            if (used == 0) break;
+            pos += used;
+        }
 
-            this->log().error("Request \"%s\" could not be fulfilled\n", req.c_str());
+        if (pos > 0) {
+            // keep the incomplete message for the next call
+            this->in_size -= pos;
+            if (this->in_size > 0) {
+                ::memmove(this->in_data.at(0), this->in_data.at(pos), this->in_size);
+            }
         }
 
+        return (this->state != receive_state::closed);
+
     } catch(vislib::net::PeerDisconnectedException ex) {
         // expected behaviour when server is closed
 
@@ -182,15 +269,89 @@ int ip_connection::run(void) {
 
     }
 
+    this->state = receive_state::closed;
+    return false;
+}
+
+
+/*
+ * ip_connection::on_writable
+ */
+bool ip_connection::on_writable(void) {
+    try {
+        auto_lock<critical_section> lock(this->send_lock);
+        if (this->comm.IsNull()) return false;
+        this->flush_send_queue();
+        return true;
+
+    } catch(vislib::Exception ex) {
+        this->log().error("ip_connection closed: %s (%s, %d)\n",
+            ex.GetMsgA(), ex.GetFile(), ex.GetLine());
+
+    } catch(...) {
+        this->log().error("ip_connection closed: unexpected exception\n");
+
+    }
+
+    this->state = receive_state::closed;
+    return false;
+}
+
+
+/*
+ * ip_connection::on_reactor_timeout
+ */
+void ip_connection::on_reactor_timeout(void) {
+    this->log().warn("ip_connection: request not received in time");
+    this->state = receive_state::closed;
+}
+
+
+/*
+ * ip_connection::on_reactor_closed
+ */
+void ip_connection::on_reactor_closed(void) {
+    this->is_terminating = true;
+    this->state = receive_state::closed;
+
     this->log().info("ip_connection: closing");
 
     try {
-        this->comm->Close();
-        this->comm.Release();
+        // remove all pending requests
+        std::vector<api_ptr_base> encs = this->select<encoder::image_encoder_base>();
+        std::vector<api_ptr_base>::iterator end = encs.end();
+        for (std::vector<api_ptr_base>::iterator i = encs.begin(); i < end; i++) {
+            encoder::image_encoder_base *enc = dynamic_cast<encoder::image_encoder_base*>(i->get());
+            if (enc == nullptr) continue;
+            enc->remove_pending_requests(&ip_connection::send_image_data, this);
+        }
+
     } catch(...) {
     }
 
-    return 0;
+    if (this->multicast != nullptr) {
+        this->multicast->remove_subscriber();
+        this->multicast = nullptr;
+    }
+
+    {
+        auto_lock<critical_section> lock(this->send_lock);
+        try {
+            if (!this->comm.IsNull()) this->comm->Close();
+        } catch(...) {
+        }
+        this->comm.Release();
+        this->shm.close();
+        for (size_t i = 0, cnt = this->out_queue.size(); i < cnt; ++i) {
+            this->close_message_fd(this->out_queue[i]);
+        }
+        this->out_queue.clear();
+        this->out_sent_cnt = 0;
+        this->out_queued_bytes = 0;
+        this->out_queued_images = 0;
+    }
+
+    this->disconnect_all();
 }
 
 
@@ -198,7 +359,6 @@ int ip_connection::run(void) {
  * ip_connection::send_message
  */
 void ip_connection::send_message(unsigned int id, unsigned int size, const char* data) {
-    // HAZARD: Possible synchronization probleme here, because this could be called from several different threads ...
     using namespace vislib::net;
 
     SimpleMessageHeader h;
@@ -206,18 +366,85 @@ void ip_connection::send_message(unsigned int id, unsigned int size, const char*
     h.SetMessageID(id);
     h.SetBodySize(static_cast<SimpleMessageSize>(size));
 
-    SIZE_T sent = this->comm->Send(h.PeekData(), h.GetHeaderSize());
-    if (sent != h.GetHeaderSize()) {
-        fprintf(stderr, "Failed to send package header\n");
+    if ((this->peer_hello.max_message_size != 0) && (size > this->peer_hello.max_message_size)) {
+        this->log().error("Message (%u) of %u bytes exceeds the limit of the client\n", id, size);
+        return;
+    }
+
+    auto_lock<critical_section> lock(this->send_lock);
+    if (this->comm.IsNull()) return;
+
+    try {
+        if (this->enqueue_message(h.PeekData(), h.GetHeaderSize(), data, size)) {
+            this->flush_send_queue();
+        }
+    } catch(...) {
+        fprintf(stderr, "Failed to send package\n");
+        this->abort_sending();
+    }
+}
+
+
+/*
+ * ip_connection::post_message
+ */
+void ip_connection::post_message(unsigned int id, std::shared_ptr<the::blob> body, bool replace) {
+    using namespace vislib::net;
+    size_t size = body->size();
+
+    if ((this->peer_hello.max_message_size != 0) && (size > this->peer_hello.max_message_size)) {
+        this->log().error("Message (%u) of %u bytes exceeds the limit of the client\n",
+            id, static_cast<unsigned int>(size));
         return;
     }
-    if (h.GetBodySize() > 0) {
-        sent = this->comm->Send(data, size);
-        if (sent != size) {
-            fprintf(stderr, "Failed to send package body\n");
+
+    SimpleMessageHeader h;
+    h.SetMessageID(id);
+    h.SetBodySize(static_cast<SimpleMessageSize>(size));
+
+    auto_lock<critical_section> lock(this->send_lock);
+    if (this->comm.IsNull()) return;
+
+    if (replace) {
+        // messages not started to send yet are exchanged in place
+        for (size_t i = this->out_sent_cnt, cnt = this->out_queue.size(); i < cnt; ++i) {
+            out_message& m = this->out_queue[i];
+            if (!m.coalesce || (m.coalesce_id != id) || (m.sent > 0)) continue;
+            ::memcpy(m.prefix, h.PeekData(), h.GetHeaderSize());
+            this->out_queued_bytes -= m.body_size;
+            m.shared_body = body;
+            m.body_size = size;
+            this->out_queued_bytes += size;
             return;
         }
     }
+
+    if ((this->out_queued_bytes > 0)
+            && (this->out_queued_bytes + h.GetHeaderSize() + size > max_queued_bytes)) {
+        this->stats.messages_dropped++;
+        return;
+    }
+    this->enqueue_message(h.PeekData(), h.GetHeaderSize());
+    out_message& m = this->out_queue.back();
+    m.shared_body = body;
+    m.body_size = size;
+    m.coalesce = replace;
+    m.coalesce_id = id;
+    this->out_queued_bytes += size;
+
+    // the I/O thread sends the message, not the posting thread
+    ip_reactor::instance().set_write_interest(this);
+}
+
+
+/*
+ * ip_connection::get_statistics
+ */
+connection_statistics ip_connection::get_statistics(void) {
+    auto_lock<critical_section> lock(this->send_lock);
+    connection_statistics s = this->stats;
+    s.queued_bytes = this->out_queued_bytes;
+    return s;
 }
 
 
@@ -226,9 +453,6 @@ void ip_connection::send_message(unsigned int id, unsigned int size, const char*
  */
 void ip_connection::on_core_discovered(void) {
     element_node::on_core_discovered();
-    if (!this->worker_thread->is_running() && !this->comm.IsNull()) {
-        this->worker_thread->start();
-    }
 }
 
 
@@ -237,13 +461,29 @@ void ip_connection::on_core_discovered(void) {
  */
 void ip_connection::on_core_lost(void) {
     element_node::on_core_lost();
-    if (!this->is_terminating && this->worker_thread->is_running()) {
-        // do not wait because the object will be cleaned up asynchroniously
-        this->worker_thread->terminate(false);
+    if (!this->is_terminating) {
+        // the reactor closes the connection when the socket reports the shutdown
+        auto_lock<critical_section> lock(this->send_lock);
+        try {
+            if (!this->comm.IsNull()) this->comm->GetSocket().Shutdown();
+        } catch(...) {
+        }
     }
 }
 
 
+/*
+ * ip_connection::is_would_block
+ */
+bool ip_connection::is_would_block(const vislib::net::SocketException& ex) {
+#ifdef _WIN32
+    return (ex.GetErrorCode() == WSAEWOULDBLOCK);
+#else /* _WIN32 */
+    return (ex.GetErrorCode() == EAGAIN) || (ex.GetErrorCode() == EWOULDBLOCK);
+#endif /* _WIN32 */
+}
+
+
 /*
  * ip_connection::send_image_data
  */
@@ -252,39 +492,436 @@ void ip_connection::send_image_data(const data::buffer::shared_ptr data, void *c
     ip_connection *that = static_cast<ip_connection*>(ctxt);
     SimpleMessageHeader h;
 
+    encoder::image_request::ptr next_req;
+    {
+        // the image consumes one credit; stream ahead while credits are left
+        auto_lock<critical_section> lock(that->credit_lock);
+        that->last_frame_time = the::system::performance_counter::query_millis();
+        that->request_queued = false;
+        that->credits--;
+        that->last_sent_time_code = data->time_code();
+        if (that->credits > 0) {
+            next_req = that->make_image_request(data->time_code());
+        }
+    }
+    if (next_req) {
+        that->image_encoder->request_output(next_req);
+    }
+
     h.SetMessageID(static_cast<uint32_t>(message_id::image_data_blob));
     h.SetBodySize(static_cast<SimpleMessageSize>(2 * sizeof(uint32_t) + data->metadata().size() + data->data().size()));
 
-    the::system::threading::thread::sleep(1);
+    bool dropped = false;
+    {
+        auto_lock<critical_section> lock(that->send_lock);
+        if (that->comm.IsNull()) return;
+
+        if (that->shm_enabled && that->store_image_shm(data)) {
+            // the image is passed through shared memory
+            try {
+                that->flush_send_queue();
+            } catch(...) {
+                fprintf(stderr, "Failed to send package\n");
+                that->abort_sending();
+            }
+            return;
+        }
 
-    // HAZARD: Sending image data but comm has been closed (and deleted) already!
+        if (that->out_queued_images >= max_queued_images) {
+            // the client is too slow: drop the oldest image not being sent
+            // yet, as the new image is more recent
+            for (size_t i = that->out_sent_cnt, cnt = that->out_queue.size(); i < cnt; ++i) {
+                out_message& m = that->out_queue[i];
+                if ((!m.image && (m.fd < 0)) || (m.sent > 0)) continue;
+                that->out_queued_bytes -= m.prefix_size;
+                if (m.image) {
+                    that->out_queued_bytes -= m.image->metadata().size() + m.image->data().size();
+                }
+                that->out_queued_images--;
+                m.prefix_size = 0;
+                m.image.reset();
+                that->close_message_fd(m);
+                that->stats.images_dropped++;
+                dropped = true;
+                break;
+            }
+        }
 
-    SIZE_T sent = that->comm->Send(h.PeekData(), h.GetHeaderSize());
-    if (sent != h.GetHeaderSize()) {
-        fprintf(stderr, "Failed to send package header\n");
-        return;
-    }
-    if (h.GetBodySize() > 0) {
         uint32_t bytes[2];
         bytes[0] = static_cast<uint32_t>(data->type());
         bytes[1] = data->time_code();
+        size_t size = h.GetHeaderSize() + h.GetBodySize();
 
-        sent = that->comm->Send(bytes, 2 * sizeof(uint32_t));
-        if (sent != 2 * sizeof(uint32_t)) {
-            fprintf(stderr, "Failed to send package body (1/3)\n");
-            return;
+        if ((that->out_queued_bytes > 0)
+                && (that->out_queued_bytes + size > max_queued_bytes)) {
+            that->stats.images_dropped++;
+            dropped = true;
+
+        } else if (that->fd_passing && (h.GetBodySize() >= fd_passing_threshold)
+                && that->enqueue_image_fd(data)) {
+            // the image is passed as memory file
+
+        } else if (that->is_egress_over_budget()) {
+            // other connections sharing the egress budget used it up
+            that->stats.images_dropped++;
+            dropped = true;
+
+        } else {
+            that->enqueue_message(h.PeekData(), h.GetHeaderSize());
+            out_message& m = that->out_queue.back();
+            ::memcpy(m.prefix + m.prefix_size, bytes, 2 * sizeof(uint32_t));
+            m.prefix_size += 2 * sizeof(uint32_t);
+            m.image = data;
+            that->out_queued_bytes += size - h.GetHeaderSize();
+            that->out_queued_images++;
+            that->consume_egress(size);
         }
-        sent = that->comm->Send(data->metadata(), data->metadata().size());
-        if (sent != data->metadata().size()) {
-            fprintf(stderr, "Failed to send package body (2/3)\n");
-            return;
+
+        try {
+            that->flush_send_queue();
+        } catch(...) {
+            fprintf(stderr, "Failed to send package\n");
+            that->abort_sending();
         }
-        sent = that->comm->Send(data->data(), data->data().size());
-        if (sent != data->data().size()) {
-            fprintf(stderr, "Failed to send package body (3/3)\n");
-            return;
+    }
+
+    if (dropped) {
+        // the dropped image returns its credit
+        encoder::image_request::ptr drop_req;
+        {
+            auto_lock<critical_section> lock(that->credit_lock);
+            if (that->credits < that->request_window) {
+                that->credits++;
+            }
+            if (!that->request_queued && (that->credits > 0)) {
+                drop_req = that->make_image_request(that->last_sent_time_code);
+            }
+        }
+        if (drop_req) {
+            that->image_encoder->request_output(drop_req);
+        }
+    }
+}
+
+
+/*
+ * ip_connection::store_image_shm
+ */
+bool ip_connection::store_image_shm(const data::buffer::shared_ptr data) {
+    using namespace vislib::net;
+    size_t meta_size = data->metadata().size();
+    size_t data_size = data->data().size();
+    size_t size = 2 * sizeof(uint32_t) + meta_size + data_size;
+    if (size > (UINT32_MAX / 2)) return false;
+
+    if (!this->shm.is_open() || (this->shm.slot_size() < size)) {
+        // the ring is (re)created only while the client holds no slot
+        if (this->shm.is_open() && !this->shm.is_idle()) return false;
+
+        // some headroom for compressed images of varying size
+        uint32_t slot_size = static_cast<uint32_t>(((size + size / 4) + 0xFFF) & ~static_cast<size_t>(0xFFF));
+        try {
+            this->shm.create(shm_slot_count, slot_size);
+        } catch(vislib::Exception ex) {
+            this->log().warn("ip_connection: shared memory not available: %s\n", ex.GetMsgA());
+            this->shm_enabled = false;
+            return false;
+        }
+
+        std::vector<char> body(2 * sizeof(uint32_t) + this->shm.name().length());
+        reinterpret_cast<uint32_t*>(body.data())[0] = this->shm.slot_count();
+        reinterpret_cast<uint32_t*>(body.data())[1] = this->shm.slot_size();
+        ::memcpy(body.data() + 2 * sizeof(uint32_t), this->shm.name().c_str(), this->shm.name().length());
+
+        SimpleMessageHeader h;
+        h.SetMessageID(static_cast<uint32_t>(message_id::image_data_shm_ring));
+        h.SetBodySize(static_cast<SimpleMessageSize>(body.size()));
+        if (!this->enqueue_message(h.PeekData(), h.GetHeaderSize(), body.data(), body.size())) {
+            this->shm.close();
+            return false;
+        }
+        this->shm_rings++;
+        this->shm_confirmed = false;
+    }
+
+    // in-band until the client confirmed that it could open the ring
+    if (!this->shm_confirmed) return false;
+
+    int slot = this->shm.reserve_slot();
+    if (slot < 0) return false; // client still holds all slots
+
+    uint8_t *dst = this->shm.slot(static_cast<uint32_t>(slot));
+    reinterpret_cast<uint32_t*>(dst)[0] = static_cast<uint32_t>(data->type());
+    reinterpret_cast<uint32_t*>(dst)[1] = data->time_code();
+    ::memcpy(dst + 2 * sizeof(uint32_t), data->metadata(), meta_size);
+    if (data_size > 0) {
+        ::memcpy(dst + 2 * sizeof(uint32_t) + meta_size, data->data(), data_size);
+    }
+
+    uint32_t body[2];
+    body[0] = static_cast<uint32_t>(slot);
+    body[1] = static_cast<uint32_t>(size);
+
+    SimpleMessageHeader h;
+    h.SetMessageID(static_cast<uint32_t>(message_id::image_data_shm_slot));
+    h.SetBodySize(static_cast<SimpleMessageSize>(sizeof(body)));
+    if (!this->enqueue_message(h.PeekData(), h.GetHeaderSize(), body, sizeof(body))) {
+        this->shm.release_slot(static_cast<uint32_t>(slot));
+        return false;
+    }
+
+    this->stats.images_sent++;
+    return true;
+}
+
+
+/*
+ * ip_connection::enqueue_image_fd
+ */
+bool ip_connection::enqueue_image_fd(const data::buffer::shared_ptr data) {
+#ifndef _WIN32
+    using namespace vislib::net;
+    uint32_t bytes[2];
+    bytes[0] = static_cast<uint32_t>(data->type());
+    bytes[1] = data->time_code();
+
+    Socket::SendBuffer parts[3];
+    parts[0].Data = bytes;
+    parts[0].Size = 2 * sizeof(uint32_t);
+    parts[1].Data = data->metadata();
+    parts[1].Size = data->metadata().size();
+    parts[2].Data = data->data();
+    parts[2].Size = data->data().size();
+    uint32_t size = static_cast<uint32_t>(parts[0].Size + parts[1].Size + parts[2].Size);
+
+    int fd;
+    try {
+        fd = unix_socket::create_memory_file(parts, 3);
+    } catch(vislib::Exception ex) {
+        this->log().warn("ip_connection: memory files not available: %s\n", ex.GetMsgA());
+        this->fd_passing = false;
+        return false;
+    }
+
+    SimpleMessageHeader h;
+    h.SetMessageID(static_cast<uint32_t>(message_id::image_data_fd));
+    h.SetBodySize(static_cast<SimpleMessageSize>(sizeof(uint32_t)));
+    if (!this->enqueue_message(h.PeekData(), h.GetHeaderSize())) {
+        ::close(fd);
+        return false;
+    }
+    out_message& m = this->out_queue.back();
+    ::memcpy(m.prefix + m.prefix_size, &size, sizeof(uint32_t));
+    m.prefix_size += sizeof(uint32_t);
+    m.fd = fd;
+    this->out_queued_bytes += sizeof(uint32_t);
+    this->out_queued_images++;
+    return true;
+
+#else /* !_WIN32 */
+    return false;
+#endif /* !_WIN32 */
+}
+
+
+/*
+ * ip_connection::close_message_fd
+ */
+void ip_connection::close_message_fd(out_message& msg) {
+#ifndef _WIN32
+    if (msg.fd >= 0) {
+        ::close(msg.fd);
+    }
+#endif /* !_WIN32 */
+    msg.fd = -1;
+}
+
+
+/*
+ * ip_connection::enqueue_message
+ */
+bool ip_connection::enqueue_message(const void *prefix, size_t prefix_size,
+        const void *body, size_t body_size) {
+    THE_ASSERT(prefix_size <= sizeof(out_message::prefix));
+    if ((this->out_queued_bytes > 0)
+            && (this->out_queued_bytes + prefix_size + body_size > max_queued_bytes)) {
+        this->stats.messages_dropped++;
+        return false;
+    }
+
+    // elements are never moved, as zero-copy sends might still use them
+    this->out_queue.push_back(out_message());
+    out_message& m = this->out_queue.back();
+    if (prefix_size > 0) {
+        ::memcpy(m.prefix, prefix, prefix_size);
+    }
+    m.prefix_size = prefix_size;
+    if (body_size > 0) {
+        m.body.assert_size(body_size);
+        ::memcpy(m.body, body, body_size);
+    }
+    m.body_size = body_size;
+    m.coalesce = false;
+    m.coalesce_id = 0;
+    m.sent = 0;
+    m.zerocopy = false;
+    m.last_zerocopy_id = 0;
+    m.fd = -1;
+    this->out_queued_bytes += prefix_size + body_size;
+
+    return true;
+}
+
+
+/*
+ * ip_connection::flush_send_queue
+ */
+bool ip_connection::flush_send_queue(void) {
+    using namespace vislib::net;
+    Socket& socket = this->comm->GetSocket();
+
+    if (this->zerocopy) {
+        this->reap_zerocopy_completions();
+    }
+
+    while (this->out_sent_cnt < this->out_queue.size()) {
+        out_message& m = this->out_queue[this->out_sent_cnt];
+        Socket::SendBuffer buffers[4];
+        size_t cnt = this->get_send_buffers(m, buffers);
+
+        if (cnt > 0) {
+            bool zc = this->zerocopy && m.image && (m.image->data().size() >= zerocopy_threshold);
+            size_t remaining = 0;
+            for (size_t i = 0; i < cnt; ++i) remaining += buffers[i].Size;
+
+            SIZE_T sent = 0;
+            UINT32 zc_cnt = 0;
+            bool is_image = m.image || (m.fd >= 0);
+            try {
+                if (m.fd < 0) {
+                    // the socket is non-blocking on all platforms ('start'), so a
+                    // full socket buffer never blocks the reactor or the encoder
+                    sent = socket.Send(buffers, cnt, Socket::TIMEOUT_INFINITE,
+                        zc ? Socket::FLAG_ZEROCOPY : 0, false, &zc_cnt);
+                } else {
+#ifndef _WIN32
+                    // the memory file is passed along with the first byte
+                    sent = unix_socket::send(socket.GetHandle(), buffers, cnt, m.fd);
+                    this->close_message_fd(m);
+#endif /* !_WIN32 */
+                }
+            } catch(SocketException ex) {
+                if (is_would_block(ex)) break;
+                throw;
+            }
+
+            if (zc_cnt > 0) {
+                this->zerocopy_sends += zc_cnt;
+                m.zerocopy = true;
+                m.last_zerocopy_id = this->zerocopy_sends - 1;
+            }
+            if (is_image && (m.sent == 0) && (sent > 0)) {
+                this->out_queued_images--;
+            }
+            m.sent += sent;
+            this->out_queued_bytes -= sent;
+            this->stats.bytes_sent += sent;
+
+            if (sent < remaining) break; // socket buffer is full
+            if (is_image) {
+                this->stats.images_sent++;
+            }
+        }
+
+        this->out_sent_cnt++;
+    }
+
+    this->release_sent_messages();
+
+    if (this->out_sent_cnt < this->out_queue.size()) {
+        ip_reactor::instance().set_write_interest(this);
+        return false;
+    }
+    return true;
+}
+
+
+/*
+ * ip_connection::get_send_buffers
+ */
+size_t ip_connection::get_send_buffers(out_message& msg, vislib::net::Socket::SendBuffer *buffers) {
+    const void *data[4];
+    size_t size[4];
+    size_t cnt = 0;
+
+    data[0] = msg.prefix;
+    size[0] = msg.prefix_size;
+    data[1] = msg.shared_body ? static_cast<void*>(*msg.shared_body) : static_cast<void*>(msg.body);
+    size[1] = msg.body_size;
+    data[2] = data[3] = nullptr;
+    size[2] = size[3] = 0;
+    if (msg.image) {
+        data[2] = msg.image->metadata();
+        size[2] = msg.image->metadata().size();
+        data[3] = msg.image->data();
+        size[3] = msg.image->data().size();
+    }
+
+    size_t skip = msg.sent;
+    for (size_t i = 0; i < 4; ++i) {
+        if (size[i] <= skip) {
+            skip -= size[i];
+            continue;
+        }
+        buffers[cnt].Data = static_cast<const uint8_t*>(data[i]) + skip;
+        buffers[cnt].Size = size[i] - skip;
+        skip = 0;
+        cnt++;
+    }
+
+    return cnt;
+}
+
+
+/*
+ * ip_connection::release_sent_messages
+ */
+void ip_connection::release_sent_messages(void) {
+    while (this->out_sent_cnt > 0) {
+        out_message& m = this->out_queue.front();
+        if (m.zerocopy && (static_cast<int32_t>(m.last_zerocopy_id - this->zerocopy_completed) > 0)) {
+            break; // still used by the kernel
+        }
+        this->close_message_fd(m);
+        this->out_queue.pop_front();
+        this->out_sent_cnt--;
+    }
+}
+
+
+/*
+ * ip_connection::reap_zerocopy_completions
+ */
+void ip_connection::reap_zerocopy_completions(void) {
+    UINT32 first, last;
+    while (this->comm->GetSocket().ReceiveZeroCopyCompletion(first, last)) {
+        // completions are reported in order of the sends
+        if (static_cast<int32_t>(last - this->zerocopy_completed) > 0) {
+            this->zerocopy_completed = last;
         }
     }
+    this->release_sent_messages();
+}
+
+
+/*
+ * ip_connection::abort_sending
+ */
+void ip_connection::abort_sending(void) {
+    try {
+        if (!this->comm.IsNull()) this->comm->GetSocket().Shutdown();
+    } catch(...) {
+    }
 }
 
 
@@ -294,7 +931,14 @@ void ip_connection::send_image_data(const data::buffer::shared_ptr data, void *c
 api_ptr_base ip_connection::find_provider(const std::string& path) {
     std::stringstream stream(path);
     std::string name;
-    api_ptr_base obj = this->get_core();
+    api_ptr_base obj;
+
+    // the first level is looked up in the provider table of the core
+    while (std::getline(stream, name, '/') && name.empty());
+    if (name.empty()) return obj;
+    core_impl *core = dynamic_cast<core_impl*>(this->get_core().get());
+    if (core == nullptr) return obj;
+    obj = core->find_provider(name);
 
     while (obj && std::getline(stream, name, '/')) {
         if (name.empty()) continue;
@@ -318,305 +962,630 @@ api_ptr_base ip_connection::find_provider(const std::string& path) {
 
 
 /*
- * ip_connection::ctrl_chan_receiver
+ * ip_connection::process_input
  */
-void ip_connection::ctrl_chan_receiver(const std::string& path) {
-    using namespace vislib::net;
-    SimpleMessage msg;
-    size_t rec = 1;
-    unsigned int err_cnt = 0;
-    bool answer;
-    SimpleMessageHeader answer_header;
-    the::blob answer_data;
+size_t ip_connection::process_input(char *data, size_t size) {
+    switch (this->state) {
+    case receive_state::request_length: {
+        if (size < sizeof(uint32_t)) return 0;
+        uint32_t len;
+        ::memcpy(&len, data, sizeof(uint32_t));
+        this->binary_request = ((len & ip_request::binary_flag) != 0);
+        this->request_len = len & ~ip_request::binary_flag;
+        if (this->request_len > max_request_length) {
+            throw the::exception("Request too long", __FILE__, __LINE__);
+        }
+        this->state = receive_state::request;
+        ip_reactor::instance().set_deadline(this,
+            the::system::performance_counter::query_millis() + request_timeout);
+        return sizeof(uint32_t);
+    }
+
+    case receive_state::request: {
+        if (size < this->request_len) return 0;
+        char *end = data + this->request_len;
+        char *str_end = std::find(data, end, '\0');
+        if (this->binary_request) {
+            this->process_binary_request(data, this->request_len);
+        } else if ((str_end != end) && (std::string(data, str_end) == ip_request::hello_request)) {
+            if (this->peer_hello.version != 0) {
+                throw the::exception("Hello repeated", __FILE__, __LINE__);
+            }
+            this->process_hello(str_end + 1, end - (str_end + 1));
+            return this->request_len;
+        } else {
+            this->process_request(std::string(data, str_end));
+        }
+        if (this->state != receive_state::closed) {
+            ip_reactor::instance().set_deadline(this, 0.0);
+        }
+        return this->request_len;
+    }
+
+    case receive_state::control_channel: {
+        vislib::net::SimpleMessageHeader h;
+        if (size < h.GetHeaderSize()) return 0;
+        ::memcpy(h.PeekData(), data, h.GetHeaderSize());
+        // only clients which received the limit with the hello must obey it
+        if ((this->peer_hello.version != 0) && (h.GetBodySize() > ip_request::max_message_size)) {
+            throw the::exception("Message too large", __FILE__, __LINE__);
+        }
+        size_t msg_size = h.GetHeaderSize() + h.GetBodySize();
+        if (size < msg_size) return 0;
+        this->process_ctrl_message(h, data + h.GetHeaderSize());
+        return msg_size;
+    }
+
+    case receive_state::image_stream: {
+        message_image_request req_message;
+        if (size < sizeof(message_image_request)) return 0;
+        ::memcpy(req_message.bytes, data, sizeof(message_image_request));
+        size_t msg_size = sizeof(message_image_request);
+        std::vector<image_region> regions;
+        if (req_message.req.id == 3) {
+            uint32_t cnt = req_message.req.time_code;
+            if (cnt > max_image_regions_of_interest) {
+                throw the::exception("Too many regions of interest requested", __FILE__, __LINE__);
+            }
+            msg_size += cnt * sizeof(image_region);
+            if (size < msg_size) return 0;
+            regions.resize(cnt);
+            if (cnt > 0) {
+                ::memcpy(regions.data(), data + sizeof(message_image_request), cnt * sizeof(image_region));
+            }
+        }
+        this->process_image_request(req_message, regions);
+        return msg_size;
+    }
+
+    default:
+        return 0;
+    }
+}
+
+
+/*
+ * ip_connection::process_request
+ */
+void ip_connection::process_request(const std::string& req) {
+
+    this->log().info("ip_connection: request to \"%s\"", req.c_str());
+
+    // avoid seqfaults on empty req strings
+    if (req.empty()) {
+        this->state = receive_state::closed;
+        return;
+    }
+
+    std::string scheme, req_user, host, req_path, req_query, req_fragment;
+    bool is_host_v6, is_host_port_set;
+    unsigned short host_port;
+    uri_utility::parse_uri(req, scheme, req_user, host, is_host_v6, host_port, is_host_port_set, req_path, req_query, req_fragment);
+
+    //req_user = the::text::string_utility::url_decode<std::string>(req_user); not used ATM
+    req_path = the::text::string_utility::url_decode<std::string>(req_path);
+    req_query = the::text::string_utility::url_decode<std::string>(req_query);
+    req_fragment = the::text::string_utility::url_decode<std::string>(req_fragment);
+
+    if (req_query.empty() && req_fragment.empty()) {
+        // direct request for providers
+        this->begin_ctrl_chan(req_path);
+
+    } else if (req_fragment.empty()) {
+        // direct request with query for providers
+        ip_request r;
+        r.path = req_path;
+        r.parse_query(req_query);
+        this->begin_data_chan(r);
+
+    } else {
+        // now conditions met
+        this->send_answer(500);
+        this->state = receive_state::closed;
+
+        this->log().error("Request \"%s\" could not be fulfilled\n", req.c_str());
+    }
+}
+
+
+/*
+ * ip_connection::process_hello
+ */
+void ip_connection::process_hello(const char *data, size_t size) {
+    ip_request::read_hello(data, size, this->peer_hello);
+    if (this->peer_hello.version == 0) {
+        throw the::exception("Invalid hello", __FILE__, __LINE__);
+    }
+
+    ip_hello answer;
+    ip_request::make_hello(answer, ip_request::max_message_size);
+    answer.capabilities &= this->peer_hello.capabilities;
+    this->peer_hello.capabilities = answer.capabilities;
+
+    this->log().info("ip_connection: client protocol version %u, capabilities 0x%x",
+        static_cast<unsigned int>(this->peer_hello.version),
+        static_cast<unsigned int>(answer.capabilities));
+
+    {
+        // answer code followed by the length prefixed hello
+        char hdr[sizeof(unsigned short) + sizeof(uint32_t)];
+        unsigned short code = ip_request::hello_answer;
+        uint32_t len = static_cast<uint32_t>(sizeof(ip_hello));
+        ::memcpy(hdr, &code, sizeof(unsigned short));
+        ::memcpy(hdr + sizeof(unsigned short), &len, sizeof(uint32_t));
+        auto_lock<critical_section> lock(this->send_lock);
+        if (this->comm.IsNull()) return;
+        this->enqueue_message(hdr, sizeof(hdr), &answer, sizeof(ip_hello));
+        this->flush_send_queue();
+    }
+
+    // the client sends the actual request next
+    this->state = receive_state::request_length;
+    ip_reactor::instance().set_deadline(this,
+        the::system::performance_counter::query_millis() + request_length_timeout);
+}
+
+
+/*
+ * ip_connection::process_binary_request
+ */
+void ip_connection::process_binary_request(const char *data, size_t size) {
+    ip_request req;
+    req.decode(data, size);
+
+    this->log().info("ip_connection: binary request to \"%s\"", req.path.c_str());
+
+    if (req.data_channel) {
+        this->begin_data_chan(req);
+    } else {
+        this->begin_ctrl_chan(req.path);
+    }
+}
+
+
+/*
+ * ip_connection::send_answer
+ */
+void ip_connection::send_answer(unsigned short answer) {
+    auto_lock<critical_section> lock(this->send_lock);
+    if (this->comm.IsNull()) return;
+    this->enqueue_message(&answer, 2);
+    this->flush_send_queue();
+}
 
+
+/*
+ * ip_connection::begin_ctrl_chan
+ */
+void ip_connection::begin_ctrl_chan(const std::string& path) {
     api_ptr_base prov_ptr = this->find_provider(path);
 
     if (prov_ptr) {
         this->connect(prov_ptr);
-
-        unsigned short answer = 200; // OK
-        this->comm->Send(&answer, 2);
+        this->send_answer(200); // OK
 
     } else {
-        unsigned short answer = 404; // not found
-        this->comm->Send(&answer, 2);
-
+        this->send_answer(404); // not found
         throw the::exception("Request service not found", __FILE__, __LINE__);
     }
 
-    provider_impl* prov = dynamic_cast<provider_impl*>(prov_ptr.get());
+    this->ctrl_provider = dynamic_cast<provider_impl*>(prov_ptr.get());
+    this->err_cnt = 0;
+    this->state = receive_state::control_channel;
+}
 
-    while (rec != 0) {
-        answer = false;
-        rec = this->comm->Receive(msg.GetHeader().PeekData(), msg.GetHeader().GetHeaderSize());
-        if (rec == msg.GetHeader().GetHeaderSize()) {
 
-            if (msg.GetHeader().GetBodySize() > 0) {
-                msg.AssertBodySize();
-                rec = this->comm->Receive(msg.GetBody(), msg.GetHeader().GetBodySize());
-                if (rec != msg.GetHeader().GetBodySize()) {
-                    if (rec == 0) break;
-                    throw the::exception("Incomplete message body", __FILE__, __LINE__);
-                }
-            }
+/*
+ * ip_connection::process_ctrl_message
+ */
+void ip_connection::process_ctrl_message(const vislib::net::SimpleMessageHeader& header, char *body) {
+    using namespace vislib::net;
+    bool answer = false;
+    SimpleMessageHeader answer_header;
+    the::blob answer_data;
+    provider_impl* prov = this->ctrl_provider;
 
-            // message complete
-            if (msg.GetHeader().GetMessageID() >= RIVLIB_USERMSG) {
-                // user message
-                prov->on_user_message_received(msg.GetHeader().GetMessageID(),
-                    msg.GetHeader().GetBodySize(), static_cast<char*>(msg.GetBody()));
+    if (header.GetMessageID() >= RIVLIB_USERMSG) {
+        // user message
+        prov->on_user_message_received(header.GetMessageID(),
+            header.GetBodySize(), body);
 
-            } else {
-                // library message
-
-                switch (msg.GetHeader().GetMessageID()) {
-                case static_cast<unsigned int>(message_id::query_data_channels):
-                    err_cnt = 0; // message to query available data channels
-                    {
-                        std::vector<data_channel_info> dci = prov->query_channels();
-                        size_t cnt = dci.size();
-                        size_t size = sizeof(uint32_t);
-
-                        for (size_t i = 0; i < cnt; ++i) {
-                            size += sizeof(uint16_t)
-                                + the::math::minimum<size_t>(dci[i].name.size(), UINT16_MAX)
-                                + sizeof(uint16_t) + sizeof(uint16_t) + sizeof(uint8_t);
-                        }
-
-                        answer_data.assert_size(size);
-                        *answer_data.as_at<uint32_t>(0) = static_cast<uint32_t>(cnt);
-                        size = sizeof(uint32_t);
-                        for (size_t i = 0; i < cnt; ++i) {
-                            size_t namelen = the::math::minimum<size_t>(dci[i].name.size(), UINT16_MAX);
-
-                            *answer_data.as_at<uint16_t>(size) = static_cast<uint16_t>(namelen);
-                            size += sizeof(uint16_t);
-
-                            ::memcpy(answer_data.at(size), dci[i].name.c_str(), namelen);
-                            size += namelen;
-
-                            *answer_data.as_at<uint16_t>(size) = static_cast<uint16_t>(dci[i].type);
-                            size += sizeof(uint16_t);
-
-                            *answer_data.as_at<uint16_t>(size) = dci[i].subtype.uint;
-                            size += sizeof(uint16_t);
-
-                            *answer_data.as_at<uint8_t>(size) = dci[i].quality;
-                            size += sizeof(uint8_t);
-                        }
-    
-                        answer_header.SetMessageID(static_cast<uint32_t>(message_id::data_channels));
-                        answer_header.SetBodySize(static_cast<SimpleMessageSize>(size));
-                        answer = true;
-                    }
-                    break;
-                default:
-                    // unexpected message
-                    ++err_cnt;
-                    if (err_cnt >= 10) {
-                        throw the::exception("Channel seems broken", __FILE__, __LINE__);
-                    } else {
-                        this->log().error("Unsupported message (%u) received\n",
-                            msg.GetHeader().GetMessageID());
-                    }
-                    break;
+    } else {
+        // library message
+
+        switch (header.GetMessageID()) {
+        case static_cast<unsigned int>(message_id::query_data_channels):
+            this->err_cnt = 0; // message to query available data channels
+            {
+                std::vector<data_channel_info> dci = prov->query_channels();
+                size_t cnt = dci.size();
+                size_t size = sizeof(uint32_t);
+
+                for (size_t i = 0; i < cnt; ++i) {
+                    size += sizeof(uint16_t)
+                        + the::math::minimum<size_t>(dci[i].name.size(), UINT16_MAX)
+                        + sizeof(uint16_t) + sizeof(uint16_t) + sizeof(uint8_t);
                 }
 
-            }
+                answer_data.assert_size(size);
+                *answer_data.as_at<uint32_t>(0) = static_cast<uint32_t>(cnt);
+                size = sizeof(uint32_t);
+                for (size_t i = 0; i < cnt; ++i) {
+                    size_t namelen = the::math::minimum<size_t>(dci[i].name.size(), UINT16_MAX);
+
+                    *answer_data.as_at<uint16_t>(size) = static_cast<uint16_t>(namelen);
+                    size += sizeof(uint16_t);
+
+                    ::memcpy(answer_data.at(size), dci[i].name.c_str(), namelen);
+                    size += namelen;
+
+                    *answer_data.as_at<uint16_t>(size) = static_cast<uint16_t>(dci[i].type);
+                    size += sizeof(uint16_t);
 
-            if (answer) {
-                this->comm->Send(answer_header.PeekData(), answer_header.GetHeaderSize());
-                if (answer_header.GetBodySize() > 0) {
-                    this->comm->Send(answer_data, answer_header.GetBodySize());
+                    *answer_data.as_at<uint16_t>(size) = dci[i].subtype.uint;
+                    size += sizeof(uint16_t);
+
+                    *answer_data.as_at<uint8_t>(size) = dci[i].quality;
+                    size += sizeof(uint8_t);
                 }
+
+                answer_header.SetMessageID(static_cast<uint32_t>(message_id::data_channels));
+                answer_header.SetBodySize(static_cast<SimpleMessageSize>(size));
+                answer = true;
+            }
+            break;
+        case static_cast<unsigned int>(message_id::multiple):
+            this->err_cnt = 0; // batch of messages sent by the client
+            this->process_ctrl_batch(body, header.GetBodySize());
+            break;
+        case static_cast<unsigned int>(message_id::query_metrics):
+            this->err_cnt = 0; // message to query the runtime metrics
+            {
+                provider_metrics metrics;
+                prov->get_metrics(metrics);
+
+                size_t size = sizeof(uint32_t) + sizeof(provider_metrics);
+                answer_data.assert_size(size);
+                *answer_data.as_at<uint32_t>(0) = static_cast<uint32_t>(sizeof(provider_metrics));
+                ::memcpy(answer_data.at(sizeof(uint32_t)), &metrics, sizeof(provider_metrics));
+
+                answer_header.SetMessageID(static_cast<uint32_t>(message_id::metrics));
+                answer_header.SetBodySize(static_cast<SimpleMessageSize>(size));
+                answer = true;
+            }
+            break;
+        default:
+            // unexpected message
+            ++this->err_cnt;
+            if (this->err_cnt >= 10) {
+                throw the::exception("Channel seems broken", __FILE__, __LINE__);
+            } else {
+                this->log().error("Unsupported message (%u) received\n",
+                    header.GetMessageID());
             }
+            break;
+        }
 
-        } else if (rec != 0) {
-            throw the::exception("Incomplete message header", __FILE__, __LINE__);
+    }
+
+    if (answer) {
+        auto_lock<critical_section> lock(this->send_lock);
+        if (this->comm.IsNull()) return;
+        if (this->enqueue_message(answer_header.PeekData(), answer_header.GetHeaderSize(),
+                answer_data, answer_header.GetBodySize())) {
+            this->flush_send_queue();
         }
     }
+}
+
 
+/*
+ * ip_connection::process_ctrl_batch
+ */
+void ip_connection::process_ctrl_batch(char *data, size_t size) {
+    vislib::net::SimpleMessageHeader h;
+    size_t pos = 0;
+
+    while (pos < size) {
+        if (size - pos < h.GetHeaderSize()) {
+            throw the::exception("Message batch truncated", __FILE__, __LINE__);
+        }
+        ::memcpy(h.PeekData(), data + pos, h.GetHeaderSize());
+        pos += h.GetHeaderSize();
+        if (h.GetBodySize() > size - pos) {
+            throw the::exception("Message batch truncated", __FILE__, __LINE__);
+        }
+        if (h.GetMessageID() == static_cast<unsigned int>(message_id::multiple)) {
+            throw the::exception("Nested message batch", __FILE__, __LINE__);
+        }
+        this->process_ctrl_message(h, data + pos);
+        pos += h.GetBodySize();
+    }
 }
 
 
 /*
- * ip_connection::data_chan_receiver
+ * ip_connection::begin_data_chan
  */
-void ip_connection::data_chan_receiver(const std::string& path, const std::string& query) {
+void ip_connection::begin_data_chan(const ip_request& req) {
 
     // find provider
-    api_ptr_base prov_ptr = this->find_provider(path);
+    api_ptr_base prov_ptr = this->find_provider(req.path);
 
     if (!prov_ptr) {
-        unsigned short answer = 404; // not found
-        this->comm->Send(&answer, 2);
+        this->send_answer(404); // not found
         throw the::exception("Request service not found", __FILE__, __LINE__);
     }
 
-    unsigned int found = 0;
-    uintptr_t name;
-    uint16_t type;
-    uint16_t subtype;
-
-    std::stringstream stream(query);
-    std::string q;
-
-    while (std::getline(stream, q, '&')) {
-        if (the::text::string_utility::starts_with(q, "n=")) {
-            unsigned char buf[sizeof(uintptr_t)];
-            the::text::string_utility::from_hex_string(buf, sizeof(uintptr_t), q.substr(2));
-            ::memcpy(&name, buf, sizeof(uintptr_t));
-            found |= 1;
-        } else if (the::text::string_utility::starts_with(q, "t=")) {
-            type = static_cast<uint16_t>(the::text::string_utility::parse_int(q.c_str() + 2));
-            found |= 2;
-        } else if (the::text::string_utility::starts_with(q, "s=")) {
-            subtype = static_cast<uint16_t>(the::text::string_utility::parse_int(q.c_str() + 2));
-            found |= 4;
-        }
-    }
-
-    if (found != 7) {
-        unsigned short answer = 400; // bad request
-        this->comm->Send(&answer, 2);
+    if (!req.is_complete()) {
+        this->send_answer(400); // bad request
         throw the::exception("Request query incomplete", __FILE__, __LINE__);
     }
 
+    uint16_t type = req.type;
+    uint16_t subtype = req.subtype;
+    this->min_frame_interval = (req.max_fps > 0) ? (1000.0 / static_cast<double>(req.max_fps)) : 0.0;
+    this->egress.set_rate(req.max_rate);
+
     // find data channel
     provider_impl* pi = dynamic_cast<provider_impl*>(prov_ptr.get());
     if (pi == nullptr) {
-        unsigned short answer = 500; // Internal Server Error
-        this->comm->Send(&answer, 2);
+        this->send_answer(500); // Internal Server Error
         throw the::exception("Internal Server Error when accessing provider", __FILE__, __LINE__);
     }
+    this->provider_egress = pi->get_egress_bucket();
 
     if (type == static_cast<uint16_t>(data_channel_type::image_stream)) {
         api_ptr_base img_dat_binding;
         std::vector<api_ptr_base> dcs = pi->select<image_data_binding>();
         for (size_t i = 0, cnt = dcs.size(); i < cnt; ++i) {
-            if (reinterpret_cast<uintptr_t>(dcs[i].get()) == name) {
+            if (static_cast<uint64_t>(reinterpret_cast<uintptr_t>(dcs[i].get())) == req.name) {
                 img_dat_binding = dcs[i];
                 break;
             }
         }
 
         if (!img_dat_binding) {
-            unsigned short answer = 404; // Not Found
-            this->comm->Send(&answer, 2);
+            this->send_answer(404); // Not Found
             throw the::exception("Requested data channel not found", __FILE__, __LINE__);
         }
 
         // TODO: Supported media types should be collected automatically
         if ((subtype != static_cast<uint16_t>(data_channel_image_stream_subtype::rgb_raw)) 
                 && (subtype != static_cast<uint16_t>(data_channel_image_stream_subtype::rgb_zip))
+                && (subtype != static_cast<uint16_t>(data_channel_image_stream_subtype::rgb_progressive))
 #if(USE_MJPEG == 1)
                 && (subtype != static_cast<uint16_t>(data_channel_image_stream_subtype::rgb_mjpeg))
 #endif
            ) {
-            unsigned short answer = 415; // Unsupported Media Type
-            this->comm->Send(&answer, 2);
+            this->send_answer(415); // Unsupported Media Type
             throw the::exception("Unsupported media subtype requested", __FILE__, __LINE__);
         }
 
-        encoder::image_encoder_base *encoder = nullptr;
-        switch (subtype) {
-        case static_cast<uint16_t>(data_channel_image_stream_subtype::rgb_raw):
-            encoder = new encoder::image_encoder_rgb_raw();
-            break;
-        case static_cast<uint16_t>(data_channel_image_stream_subtype::rgb_zip):
-            encoder = new encoder::image_encoder_rgb_zip();
-            break;
-#if(USE_MJPEG == 1)
-        case static_cast<uint16_t>(data_channel_image_stream_subtype::rgb_mjpeg):
-            encoder = new encoder::image_encoder_rgb_mjpeg();
-            break;
-#endif
-        default: {
-            unsigned short answer = 415; // Unsupported Media Type
-            this->comm->Send(&answer, 2);
+        if (!req.multicast_group.empty()) {
+            this->begin_multicast_chan(img_dat_binding, subtype, req.multicast_group);
+            return;
+        }
+
+        encoder::image_encoder_base *encoder = create_image_encoder(subtype);
+        if (encoder == nullptr) {
+            this->send_answer(415); // Unsupported Media Type
             throw the::exception("Unsupported media subtype requested", __FILE__, __LINE__);
         }
+
+        if (req.shm && !this->fd_passing) {
+            // shared memory only works if the client runs on this host. The
+            // same address does not guarantee a shared memory namespace
+            // (e.g. containers), so the client confirms the ring first.
+            try {
+                this->shm_enabled = (this->comm->GetSocket().GetPeerEndPoint().GetIPAddress()
+                    == this->comm->GetSocket().GetLocalEndPoint().GetIPAddress());
+            } catch(...) {
+            }
         }
 
+        this->image_encoder = encoder;
         api_ptr_base encoder_ptr(encoder);
         this->connect(encoder_ptr);
         encoder->connect(img_dat_binding);
         this->connect(this->get_core()); // quick-fix for shutdown assertion ... ugly
 
-        unsigned short answer = 200; // OK
-        this->comm->Send(&answer, 2);
+        this->send_answer(200); // OK
 
-        this->image_encoder_receiver(encoder);
+        this->state = receive_state::image_stream;
 
     } else {
-        unsigned short answer = 415; // Unsupported Media Type
-        this->comm->Send(&answer, 2);
+        this->send_answer(415); // Unsupported Media Type
         throw the::exception("Unsupported media type requested", __FILE__, __LINE__);
     }
 }
 
 
 /*
- * ip_connection::image_encoder_receiver
+ * ip_connection::begin_multicast_chan
  */
-void ip_connection::image_encoder_receiver(encoder::image_encoder_base* encoder) {
-    size_t rec = 1;
-    uint16_t code = 0;
-    message_image_request req_message;
+void ip_connection::begin_multicast_chan(api_ptr_base img_dat_binding, uint16_t subtype, const std::string& group) {
+    using namespace vislib::net;
 
+    IPEndPoint endpoint;
+    size_t colon = group.rfind(':');
     try {
+        if (colon == std::string::npos) throw the::exception("Port missing", __FILE__, __LINE__);
+        int port = the::text::string_utility::parse_int(group.c_str() + colon + 1);
+        if ((port <= 0) || (port > USHRT_MAX)) throw the::exception("Port invalid", __FILE__, __LINE__);
+        endpoint = IPEndPoint(IPAddress::Create(group.substr(0, colon).c_str()),
+            static_cast<unsigned short>(port));
+    } catch(...) {
+        this->send_answer(400); // bad request
+        throw the::exception("Multicast group invalid", __FILE__, __LINE__);
+    }
+    if ((endpoint.GetIPAddress4()[0] & 0xF0) != 0xE0) {
+        this->send_answer(400); // bad request
+        throw the::exception("Address is no multicast group", __FILE__, __LINE__);
+    }
+    if (!multicast_sender::is_group_in_range(this->multicast_groups, endpoint.GetIPAddress4())) {
+        this->send_answer(403); // Forbidden
+        throw the::exception("Multicast group not permitted by the communicator", __FILE__, __LINE__);
+    }
 
-        while (rec != 0) {
-            rec = this->comm->Receive(&req_message.bytes, 5);
-            if (rec == 5) {
-                switch (req_message.req.id) {
-                case 0: // close
-                    return;
-                    break;
-                case 1: // restart image stream
-                    if (req_message.req.time_code != 0x12345678) {
-                        if (req_message.req.time_code == 0x78563412) {
-                            throw the::exception("Byte order switch of network image request message is not supported", __FILE__, __LINE__);
-                        } else {
-                            // printf("%.2x%.2x%.2x%.2x%.2x\n", req_message.bytes[0], req_message.bytes[1], req_message.bytes[2], req_message.bytes[3], req_message.bytes[4]);
-                            throw the::exception("Image stream init message broken", __FILE__, __LINE__);
-                        }
-                    }
-                    req_message.req.time_code = 0;
-                    // fall though
-                case 2: { // next image
-                    std::vector<api_ptr_base> encs = this->select<encoder::image_encoder_base>();
-                    if (encs.size() != 1) continue;
-                    encoder::image_encoder_base *enc = dynamic_cast<encoder::image_encoder_base*>(encs[0].get());
-
-                    encoder::image_request::ptr ir(new encoder::image_request(
-                        &ip_connection::send_image_data, this, req_message.req.time_code));
-                    //printf("req(%u, %u)\n", req_message.req.id, req_message.req.time_code);
-
-                    enc->request_output(ir);
-
-                } break;
-                default: // invalid code. Close!
-                    throw the::exception(the::text::astring_builder::format("Invalid image request code received: %d", static_cast<int>(req_message.req.id)).c_str(), __FILE__, __LINE__);
-                }
-            } else if (rec != 0) {
-                throw the::exception("Incomplete message", __FILE__, __LINE__);
+    bool group_in_use;
+    api_ptr_base sender = multicast_sender::acquire(img_dat_binding, subtype, endpoint,
+        this->provider_egress, group_in_use);
+    if (group_in_use) {
+        this->send_answer(409); // Conflict
+        throw the::exception("Multicast group used by another image stream", __FILE__, __LINE__);
+    }
+    if (!sender) {
+        this->send_answer(415); // Unsupported Media Type
+        throw the::exception("Unsupported media subtype requested", __FILE__, __LINE__);
+    }
+
+    this->multicast = dynamic_cast<multicast_sender*>(sender.get());
+    this->connect(sender);
+    this->connect(this->get_core()); // quick-fix for shutdown assertion ... ugly
+
+    this->send_answer(200); // OK
+
+    // image requests are ignored, the images are sent by the multicast sender
+    this->state = receive_state::image_stream;
+}
+
+
+/*
+ * ip_connection::process_image_request
+ */
+void ip_connection::process_image_request(const message_image_request& req_message,
+        const std::vector<image_region>& regions) {
+    // requests are passed to the encoder after 'credit_lock' has been released
+    encoder::image_request::ptr next_req;
+
+    switch (req_message.req.id) {
+    case 0: // close
+        this->state = receive_state::closed;
+        break;
+    case 1: // restart image stream
+        if (req_message.req.time_code != 0x12345678) {
+            if (req_message.req.time_code == 0x78563412) {
+                throw the::exception("Byte order switch of network image request message is not supported", __FILE__, __LINE__);
+            } else {
+                // printf("%.2x%.2x%.2x%.2x%.2x\n", req_message.bytes[0], req_message.bytes[1], req_message.bytes[2], req_message.bytes[3], req_message.bytes[4]);
+                throw the::exception("Image stream init message broken", __FILE__, __LINE__);
             }
         }
-
-    } catch(...) {
-        try {
-            // remove all pending requests
-            std::vector<api_ptr_base> encs = this->select<encoder::image_encoder_base>();
-            std::vector<api_ptr_base>::iterator end = encs.end();
-            for (std::vector<api_ptr_base>::iterator i = encs.begin(); i < end; i++) {
-                encoder::image_encoder_base *enc = dynamic_cast<encoder::image_encoder_base*>(i->get());
-                if (enc == nullptr) continue;
-                enc->remove_pending_requests(&ip_connection::send_image_data, this);
+        {
+            auto_lock<critical_section> lock(this->credit_lock);
+            this->credits = this->request_window;
+            this->last_sent_time_code = 0;
+            if (!this->request_queued) {
+                next_req = this->make_image_request(0);
             }
+        }
+        break;
+    case 2: { // next image
+        //printf("req(%u, %u)\n", req_message.req.id, req_message.req.time_code);
+        auto_lock<critical_section> lock(this->credit_lock);
+        if (this->credits < this->request_window) {
+            this->credits++;
+        }
+        if (!this->request_queued && (this->credits > 0)) {
+            next_req = this->make_image_request(the::math::maximum(
+                req_message.req.time_code, this->last_sent_time_code));
+        }
 
-        } catch(...) {
+    } break;
+    case 4: { // set request window
+        int window = static_cast<int>(the::math::minimum(
+            the::math::maximum<uint32_t>(req_message.req.time_code, 1),
+            max_image_request_window));
+        auto_lock<critical_section> lock(this->credit_lock);
+        this->credits += window - this->request_window;
+        this->request_window = window;
+        if (!this->request_queued && (this->credits > 0)) {
+            next_req = this->make_image_request(this->last_sent_time_code);
         }
-        throw;
+
+    } break;
+    case 5: { // release shared memory slot
+        auto_lock<critical_section> lock(this->send_lock);
+        this->shm.release_slot(req_message.req.time_code);
+
+    } break;
+    case 6: { // shared memory ring opened by the client or not
+        auto_lock<critical_section> lock(this->send_lock);
+        if (req_message.req.time_code == 0) {
+            this->log().info("ip_connection: client cannot open the shared memory ring; sending images in-band");
+            this->shm.close();
+            this->shm_enabled = false;
+            this->shm_confirmed = false;
+        } else if (this->shm.is_open() && (req_message.req.time_code == this->shm_rings)) {
+            // answers to replaced rings are ignored
+            this->shm_confirmed = true;
+        }
+
+    } break;
+    case 3: // set regions of interest
+        if (this->image_encoder != nullptr) { // not supported for multicast streams
+            this->image_encoder->set_regions_of_interest(regions);
+        }
+        break;
+    default: // invalid code. Close!
+        throw the::exception(the::text::astring_builder::format("Invalid image request code received: %d", static_cast<int>(req_message.req.id)).c_str(), __FILE__, __LINE__);
+    }
+
+    if (next_req) {
+        this->image_encoder->request_output(next_req);
+    }
+}
+
+
+/*
+ * ip_connection::make_image_request
+ */
+encoder::image_request::ptr ip_connection::make_image_request(unsigned int last_time_code) {
+    if (this->image_encoder == nullptr) return nullptr;
+
+    // pace the images to the requested maximum frame rate
+    double not_before = (this->min_frame_interval > 0.0)
+        ? (this->last_frame_time + this->min_frame_interval) : 0.0;
+
+    // and to the egress rates, unless the images do not leave the host
+    if (!this->shm_confirmed && !this->fd_passing) {
+        not_before = the::math::maximum(not_before, this->egress.ready_time());
+        if (this->provider_egress) {
+            not_before = the::math::maximum(not_before, this->provider_egress->ready_time());
+        }
+        if (this->communicator_egress) {
+            not_before = the::math::maximum(not_before, this->communicator_egress->ready_time());
+        }
+    }
+
+    encoder::image_request::ptr ir(new encoder::image_request(
+        &ip_connection::send_image_data, this, last_time_code, not_before));
+
+    this->request_queued = true;
+    return ir;
+}
+
+
+/*
+ * ip_connection::is_egress_over_budget
+ */
+bool ip_connection::is_egress_over_budget(void) {
+    return this->egress.is_over_budget()
+        || (this->provider_egress && this->provider_egress->is_over_budget())
+        || (this->communicator_egress && this->communicator_egress->is_over_budget());
+}
+
+
+/*
+ * ip_connection::consume_egress
+ */
+void ip_connection::consume_egress(size_t size) {
+    this->egress.consume(size);
+    if (this->provider_egress) {
+        this->provider_egress->consume(size);
+    }
+    if (this->communicator_egress) {
+        this->communicator_egress->consume(size);
     }
 }
@@ -14,22 +14,47 @@
 
 #include "element_node.h"
 #include "encoder/image_encoder_base.h"
-#include "the/system/threading/runnable.h"
-#include "the/system/threading/thread.h"
+#include "ip_reactor.h"
+#include "ip_request.h"
+#include "message_image_request.h"
+#include "multicast_sender.h"
+#include "shm_ring.h"
+#include "token_bucket.h"
+#include "rivlib/ip_utilities.h"
+#include "rivlib/provider.h"
+#include "the/blob.h"
+#include "the/system/threading/critical_section.h"
+#include "vislib/SimpleMessageHeader.h"
+#include "vislib/SimpleMessageHeaderData.h"
 #include "vislib/SmartRef.h"
+#include "vislib/SocketException.h"
 #include "vislib/TcpCommChannel.h"
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
 
 
 namespace eu_vicci {
 namespace rivlib {
 
 
+    /** forward declaration */
+    class provider_impl;
+
+
     /**
      * Class of (generic) ip connections
+     *
+     * Incoming data is received by the I/O threads of the 'ip_reactor' and
+     * processed by a state machine. No thread is bound to a connection.
      */
-    class ip_connection : public element_node, public the::system::threading::runnable {
+    class ip_connection : public element_node, public ip_reactor::handler {
     public:
 
+        /** The kind of this node in the peer indexes */
+        static const node_kind kind = node_kind::ip_connection;
+
         /** the used comm_channel type */
         typedef vislib::SmartRef<vislib::net::TcpCommChannel> comm_channel_type;
 
@@ -44,36 +69,49 @@ namespace rivlib {
         virtual ~ip_connection(void);
 
         /**
-         * The thread will call this method if it was requested to terminate by
-         * the user.
+         * Answer the kind of this node
          *
-         * @return termination_behaviour::graceful or termination_behaviour::forceful.
+         * @return node_kind::ip_connection
          */
-        virtual the::system::threading::thread::termination_behaviour on_thread_terminating(void) throw();
+        virtual node_kind get_kind(void) const;
 
         /**
-         * removes the object when the thread has terminated
+         * Creates the image encoder for an image stream subtype
+         *
+         * @param subtype The image stream subtype
          *
-         * @param reason Not used
+         * @return The new encoder or nullptr if 'subtype' is not supported
+         */
+        static encoder::image_encoder_base *create_image_encoder(uint16_t subtype);
+
+        /**
+         * Passes large images as memory files instead of copying them
+         * through the socket. Only valid for Unix domain socket connections
+         * and must be called before 'start'.
          */
-        virtual void on_thread_terminated(const the::system::threading::thread::exit_reason reason) throw();
+        void enable_fd_passing(void);
 
         /**
-         * Perform the work of a thread.
+         * Sets the egress token bucket shared by all connections of the
+         * communicator. Must be called before 'start'.
          *
-         * @return The application dependent return code of the thread. This 
-         *         must not be STILL_ACTIVE (259).
+         * @param bucket The egress token bucket
          */
-        virtual int run(void);
+        void set_communicator_egress(token_bucket::shared_ptr bucket);
 
         /**
-         * Answer wether or not the thread is running
+         * Sets the range of multicast groups the client may request the
+         * images to be sent to. Must be called before 'start'.
          *
-         * @return True if the thread is running
+         * @param range The range of multicast groups
          */
-        inline bool is_running(void) const {
-            return (this->worker_thread != nullptr) ? this->worker_thread->is_running() : false;
-        }
+        void set_multicast_groups(const multicast_group_range& range);
+
+        /**
+         * Sends the handshake and registers the connection with the reactor.
+         * The connection must be connected to the core.
+         */
+        void start(void);
 
         /**
          * Sends a user message
@@ -84,6 +122,65 @@ namespace rivlib {
          */
         void send_message(unsigned int id, unsigned int size, const char* data);
 
+        /**
+         * Queues a user message whose body is shared with other connections.
+         * The message is sent by the reactor; the call never blocks.
+         *
+         * @param id The message ID. Should be at least RIVLIB_USERMSG
+         * @param body The message body
+         * @param replace If true, the message replaces an unsent message
+         *                with the same id posted with 'replace'
+         */
+        void post_message(unsigned int id, std::shared_ptr<the::blob> body, bool replace);
+
+        /**
+         * Answer whether the connection is an established control channel
+         *
+         * @return True for control channel connections
+         */
+        inline bool is_control_channel(void) const {
+            return this->state == receive_state::control_channel;
+        }
+
+        /**
+         * Answer the socket handle to be watched
+         *
+         * @return The socket handle
+         */
+        virtual SOCKET get_reactor_handle(void);
+
+        /**
+         * Receives and processes the available data
+         *
+         * @return False if the connection should be closed
+         */
+        virtual bool on_readable(void);
+
+        /**
+         * Continues sending the send queue
+         *
+         * @return False if the connection should be closed
+         */
+        virtual bool on_writable(void);
+
+        /**
+         * Closes the connection if the client did not complete its request
+         * in time
+         */
+        virtual void on_reactor_timeout(void);
+
+        /**
+         * Closes the connection
+         */
+        virtual void on_reactor_closed(void);
+
+        /**
+         * Answer the send statistics of the connection
+         *
+         * @return The send statistics of the connection
+         */
+        connection_statistics get_statistics(void);
+
     protected:
 
         /**
@@ -98,6 +195,16 @@ namespace rivlib {
 
     private:
 
+        /**
+         * Answer whether a socket call failed because the non-blocking
+         * socket is not ready
+         *
+         * @param ex The exception of the socket call
+         *
+         * @return True if the call would have blocked
+         */
+        static bool is_would_block(const vislib::net::SocketException& ex);
+
         /**
          * Callback type used to asynchronously request encoder output
          *
@@ -115,36 +222,395 @@ namespace rivlib {
          */
         api_ptr_base find_provider(const std::string& path);
 
+        /** The states of the incoming data stream */
+        enum class receive_state {
+            request_length,
+            request,
+            control_channel,
+            image_stream,
+            closed
+        };
+
+        /** A message in the send queue */
+        typedef struct _out_message_t {
+
+            /** The leading part of the message (header, answer code, etc.) */
+            uint8_t prefix[sizeof(vislib::net::SimpleMessageHeaderData) + 2 * sizeof(uint32_t)];
+
+            /** The number of bytes in 'prefix' */
+            size_t prefix_size;
+
+            /** The copy of the message body */
+            the::blob body;
+
+            /** The message body shared with other connections, used instead of 'body' */
+            std::shared_ptr<the::blob> shared_body;
+
+            /** Flag whether later posted messages with the same id replace this one */
+            bool coalesce;
+
+            /** The message id used for coalescing */
+            uint32_t coalesce_id;
+
+            /** The number of bytes in 'body' */
+            size_t body_size;
+
+            /** The image of image data messages (metadata and data are sent) */
+            data::buffer::shared_ptr image;
+
+            /** The number of bytes of the message already sent */
+            size_t sent;
+
+            /** Flag whether parts of the message have been sent without copying */
+            bool zerocopy;
+
+            /** The completion id of the last zero-copy send call of the message */
+            uint32_t last_zerocopy_id;
+
+            /** The memory file passed with the message or -1 */
+            int fd;
+
+        } out_message;
+
+        /** The minimum image size to be sent without copying */
+        static const size_t zerocopy_threshold = 0x10000;
+
+        /** The maximum number of images waiting in the send queue */
+        static const unsigned int max_queued_images = 2;
+
+        /** The maximum number of bytes of other messages waiting in the send queue */
+        static const size_t max_queued_bytes = 0x4000000;
+
+        /** The minimum image size to be passed as memory file */
+        static const size_t fd_passing_threshold = 0x10000;
+
+        /** The number of slots of the shared memory ring */
+        static const uint32_t shm_slot_count = 4;
+
+        /** The number of bytes received at once */
+        static const size_t receive_chunk_size = 0x10000;
+
+        /** The maximum length of the initial request string */
+        static const uint32_t max_request_length = 0x10000;
+
+        /** The time the client has to send the request length after the handshake in milliseconds */
+        static const unsigned int request_length_timeout = 2000;
+
+        /** The time the client has to send the request after its length in milliseconds */
+        static const unsigned int request_timeout = 2000;
+
         /**
-         * The receiver message loop for control_channel connections
+         * Processes the next complete message from the received data
          *
-         * @param path The path to the object
+         * @param data The received data not yet processed
+         * @param size The number of bytes in 'data'
+         *
+         * @return The number of bytes consumed, zero if the message is incomplete
+         */
+        size_t process_input(char *data, size_t size);
+
+        /**
+         * Processes the initial request string
+         *
+         * @param req The request string
+         */
+        void process_request(const std::string& req);
+
+        /**
+         * Processes the hello probe of the client and answers with
+         * 'ip_request::hello_answer' and the hello of the server holding the
+         * common capabilities
+         *
+         * @param data The hello following the probe request string
+         * @param size The number of bytes in 'data'
+         */
+        void process_hello(const char *data, size_t size);
+
+        /**
+         * Processes the initial request in the binary encoding
+         *
+         * @param data The request
+         * @param size The number of bytes in 'data'
          */
-        void ctrl_chan_receiver(const std::string& path);
+        void process_binary_request(const char *data, size_t size);
 
         /**
-         * The receiver message loop for data_channel connections
+         * Opens a control_channel connection
          *
          * @param path The path to the object
-         * @param query The query
          */
-        void data_chan_receiver(const std::string& path, const std::string& query);
+        void begin_ctrl_chan(const std::string& path);
+
+        /**
+         * Processes one message of a control_channel connection
+         *
+         * @param header The message header
+         * @param body The message body
+         */
+        void process_ctrl_message(const vislib::net::SimpleMessageHeader& header, char *body);
+
+        /**
+         * Processes the messages of a 'message_id::multiple' batch
+         *
+         * @param data The body of the batch
+         * @param size The size of the body of the batch in bytes
+         */
+        void process_ctrl_batch(char *data, size_t size);
+
+        /**
+         * Opens a data_channel connection
+         *
+         * @param req The request
+         */
+        void begin_data_chan(const ip_request& req);
 
         /**
-         * The receiver message loop for image_data_channel connections
+         * Subscribes the data_channel connection to the multicast sender of
+         * the image data binding
          *
-         * @param encoder The image data encoder
+         * @param img_dat_binding The image data binding
+         * @param subtype The image stream subtype
+         * @param group The multicast group "address:port"
          */
-        void image_encoder_receiver(encoder::image_encoder_base* encoder);
+        void begin_multicast_chan(api_ptr_base img_dat_binding, uint16_t subtype, const std::string& group);
+
+        /**
+         * Processes one image request of an image_data_channel connection
+         *
+         * @param req_message The request message
+         * @param regions The regions of interest following a set regions of interest request
+         */
+        void process_image_request(const message_image_request& req_message,
+            const std::vector<image_region>& regions);
+
+        /**
+         * Sends the two-byte answer to the initial request
+         *
+         * @param answer The answer code
+         */
+        void send_answer(unsigned short answer);
+
+        /**
+         * Stores an image in the shared memory ring and queues the message
+         * referencing it. The caller must hold 'send_lock'.
+         *
+         * @param data The encoded image
+         *
+         * @return False if the image must be sent through the socket
+         */
+        bool store_image_shm(const data::buffer::shared_ptr data);
+
+        /**
+         * Copies an image into a new memory file and queues the message
+         * passing it. The caller must hold 'send_lock'.
+         *
+         * @param data The encoded image
+         *
+         * @return False if the image must be sent through the socket
+         */
+        bool enqueue_image_fd(const data::buffer::shared_ptr data);
+
+        /**
+         * Closes the memory file of a message if it has not been passed yet
+         *
+         * @param msg The message
+         */
+        void close_message_fd(out_message& msg);
+
+        /**
+         * Appends a message to the send queue. The caller must hold
+         * 'send_lock' and should call 'flush_send_queue' afterwards.
+         *
+         * @param prefix The leading part of the message
+         * @param prefix_size The number of bytes in 'prefix'
+         * @param body The message body to be copied
+         * @param body_size The number of bytes in 'body'
+         *
+         * @return False if the message has been dropped because the queue is full
+         */
+        bool enqueue_message(const void *prefix, size_t prefix_size,
+            const void *body = nullptr, size_t body_size = 0);
+
+        /**
+         * Sends as much of the send queue as possible without blocking. If
+         * data remains, the reactor continues when the socket is writable.
+         * The caller must hold 'send_lock'.
+         *
+         * @return True if the send queue is empty
+         */
+        bool flush_send_queue(void);
+
+        /**
+         * Fills the send buffers with the unsent part of a message
+         *
+         * @param msg The message
+         * @param buffers Receives the send buffers (at least four)
+         *
+         * @return The number of send buffers used
+         */
+        size_t get_send_buffers(out_message& msg, vislib::net::Socket::SendBuffer *buffers);
+
+        /**
+         * Removes the completely sent messages from the send queue, which
+         * are no longer used by zero-copy sends. The caller must hold
+         * 'send_lock'.
+         */
+        void release_sent_messages(void);
+
+        /**
+         * Receives the completions of zero-copy sends and releases the
+         * messages no longer needed. The caller must hold 'send_lock'.
+         */
+        void reap_zerocopy_completions(void);
+
+        /**
+         * Shuts the socket down after a failed send, which causes the reactor
+         * to close the connection. The caller must hold 'send_lock'.
+         */
+        void abort_sending(void);
+
+        /**
+         * Creates the next image request for the image encoder and marks it
+         * as queued. The caller must hold 'credit_lock' and must pass the
+         * request to the encoder after releasing 'credit_lock'.
+         *
+         * @param last_time_code The time code of the last image the client received
+         *
+         * @return The image request
+         */
+        encoder::image_request::ptr make_image_request(unsigned int last_time_code);
+
+        /**
+         * Answer whether an image must be dropped because the egress budget
+         * of the connection, its provider or its communicator is used up
+         *
+         * @return True if the image must be dropped
+         */
+        bool is_egress_over_budget(void);
+
+        /**
+         * Consumes the egress tokens for an image sent through the socket
+         *
+         * @param size The number of bytes sent
+         */
+        void consume_egress(size_t size);
 
         /** The comm channel */
         comm_channel_type comm;
 
-        /** The thread object */
-        the::system::threading::thread *worker_thread;
+        /** The lock serializing all sends and the closing of 'comm' */
+        the::system::threading::critical_section send_lock;
 
         /** flag to aid the cleanup process */
-        bool is_terminating;
+        volatile bool is_terminating;
+
+        /** The state of the incoming data stream */
+        receive_state state;
+
+        /** The received data not yet processed */
+        the::blob in_data;
+
+        /** The number of valid bytes in 'in_data' */
+        size_t in_size;
+
+        /** The length of the initial request string */
+        uint32_t request_len;
+
+        /** Flag whether the initial request is in the binary encoding */
+        bool binary_request;
+
+        /**
+         * The hello of the client with the capabilities reduced to the
+         * common ones. Zero if the client did not send a hello.
+         */
+        ip_hello peer_hello;
+
+        /** The provider of control_channel connections */
+        provider_impl *ctrl_provider;
+
+        /** The number of consecutive unsupported control messages */
+        unsigned int err_cnt;
+
+        /** Flag whether large images are sent without copying */
+        bool zerocopy;
+
+        /** The number of zero-copy send calls issued */
+        uint32_t zerocopy_sends;
+
+        /** The id of the last completed zero-copy send call */
+        uint32_t zerocopy_completed;
+
+        /** The send queue */
+        std::deque<out_message> out_queue;
+
+        /** The number of messages at the front of 'out_queue' sent completely */
+        size_t out_sent_cnt;
+
+        /** The number of bytes in 'out_queue' not sent yet */
+        size_t out_queued_bytes;
+
+        /** The number of images in 'out_queue' not started to send yet */
+        unsigned int out_queued_images;
+
+        /** The send statistics */
+        connection_statistics stats;
+
+        /** The minimum time between two images sent in milliseconds (0 for unlimited) */
+        double min_frame_interval;
+
+        /** The time the last image has been sent in performance counter milliseconds; guarded by 'credit_lock' */
+        double last_frame_time;
+
+        /** The image encoder of data channel connections */
+        encoder::image_encoder_base *image_encoder;
+
+        /** The multicast sender of multicast data channel connections (kept alive as peer node) */
+        multicast_sender *multicast;
+
+        /** The range of multicast groups the client may request */
+        multicast_group_range multicast_groups;
+
+        /** Flag whether images are passed through shared memory to a same-host client */
+        bool shm_enabled;
+
+        /** The shared memory ring of same-host clients (guarded by 'send_lock') */
+        shm_ring shm;
+
+        /** The number of shared memory rings announced (guarded by 'send_lock') */
+        uint32_t shm_rings;
+
+        /**
+         * Flag whether the client opened the current shared memory ring,
+         * i.e. whether images may be passed through it (guarded by 'send_lock')
+         */
+        bool shm_confirmed;
+
+        /** Flag whether large images are passed as memory files */
+        bool fd_passing;
+
+        /** The lock for the image request credits */
+        the::system::threading::critical_section credit_lock;
+
+        /** The number of images the client is still willing to receive */
+        int credits;
+
+        /** The number of images the client allows to be in flight */
+        int request_window;
+
+        /** Flag whether an image request is queued at the image encoder */
+        bool request_queued;
+
+        /** The time code of the last image sent */
+        unsigned int last_sent_time_code;
+
+        /** The egress token bucket of this connection */
+        token_bucket egress;
+
+        /** The egress token bucket of the provider or nullptr */
+        token_bucket::shared_ptr provider_egress;
+
+        /** The egress token bucket of the communicator or nullptr */
+        token_bucket::shared_ptr communicator_egress;
 
     };
 
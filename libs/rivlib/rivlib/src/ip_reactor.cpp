@@ -0,0 +1,503 @@
+/*
+ * rivlib
+ * ip_reactor.cpp
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+#include "stdafx.h"
+#include "ip_reactor.h"
+#include "the/assert.h"
+#include "the/exception.h"
+#include "the/memory.h"
+#include "the/system/performance_counter.h"
+#include "the/system/threading/auto_lock.h"
+#ifdef THE_LINUX
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <errno.h>
+#endif /* THE_LINUX */
+
+using namespace eu_vicci::rivlib;
+using namespace the::system::threading;
+
+
+/*
+ * ip_reactor::handler::~handler
+ */
+ip_reactor::handler::~handler(void) {
+    // intentionally empty
+}
+
+
+/*
+ * ip_reactor::handler::handler
+ */
+ip_reactor::handler::handler(void) {
+    // intentionally empty
+}
+
+
+/*
+ * ip_reactor::instance
+ */
+ip_reactor& ip_reactor::instance(void) {
+    static ip_reactor inst;
+    return inst;
+}
+
+
+/*
+ * ip_reactor::add
+ */
+void ip_reactor::add(handler *h, api_ptr_base keep_alive) {
+    THE_ASSERT(h != nullptr);
+    auto_lock<critical_section> lock(this->lock_obj);
+    if (this->terminating) {
+        throw the::exception("ip_reactor is shutting down", __FILE__, __LINE__);
+    }
+    this->assert_started();
+
+    entry& e = this->handlers[h];
+    e.keep_alive = keep_alive;
+    e.busy = false;
+    e.want_write = false;
+    e.pending = 0;
+    e.deadline = 0.0;
+
+#ifdef THE_LINUX
+    epoll_event ev;
+    ::memset(&ev, 0, sizeof(epoll_event));
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.ptr = h;
+    if (::epoll_ctl(this->epoll_fd, EPOLL_CTL_ADD, h->get_reactor_handle(), &ev) != 0) {
+        this->handlers.erase(h);
+        throw the::exception("Unable to register socket with epoll", __FILE__, __LINE__);
+    }
+#endif /* THE_LINUX */
+}
+
+
+/*
+ * ip_reactor::set_write_interest
+ */
+void ip_reactor::set_write_interest(handler *h) {
+    auto_lock<critical_section> lock(this->lock_obj);
+    std::map<handler *, entry>::iterator e = this->handlers.find(h);
+    if ((e == this->handlers.end()) || e->second.want_write) return;
+    e->second.want_write = true;
+    if (!e->second.busy) {
+        // otherwise rearmed when the I/O thread is done with the handler
+        this->rearm(h, e->second);
+    }
+}
+
+
+/*
+ * ip_reactor::set_deadline
+ */
+void ip_reactor::set_deadline(handler *h, double deadline) {
+    auto_lock<critical_section> lock(this->lock_obj);
+    std::map<handler *, entry>::iterator e = this->handlers.find(h);
+    if (e == this->handlers.end()) return;
+    if ((e->second.deadline == 0.0) && (deadline != 0.0)) {
+        this->deadline_cnt++;
+    } else if ((e->second.deadline != 0.0) && (deadline == 0.0)) {
+        this->deadline_cnt--;
+    }
+    e->second.deadline = deadline;
+    this->update_timer();
+}
+
+
+/*
+ * ip_reactor::count
+ */
+size_t ip_reactor::count(void) {
+    auto_lock<critical_section> lock(this->lock_obj);
+    return this->handlers.size();
+}
+
+
+/*
+ * ip_reactor::io_worker::io_worker
+ */
+ip_reactor::io_worker::io_worker(ip_reactor& owner) : runnable(), owner(owner) {
+    // intentionally empty
+}
+
+
+/*
+ * ip_reactor::io_worker::~io_worker
+ */
+ip_reactor::io_worker::~io_worker(void) {
+    // intentionally empty
+}
+
+
+/*
+ * ip_reactor::io_worker::run
+ */
+int ip_reactor::io_worker::run(void) {
+    return this->owner.run_io();
+}
+
+
+/*
+ * ip_reactor::io_worker::on_thread_terminating
+ */
+thread::termination_behaviour ip_reactor::io_worker::on_thread_terminating(void) throw() {
+    return thread::termination_behaviour::graceful;
+}
+
+
+/*
+ * ip_reactor::ip_reactor
+ */
+ip_reactor::ip_reactor(void) : threads(), workers(), handlers(), lock_obj(),
+        terminating(false), deadline_cnt(0), last_deadline_check(0.0)
+#ifdef THE_LINUX
+        , epoll_fd(-1), wakeup_fd(-1), timer_fd(-1), timer_armed(false)
+#endif /* THE_LINUX */
+        {
+    vislib::net::Socket::Startup();
+#ifdef THE_LINUX
+    this->epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+    this->wakeup_fd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if ((this->epoll_fd >= 0) && (this->wakeup_fd >= 0)) {
+        // level triggered and never read, so all threads wake up on stop
+        epoll_event ev;
+        ::memset(&ev, 0, sizeof(epoll_event));
+        ev.events = EPOLLIN;
+        ev.data.ptr = nullptr;
+        ::epoll_ctl(this->epoll_fd, EPOLL_CTL_ADD, this->wakeup_fd, &ev);
+    }
+    this->timer_fd = ::timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if ((this->epoll_fd >= 0) && (this->timer_fd >= 0)) {
+        // one shot, so only one thread checks the deadlines per tick
+        epoll_event ev;
+        ::memset(&ev, 0, sizeof(epoll_event));
+        ev.events = EPOLLIN | EPOLLONESHOT;
+        ev.data.ptr = this;
+        ::epoll_ctl(this->epoll_fd, EPOLL_CTL_ADD, this->timer_fd, &ev);
+    }
+#endif /* THE_LINUX */
+}
+
+
+/*
+ * ip_reactor::~ip_reactor
+ */
+ip_reactor::~ip_reactor(void) {
+    this->stop();
+#ifdef THE_LINUX
+    if (this->timer_fd >= 0) ::close(this->timer_fd);
+    if (this->wakeup_fd >= 0) ::close(this->wakeup_fd);
+    if (this->epoll_fd >= 0) ::close(this->epoll_fd);
+#endif /* THE_LINUX */
+    vislib::net::Socket::Cleanup();
+}
+
+
+/*
+ * ip_reactor::assert_started
+ */
+void ip_reactor::assert_started(void) {
+    if (!this->threads.empty()) return;
+#ifdef THE_LINUX
+    if ((this->epoll_fd < 0) || (this->wakeup_fd < 0) || (this->timer_fd < 0)) {
+        throw the::exception("Unable to create epoll instance", __FILE__, __LINE__);
+    }
+#endif /* THE_LINUX */
+    for (unsigned int i = 0; i < thread_count; ++i) {
+        io_worker *w = new io_worker(*this);
+        thread *t = new thread(w);
+        this->workers.push_back(w);
+        this->threads.push_back(t);
+        t->start();
+    }
+}
+
+
+/*
+ * ip_reactor::stop
+ */
+void ip_reactor::stop(void) {
+    this->lock_obj.lock();
+    this->terminating = true;
+    this->lock_obj.unlock();
+
+    this->wake_all();
+
+    for (size_t i = 0, cnt = this->threads.size(); i < cnt; ++i) {
+        if (this->threads[i]->is_running()) {
+            this->threads[i]->join();
+        }
+        the::safe_delete(this->threads[i]);
+        the::safe_delete(this->workers[i]);
+    }
+    this->threads.clear();
+    this->workers.clear();
+
+    while (true) {
+        handler *h = nullptr;
+        this->lock_obj.lock();
+        if (!this->handlers.empty()) h = this->handlers.begin()->first;
+        this->lock_obj.unlock();
+        if (h == nullptr) break;
+        this->remove(h);
+    }
+}
+
+
+/*
+ * ip_reactor::run_io
+ */
+int ip_reactor::run_io(void) {
+#ifdef THE_LINUX
+    epoll_event ev;
+
+    while (!this->terminating) {
+        int n = ::epoll_wait(this->epoll_fd, &ev, 1, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if ((n == 0) || (ev.data.ptr == nullptr)) continue; // wakeup
+
+        if (ev.data.ptr == this) {
+            // deadline timer tick
+            uint64_t ticks;
+            if (::read(this->timer_fd, &ticks, sizeof(uint64_t)) < 0) {
+                // timer disarmed meanwhile
+            }
+            this->expire_deadlines();
+            ev.events = EPOLLIN | EPOLLONESHOT;
+            ::epoll_ctl(this->epoll_fd, EPOLL_CTL_MOD, this->timer_fd, &ev);
+            continue;
+        }
+
+        unsigned int events = 0;
+        if ((ev.events & (EPOLLIN | EPOLLERR | EPOLLHUP)) != 0) events |= event_read;
+        if ((ev.events & EPOLLOUT) != 0) events |= event_write;
+        this->dispatch(static_cast<handler*>(ev.data.ptr), events);
+    }
+
+#else /* THE_LINUX */
+    const long select_timeout = 50; // milliseconds
+    std::vector<handler *> hs;
+
+    while (!this->terminating) {
+        double now = the::system::performance_counter::query_millis();
+        if (now - this->last_deadline_check >= deadline_check_interval) {
+            this->last_deadline_check = now;
+            this->expire_deadlines();
+        }
+
+        fd_set rfds, wfds;
+        FD_ZERO(&rfds);
+        FD_ZERO(&wfds);
+        SOCKET max_fd = 0;
+        hs.clear();
+
+        this->lock_obj.lock();
+        for (std::map<handler *, entry>::iterator i = this->handlers.begin();
+                (i != this->handlers.end()) && (hs.size() < FD_SETSIZE); ++i) {
+            if (i->second.busy) continue;
+            SOCKET s = i->first->get_reactor_handle();
+            FD_SET(s, &rfds);
+            if (i->second.want_write) FD_SET(s, &wfds);
+            if (s > max_fd) max_fd = s;
+            hs.push_back(i->first);
+        }
+        this->lock_obj.unlock();
+
+        if (hs.empty()) {
+            thread::sleep(select_timeout);
+            continue;
+        }
+
+        timeval tv;
+        tv.tv_sec = 0;
+        tv.tv_usec = select_timeout * 1000;
+        if (::select(static_cast<int>(max_fd + 1), &rfds, &wfds, nullptr, &tv) <= 0) continue;
+
+        for (size_t i = 0, cnt = hs.size(); i < cnt; ++i) {
+            SOCKET s = hs[i]->get_reactor_handle();
+            unsigned int events = 0;
+            if (FD_ISSET(s, &rfds)) events |= event_read;
+            if (FD_ISSET(s, &wfds)) events |= event_write;
+            if (events != 0) this->dispatch(hs[i], events);
+        }
+    }
+
+#endif /* THE_LINUX */
+    return 0;
+}
+
+
+/*
+ * ip_reactor::dispatch
+ */
+void ip_reactor::dispatch(handler *h, unsigned int events) {
+
+    // claim the handler, another thread might handle it already
+    this->lock_obj.lock();
+    std::map<handler *, entry>::iterator e = this->handlers.find(h);
+    if (e == this->handlers.end()) {
+        this->lock_obj.unlock();
+        return;
+    }
+    if (e->second.busy) {
+        e->second.pending |= events;
+        this->lock_obj.unlock();
+        return;
+    }
+    e->second.busy = true;
+    if ((events & event_write) != 0) e->second.want_write = false;
+    this->lock_obj.unlock();
+
+    while (true) {
+        bool keep = true;
+        try {
+            if ((events & event_read) != 0) keep = h->on_readable();
+            if (keep && ((events & event_write) != 0)) keep = h->on_writable();
+        } catch(...) {
+            keep = false;
+        }
+
+        if (!keep) break;
+        if (this->terminating) return; // 'stop' closes the handler
+
+        auto_lock<critical_section> lock(this->lock_obj);
+        e = this->handlers.find(h);
+        THE_ASSERT(e != this->handlers.end());
+        events = e->second.pending;
+        e->second.pending = 0;
+        if ((events & event_write) != 0) e->second.want_write = false;
+        if (events == 0) {
+            e->second.busy = false;
+            this->rearm(h, e->second);
+            return;
+        }
+    }
+
+    this->remove(h);
+}
+
+
+/*
+ * ip_reactor::rearm
+ */
+void ip_reactor::rearm(handler *h, entry& e) {
+#ifdef THE_LINUX
+    epoll_event ev;
+    ::memset(&ev, 0, sizeof(epoll_event));
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    if (e.want_write) ev.events |= static_cast<uint32_t>(EPOLLOUT);
+    ev.data.ptr = h;
+    ::epoll_ctl(this->epoll_fd, EPOLL_CTL_MOD, h->get_reactor_handle(), &ev);
+#endif /* THE_LINUX */
+    // the select fallback collects all handlers which are not busy
+}
+
+
+/*
+ * ip_reactor::remove
+ */
+void ip_reactor::remove(handler *h) {
+    api_ptr_base keep_alive;
+
+    this->lock_obj.lock();
+    std::map<handler *, entry>::iterator e = this->handlers.find(h);
+    if (e == this->handlers.end()) {
+        this->lock_obj.unlock();
+        return;
+    }
+    keep_alive = e->second.keep_alive;
+    if (e->second.deadline != 0.0) {
+        this->deadline_cnt--;
+        this->update_timer();
+    }
+#ifdef THE_LINUX
+    // the handler closes its socket after the removal, and the descriptor
+    // might be reused by a new connection right away
+    ::epoll_ctl(this->epoll_fd, EPOLL_CTL_DEL, h->get_reactor_handle(), nullptr);
+#endif /* THE_LINUX */
+    this->handlers.erase(e);
+    this->lock_obj.unlock();
+
+    try {
+        h->on_reactor_closed();
+    } catch(...) {
+    }
+    // 'keep_alive' is released here, which might delete the handler
+}
+
+
+/*
+ * ip_reactor::update_timer
+ */
+void ip_reactor::update_timer(void) {
+#ifdef THE_LINUX
+    // the timer only runs while deadlines are pending
+    bool armed = (this->deadline_cnt > 0);
+    if (armed == this->timer_armed) return;
+    itimerspec ts;
+    ::memset(&ts, 0, sizeof(itimerspec));
+    if (armed) {
+        ts.it_interval.tv_nsec = deadline_check_interval * 1000000L;
+        ts.it_value = ts.it_interval;
+    }
+    ::timerfd_settime(this->timer_fd, 0, &ts, nullptr);
+    this->timer_armed = armed;
+#endif /* THE_LINUX */
+    // the select fallback checks the deadlines with its timeout
+}
+
+
+/*
+ * ip_reactor::expire_deadlines
+ */
+void ip_reactor::expire_deadlines(void) {
+    std::vector<handler *> expired;
+    double now = the::system::performance_counter::query_millis();
+
+    this->lock_obj.lock();
+    if (this->deadline_cnt > 0) {
+        for (std::map<handler *, entry>::iterator i = this->handlers.begin();
+                i != this->handlers.end(); ++i) {
+            if (i->second.busy || (i->second.deadline == 0.0) || (i->second.deadline > now)) continue;
+            // claim the handler, so no I/O thread calls it any more
+            i->second.busy = true;
+            expired.push_back(i->first);
+        }
+    }
+    this->lock_obj.unlock();
+
+    for (size_t i = 0, cnt = expired.size(); i < cnt; ++i) {
+        try {
+            expired[i]->on_reactor_timeout();
+        } catch(...) {
+        }
+        this->remove(expired[i]);
+    }
+}
+
+
+/*
+ * ip_reactor::wake_all
+ */
+void ip_reactor::wake_all(void) {
+#ifdef THE_LINUX
+    if (this->wakeup_fd >= 0) {
+        uint64_t one = 1;
+        if (::write(this->wakeup_fd, &one, sizeof(uint64_t)) < 0) {
+            // counter overflow only; the fd is readable anyway
+        }
+    }
+#endif /* THE_LINUX */
+    // the select fallback polls 'terminating' with its timeout
+}
@@ -0,0 +1,316 @@
+/*
+ * rivlib
+ * ip_reactor.h
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+
+#ifndef VICCI_RIVLIB_IP_REACTOR_H_INCLUDED
+#define VICCI_RIVLIB_IP_REACTOR_H_INCLUDED
+#if (defined(_MSC_VER) && (_MSC_VER > 1000))
+#pragma once
+#endif /* (defined(_MSC_VER) && (_MSC_VER > 1000)) */
+
+#include "rivlib/api_ptr_base.h"
+#include "the/config.h"
+#include "the/system/threading/critical_section.h"
+#include "the/system/threading/runnable.h"
+#include "the/system/threading/thread.h"
+#include "vislib/Socket.h"
+#include <map>
+#include <vector>
+
+
+namespace eu_vicci {
+namespace rivlib {
+
+
+    /**
+     * Event-driven dispatcher for socket I/O.
+     *
+     * A small fixed set of I/O threads waits for incoming data on all
+     * registered sockets (epoll on Linux, select elsewhere) and calls the
+     * handler of a socket when data is available, or when the socket became
+     * writable and the handler asked for it. A handler is never called
+     * concurrently by more than one I/O thread. All ip_connections of the
+     * process share the single instance of this class.
+     *
+     * A handler may set a deadline. If the deadline passes while the handler
+     * is idle, the handler is told so and removed from the reactor.
+     */
+    class ip_reactor {
+    public:
+
+        /**
+         * Interface of objects handling socket input
+         */
+        class handler {
+        public:
+
+            /** dtor */
+            virtual ~handler(void);
+
+            /**
+             * Answer the socket handle to be watched. The socket must be
+             * non-blocking, because more than one I/O thread may report it
+             * ready and the data may be gone when the handler is called.
+             *
+             * @return The socket handle
+             */
+            virtual SOCKET get_reactor_handle(void) = 0;
+
+            /**
+             * Called when data might be available on the socket. The handler
+             * should not read more than once from the socket, to be fair to
+             * the other handlers.
+             *
+             * @return False if the handler should be removed from the reactor
+             */
+            virtual bool on_readable(void) = 0;
+
+            /**
+             * Called when the socket became writable after the handler
+             * requested it using 'set_write_interest'. The interest is
+             * cleared before the call.
+             *
+             * @return False if the handler should be removed from the reactor
+             */
+            virtual bool on_writable(void) = 0;
+
+            /**
+             * Called when the deadline of the handler passed, right before
+             * the handler is removed from the reactor
+             */
+            virtual void on_reactor_timeout(void) = 0;
+
+            /**
+             * Called after the handler has been removed from the reactor
+             */
+            virtual void on_reactor_closed(void) = 0;
+
+        protected:
+
+            /** ctor */
+            handler(void);
+
+        };
+
+        /** The number of I/O threads */
+        static const unsigned int thread_count = 4;
+
+        /**
+         * Answer the only instance of the class
+         *
+         * @return The only instance of the class
+         */
+        static ip_reactor& instance(void);
+
+        /**
+         * Registers a handler. The I/O threads are started on demand.
+         *
+         * @param h The handler
+         * @param keep_alive Reference keeping the handler alive while it is registered
+         */
+        void add(handler *h, api_ptr_base keep_alive);
+
+        /**
+         * Requests 'on_writable' to be called when the socket of the handler
+         * becomes writable. May be called from any thread.
+         *
+         * @param h The handler
+         */
+        void set_write_interest(handler *h);
+
+        /**
+         * Sets or clears the deadline of a handler. May be called from any
+         * thread. Deadlines are checked every 'deadline_check_interval'
+         * milliseconds.
+         *
+         * @param h The handler
+         * @param deadline The deadline in performance counter milliseconds,
+         *                 or zero to clear the deadline
+         */
+        void set_deadline(handler *h, double deadline);
+
+        /**
+         * Answer the number of registered handlers
+         *
+         * @return The number of registered handlers
+         */
+        size_t count(void);
+
+    private:
+
+        /** Utility runnable class for the I/O threads */
+        class io_worker : public the::system::threading::runnable {
+        public:
+
+            /**
+             * ctor
+             *
+             * @param owner The owning reactor
+             */
+            io_worker(ip_reactor& owner);
+
+            /** dtor */
+            virtual ~io_worker(void);
+
+            /**
+             * Perform the work of a thread.
+             *
+             * @return The application dependent return code of the thread. This 
+             *         must not be STILL_ACTIVE (259).
+             */
+            virtual int run(void);
+
+            /**
+             * Requests the runnable to be terminated
+             *
+             * @return graceful
+             */
+            virtual the::system::threading::thread::termination_behaviour on_thread_terminating(void) throw();
+
+        private:
+
+            /** The owning reactor */
+            ip_reactor& owner;
+
+        };
+
+        /** Registration data of a handler */
+        typedef struct _entry_t {
+
+            /** Reference keeping the handler alive */
+            api_ptr_base keep_alive;
+
+            /** Flag whether an I/O thread currently calls the handler */
+            bool busy;
+
+            /** Flag whether the handler waits for the socket to become writable */
+            bool want_write;
+
+            /** The events which occurred while the handler was busy */
+            unsigned int pending;
+
+            /** The deadline in performance counter milliseconds or zero */
+            double deadline;
+
+        } entry;
+
+        /** The interval in which deadlines are checked in milliseconds */
+        static const unsigned int deadline_check_interval = 100;
+
+        /** ctor */
+        ip_reactor(void);
+
+        /** dtor */
+        ~ip_reactor(void);
+
+        /**
+         * Starts the I/O threads if they are not running. The caller must
+         * hold 'lock_obj'.
+         */
+        void assert_started(void);
+
+        /**
+         * Stops the I/O threads and closes all registered handlers
+         */
+        void stop(void);
+
+        /**
+         * The I/O thread function
+         *
+         * @return 0
+         */
+        int run_io(void);
+
+        /** Event flag for readable sockets */
+        static const unsigned int event_read = 1;
+
+        /** Event flag for writable sockets */
+        static const unsigned int event_write = 2;
+
+        /**
+         * Calls the handler and rearms or removes it afterwards
+         *
+         * @param h The handler
+         * @param events The events which occurred
+         */
+        void dispatch(handler *h, unsigned int events);
+
+        /**
+         * Rearms the handler with the events it is interested in. The caller
+         * must hold 'lock_obj'.
+         *
+         * @param h The handler
+         * @param e The registration data of the handler
+         */
+        void rearm(handler *h, entry& e);
+
+        /**
+         * Removes a handler and calls its 'on_reactor_closed'
+         *
+         * @param h The handler
+         */
+        void remove(handler *h);
+
+        /**
+         * Starts or stops the deadline timer depending on whether deadlines
+         * are pending. The caller must hold 'lock_obj'.
+         */
+        void update_timer(void);
+
+        /**
+         * Removes all idle handlers whose deadline passed
+         */
+        void expire_deadlines(void);
+
+        /**
+         * Wakes up all I/O threads
+         */
+        void wake_all(void);
+
+        /** The I/O threads */
+        std::vector<the::system::threading::thread *> threads;
+
+        /** The runnables of the I/O threads */
+        std::vector<io_worker *> workers;
+
+        /** The registered handlers */
+        std::map<handler *, entry> handlers;
+
+        /** The lock for 'handlers' */
+        the::system::threading::critical_section lock_obj;
+
+        /** Flag that the I/O threads should terminate */
+        volatile bool terminating;
+
+        /** The number of handlers with a deadline */
+        size_t deadline_cnt;
+
+        /** The time the select fallback checked the deadlines last in performance counter milliseconds */
+        double last_deadline_check;
+
+#ifdef THE_LINUX
+        /** The epoll instance */
+        int epoll_fd;
+
+        /** The event file descriptor used to wake up the I/O threads */
+        int wakeup_fd;
+
+        /** The periodic timer file descriptor triggering the deadline checks */
+        int timer_fd;
+
+        /** Flag whether 'timer_fd' is running */
+        bool timer_armed;
+#endif /* THE_LINUX */
+
+    };
+
+
+} /* end namespace rivlib */
+} /* end namespace eu_vicci */
+
+
+#endif /* VICCI_RIVLIB_IP_REACTOR_H_INCLUDED */
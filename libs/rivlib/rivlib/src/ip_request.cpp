@@ -0,0 +1,178 @@
+/*
+ * ip_request.cpp
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+#include "stdafx.h"
+#include "ip_request.h"
+#include "message_image_request.h"
+#include "the/exception.h"
+#include "the/math/functions.h"
+#include "the/string.h"
+#include "the/text/string_utility.h"
+#include <sstream>
+
+using namespace eu_vicci::rivlib;
+
+
+/*
+ * ip_request::hello_request
+ */
+const char *const ip_request::hello_request = "/#riv-hello";
+
+
+/*
+ * ip_request::make_hello
+ */
+void ip_request::make_hello(ip_hello& hello, uint32_t max_message_size) {
+    ::memset(&hello, 0, sizeof(ip_hello));
+    hello.version = ip_protocol_version;
+    hello.size = static_cast<uint16_t>(sizeof(ip_hello));
+    hello.capabilities = static_cast<uint32_t>(ip_capability::binary_request)
+        | static_cast<uint32_t>(ip_capability::request_window)
+        | static_cast<uint32_t>(ip_capability::regions_of_interest)
+        | static_cast<uint32_t>(ip_capability::shared_memory)
+        | static_cast<uint32_t>(ip_capability::multicast)
+        | static_cast<uint32_t>(ip_capability::rate_limit)
+        | static_cast<uint32_t>(ip_capability::message_batch)
+        | static_cast<uint32_t>(ip_capability::metrics);
+    hello.image_stream_subtypes
+        = (1u << static_cast<uint16_t>(data_channel_image_stream_subtype::rgb_raw))
+        | (1u << static_cast<uint16_t>(data_channel_image_stream_subtype::rgb_zip))
+#if(USE_MJPEG == 1)
+        | (1u << static_cast<uint16_t>(data_channel_image_stream_subtype::rgb_mjpeg))
+#endif
+        | (1u << static_cast<uint16_t>(data_channel_image_stream_subtype::rgb_progressive));
+    hello.max_request_window = static_cast<uint16_t>(max_image_request_window);
+    hello.max_regions_of_interest = static_cast<uint16_t>(max_image_regions_of_interest);
+    hello.max_message_size = max_message_size;
+}
+
+
+/*
+ * ip_request::read_hello
+ */
+void ip_request::read_hello(const void *data, size_t size, ip_hello& hello) {
+    ::memset(&hello, 0, sizeof(ip_hello));
+    ::memcpy(&hello, data, the::math::minimum(size, sizeof(ip_hello)));
+}
+
+
+/*
+ * ip_request::ip_request
+ */
+ip_request::ip_request(void) : path(), data_channel(false), name(0), type(0),
+        subtype(0), multicast_group(), shm(false), max_fps(0), max_rate(0),
+        found(0) {
+    // intentionally empty
+}
+
+
+/*
+ * ip_request::~ip_request
+ */
+ip_request::~ip_request(void) {
+    // intentionally empty
+}
+
+
+/*
+ * ip_request::parse_query
+ */
+bool ip_request::parse_query(const std::string& query) {
+    using the::text::string_utility;
+    std::stringstream stream(query);
+    std::string q;
+    bool known = true;
+
+    this->data_channel = true;
+    while (std::getline(stream, q, '&')) {
+        if (string_utility::starts_with(q, "n=")) {
+            unsigned char buf[sizeof(uintptr_t)];
+            uintptr_t n;
+            string_utility::from_hex_string(buf, sizeof(uintptr_t), q.substr(2));
+            ::memcpy(&n, buf, sizeof(uintptr_t));
+            this->name = static_cast<uint64_t>(n);
+            this->found |= 1;
+        } else if (string_utility::starts_with(q, "t=")) {
+            this->type = static_cast<uint16_t>(string_utility::parse_int(q.c_str() + 2));
+            this->found |= 2;
+        } else if (string_utility::starts_with(q, "s=")) {
+            this->subtype = static_cast<uint16_t>(string_utility::parse_int(q.c_str() + 2));
+            this->found |= 4;
+        } else if (string_utility::starts_with(q, "l=")) {
+            // optional shared memory transport for same-host clients
+            this->shm = (string_utility::parse_int(q.c_str() + 2) != 0);
+        } else if (string_utility::starts_with(q, "m=")) {
+            // optional multicast group "address:port"
+            this->multicast_group = q.substr(2);
+        } else if (string_utility::starts_with(q, "f=")) {
+            // optional maximum frame rate
+            this->max_fps = string_utility::parse_int(q.c_str() + 2);
+        } else if (string_utility::starts_with(q, "r=")) {
+            // optional maximum egress rate in bytes per second
+            this->max_rate = 0;
+            std::istringstream(q.substr(2)) >> this->max_rate;
+        } else if (!q.empty()) {
+            known = false;
+        }
+    }
+
+    return known;
+}
+
+
+/*
+ * ip_request::encode
+ */
+size_t ip_request::encode(the::blob& out) const {
+    header h;
+    ::memset(&h, 0, sizeof(header));
+    h.name = this->name;
+    h.max_rate = this->max_rate;
+    h.max_fps = static_cast<int32_t>(this->max_fps);
+    h.type = this->type;
+    h.subtype = this->subtype;
+    h.path_len = static_cast<uint16_t>(the::math::minimum<size_t>(this->path.size(), UINT16_MAX));
+    h.group_len = static_cast<uint16_t>(the::math::minimum<size_t>(this->multicast_group.size(), UINT16_MAX));
+    h.data_channel = this->data_channel ? 1 : 0;
+    h.shm = this->shm ? 1 : 0;
+
+    uint32_t len = static_cast<uint32_t>(sizeof(header) + h.path_len + h.group_len);
+    out.assert_size(sizeof(uint32_t) + len);
+    *out.as_at<uint32_t>(0) = len | binary_flag;
+    ::memcpy(out.at(sizeof(uint32_t)), &h, sizeof(header));
+    ::memcpy(out.at(sizeof(uint32_t) + sizeof(header)), this->path.c_str(), h.path_len);
+    ::memcpy(out.at(sizeof(uint32_t) + sizeof(header) + h.path_len),
+        this->multicast_group.c_str(), h.group_len);
+
+    return sizeof(uint32_t) + len;
+}
+
+
+/*
+ * ip_request::decode
+ */
+void ip_request::decode(const void *data, size_t size) {
+    header h;
+    if (size < sizeof(header)) {
+        throw the::exception("Binary request truncated", __FILE__, __LINE__);
+    }
+    ::memcpy(&h, data, sizeof(header));
+    if (size != sizeof(header) + h.path_len + h.group_len) {
+        throw the::exception("Binary request size mismatch", __FILE__, __LINE__);
+    }
+
+    const char *str = static_cast<const char*>(data) + sizeof(header);
+    this->path.assign(str, h.path_len);
+    this->multicast_group.assign(str + h.path_len, h.group_len);
+    this->data_channel = (h.data_channel != 0);
+    this->name = h.name;
+    this->type = h.type;
+    this->subtype = h.subtype;
+    this->shm = (h.shm != 0);
+    this->max_fps = static_cast<int>(h.max_fps);
+    this->max_rate = h.max_rate;
+    this->found = this->data_channel ? 7 : 0;
+}
@@ -0,0 +1,190 @@
+/*
+ * ip_request.h
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+
+#ifndef VICCI_RIVLIB_IP_REQUEST_H_INCLUDED
+#define VICCI_RIVLIB_IP_REQUEST_H_INCLUDED
+#if (defined(_MSC_VER) && (_MSC_VER > 1000))
+#pragma once
+#endif /* (defined(_MSC_VER) && (_MSC_VER > 1000)) */
+
+#include "the/config.h"
+#include "the/types.h"
+#include "the/blob.h"
+#include "rivlib/ip_utilities.h"
+#include <string>
+
+
+namespace eu_vicci {
+namespace rivlib {
+
+    /**
+     * The initial request of a connection to an ip_communicator.
+     *
+     * The request is sent by the client as 32-bit length followed by either
+     * the request uri string ("path?query") or, if 'binary_flag' is set in
+     * the length, by the binary encoding 'ip_request::header' followed by the
+     * path and the multicast group. The binary encoding saves the server
+     * from parsing and decoding the uri; clients only use it if the server
+     * negotiated 'ip_capability::binary_request' in its 'ip_hello', since
+     * older servers would take the flag for a part of the length. The
+     * request 'hello_request' followed by a zero byte and an 'ip_hello'
+     * starts the negotiation described at 'ip_hello'.
+     */
+    class ip_request {
+    public:
+
+        /** Flag in the request length marking a binary request */
+        static const uint32_t binary_flag = 0x80000000u;
+
+        /** The string request of the hello probe */
+        static const char *const hello_request;
+
+        /** The answer of servers accepting the hello probe */
+        static const unsigned short hello_answer = 101;
+
+        /** The largest message body accepted by servers in bytes */
+        static const uint32_t max_message_size = 0x4000000;
+
+        /**
+         * Fills the hello announcing the capabilities and limits of this
+         * library
+         *
+         * @param hello Receives the hello
+         * @param max_message_size The largest message body accepted (0 for unlimited)
+         */
+        static void make_hello(ip_hello& hello, uint32_t max_message_size);
+
+        /**
+         * Reads the hello of a peer, which might be shorter or longer than
+         * 'ip_hello'. Missing fields are zero.
+         *
+         * @param data The hello without the leading length
+         * @param size The number of bytes in 'data'
+         * @param hello Receives the hello
+         */
+        static void read_hello(const void *data, size_t size, ip_hello& hello);
+
+        /** The fixed-size part of a binary request */
+        typedef struct _header_t {
+
+            /** The name of the data channel */
+            uint64_t name;
+
+            /** The maximum egress rate in bytes per second (0 for unlimited) */
+            uint64_t max_rate;
+
+            /** The maximum frame rate (0 for unlimited) */
+            int32_t max_fps;
+
+            /** The data channel type */
+            uint16_t type;
+
+            /** The data channel subtype */
+            uint16_t subtype;
+
+            /** The number of bytes of the path */
+            uint16_t path_len;
+
+            /** The number of bytes of the multicast group */
+            uint16_t group_len;
+
+            /** Non-zero for data channel requests */
+            uint8_t data_channel;
+
+            /** Non-zero if images should be passed through shared memory */
+            uint8_t shm;
+
+            /** Reserved for future use; always zero */
+            uint8_t reserved[2];
+
+        } header;
+
+        /** ctor */
+        ip_request(void);
+
+        /** dtor */
+        ~ip_request(void);
+
+        /**
+         * Parses the (decoded) query of a data channel request
+         *
+         * @param query The query
+         *
+         * @return False if the query contains keys not representable in the
+         *         binary encoding
+         */
+        bool parse_query(const std::string& query);
+
+        /**
+         * Answer whether the data channel request names the data channel,
+         * its type and subtype
+         *
+         * @return True if the data channel request is complete
+         */
+        inline bool is_complete(void) const {
+            return (this->found & 7) == 7;
+        }
+
+        /**
+         * Encodes the request in the binary encoding, including the leading
+         * length
+         *
+         * @param out Receives the encoded request
+         *
+         * @return The number of bytes in 'out'
+         */
+        size_t encode(the::blob& out) const;
+
+        /**
+         * Decodes a binary request
+         *
+         * @param data The request without the leading length
+         * @param size The number of bytes in 'data'
+         *
+         * @throws the::exception if the request is malformed
+         */
+        void decode(const void *data, size_t size);
+
+        /** The path to the provider */
+        std::string path;
+
+        /** Flag whether this is a data channel request */
+        bool data_channel;
+
+        /** The name of the data channel */
+        uint64_t name;
+
+        /** The data channel type */
+        uint16_t type;
+
+        /** The data channel subtype */
+        uint16_t subtype;
+
+        /** The multicast group "address:port" or empty */
+        std::string multicast_group;
+
+        /** Flag whether images should be passed through shared memory */
+        bool shm;
+
+        /** The maximum frame rate (0 for unlimited) */
+        int max_fps;
+
+        /** The maximum egress rate in bytes per second (0 for unlimited) */
+        uint64_t max_rate;
+
+    private:
+
+        /** Flags of the found keys (1 name, 2 type, 4 subtype) */
+        unsigned int found;
+
+    };
+
+
+} /* end namespace rivlib */
+} /* end namespace eu_vicci */
+
+#endif /* VICCI_RIVLIB_IP_REQUEST_H_INCLUDED */
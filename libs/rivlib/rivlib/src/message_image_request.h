@@ -16,6 +16,22 @@ namespace rivlib {
 
     /**
      * Message sent to request an image frame from an image stream
+     *
+     * id 0: close the stream
+     * id 1: (re)start the stream, 'time_code' must be 0x12345678
+     * id 2: request the next image newer than 'time_code'
+     * id 3: set the regions of interest, 'time_code' is the number of
+     *       image_region structs following the message (0 clears them)
+     * id 4: set the request window, 'time_code' is the number of images
+     *       the server may send ahead of the requests (default 1)
+     * id 5: release the shared memory slot 'time_code' after the image
+     *       stored in it has been processed
+     * id 6: answer an 'image_data_shm_ring' message, 'time_code' is the
+     *       number of rings announced so far if the client opened the
+     *       ring, or 0 if it could not (the images are then sent in-band)
+     *
+     * Each image sent consumes one credit and each id 2 message grants one
+     * more credit, up to the request window.
      */
 #ifdef THE_WINDOWS
 #pragma pack(push)
@@ -41,5 +57,12 @@ namespace rivlib {
 #endif /* THE_WINDOWS */
 
 
+    /** The maximum number of regions of interest of an image stream */
+    const uint32_t max_image_regions_of_interest = 64;
+
+    /** The maximum request window of an image stream */
+    const uint32_t max_image_request_window = 32;
+
+
 } /* end namespace rivlib */
 } /* end namespace eu_vicci */
@@ -0,0 +1,239 @@
+/*
+ * message_inbox.cpp
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+#include "stdafx.h"
+#include "message_inbox.h"
+#include "the/memory.h"
+#include "the/system/threading/auto_lock.h"
+
+using namespace eu_vicci::rivlib;
+using namespace the::system::threading;
+
+
+/*
+ * message_inbox::message_inbox
+ */
+message_inbox::message_inbox(target_delegate target) : target(target),
+        delivery(provider::message_delivery::immediate), capacity(0),
+        overflow(provider::inbox_overflow::drop_oldest), queue(), lock_obj(),
+        deliver_lock(), queued_event(), terminating(false), worker(nullptr),
+        worker_thread(nullptr) {
+    // intentionally empty
+}
+
+
+/*
+ * message_inbox::~message_inbox
+ */
+message_inbox::~message_inbox(void) {
+    this->stop();
+}
+
+
+/*
+ * message_inbox::configure
+ */
+void message_inbox::configure(provider::message_delivery delivery, unsigned int capacity,
+        provider::inbox_overflow overflow) {
+    std::deque<message> batch;
+
+    if (delivery != provider::message_delivery::dispatcher_thread) {
+        this->stop_dispatcher();
+    }
+
+    {
+        auto_lock<critical_section> lock(this->lock_obj);
+        this->delivery = delivery;
+        this->capacity = (capacity > 0) ? capacity : 1;
+        this->overflow = overflow;
+        while (this->queue.size() > this->capacity) {
+            this->queue.pop_front();
+        }
+        if (delivery == provider::message_delivery::immediate) {
+            this->take_batch(batch, 0);
+        }
+
+        if ((delivery == provider::message_delivery::dispatcher_thread)
+                && (this->worker_thread == nullptr)) {
+            this->terminating = false;
+            this->worker = new dispatcher(*this);
+            this->worker_thread = new thread(this->worker);
+            this->worker_thread->start();
+            if (!this->queue.empty()) this->queued_event.set();
+        }
+    }
+
+    this->deliver(batch);
+}
+
+
+/*
+ * message_inbox::push
+ */
+void message_inbox::push(unsigned int id, unsigned int size, const char *data) {
+    {
+        auto_lock<critical_section> lock(this->lock_obj);
+        if (this->delivery != provider::message_delivery::immediate) {
+            if (this->queue.size() >= this->capacity) {
+                if (this->overflow == provider::inbox_overflow::drop_newest) return;
+                this->queue.pop_front();
+            }
+
+            this->queue.push_back(message());
+            message& m = this->queue.back();
+            m.id = id;
+            m.size = size;
+            if (size > 0) {
+                m.data.enforce_size(size);
+                ::memcpy(m.data, data, size);
+            }
+
+            if (this->delivery == provider::message_delivery::dispatcher_thread) {
+                this->queued_event.set();
+            }
+            return;
+        }
+    }
+
+    // concurrent calls are allowed in this mode
+    this->target(id, size, data);
+}
+
+
+/*
+ * message_inbox::poll
+ */
+unsigned int message_inbox::poll(unsigned int max_count) {
+    std::deque<message> batch;
+    {
+        auto_lock<critical_section> lock(this->lock_obj);
+        if (this->delivery != provider::message_delivery::poll) return 0;
+        this->take_batch(batch, max_count);
+    }
+    unsigned int cnt = static_cast<unsigned int>(batch.size());
+    this->deliver(batch);
+    return cnt;
+}
+
+
+/*
+ * message_inbox::stop
+ */
+void message_inbox::stop(void) {
+    this->stop_dispatcher();
+    auto_lock<critical_section> lock(this->lock_obj);
+    this->delivery = provider::message_delivery::immediate;
+    this->queue.clear();
+}
+
+
+/*
+ * message_inbox::dispatcher::dispatcher
+ */
+message_inbox::dispatcher::dispatcher(message_inbox& owner) : runnable(), owner(owner) {
+    // intentionally empty
+}
+
+
+/*
+ * message_inbox::dispatcher::~dispatcher
+ */
+message_inbox::dispatcher::~dispatcher(void) {
+    // intentionally empty
+}
+
+
+/*
+ * message_inbox::dispatcher::run
+ */
+int message_inbox::dispatcher::run(void) {
+    return this->owner.run_dispatcher();
+}
+
+
+/*
+ * message_inbox::dispatcher::on_thread_terminating
+ */
+thread::termination_behaviour message_inbox::dispatcher::on_thread_terminating(void) throw() {
+    return thread::termination_behaviour::graceful;
+}
+
+
+/*
+ * message_inbox::run_dispatcher
+ */
+int message_inbox::run_dispatcher(void) {
+    std::deque<message> batch;
+
+    while (!this->terminating) {
+        this->queued_event.wait();
+        if (this->terminating) break;
+        {
+            // all messages queued meanwhile are delivered as one batch
+            auto_lock<critical_section> lock(this->lock_obj);
+            this->take_batch(batch, 0);
+        }
+        this->deliver(batch);
+    }
+
+    return 0;
+}
+
+
+/*
+ * message_inbox::take_batch
+ */
+void message_inbox::take_batch(std::deque<message>& batch, unsigned int max_count) {
+    if ((max_count == 0) || (max_count >= this->queue.size())) {
+        batch.swap(this->queue);
+        this->queue.clear();
+        return;
+    }
+    for (unsigned int i = 0; i < max_count; ++i) {
+        batch.push_back(std::move(this->queue.front()));
+        this->queue.pop_front();
+    }
+}
+
+
+/*
+ * message_inbox::deliver
+ */
+void message_inbox::deliver(std::deque<message>& batch) {
+    auto_lock<critical_section> lock(this->deliver_lock);
+    for (std::deque<message>::iterator i = batch.begin(); i != batch.end(); ++i) {
+        try {
+            this->target(i->id, i->size, i->data.as<char>());
+        } catch(...) {
+        }
+    }
+    batch.clear();
+}
+
+
+/*
+ * message_inbox::stop_dispatcher
+ */
+void message_inbox::stop_dispatcher(void) {
+    thread *t;
+    dispatcher *w;
+    {
+        auto_lock<critical_section> lock(this->lock_obj);
+        t = this->worker_thread;
+        w = this->worker;
+        this->worker_thread = nullptr;
+        this->worker = nullptr;
+        if (t == nullptr) return;
+        this->terminating = true;
+        this->queued_event.set();
+    }
+
+    if (t->is_running()) {
+        t->join();
+    }
+    the::safe_delete(t);
+    the::safe_delete(w);
+}
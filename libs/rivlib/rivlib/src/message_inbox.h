@@ -0,0 +1,207 @@
+/*
+ * message_inbox.h
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+
+#ifndef VICCI_RIVLIB_MESSAGE_INBOX_H_INCLUDED
+#define VICCI_RIVLIB_MESSAGE_INBOX_H_INCLUDED
+#if (defined(_MSC_VER) && (_MSC_VER > 1000))
+#pragma once
+#endif /* (defined(_MSC_VER) && (_MSC_VER > 1000)) */
+
+#include "rivlib/provider.h"
+#include "the/blob.h"
+#include "the/delegate.h"
+#include "the/system/threading/critical_section.h"
+#include "the/system/threading/event.h"
+#include "the/system/threading/runnable.h"
+#include "the/system/threading/thread.h"
+#include <deque>
+
+
+namespace eu_vicci {
+namespace rivlib {
+
+    /**
+     * Bounded inbox of the user messages received by a provider.
+     *
+     * Any number of I/O threads push messages, which are delivered to the
+     * target delegate in batches, either by the dispatcher thread of the
+     * inbox or by the application calling 'poll'. Thus the target is never
+     * called concurrently. In 'immediate' mode the inbox is bypassed.
+     */
+    class message_inbox {
+    public:
+
+        /** The delegate type receiving the messages (id, size, data) */
+        typedef the::delegate<void, unsigned int, unsigned int, const char *> target_delegate;
+
+        /**
+         * ctor
+         *
+         * @param target The delegate receiving the messages
+         */
+        message_inbox(target_delegate target);
+
+        /** dtor */
+        ~message_inbox(void);
+
+        /**
+         * Sets the delivery mode. Messages queued when switching to
+         * 'immediate' are delivered by the calling thread.
+         *
+         * @param delivery The delivery mode
+         * @param capacity The maximum number of queued messages
+         * @param overflow The policy for messages arriving while the inbox is full
+         */
+        void configure(provider::message_delivery delivery, unsigned int capacity,
+            provider::inbox_overflow overflow);
+
+        /**
+         * Delivers a message, or queues it according to the delivery mode
+         *
+         * @param id The id of the message
+         * @param size The size of the message data in byte
+         * @param data The message data
+         */
+        void push(unsigned int id, unsigned int size, const char *data);
+
+        /**
+         * Delivers queued messages on the calling thread. Only delivers
+         * messages in 'poll' mode.
+         *
+         * @param max_count The maximum number of messages to deliver, or
+         *                  zero for all
+         *
+         * @return The number of messages delivered
+         */
+        unsigned int poll(unsigned int max_count);
+
+        /**
+         * Stops the dispatcher thread and drops all queued messages
+         */
+        void stop(void);
+
+    private:
+
+        /** A queued message */
+        typedef struct _message_t {
+
+            /** The id of the message */
+            unsigned int id;
+
+            /** The size of the message data in byte */
+            unsigned int size;
+
+            /** The message data */
+            the::blob data;
+
+        } message;
+
+        /** Utility runnable class for the dispatcher thread */
+        class dispatcher : public the::system::threading::runnable {
+        public:
+
+            /**
+             * ctor
+             *
+             * @param owner The owning inbox
+             */
+            dispatcher(message_inbox& owner);
+
+            /** dtor */
+            virtual ~dispatcher(void);
+
+            /**
+             * Perform the work of a thread.
+             *
+             * @return The application dependent return code of the thread. This
+             *         must not be STILL_ACTIVE (259).
+             */
+            virtual int run(void);
+
+            /**
+             * Requests the runnable to be terminated
+             *
+             * @return graceful
+             */
+            virtual the::system::threading::thread::termination_behaviour on_thread_terminating(void) throw();
+
+        private:
+
+            /** The owning inbox */
+            message_inbox& owner;
+
+        };
+
+        /**
+         * The dispatcher thread function
+         *
+         * @return 0
+         */
+        int run_dispatcher(void);
+
+        /**
+         * Moves queued messages to a batch. The caller must hold 'lock_obj'.
+         *
+         * @param batch Receives the messages
+         * @param max_count The maximum number of messages, or zero for all
+         */
+        void take_batch(std::deque<message>& batch, unsigned int max_count);
+
+        /**
+         * Delivers a batch of messages to the target. Must not be called
+         * concurrently.
+         *
+         * @param batch The messages
+         */
+        void deliver(std::deque<message>& batch);
+
+        /**
+         * Stops the dispatcher thread if it is running. The caller must not
+         * hold 'lock_obj'.
+         */
+        void stop_dispatcher(void);
+
+        /** The delegate receiving the messages */
+        target_delegate target;
+
+        /** The delivery mode; only accessed holding 'lock_obj' */
+        provider::message_delivery delivery;
+
+        /** The maximum number of queued messages */
+        size_t capacity;
+
+        /** The policy for messages arriving while the inbox is full */
+        provider::inbox_overflow overflow;
+
+        /** The queued messages */
+        std::deque<message> queue;
+
+        /** The lock for the queue and the configuration */
+        the::system::threading::critical_section lock_obj;
+
+        /** Serialises the deliveries by the dispatcher and 'poll' */
+        the::system::threading::critical_section deliver_lock;
+
+        /** Event set when messages are queued or the dispatcher should stop */
+        the::system::threading::event queued_event;
+
+        /** Flag that the dispatcher thread should terminate */
+        volatile bool terminating;
+
+        /** The runnable of the dispatcher thread */
+        dispatcher *worker;
+
+        /** The dispatcher thread */
+        the::system::threading::thread *worker_thread;
+
+    };
+
+
+} /* end namespace rivlib */
+} /* end namespace eu_vicci */
+
+#endif /* VICCI_RIVLIB_MESSAGE_INBOX_H_INCLUDED */
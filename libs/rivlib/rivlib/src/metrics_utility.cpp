@@ -0,0 +1,67 @@
+/*
+ * metrics_utility.cpp
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+#include "stdafx.h"
+#include "metrics_utility.h"
+
+using namespace eu_vicci::rivlib;
+
+
+/*
+ * metrics_utility::record
+ */
+void metrics_utility::record(latency_histogram& hist, double ms) {
+    if (ms < 0.0) ms = 0.0;
+    unsigned int b = 0;
+    for (double limit = 1.0; (ms >= limit) && (b < latency_histogram::bucket_count - 1); limit *= 2.0) {
+        ++b;
+    }
+    hist.buckets[b]++;
+    hist.count++;
+    hist.sum_ms += ms;
+    if (ms > hist.max_ms) hist.max_ms = ms;
+}
+
+
+/*
+ * metrics_utility::add
+ */
+void metrics_utility::add(latency_histogram& hist, const latency_histogram& src) {
+    for (unsigned int i = 0; i < latency_histogram::bucket_count; ++i) {
+        hist.buckets[i] += src.buckets[i];
+    }
+    hist.count += src.count;
+    hist.sum_ms += src.sum_ms;
+    if (src.max_ms > hist.max_ms) hist.max_ms = src.max_ms;
+}
+
+
+/*
+ * metrics_utility::add
+ */
+void metrics_utility::add(provider_metrics& metrics, const data_binding_metrics& src) {
+    metrics.data_bindings++;
+    metrics.encoders += src.encoders;
+    metrics.image_streams += src.image_streams;
+    metrics.frames_available += src.frames_available;
+    metrics.frames_captured += src.frames_captured;
+    metrics.frames_encoded += src.frames_encoded;
+    metrics.refinements_encoded += src.refinements_encoded;
+    metrics.bytes_encoded += src.bytes_encoded;
+    add(metrics.encode_time, src.encode_time);
+}
+
+
+/*
+ * metrics_utility::add
+ */
+void metrics_utility::add(provider_metrics& metrics, const connection_statistics& src) {
+    metrics.images_sent += src.images_sent;
+    metrics.images_dropped += src.images_dropped;
+    metrics.messages_dropped += src.messages_dropped;
+    metrics.bytes_sent += src.bytes_sent;
+    metrics.queued_bytes += src.queued_bytes;
+}
@@ -0,0 +1,73 @@
+/*
+ * metrics_utility.h
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+
+#ifndef VICCI_RIVLIB_METRICS_UTILITY_H_INCLUDED
+#define VICCI_RIVLIB_METRICS_UTILITY_H_INCLUDED
+#if (defined(_MSC_VER) && (_MSC_VER > 1000))
+#pragma once
+#endif /* (defined(_MSC_VER) && (_MSC_VER > 1000)) */
+
+#include "rivlib/provider.h"
+
+
+namespace eu_vicci {
+namespace rivlib {
+
+
+    /**
+     * metrics utility class
+     */
+    class metrics_utility {
+    public:
+
+        /**
+         * Adds a sample to a histogram
+         *
+         * @param hist The histogram
+         * @param ms The sample in milliseconds
+         */
+        static void record(latency_histogram& hist, double ms);
+
+        /**
+         * Adds all samples of a histogram to another histogram
+         *
+         * @param hist The histogram receiving the samples
+         * @param src The histogram to be added
+         */
+        static void add(latency_histogram& hist, const latency_histogram& src);
+
+        /**
+         * Adds the metrics of a data binding to the metrics of a provider
+         *
+         * @param metrics The metrics of the provider
+         * @param src The metrics of the data binding
+         */
+        static void add(provider_metrics& metrics, const data_binding_metrics& src);
+
+        /**
+         * Adds the statistics of a connection to the metrics of a provider
+         *
+         * @param metrics The metrics of the provider
+         * @param src The statistics of the connection
+         */
+        static void add(provider_metrics& metrics, const connection_statistics& src);
+
+    private:
+
+        /** ctor */
+        metrics_utility(void);
+
+        /** dtor */
+        ~metrics_utility(void);
+
+    };
+
+
+} /* end namespace rivlib */
+} /* end namespace eu_vicci */
+
+#endif /* VICCI_RIVLIB_METRICS_UTILITY_H_INCLUDED */
@@ -0,0 +1,191 @@
+/*
+ * multicast_frame.cpp
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+#include "stdafx.h"
+#include "multicast_frame.h"
+#include "data/buffer_type.h"
+#include "data/image_buffer_metadata.h"
+#include "the/math/functions.h"
+#include <cstring>
+
+using namespace eu_vicci::rivlib;
+
+
+/*
+ * multicast_frame_assembler::multicast_frame_assembler
+ */
+multicast_frame_assembler::multicast_frame_assembler(void) : active(false),
+        frame_data(), parity_data(), received(), group_received(), missing(0),
+        last_frame_id(0), dropped_frames(0), restored_fragments(0) {
+    ::memset(&this->frame, 0, sizeof(multicast_fragment_header));
+}
+
+
+/*
+ * multicast_frame_assembler::~multicast_frame_assembler
+ */
+multicast_frame_assembler::~multicast_frame_assembler(void) {
+    // intentionally empty
+}
+
+
+/*
+ * multicast_frame_assembler::add
+ */
+data::buffer::shared_ptr multicast_frame_assembler::add(const void *datagram, size_t size) {
+    multicast_fragment_header h;
+    if (size < sizeof(multicast_fragment_header)) return nullptr;
+    ::memcpy(&h, datagram, sizeof(multicast_fragment_header));
+    const uint8_t *payload = static_cast<const uint8_t*>(datagram) + sizeof(multicast_fragment_header);
+
+    // sanity checks against malformed or foreign datagrams
+    if ((h.payload_size > multicast_fragment_payload)
+            || (sizeof(multicast_fragment_header) + h.payload_size > size)
+            || (h.frame_size == 0) || (h.frame_size > multicast_max_frame_size)
+            || (h.fec_group == 0)
+            || (h.count != (h.frame_size + multicast_fragment_payload - 1) / multicast_fragment_payload)) {
+        return nullptr;
+    }
+    size_t groups = (h.count + h.fec_group - 1) / h.fec_group;
+    if (h.index >= h.count + groups) return nullptr;
+
+    if (this->active && (h.frame_id != this->frame.frame_id)) {
+        if (static_cast<int32_t>(h.frame_id - this->frame.frame_id) < 0) {
+            return nullptr; // late fragment of an older frame
+        }
+        // a newer frame started before the current one was completed
+        this->active = false;
+        this->last_frame_id = this->frame.frame_id;
+        this->dropped_frames++;
+    }
+    if (!this->active) {
+        int32_t age = static_cast<int32_t>(this->last_frame_id - h.frame_id);
+        if ((age >= 0) && (age < 64)) {
+            return nullptr; // frame already completed or dropped
+        }
+        // otherwise a newer frame or the sender restarted its sequence
+        this->begin_frame(h);
+    }
+
+    if ((h.frame_size != this->frame.frame_size) || (h.count != this->frame.count)
+            || (h.fec_group != this->frame.fec_group) || this->received[h.index]) {
+        return nullptr;
+    }
+
+    size_t group;
+    if (h.index < h.count) {
+        if (h.payload_size != this->fragment_size(h.index)) return nullptr;
+        ::memcpy(this->frame_data.as_at<uint8_t>(h.index * multicast_fragment_payload),
+            payload, h.payload_size);
+        this->missing--;
+        group = h.index / h.fec_group;
+    } else {
+        if (h.payload_size != multicast_fragment_payload) return nullptr;
+        group = h.index - h.count;
+        ::memcpy(this->parity_data.as_at<uint8_t>(group * multicast_fragment_payload),
+            payload, multicast_fragment_payload);
+    }
+    this->received[h.index] = true;
+    this->group_received[group]++;
+
+    size_t group_size = the::math::minimum<size_t>(h.fec_group, h.count - group * h.fec_group);
+    if (this->received[h.count + group] && (this->group_received[group] == group_size)) {
+        // parity and all but one data fragment received
+        this->restore_fragment(group);
+    }
+
+    if (this->missing > 0) return nullptr;
+
+    this->active = false;
+    this->last_frame_id = this->frame.frame_id;
+    return this->finish_frame();
+}
+
+
+/*
+ * multicast_frame_assembler::begin_frame
+ */
+void multicast_frame_assembler::begin_frame(const multicast_fragment_header& header) {
+    size_t groups = (header.count + header.fec_group - 1) / header.fec_group;
+
+    this->active = true;
+    this->frame = header;
+    this->frame_data.assert_size(header.frame_size);
+    this->parity_data.assert_size(groups * multicast_fragment_payload);
+    this->received.assign(header.count + groups, false);
+    this->group_received.assign(groups, 0);
+    this->missing = header.count;
+}
+
+
+/*
+ * multicast_frame_assembler::restore_fragment
+ */
+void multicast_frame_assembler::restore_fragment(size_t group) {
+    size_t first = group * this->frame.fec_group;
+    size_t last = the::math::minimum<size_t>(first + this->frame.fec_group, this->frame.count);
+    size_t lost = last;
+    uint8_t restored[multicast_fragment_payload];
+
+    ::memcpy(restored, this->parity_data.as_at<uint8_t>(group * multicast_fragment_payload),
+        multicast_fragment_payload);
+    for (size_t i = first; i < last; ++i) {
+        if (!this->received[i]) {
+            lost = i;
+            continue;
+        }
+        const uint8_t *d = this->frame_data.as_at<uint8_t>(i * multicast_fragment_payload);
+        for (size_t j = 0, s = this->fragment_size(i); j < s; ++j) {
+            restored[j] ^= d[j];
+        }
+    }
+    if (lost == last) return; // nothing missing
+
+    ::memcpy(this->frame_data.as_at<uint8_t>(lost * multicast_fragment_payload),
+        restored, this->fragment_size(lost));
+    this->received[lost] = true;
+    this->group_received[group]++;
+    this->missing--;
+    this->restored_fragments++;
+}
+
+
+/*
+ * multicast_frame_assembler::fragment_size
+ */
+size_t multicast_frame_assembler::fragment_size(size_t index) const {
+    return the::math::minimum<size_t>(multicast_fragment_payload,
+        this->frame.frame_size - index * multicast_fragment_payload);
+}
+
+
+/*
+ * multicast_frame_assembler::finish_frame
+ */
+data::buffer::shared_ptr multicast_frame_assembler::finish_frame(void) {
+    size_t size = this->frame.frame_size;
+    if (size < 2 * sizeof(uint32_t) + sizeof(data::image_buffer_metadata)) return nullptr;
+
+    data::buffer::shared_ptr buf = data::buffer::create();
+    buf->set_type(static_cast<data::buffer_type>(this->frame_data.as<uint32_t>()[0]));
+    buf->set_time_code(this->frame_data.as<uint32_t>()[1]);
+    size_t meta_size = (buf->type() == data::buffer_type::progressive_rgb_bytes)
+        ? sizeof(data::progressive_image_buffer_metadata)
+        : sizeof(data::image_buffer_metadata);
+    if (size < 2 * sizeof(uint32_t) + meta_size) return nullptr;
+
+    buf->metadata().assert_size(meta_size);
+    ::memcpy(buf->metadata(), this->frame_data.as_at<uint8_t>(2 * sizeof(uint32_t)), meta_size);
+    size_t data_size = size - (2 * sizeof(uint32_t) + meta_size);
+    if (buf->type() == data::buffer_type::raw_rgb_bytes) {
+        const data::image_buffer_metadata *meta = buf->metadata().as<data::image_buffer_metadata>();
+        if (static_cast<uint64_t>(meta->width) * meta->height * 3 > data_size) return nullptr;
+    }
+    buf->data().assert_size(data_size);
+    ::memcpy(buf->data(), this->frame_data.as_at<uint8_t>(2 * sizeof(uint32_t) + meta_size), data_size);
+
+    return buf;
+}
@@ -0,0 +1,184 @@
+/*
+ * multicast_frame.h
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+
+#ifndef VICCI_RIVLIB_MULTICAST_FRAME_H_INCLUDED
+#define VICCI_RIVLIB_MULTICAST_FRAME_H_INCLUDED
+#if (defined(_MSC_VER) && (_MSC_VER > 1000))
+#pragma once
+#endif /* (defined(_MSC_VER) && (_MSC_VER > 1000)) */
+
+#include "the/config.h"
+#include "the/types.h"
+#include "the/blob.h"
+#include "data/buffer.h"
+#include <vector>
+
+
+namespace eu_vicci {
+namespace rivlib {
+
+
+    /**
+     * Header of each datagram of a multicast image stream.
+     *
+     * A frame is the body of an 'image_data_blob' message (type, time code,
+     * metadata and data). It is split into 'count' data fragments of
+     * 'multicast_fragment_payload' bytes (the last one may be shorter).
+     * After every 'multicast_fec_group' data fragments one parity fragment
+     * follows, holding the xor of the group's payloads. Parity fragments
+     * use the indices 'count' and above, one per group. A single lost data
+     * fragment per group is restored from the parity fragment.
+     * The size of the struct must be 16 bytes.
+     */
+    typedef struct _multicast_fragment_header_t {
+
+        /** The sequence number of the frame */
+        uint32_t frame_id;
+
+        /** The size of the whole frame in bytes */
+        uint32_t frame_size;
+
+        /** The index of the fragment */
+        uint16_t index;
+
+        /** The number of data fragments of the frame */
+        uint16_t count;
+
+        /** The number of data fragments covered by one parity fragment */
+        uint16_t fec_group;
+
+        /** The number of payload bytes following the header */
+        uint16_t payload_size;
+
+    } multicast_fragment_header;
+
+
+    /** The maximum number of payload bytes per datagram */
+    const uint16_t multicast_fragment_payload = 1400;
+
+    /** The number of data fragments covered by one parity fragment */
+    const uint16_t multicast_fec_group = 8;
+
+    /**
+     * The largest frame accepted by receivers in bytes, which matches the
+     * largest message body accepted over tcp
+     */
+    const uint32_t multicast_max_frame_size = 0x4000000;
+
+
+    /**
+     * Reassembles the frames of a multicast image stream from the received
+     * datagrams. Only the most recent frame is assembled; an incomplete
+     * frame is dropped as soon as a fragment of a newer frame arrives.
+     */
+    class multicast_frame_assembler {
+    public:
+
+        /** ctor */
+        multicast_frame_assembler(void);
+
+        /** dtor */
+        ~multicast_frame_assembler(void);
+
+        /**
+         * Adds a received datagram
+         *
+         * @param datagram The datagram
+         * @param size The size of 'datagram' in bytes
+         *
+         * @return The completed image buffer or nullptr if the frame of the
+         *         datagram is not complete yet
+         */
+        data::buffer::shared_ptr add(const void *datagram, size_t size);
+
+        /**
+         * Answer the number of frames dropped because of lost fragments
+         *
+         * @return The number of dropped frames
+         */
+        inline uint64_t get_dropped_frames(void) const {
+            return this->dropped_frames;
+        }
+
+        /**
+         * Answer the number of data fragments restored from parity fragments
+         *
+         * @return The number of restored fragments
+         */
+        inline uint64_t get_restored_fragments(void) const {
+            return this->restored_fragments;
+        }
+
+    private:
+
+        /**
+         * Starts assembling a new frame
+         *
+         * @param header The header of the first received fragment
+         */
+        void begin_frame(const multicast_fragment_header& header);
+
+        /**
+         * Restores the missing data fragment of a group from its parity
+         *
+         * @param group The index of the group
+         */
+        void restore_fragment(size_t group);
+
+        /**
+         * Answer the payload size of a data fragment
+         *
+         * @param index The index of the data fragment
+         *
+         * @return The payload size in bytes
+         */
+        size_t fragment_size(size_t index) const;
+
+        /**
+         * Creates the image buffer from the completed frame
+         *
+         * @return The image buffer or nullptr if the frame is malformed
+         */
+        data::buffer::shared_ptr finish_frame(void);
+
+        /** Flag whether a frame is being assembled */
+        bool active;
+
+        /** The header of the frame being assembled */
+        multicast_fragment_header frame;
+
+        /** The data of the frame being assembled */
+        the::blob frame_data;
+
+        /** The parity payloads of the frame, one per group */
+        the::blob parity_data;
+
+        /** Flags of the received data and parity fragments */
+        std::vector<bool> received;
+
+        /** The number of received data and parity fragments per group */
+        std::vector<uint16_t> group_received;
+
+        /** The number of missing data fragments */
+        size_t missing;
+
+        /** The id of the last completed or dropped frame */
+        uint32_t last_frame_id;
+
+        /** The number of dropped frames */
+        uint64_t dropped_frames;
+
+        /** The number of restored data fragments */
+        uint64_t restored_fragments;
+
+    };
+
+
+} /* end namespace rivlib */
+} /* end namespace eu_vicci */
+
+#endif /* VICCI_RIVLIB_MULTICAST_FRAME_H_INCLUDED */
@@ -0,0 +1,323 @@
+/*
+ * multicast_sender.cpp
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+#include "stdafx.h"
+#include "multicast_sender.h"
+#include "multicast_frame.h"
+#include "ip_connection.h"
+#include "encoder/image_request.h"
+#include "the/argument_exception.h"
+#include "the/math/functions.h"
+#include "the/system/threading/auto_lock.h"
+#include "vislib/IPCommEndPoint.h"
+#include "vislib/Socket.h"
+#include "vislib/SocketException.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+using namespace eu_vicci::rivlib;
+using namespace the::system::threading;
+
+
+/*
+ * multicast_sender::acquire_lock
+ */
+critical_section multicast_sender::acquire_lock;
+
+
+/*
+ * multicast_sender::active
+ */
+std::vector<multicast_sender*> multicast_sender::active;
+
+
+/*
+ * multicast_sender::acquire
+ */
+api_ptr_base multicast_sender::acquire(api_ptr_base img_dat_binding, uint16_t subtype,
+        const vislib::net::IPEndPoint& group, token_bucket::shared_ptr egress,
+        bool& group_in_use) {
+    using namespace vislib::net;
+    auto_lock<critical_section> lock(acquire_lock);
+    group_in_use = false;
+
+    // search for a running sender of the group
+    node *binding = dynamic_cast<node*>(img_dat_binding.get());
+    THE_ASSERT(binding != nullptr);
+    for (size_t i = 0, cnt = active.size(); i < cnt; ++i) {
+        multicast_sender *ms = active[i];
+        if (!(ms->group == group)) continue;
+        if ((ms->binding != binding) || (ms->subtype != subtype)) {
+            // the clients could not tell the two streams apart
+            group_in_use = true;
+            return api_ptr_base();
+        }
+        auto_lock<critical_section> sub_lock(ms->sub_lock);
+        THE_ASSERT(ms->subscribers > 0);
+        ms->subscribers++;
+        return api_ptr_base(ms);
+    }
+
+    encoder::image_encoder_base *encoder = ip_connection::create_image_encoder(subtype);
+    if (encoder == nullptr) return api_ptr_base();
+    api_ptr_base encoder_ptr(encoder);
+
+    multicast_sender *ms = new multicast_sender(binding, subtype, group);
+    api_ptr_base ms_ptr(ms);
+
+    ms->comm = UdpCommChannel::Create();
+    ms->comm->Connect(IPCommEndPoint::Create(group));
+    ms->comm->GetSocket().SetMulticastTimeToLive(Socket::FAMILY_INET, multicast_ttl);
+    ms->comm->GetSocket().SetSndBuf(send_buffer_size);
+
+    ms->image_encoder = encoder;
+    ms->egress = egress;
+    ms->subscribers = 1;
+    ms->connect(encoder_ptr);
+    encoder->connect(img_dat_binding);
+
+    active.push_back(ms);
+    ms->request_next(0);
+
+    return ms_ptr;
+}
+
+
+/*
+ * multicast_sender::parse_group_range
+ */
+multicast_group_range multicast_sender::parse_group_range(const char *first, const char *last) {
+    using namespace vislib::net;
+    multicast_group_range range;
+    range.first = 1;
+    range.last = 0;
+    if (first == nullptr) return range;
+
+    try {
+        range.first = to_host_order(IPAddress::Create(first));
+    } catch(...) {
+        throw the::argument_exception("first", __FILE__, __LINE__);
+    }
+    if ((range.first & 0xF0000000) != 0xE0000000) {
+        throw the::argument_exception("first", __FILE__, __LINE__);
+    }
+    if (last == nullptr) {
+        range.last = range.first;
+        return range;
+    }
+
+    try {
+        range.last = to_host_order(IPAddress::Create(last));
+    } catch(...) {
+        throw the::argument_exception("last", __FILE__, __LINE__);
+    }
+    if (((range.last & 0xF0000000) != 0xE0000000) || (range.last < range.first)) {
+        throw the::argument_exception("last", __FILE__, __LINE__);
+    }
+
+    return range;
+}
+
+
+/*
+ * multicast_sender::is_group_in_range
+ */
+bool multicast_sender::is_group_in_range(const multicast_group_range& range,
+        const vislib::net::IPAddress& group) {
+    uint32_t g = to_host_order(group);
+    return (range.first <= g) && (g <= range.last);
+}
+
+
+/*
+ * multicast_sender::~multicast_sender
+ */
+multicast_sender::~multicast_sender(void) {
+    THE_ASSERT(this->subscribers == 0);
+    if (!this->comm.IsNull()) {
+        try {
+            this->comm->Close();
+        } catch(...) {
+        }
+        this->comm.Release();
+    }
+    vislib::net::Socket::Cleanup();
+}
+
+
+/*
+ * multicast_sender::remove_subscriber
+ */
+void multicast_sender::remove_subscriber(void) {
+    auto_lock<critical_section> lock(acquire_lock);
+    {
+        auto_lock<critical_section> sub_lock(this->sub_lock);
+        THE_ASSERT(this->subscribers > 0);
+        if (--this->subscribers > 0) return;
+    }
+    active.erase(std::remove(active.begin(), active.end(), this), active.end());
+
+    // last subscriber gone: detach the encoder from the image data binding
+    // and release it. The sender itself lives as long as its subscribers
+    // keep it connected.
+    api_ptr_base keep_alive(this);
+    if (this->image_encoder != nullptr) {
+        this->image_encoder->remove_pending_requests(&multicast_sender::send_image_data, this);
+    }
+    std::vector<api_ptr_base> encs = this->select<encoder::image_encoder_base>();
+    for (size_t i = 0, cnt = encs.size(); i < cnt; ++i) {
+        dynamic_cast<node*>(encs[i].get())->disconnect_all();
+    }
+
+    auto_lock<critical_section> sub_lock(this->sub_lock);
+    this->image_encoder = nullptr;
+    if (!this->comm.IsNull()) {
+        try {
+            this->comm->Close();
+        } catch(...) {
+        }
+        this->comm.Release();
+    }
+}
+
+
+/*
+ * multicast_sender::send_image_data
+ */
+void multicast_sender::send_image_data(const data::buffer::shared_ptr data, void *ctxt) {
+    multicast_sender *that = static_cast<multicast_sender*>(ctxt);
+
+    that->send_frame(data);
+    that->request_next(data->time_code());
+}
+
+
+/*
+ * multicast_sender::multicast_sender
+ */
+multicast_sender::multicast_sender(const node *binding, uint16_t subtype,
+        const vislib::net::IPEndPoint& group)
+        : element_node(), binding(binding), subtype(subtype), group(group), comm(), image_encoder(nullptr),
+        subscribers(0), sub_lock(), frame_id(0), frame(), parity(), egress() {
+    vislib::net::Socket::Startup();
+}
+
+
+/*
+ * multicast_sender::to_host_order
+ */
+uint32_t multicast_sender::to_host_order(const vislib::net::IPAddress& group) {
+    return (static_cast<uint32_t>(group[0]) << 24) | (static_cast<uint32_t>(group[1]) << 16)
+        | (static_cast<uint32_t>(group[2]) << 8) | static_cast<uint32_t>(group[3]);
+}
+
+
+/*
+ * multicast_sender::send_frame
+ */
+void multicast_sender::send_frame(const data::buffer::shared_ptr data) {
+    auto_lock<critical_section> lock(this->sub_lock);
+    if (this->comm.IsNull()) return;
+
+    // the frame is the body of an 'image_data_blob' message
+    size_t meta_size = data->metadata().size();
+    size_t data_size = data->data().size();
+    size_t frame_size = 2 * sizeof(uint32_t) + meta_size + data_size;
+    size_t count = (frame_size + multicast_fragment_payload - 1) / multicast_fragment_payload;
+    if (count > USHRT_MAX) {
+        this->log().error("multicast_sender: image too large (%u bytes)\n",
+            static_cast<unsigned int>(frame_size));
+        return;
+    }
+
+    this->frame.assert_size(frame_size);
+    this->frame.as<uint32_t>()[0] = static_cast<uint32_t>(data->type());
+    this->frame.as<uint32_t>()[1] = data->time_code();
+    ::memcpy(this->frame.as_at<uint8_t>(2 * sizeof(uint32_t)), data->metadata(), meta_size);
+    if (data_size > 0) {
+        ::memcpy(this->frame.as_at<uint8_t>(2 * sizeof(uint32_t) + meta_size), data->data(), data_size);
+    }
+
+    this->parity.assert_size(multicast_fragment_payload);
+    ::memset(this->parity, 0, multicast_fragment_payload);
+
+    multicast_fragment_header h;
+    h.frame_id = ++this->frame_id;
+    h.frame_size = static_cast<uint32_t>(frame_size);
+    h.count = static_cast<uint16_t>(count);
+    h.fec_group = multicast_fec_group;
+
+    try {
+        for (size_t i = 0; i < count; ++i) {
+            const uint8_t *payload = this->frame.as_at<uint8_t>(i * multicast_fragment_payload);
+            size_t size = the::math::minimum<size_t>(multicast_fragment_payload,
+                frame_size - i * multicast_fragment_payload);
+            h.index = static_cast<uint16_t>(i);
+            h.payload_size = static_cast<uint16_t>(size);
+            this->send_fragment(&h, payload);
+
+            uint8_t *p = this->parity.as<uint8_t>();
+            for (size_t j = 0; j < size; ++j) {
+                p[j] ^= payload[j];
+            }
+
+            if (((i + 1) % multicast_fec_group == 0) || (i + 1 == count)) {
+                h.index = static_cast<uint16_t>(count + i / multicast_fec_group);
+                h.payload_size = multicast_fragment_payload;
+                this->send_fragment(&h, p);
+                ::memset(p, 0, multicast_fragment_payload);
+            }
+        }
+
+    } catch(vislib::Exception ex) {
+        // the datagrams of this frame are lost; the clients skip the frame
+        this->log().error("multicast_sender: %s (%s, %d)\n",
+            ex.GetMsgA(), ex.GetFile(), ex.GetLine());
+    }
+
+    if (this->egress) {
+        size_t groups = (count + multicast_fec_group - 1) / multicast_fec_group;
+        this->egress->consume(frame_size + groups * multicast_fragment_payload
+            + (count + groups) * sizeof(multicast_fragment_header));
+    }
+}
+
+
+/*
+ * multicast_sender::send_fragment
+ */
+void multicast_sender::send_fragment(const void *header, const void *payload) {
+    using namespace vislib::net;
+    const multicast_fragment_header *h = static_cast<const multicast_fragment_header*>(header);
+    Socket::SendBuffer buffers[2];
+    buffers[0].Data = header;
+    buffers[0].Size = sizeof(multicast_fragment_header);
+    buffers[1].Data = payload;
+    buffers[1].Size = h->payload_size;
+    this->comm->GetSocket().Send(buffers, 2, Socket::TIMEOUT_INFINITE, 0, false);
+}
+
+
+/*
+ * multicast_sender::request_next
+ */
+void multicast_sender::request_next(unsigned int last_time_code) {
+    encoder::image_encoder_base *encoder;
+    {
+        auto_lock<critical_section> lock(this->sub_lock);
+        if (this->subscribers == 0) return;
+        encoder = this->image_encoder;
+    }
+    if (encoder == nullptr) return;
+
+    // pace the images to the egress rate of the provider
+    double not_before = this->egress ? this->egress->ready_time() : 0.0;
+
+    encoder::image_request::ptr ir(new encoder::image_request(
+        &multicast_sender::send_image_data, this, last_time_code, not_before));
+    encoder->request_output(ir);
+}
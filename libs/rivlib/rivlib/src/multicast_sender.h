@@ -0,0 +1,214 @@
+/*
+ * multicast_sender.h
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+
+#ifndef VICCI_RIVLIB_MULTICAST_SENDER_H_INCLUDED
+#define VICCI_RIVLIB_MULTICAST_SENDER_H_INCLUDED
+#if (defined(_MSC_VER) && (_MSC_VER > 1000))
+#pragma once
+#endif /* (defined(_MSC_VER) && (_MSC_VER > 1000)) */
+
+#include "element_node.h"
+#include "encoder/image_encoder_base.h"
+#include "data/buffer.h"
+#include "token_bucket.h"
+#include "the/blob.h"
+#include "the/system/threading/critical_section.h"
+#include "vislib/IPEndPoint.h"
+#include "vislib/SmartRef.h"
+#include "vislib/UdpCommChannel.h"
+#include <vector>
+
+
+namespace eu_vicci {
+namespace rivlib {
+
+    /**
+     * An inclusive range of IPv4 multicast groups in host byte order.
+     * The range is empty if 'first' is greater than 'last'.
+     */
+    typedef struct _multicast_group_range_t {
+
+        /** The first group of the range */
+        uint32_t first;
+
+        /** The last group of the range */
+        uint32_t last;
+
+    } multicast_group_range;
+
+    /**
+     * Sends the images of one image data binding to an UDP multicast group.
+     *
+     * All ip_connections requesting the same data channel, subtype and
+     * group share one sender and thus one encoder, so the egress of the
+     * provider does not depend on the number of viewers. The fragments do
+     * not identify the stream, so each group carries only one stream of
+     * the process at a time. The sender
+     * requests the next image as soon as the previous one has been sent.
+     * The images are split into datagrams as described by
+     * 'multicast_fragment_header'.
+     */
+    class multicast_sender : public element_node {
+    public:
+
+        /**
+         * Answer the sender for the specified data channel and group. A new
+         * sender is created if none exists. The caller is registered as
+         * subscriber and must call 'remove_subscriber' when done.
+         *
+         * @param img_dat_binding The image data binding to be sent
+         * @param subtype The image stream subtype
+         * @param group The multicast group and port
+         * @param egress The egress token bucket of the provider or nullptr.
+         *               Only used if a new sender is created.
+         * @param group_in_use Set to true if the group is used by a sender
+         *               of another data channel or subtype
+         *
+         * @return The sender or an invalid pointer if 'subtype' is not
+         *         supported or the group is in use
+         */
+        static api_ptr_base acquire(api_ptr_base img_dat_binding, uint16_t subtype,
+            const vislib::net::IPEndPoint& group, token_bucket::shared_ptr egress,
+            bool& group_in_use);
+
+        /**
+         * Parses a range of IPv4 multicast groups
+         *
+         * @param first The first group of the range, or nullptr for an
+         *              empty range
+         * @param last The last group of the range, or nullptr for the
+         *             single group 'first'
+         *
+         * @return The range
+         *
+         * @throw the::argument_exception if an address is no multicast group
+         *        or 'last' is lower than 'first'
+         */
+        static multicast_group_range parse_group_range(const char *first, const char *last);
+
+        /**
+         * Answer whether a group lies within a range
+         *
+         * @param range The range of groups
+         * @param group The multicast group
+         *
+         * @return True if 'group' is within 'range'
+         */
+        static bool is_group_in_range(const multicast_group_range& range,
+            const vislib::net::IPAddress& group);
+
+        /** dtor */
+        virtual ~multicast_sender(void);
+
+        /**
+         * Unregisters a subscriber. The sender stops when the last
+         * subscriber is removed.
+         */
+        void remove_subscriber(void);
+
+    private:
+
+        /** The time to live of the datagrams, keeping them in the local subnet */
+        static const unsigned char multicast_ttl = 1;
+
+        /** The send buffer size of the socket in bytes */
+        static const int send_buffer_size = 0x400000;
+
+        /** Lock serialising 'acquire' and the teardown of senders */
+        static the::system::threading::critical_section acquire_lock;
+
+        /** The senders with subscribers, guarded by 'acquire_lock' */
+        static std::vector<multicast_sender*> active;
+
+        /**
+         * Answer the address of a group in host byte order
+         *
+         * @param group The IPv4 address
+         *
+         * @return The address in host byte order
+         */
+        static uint32_t to_host_order(const vislib::net::IPAddress& group);
+
+        /**
+         * Callback receiving the encoded images
+         *
+         * @param data The encoded image
+         * @param ctxt The multicast_sender
+         */
+        static void send_image_data(const data::buffer::shared_ptr data, void *ctxt);
+
+        /**
+         * ctor
+         *
+         * @param binding The image data binding
+         * @param subtype The image stream subtype
+         * @param group The multicast group and port
+         */
+        multicast_sender(const node *binding, uint16_t subtype, const vislib::net::IPEndPoint& group);
+
+        /**
+         * Sends one image as fragments to the group
+         *
+         * @param data The encoded image
+         */
+        void send_frame(const data::buffer::shared_ptr data);
+
+        /**
+         * Sends one datagram to the group
+         *
+         * @param header The fragment header
+         * @param payload The fragment payload
+         */
+        void send_fragment(const void *header, const void *payload);
+
+        /**
+         * Requests the next image from the encoder
+         *
+         * @param last_time_code The time code of the last image sent
+         */
+        void request_next(unsigned int last_time_code);
+
+        /** The image data binding (only used for comparison) */
+        const node *binding;
+
+        /** The image stream subtype */
+        uint16_t subtype;
+
+        /** The multicast group */
+        vislib::net::IPEndPoint group;
+
+        /** The communication channel */
+        vislib::SmartRef<vislib::net::UdpCommChannel> comm;
+
+        /** The encoder (kept alive as peer node) */
+        encoder::image_encoder_base *image_encoder;
+
+        /** The number of subscribed ip_connections */
+        unsigned int subscribers;
+
+        /** The lock for the subscribers and the channel */
+        the::system::threading::critical_section sub_lock;
+
+        /** The sequence number of the last frame sent */
+        uint32_t frame_id;
+
+        /** The frame being sent */
+        the::blob frame;
+
+        /** The parity of the current fragment group */
+        the::blob parity;
+
+        /** The egress token bucket of the provider or nullptr */
+        token_bucket::shared_ptr egress;
+
+    };
+
+
+} /* end namespace rivlib */
+} /* end namespace eu_vicci */
+
+#endif /* VICCI_RIVLIB_MULTICAST_SENDER_H_INCLUDED */
@@ -0,0 +1,215 @@
+/*
+ * network_interfaces.cpp
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+#include "stdafx.h"
+#include "network_interfaces.h"
+#include "the/system/performance_counter.h"
+#include "the/system/system_information.h"
+#include "the/system/threading/auto_lock.h"
+#include "vislib/NetworkInformation.h"
+#ifdef THE_WINDOWS
+#include <iphlpapi.h>
+#pragma comment(lib, "iphlpapi.lib")
+#else /* THE_WINDOWS */
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <unistd.h>
+#endif /* THE_WINDOWS */
+
+using namespace eu_vicci::rivlib;
+using namespace the::system::threading;
+
+
+/*
+ * network_interfaces::instance
+ */
+network_interfaces& network_interfaces::instance(void) {
+    static network_interfaces inst;
+    return inst;
+}
+
+
+/*
+ * network_interfaces::get
+ */
+network_interfaces::snapshot_ptr network_interfaces::get(void) {
+    auto_lock<critical_section> lock(this->lock_obj);
+    double now = the::system::performance_counter::query_millis();
+
+    bool stale = !this->current;
+    if (this->changed()) {
+        stale = true;
+    } else if (!this->watching && (now - this->built > max_age)) {
+        stale = true;
+    }
+
+    if (stale) {
+        uint64_t generation = this->current ? this->current->generation + 1 : 1;
+        // notifications arriving while rebuilding trigger another rebuild
+        this->current = build(generation);
+        this->built = now;
+    }
+
+    return this->current;
+}
+
+
+/*
+ * network_interfaces::network_interfaces
+ */
+network_interfaces::network_interfaces(void) : current(), built(0.0),
+        watching(false),
+#ifdef THE_WINDOWS
+        notify_handle(NULL),
+#else /* THE_WINDOWS */
+        netlink_fd(-1),
+#endif /* THE_WINDOWS */
+        lock_obj() {
+#ifdef THE_WINDOWS
+    ::memset(&this->notify_overlapped, 0, sizeof(OVERLAPPED));
+    this->notify_overlapped.hEvent = ::CreateEvent(NULL, TRUE, FALSE, NULL);
+#endif /* THE_WINDOWS */
+    this->watching = this->watch();
+}
+
+
+/*
+ * network_interfaces::~network_interfaces
+ */
+network_interfaces::~network_interfaces(void) {
+#ifdef THE_WINDOWS
+    if (this->watching) {
+        ::CancelIPChangeNotify(&this->notify_overlapped);
+    }
+    if (this->notify_overlapped.hEvent != NULL) {
+        ::CloseHandle(this->notify_overlapped.hEvent);
+        this->notify_overlapped.hEvent = NULL;
+    }
+#else /* THE_WINDOWS */
+    if (this->netlink_fd >= 0) {
+        ::close(this->netlink_fd);
+        this->netlink_fd = -1;
+    }
+#endif /* THE_WINDOWS */
+}
+
+
+/*
+ * network_interfaces::watch
+ */
+bool network_interfaces::watch(void) {
+#ifdef THE_WINDOWS
+    if (this->notify_overlapped.hEvent == NULL) return false;
+    ::ResetEvent(this->notify_overlapped.hEvent);
+    DWORD rv = ::NotifyAddrChange(&this->notify_handle, &this->notify_overlapped);
+    return (rv == ERROR_IO_PENDING);
+
+#else /* THE_WINDOWS */
+    int fd = ::socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (fd < 0) return false;
+
+    sockaddr_nl addr;
+    ::memset(&addr, 0, sizeof(sockaddr_nl));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(sockaddr_nl)) != 0) {
+        ::close(fd);
+        return false;
+    }
+    this->netlink_fd = fd;
+    return true;
+
+#endif /* THE_WINDOWS */
+}
+
+
+/*
+ * network_interfaces::changed
+ */
+bool network_interfaces::changed(void) {
+    if (!this->watching) return false;
+#ifdef THE_WINDOWS
+    if (::WaitForSingleObject(this->notify_overlapped.hEvent, 0) != WAIT_OBJECT_0) {
+        return false;
+    }
+    this->watching = this->watch();
+    return true;
+
+#else /* THE_WINDOWS */
+    // the notifications are only counted, not parsed
+    char buf[4096];
+    bool rv = false;
+    while (true) {
+        ssize_t r = ::recv(this->netlink_fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (r > 0) {
+            rv = true;
+        } else if ((r < 0) && (errno == ENOBUFS)) {
+            rv = true; // notifications have been lost
+        } else {
+            break;
+        }
+    }
+    return rv;
+
+#endif /* THE_WINDOWS */
+}
+
+
+/*
+ * network_interfaces::build
+ */
+network_interfaces::snapshot_ptr network_interfaces::build(uint64_t generation) {
+    std::shared_ptr<snapshot> s(new snapshot());
+    s->generation = generation;
+
+    the::system::system_information::computer_name(s->computer_name);
+
+    // vislib caches the adapters until told otherwise
+    vislib::net::NetworkInformation::DiscardCache(false);
+    vislib::net::NetworkInformation::AdapterList ads;
+    vislib::net::NetworkInformation::GetAdaptersForType(ads, vislib::net::NetworkInformation::Adapter::Type::TYPE_ETHERNET);
+    vislib::net::NetworkInformation::AdapterList ads2;
+    vislib::net::NetworkInformation::GetAdaptersForType(ads2, vislib::net::NetworkInformation::Adapter::Type::TYPE_IEEE80211);
+    for (size_t i = 0; i < ads2.Count(); i++) ads.Add(ads2[i]);
+    // TYPE_LOOPBACK etc. does not make any sense here, because I want address how I can be found
+
+    for (size_t i = 0; i < ads.Count(); i++) {
+        const vislib::net::NetworkInformation::Adapter &a = ads[i];
+
+        vislib::net::NetworkInformation::Confidence conf;
+        vislib::net::NetworkInformation::Adapter::OperStatus stat = a.GetStatus(&conf);
+        if (conf != vislib::net::NetworkInformation::INVALID) {
+            if ((stat != vislib::net::NetworkInformation::Adapter::OperStatus::OPERSTATUS_UP)
+                    && (stat != vislib::net::NetworkInformation::Adapter::OperStatus::OPERSTATUS_UNKNOWN)) {
+                // skip adapters which are most likely down
+                continue;
+            }
+        }
+
+        try {
+            vislib::net::IPAgnosticAddress addr = a.GetUnicastAddress(vislib::net::IPAgnosticAddress::AddressFamily::FAMILY_INET);
+            if (addr.IsV4()) {
+                vislib::StringA addrStr(addr.ToStringA());
+                if (!addrStr.IsEmpty()) s->ipv4.push_back(addrStr.PeekBuffer());
+            }
+        } catch(...) {
+        }
+
+        try {
+            vislib::net::IPAgnosticAddress addr = a.GetUnicastAddress(vislib::net::IPAgnosticAddress::AddressFamily::FAMILY_INET6);
+            if (addr.IsV6()) {
+                vislib::StringA addrStr(addr.ToStringA());
+                if (!addrStr.IsEmpty()) s->ipv6.push_back(addrStr.PeekBuffer());
+            }
+        } catch(...) {
+        }
+    }
+
+    return s;
+}
@@ -0,0 +1,143 @@
+/*
+ * network_interfaces.h
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+
+#ifndef VICCI_RIVLIB_NETWORK_INTERFACES_H_INCLUDED
+#define VICCI_RIVLIB_NETWORK_INTERFACES_H_INCLUDED
+#if (defined(_MSC_VER) && (_MSC_VER > 1000))
+#pragma once
+#endif /* (defined(_MSC_VER) && (_MSC_VER > 1000)) */
+
+#include "the/config.h"
+#include "the/types.h"
+#include "the/system/threading/critical_section.h"
+#include <memory>
+#include <string>
+#include <vector>
+#ifdef THE_WINDOWS
+#include <windows.h>
+#endif /* THE_WINDOWS */
+
+
+namespace eu_vicci {
+namespace rivlib {
+
+    /**
+     * Process-wide snapshot of the names and addresses under which this
+     * host can be reached.
+     *
+     * Querying the computer name and the network adapters is slow on hosts
+     * with many virtual interfaces, so the snapshot is only rebuilt after
+     * the operating system reported a change of the interface addresses
+     * (netlink on Linux, 'NotifyAddrChange' on Windows), or after
+     * 'max_age' if no notification is available.
+     */
+    class network_interfaces {
+    public:
+
+        /** The addresses of the host */
+        typedef struct _snapshot_t {
+
+            /** Number increased with each rebuild of the snapshot */
+            uint64_t generation;
+
+            /** The network name of the host */
+            std::string computer_name;
+
+            /** The IPv4 addresses of the adapters which are up */
+            std::vector<std::string> ipv4;
+
+            /** The IPv6 addresses of the adapters which are up */
+            std::vector<std::string> ipv6;
+
+        } snapshot;
+
+        /** The shared pointer type of the snapshots */
+        typedef std::shared_ptr<const snapshot> snapshot_ptr;
+
+        /**
+         * The age after which the snapshot is rebuilt if the operating
+         * system does not report changes, in milliseconds
+         */
+        static const unsigned int max_age = 60000;
+
+        /**
+         * Answer the only instance of the class
+         *
+         * @return The only instance of the class
+         */
+        static network_interfaces& instance(void);
+
+        /**
+         * Answer the current snapshot, rebuilding it if the interfaces have
+         * changed. Snapshots are immutable and may be kept by the caller.
+         *
+         * @return The current snapshot
+         */
+        snapshot_ptr get(void);
+
+    private:
+
+        /** ctor */
+        network_interfaces(void);
+
+        /** dtor */
+        ~network_interfaces(void);
+
+        /**
+         * Starts watching the interface addresses for changes
+         *
+         * @return True if changes are reported
+         */
+        bool watch(void);
+
+        /**
+         * Answer whether the interface addresses changed since the last
+         * call. The caller must hold 'lock_obj'.
+         *
+         * @return True if the interfaces changed
+         */
+        bool changed(void);
+
+        /**
+         * Builds a new snapshot
+         *
+         * @param generation The generation of the new snapshot
+         *
+         * @return The new snapshot
+         */
+        static snapshot_ptr build(uint64_t generation);
+
+        /** The current snapshot */
+        snapshot_ptr current;
+
+        /** The time the current snapshot was built in milliseconds */
+        double built;
+
+        /** Flag whether the operating system reports changes */
+        bool watching;
+
+#ifdef THE_WINDOWS
+        /** The overlapped structure of 'NotifyAddrChange' */
+        OVERLAPPED notify_overlapped;
+
+        /** The handle of 'NotifyAddrChange' */
+        HANDLE notify_handle;
+#else /* THE_WINDOWS */
+        /** The netlink socket receiving the address changes */
+        int netlink_fd;
+#endif /* THE_WINDOWS */
+
+        /** The lock for all members */
+        the::system::threading::critical_section lock_obj;
+
+    };
+
+
+} /* end namespace rivlib */
+} /* end namespace eu_vicci */
+
+#endif /* VICCI_RIVLIB_NETWORK_INTERFACES_H_INCLUDED */
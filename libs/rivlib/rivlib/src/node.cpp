@@ -13,13 +13,33 @@
 using namespace eu_vicci::rivlib;
 
 
+/*
+ * node::graph_lock
+ */
+the::system::threading::critical_section node::graph_lock;
+
+
+/*
+ * node::pending_pairs
+ */
+std::vector<std::pair<const node*, const node*> > node::pending_pairs;
+
+
 /*
  * node::~node
  */
 node::~node(void) {
     // cannot call "this->disconnect_all();" because this would lock,
     //  which is no longer existant here (pure virtual method thus)
-    THE_ASSERT(this->peer_nodes.size() == 0);
+    THE_ASSERT(this->peer_nodes->all.size() == 0);
+}
+
+
+/*
+ * node::get_kind
+ */
+node_kind node::get_kind(void) const {
+    return node_kind::other;
 }
 
 
@@ -39,7 +59,7 @@ std::shared_ptr<node_base> node::get_api_ptr(void) {
 /*
  * node::node
  */
-node::node(void) : node_base(), self_api_ptr(), peer_nodes(), connecting_event(),
+node::node(void) : node_base(), self_api_ptr(), peer_nodes(node::make_snapshot(peer_list())), connecting_event(),
         connected_event(), disconnecting_event(), disconnected_event() {
     // intentionally empty
 }
@@ -49,22 +69,43 @@ node::node(void) : node_base(), self_api_ptr(), peer_nodes(), connecting_event()
  * node::connect
  */
 void node::connect(api_ptr_base peer) {
-    the::system::threading::auto_lock<node>(*this);
-    // locking peer is not required, because I know that all 'nodes' use the same lock object
+    using the::system::threading::auto_lock;
+    using the::system::threading::critical_section;
     if (!peer) throw the::argument_null_exception("peer", __FILE__, __LINE__);
-    if (this->is_connected(peer)) return;
 
     node *peer_node = dynamic_cast<node*>(peer.get());
     THE_ASSERT(peer_node != nullptr);
 
-    bool abort = false;
-    this->on_connecting(peer, abort);
-    if (abort) throw the::exception("aborted", __FILE__, __LINE__);
-    peer_node->on_connecting(this, abort);
-    if (abort) throw the::exception("aborted", __FILE__, __LINE__);
+    {
+        // a duplicate call returns before any event is fired
+        auto_lock<critical_section> lock(node::graph_lock);
+        if (this->is_connected(peer)) return;
+        if (!node::reserve_pair(this, peer_node)) return;
+    }
 
-    this->peer_nodes.push_back(peer);
-    peer_node->peer_nodes.push_back(this);
+    try {
+        // the events are fired outside the lock
+        bool abort = false;
+        this->on_connecting(peer, abort);
+        if (abort) throw the::exception("aborted", __FILE__, __LINE__);
+        peer_node->on_connecting(this, abort);
+        if (abort) throw the::exception("aborted", __FILE__, __LINE__);
+    } catch(...) {
+        auto_lock<critical_section> lock(node::graph_lock);
+        node::release_pair(this, peer_node);
+        throw;
+    }
+
+    {
+        auto_lock<critical_section> lock(node::graph_lock);
+        peer_list this_next(this->get_peers()->all);
+        peer_list peer_next(peer_node->get_peers()->all);
+        this_next.push_back(peer);
+        peer_next.push_back(this);
+        this->set_peers(node::make_snapshot(this_next));
+        peer_node->set_peers(node::make_snapshot(peer_next));
+        node::release_pair(this, peer_node);
+    }
 
     this->on_connected(peer);
     peer_node->on_connected(this);
@@ -76,37 +117,49 @@ void node::connect(api_ptr_base peer) {
  * node::disconnect
  */
 void node::disconnect(api_ptr_base peer) {
-    the::system::threading::auto_lock<node>(*this);
-    // locking peer is not required, because I know that all 'nodes' use the same lock object
+    using the::system::threading::auto_lock;
+    using the::system::threading::critical_section;
     if (!peer) throw the::argument_null_exception("peer", __FILE__, __LINE__);
-    std::vector<api_ptr_base>::iterator this_it
-        = std::find(this->peer_nodes.begin(), this->peer_nodes.end(), peer);
-    if (this_it == this->peer_nodes.end()) return;
 
     node *peer_node = dynamic_cast<node*>(peer.get());
     THE_ASSERT(peer_node != nullptr);
 
-    std::vector<api_ptr_base>::iterator node_it
-        = std::find(peer_node->peer_nodes.begin(), peer_node->peer_nodes.end(), this);
-    THE_ASSERT(node_it != peer_node->peer_nodes.end());
-
-    bool abort = false;
-    this->on_disconnecting(peer, abort);
-    if (abort) throw the::exception("aborted", __FILE__, __LINE__);
-    peer_node->on_disconnecting(this, abort);
-    if (abort) throw the::exception("aborted", __FILE__, __LINE__);
+    {
+        // a duplicate call returns before any event is fired
+        auto_lock<critical_section> lock(node::graph_lock);
+        if (!this->is_connected(peer)) return;
+        if (!node::reserve_pair(this, peer_node)) return;
+    }
 
     try {
-        this->peer_nodes.erase(this_it);
+        // the events are fired outside the lock
+        bool abort = false;
+        this->on_disconnecting(peer, abort);
+        if (abort) throw the::exception("aborted", __FILE__, __LINE__);
+        peer_node->on_disconnecting(this, abort);
+        if (abort) throw the::exception("aborted", __FILE__, __LINE__);
     } catch(...) {
-        THE_ASSERT(std::find(this->peer_nodes.begin(), this->peer_nodes.end(), peer)
-            == this->peer_nodes.end());
+        auto_lock<critical_section> lock(node::graph_lock);
+        node::release_pair(this, peer_node);
+        throw;
     }
-    try {
-        peer_node->peer_nodes.erase(node_it);
-    } catch(...) {
-        THE_ASSERT(std::find(peer_node->peer_nodes.begin(), peer_node->peer_nodes.end(), this)
-            == peer_node->peer_nodes.end());
+
+    {
+        // the reservation keeps other calls from changing the pair
+        auto_lock<critical_section> lock(node::graph_lock);
+        peer_list this_next(this->get_peers()->all);
+        peer_list::iterator this_it = std::find(this_next.begin(), this_next.end(), peer);
+        THE_ASSERT(this_it != this_next.end());
+
+        peer_list peer_next(peer_node->get_peers()->all);
+        peer_list::iterator node_it = std::find(peer_next.begin(), peer_next.end(), this);
+        THE_ASSERT(node_it != peer_next.end());
+
+        if (this_it != this_next.end()) this_next.erase(this_it);
+        if (node_it != peer_next.end()) peer_next.erase(node_it);
+        this->set_peers(node::make_snapshot(this_next));
+        peer_node->set_peers(node::make_snapshot(peer_next));
+        node::release_pair(this, peer_node);
     }
 
     this->on_disconnected(peer);
@@ -119,17 +172,13 @@ void node::disconnect(api_ptr_base peer) {
  * node::disconnect_all
  */
 void node::disconnect_all(void) {
-    the::system::threading::auto_lock<node>(*this);
-
-    std::vector<api_ptr_base> ary(this->peer_nodes);
+    std::vector<api_ptr_base> ary(this->get_peers()->all);
     size_t cnt = ary.size();
     for (size_t i = 0; i < cnt; ++i) {
         node* n = dynamic_cast<node*>(ary[i].get());
         THE_ASSERT(n != nullptr);
         n->disconnect(this);
     }
-
-    THE_ASSERT(this->peer_nodes.size() == 0);
 }
 
 
@@ -137,14 +186,10 @@ void node::disconnect_all(void) {
  * node::disconnect_all_recursively
  */
 void node::disconnect_all_recursively(void) {
-    the::system::threading::auto_lock<node>(*this);
-
-    std::vector<api_ptr_base> ary(this->peer_nodes);
+    std::vector<api_ptr_base> ary(this->get_peers()->all);
     size_t cnt = ary.size();
     this->disconnect_all();
 
-    THE_ASSERT(this->peer_nodes.size() == 0);
-
     for (size_t i = 0; i < cnt; ++i) {
         node* n = dynamic_cast<node*>(ary[i].get());
         THE_ASSERT(n != nullptr);
@@ -158,10 +203,8 @@ void node::disconnect_all_recursively(void) {
  * node::is_connected
  */
 bool node::is_connected(api_ptr_base peer) {
-    the::system::threading::auto_lock<node>(*this);
-    return std::find(this->peer_nodes.begin(),
-        this->peer_nodes.end(), peer)
-        != this->peer_nodes.end();
+    std::shared_ptr<const peer_snapshot> peers = this->get_peers();
+    return std::find(peers->all.begin(), peers->all.end(), peer) != peers->all.end();
 }
 
 
@@ -195,3 +238,46 @@ void node::on_disconnecting(api_ptr_base peer, bool& abort) {
 void node::on_disconnected(api_ptr_base peer) {
     this->disconnected_event(peer);
 }
+
+
+/*
+ * node::reserve_pair
+ */
+bool node::reserve_pair(const node *a, const node *b) {
+    for (size_t i = 0, cnt = node::pending_pairs.size(); i < cnt; ++i) {
+        const std::pair<const node*, const node*>& p = node::pending_pairs[i];
+        if (((p.first == a) && (p.second == b)) || ((p.first == b) && (p.second == a))) {
+            return false;
+        }
+    }
+    node::pending_pairs.push_back(std::make_pair(a, b));
+    return true;
+}
+
+
+/*
+ * node::release_pair
+ */
+void node::release_pair(const node *a, const node *b) {
+    std::vector<std::pair<const node*, const node*> >::iterator i = std::find(
+        node::pending_pairs.begin(), node::pending_pairs.end(), std::make_pair(a, b));
+    THE_ASSERT(i != node::pending_pairs.end());
+    if (i != node::pending_pairs.end()) node::pending_pairs.erase(i);
+}
+
+
+/*
+ * node::make_snapshot
+ */
+std::shared_ptr<const node::peer_snapshot> node::make_snapshot(const peer_list& all) {
+    std::shared_ptr<peer_snapshot> s = std::make_shared<peer_snapshot>();
+    s->all = all;
+    for (peer_list::iterator i = s->all.begin(); i != s->all.end(); ++i) {
+        node *n = dynamic_cast<node*>(i->get());
+        if (n == nullptr) continue;
+        node_kind k = n->get_kind();
+        if (k == node_kind::other) continue;
+        s->by_kind[static_cast<size_t>(k)].push_back(n);
+    }
+    return s;
+}
@@ -16,6 +16,7 @@
 #include "rivlib/api_ptr_base.h"
 #include "rivlib/api_ptr.h"
 #include "the/system/threading/auto_lock.h"
+#include "the/system/threading/critical_section.h"
 #include "the/multicast_delegate.h"
 #include "error_log.h"
 #include <vector>
@@ -26,12 +27,116 @@ namespace eu_vicci {
 namespace rivlib {
 
 
+    /**
+     * The kinds of nodes indexed in the peer lists of their peers. A node
+     * class of a kind other than 'other' declares a static member 'kind'
+     * and returns it from 'get_kind'.
+     */
+    enum class node_kind : unsigned int {
+
+        /** Not indexed */
+        other = 0,
+
+        /** encoder::image_encoder_base */
+        image_encoder = 1,
+
+        /** raw_image_data_binding_impl */
+        image_data_binding = 2,
+
+        /** ip_connection */
+        ip_connection = 3
+
+    };
+
+
+    /** The number of node kinds */
+    const size_t node_kind_count = 4;
+
+
     /**
      * Base class for rivlib internal node objects
      */
     class node : public node_base {
     public:
 
+        /** Type of the lists of connected peers */
+        typedef std::vector<api_ptr_base> peer_list;
+
+        /**
+         * Immutable snapshot of the connected peers of a node. The peers of
+         * each kind are additionally indexed as 'node' pointers, which stay
+         * valid as long as the snapshot holds the peers in 'all'.
+         */
+        typedef struct _peer_snapshot_t {
+
+            /** All connected peers */
+            peer_list all;
+
+            /** The connected peers of each kind */
+            std::vector<node*> by_kind[node_kind_count];
+
+        } peer_snapshot;
+
+        /**
+         * The connected peers of one kind, iterable without allocating and
+         * without casting each peer.
+         *
+         * @param T The node class of the kind, declaring a static member 'kind'
+         */
+        template<class T>
+        class peer_range {
+        public:
+
+            /**
+             * ctor
+             *
+             * @param snapshot The snapshot of the peers
+             */
+            peer_range(std::shared_ptr<const peer_snapshot> snapshot)
+                    : snapshot(snapshot),
+                    peers(&snapshot->by_kind[static_cast<size_t>(T::kind)]) {
+                // intentionally empty
+            }
+
+            /**
+             * Answer the number of peers
+             *
+             * @return The number of peers
+             */
+            inline size_t size(void) const {
+                return this->peers->size();
+            }
+
+            /**
+             * Answer whether there are no peers
+             *
+             * @return True if there are no peers
+             */
+            inline bool empty(void) const {
+                return this->peers->empty();
+            }
+
+            /**
+             * Answer a peer
+             *
+             * @param i The zero-based index of the peer
+             *
+             * @return The peer
+             */
+            inline T* operator[](size_t i) const {
+                return static_cast<T*>((*this->peers)[i]);
+            }
+
+        private:
+
+            /** The snapshot, keeping the peers alive */
+            std::shared_ptr<const peer_snapshot> snapshot;
+
+            /** The peers of the kind */
+            const std::vector<node*> *peers;
+
+        };
+
         /** Dtor */
         virtual ~node(void);
 
@@ -97,6 +202,37 @@ namespace rivlib {
          */
         std::shared_ptr<node_base> get_api_ptr(void);
 
+        /**
+         * Answer the kind of this node
+         *
+         * @return The kind of this node
+         */
+        virtual node_kind get_kind(void) const;
+
+        /**
+         * Answer the current snapshot of all connected peers. Connecting or
+         * disconnecting peers replaces the snapshot instead of modifying it,
+         * so readers need no lock.
+         *
+         * @return The snapshot of all connected peers
+         */
+        inline std::shared_ptr<const peer_snapshot> get_peers(void) const {
+            return std::atomic_load(&this->peer_nodes);
+        }
+
+        /**
+         * Answer the connected peers of the kind of 'T'. Prefer this over
+         * 'select' on paths run per frame or per message.
+         *
+         * @param T The node class of the kind, declaring a static member 'kind'
+         *
+         * @return The connected peers of the kind
+         */
+        template<class T>
+        inline peer_range<T> peers_of(void) const {
+            return peer_range<T>(this->get_peers());
+        }
+
         /**
          * Creates a list of all connected peers which can be cast to the
          * template parameter type
@@ -178,11 +314,64 @@ namespace rivlib {
 
     private:
 
+        /**
+         * Serialises all changes of the peer lists. Connecting two nodes
+         * changes both lists, so one lock for all nodes avoids any lock
+         * ordering. Readers never take this lock.
+         */
+        static the::system::threading::critical_section graph_lock;
+
+        /**
+         * The pairs of nodes currently being connected or disconnected.
+         * Only accessed holding 'graph_lock'.
+         */
+        static std::vector<std::pair<const node*, const node*> > pending_pairs;
+
+        /**
+         * Marks a pair of nodes as being connected or disconnected. The
+         * caller must hold 'graph_lock'.
+         *
+         * @param a The one node
+         * @param b The other node
+         *
+         * @return False if the pair is already being connected or
+         *         disconnected by another call
+         */
+        static bool reserve_pair(const node *a, const node *b);
+
+        /**
+         * Removes the mark set by 'reserve_pair'. The caller must hold
+         * 'graph_lock'.
+         *
+         * @param a The one node
+         * @param b The other node
+         */
+        static void release_pair(const node *a, const node *b);
+
+        /**
+         * Builds the snapshot of a list of peers
+         *
+         * @param all The peers
+         *
+         * @return The snapshot
+         */
+        static std::shared_ptr<const peer_snapshot> make_snapshot(const peer_list& all);
+
+        /**
+         * Replaces the snapshot of connected peers. The caller must hold
+         * 'graph_lock'.
+         *
+         * @param peers The new snapshot
+         */
+        inline void set_peers(std::shared_ptr<const peer_snapshot> peers) {
+            std::atomic_store(&this->peer_nodes, peers);
+        }
+
         /** This weak pointer will be used to construct all api_ptr objects from */
         std::weak_ptr<node_base> self_api_ptr;
 
-        /** The list of all connected peer objects */
-        std::vector<api_ptr_base> peer_nodes;
+        /** The snapshot of all connected peer objects */
+        std::shared_ptr<const peer_snapshot> peer_nodes;
 
         /** The event called before a new connection is established */
         the::multicast_delegate<the::delegate<void, api_ptr_base, bool&> > connecting_event;
@@ -204,13 +393,13 @@ namespace rivlib {
      */
     template<class T>
     std::vector<api_ptr_base> node::select(void) {
-        the::system::threading::auto_lock<node>(*this);
+        std::shared_ptr<const peer_snapshot> peers = this->get_peers();
         std::vector<api_ptr_base> ret;
-        size_t cnt = this->peer_nodes.size();
+        size_t cnt = peers->all.size();
         for (size_t i = 0; i < cnt; i++) {
-            api_ptr_base& n = this->peer_nodes[i];
-            if (dynamic_cast<T*>(n.get()) != nullptr) {
-                ret.push_back(this->peer_nodes[i]);
+            const api_ptr_base& n = peers->all[i];
+            if (dynamic_cast<const T*>(n.get()) != nullptr) {
+                ret.push_back(n);
             }
         }
         return ret;
@@ -0,0 +1,136 @@
+/*
+ * shm_ring.cpp
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+#include "stdafx.h"
+#include "shm_ring.h"
+#include "the/text/string_builder.h"
+#include "the/system/threading/auto_lock.h"
+#include "vislib/Process.h"
+#include <random>
+
+using namespace eu_vicci::rivlib;
+
+
+/*
+ * shm_ring::name_lock
+ */
+the::system::threading::critical_section shm_ring::name_lock;
+
+
+/*
+ * shm_ring::name_cnt
+ */
+unsigned int shm_ring::name_cnt = 0;
+
+
+/*
+ * shm_ring::shm_ring
+ */
+shm_ring::shm_ring(void) : mem(), ring_name(), size(0), reserved() {
+    // intentionally empty
+}
+
+
+/*
+ * shm_ring::~shm_ring
+ */
+shm_ring::~shm_ring(void) {
+    this->close();
+}
+
+
+/*
+ * shm_ring::create
+ */
+void shm_ring::create(uint32_t slot_count, uint32_t slot_size) {
+    using namespace vislib::sys;
+    unsigned int cnt;
+    {
+        the::system::threading::auto_lock<the::system::threading::critical_section> lock(name_lock);
+        cnt = ++name_cnt;
+    }
+
+    // a random name keeps other processes from guessing the segment
+    std::random_device random;
+    std::string secret;
+    for (int i = 0; i < 4; ++i) {
+        secret += the::text::astring_builder::format("%08x", static_cast<unsigned int>(random()));
+    }
+
+    this->close();
+    this->ring_name = the::text::astring_builder::format("rivlib_%u_%u_%s",
+        static_cast<unsigned int>(Process::CurrentID()), cnt, secret.c_str());
+    this->mem.Open(this->ring_name.c_str(), SharedMemory::READ_WRITE,
+        SharedMemory::CREATE_ONLY, static_cast<SharedMemory::FileSize>(slot_count) * slot_size,
+        true);
+    this->size = slot_size;
+    this->reserved.assign(slot_count, false);
+}
+
+
+/*
+ * shm_ring::open
+ */
+void shm_ring::open(const std::string& name, uint32_t slot_count, uint32_t slot_size) {
+    using namespace vislib::sys;
+
+    this->close();
+    this->mem.Open(name.c_str(), SharedMemory::READ_WRITE,
+        SharedMemory::OPEN_ONLY, static_cast<SharedMemory::FileSize>(slot_count) * slot_size);
+    this->ring_name = name;
+    this->size = slot_size;
+    this->reserved.assign(slot_count, false);
+}
+
+
+/*
+ * shm_ring::close
+ */
+void shm_ring::close(void) {
+    try {
+        // the first side closing the segment removes its name
+        this->mem.Close();
+    } catch(...) {
+    }
+    this->ring_name.clear();
+    this->size = 0;
+    this->reserved.clear();
+}
+
+
+/*
+ * shm_ring::reserve_slot
+ */
+int shm_ring::reserve_slot(void) {
+    for (size_t i = 0, cnt = this->reserved.size(); i < cnt; ++i) {
+        if (!this->reserved[i]) {
+            this->reserved[i] = true;
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+
+/*
+ * shm_ring::release_slot
+ */
+void shm_ring::release_slot(uint32_t idx) {
+    if (idx < this->reserved.size()) {
+        this->reserved[idx] = false;
+    }
+}
+
+
+/*
+ * shm_ring::is_idle
+ */
+bool shm_ring::is_idle(void) const {
+    for (size_t i = 0, cnt = this->reserved.size(); i < cnt; ++i) {
+        if (this->reserved[i]) return false;
+    }
+    return true;
+}
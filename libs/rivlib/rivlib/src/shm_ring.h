@@ -0,0 +1,162 @@
+/*
+ * shm_ring.h
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+
+#ifndef VICCI_RIVLIB_SHM_RING_H_INCLUDED
+#define VICCI_RIVLIB_SHM_RING_H_INCLUDED
+#if (defined(_MSC_VER) && (_MSC_VER > 1000))
+#pragma once
+#endif /* (defined(_MSC_VER) && (_MSC_VER > 1000)) */
+
+#include "the/config.h"
+#include "the/types.h"
+#include "the/system/threading/critical_section.h"
+#include "vislib/SharedMemory.h"
+#include <string>
+#include <vector>
+
+
+namespace eu_vicci {
+namespace rivlib {
+
+    /**
+     * Ring of equally sized image slots in a shared memory segment, used to
+     * pass images to clients on the same host without copying them through
+     * the socket. The provider creates the ring and reserves slots, the
+     * client opens the ring by its name. Slot reservations are only tracked
+     * on the provider side; the client releases slots by messages.
+     */
+    class shm_ring {
+    public:
+
+        /** ctor */
+        shm_ring(void);
+
+        /** dtor */
+        ~shm_ring(void);
+
+        /**
+         * Creates a new shared memory segment with a unique, random name,
+         * which only the user of this process may open
+         *
+         * @param slot_count The number of slots
+         * @param slot_size The size of each slot in bytes
+         *
+         * @throws vislib::sys::SystemException if the segment cannot be created
+         */
+        void create(uint32_t slot_count, uint32_t slot_size);
+
+        /**
+         * Opens a shared memory segment created by the provider
+         *
+         * @param name The name of the segment
+         * @param slot_count The number of slots
+         * @param slot_size The size of each slot in bytes
+         *
+         * @throws vislib::sys::SystemException if the segment cannot be opened
+         */
+        void open(const std::string& name, uint32_t slot_count, uint32_t slot_size);
+
+        /**
+         * Closes the shared memory segment
+         */
+        void close(void);
+
+        /**
+         * Answer whether the segment is open
+         *
+         * @return True if the segment is open
+         */
+        inline bool is_open(void) const {
+            return this->mem.IsOpen();
+        }
+
+        /**
+         * Reserves a free slot
+         *
+         * @return The index of the reserved slot or -1 if all slots are in use
+         */
+        int reserve_slot(void);
+
+        /**
+         * Releases a reserved slot
+         *
+         * @param idx The index of the slot
+         */
+        void release_slot(uint32_t idx);
+
+        /**
+         * Answer whether no slot is reserved
+         *
+         * @return True if no slot is reserved
+         */
+        bool is_idle(void) const;
+
+        /**
+         * Answer the memory of a slot
+         *
+         * @param idx The index of the slot
+         *
+         * @return The memory of the slot
+         */
+        inline uint8_t *slot(uint32_t idx) {
+            return this->mem.As<uint8_t>() + static_cast<size_t>(idx) * this->size;
+        }
+
+        /**
+         * Answer the name of the segment
+         *
+         * @return The name of the segment
+         */
+        inline const std::string& name(void) const {
+            return this->ring_name;
+        }
+
+        /**
+         * Answer the number of slots
+         *
+         * @return The number of slots
+         */
+        inline uint32_t slot_count(void) const {
+            return static_cast<uint32_t>(this->reserved.size());
+        }
+
+        /**
+         * Answer the size of each slot in bytes
+         *
+         * @return The size of each slot in bytes
+         */
+        inline uint32_t slot_size(void) const {
+            return this->size;
+        }
+
+    private:
+
+        /** The lock for 'name_cnt' */
+        static the::system::threading::critical_section name_lock;
+
+        /** The number of segment names generated by this process */
+        static unsigned int name_cnt;
+
+        /** The shared memory segment */
+        vislib::sys::SharedMemory mem;
+
+        /** The name of the segment */
+        std::string ring_name;
+
+        /** The size of each slot in bytes */
+        uint32_t size;
+
+        /** Flags of the reserved slots */
+        std::vector<bool> reserved;
+
+    };
+
+
+} /* end namespace rivlib */
+} /* end namespace eu_vicci */
+
+#endif /* VICCI_RIVLIB_SHM_RING_H_INCLUDED */
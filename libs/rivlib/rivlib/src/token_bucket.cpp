@@ -0,0 +1,88 @@
+/*
+ * token_bucket.cpp
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+#include "stdafx.h"
+#include "token_bucket.h"
+#include "the/math/functions.h"
+#include "the/system/performance_counter.h"
+#include "the/system/threading/auto_lock.h"
+
+using namespace eu_vicci::rivlib;
+using namespace the::system::threading;
+
+
+/*
+ * token_bucket::token_bucket
+ */
+token_bucket::token_bucket(void) : rate(0), burst(0.0), tokens(0.0),
+        last_refill(0.0), lock() {
+    // intentionally empty
+}
+
+
+/*
+ * token_bucket::~token_bucket
+ */
+token_bucket::~token_bucket(void) {
+    // intentionally empty
+}
+
+
+/*
+ * token_bucket::set_rate
+ */
+void token_bucket::set_rate(uint64_t rate, uint64_t burst) {
+    auto_lock<critical_section> l(this->lock);
+    this->rate = rate;
+    this->burst = static_cast<double>((burst > 0) ? burst : (rate / 10));
+    this->tokens = this->burst;
+    this->last_refill = the::system::performance_counter::query_millis();
+}
+
+
+/*
+ * token_bucket::is_over_budget
+ */
+bool token_bucket::is_over_budget(void) {
+    auto_lock<critical_section> l(this->lock);
+    if (this->rate == 0) return false;
+    this->refill();
+    return (this->tokens < -this->burst);
+}
+
+
+/*
+ * token_bucket::consume
+ */
+void token_bucket::consume(size_t size) {
+    auto_lock<critical_section> l(this->lock);
+    if (this->rate == 0) return;
+    this->refill();
+    this->tokens -= static_cast<double>(size);
+}
+
+
+/*
+ * token_bucket::ready_time
+ */
+double token_bucket::ready_time(void) {
+    auto_lock<critical_section> l(this->lock);
+    if (this->rate == 0) return 0.0;
+    this->refill();
+    if (this->tokens >= 0.0) return 0.0;
+    return this->last_refill - this->tokens * 1000.0 / static_cast<double>(this->rate);
+}
+
+
+/*
+ * token_bucket::refill
+ */
+void token_bucket::refill(void) {
+    double now = the::system::performance_counter::query_millis();
+    this->tokens = the::math::minimum(this->burst,
+        this->tokens + (now - this->last_refill) * static_cast<double>(this->rate) / 1000.0);
+    this->last_refill = now;
+}
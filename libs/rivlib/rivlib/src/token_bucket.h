@@ -0,0 +1,111 @@
+/*
+ * token_bucket.h
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+
+#ifndef VICCI_RIVLIB_TOKEN_BUCKET_H_INCLUDED
+#define VICCI_RIVLIB_TOKEN_BUCKET_H_INCLUDED
+#if (defined(_MSC_VER) && (_MSC_VER > 1000))
+#pragma once
+#endif /* (defined(_MSC_VER) && (_MSC_VER > 1000)) */
+
+#include "the/config.h"
+#include "the/types.h"
+#include "the/system/threading/critical_section.h"
+#include <memory>
+
+
+namespace eu_vicci {
+namespace rivlib {
+
+    /**
+     * Token bucket limiting the egress rate of image data.
+     *
+     * The bucket is filled with 'rate' bytes per second up to its burst
+     * size. Sending consumes tokens and may take the bucket into debt, as
+     * images are never split; the next image is then paced until the debt
+     * is paid off. Buckets may be shared by several connections, e.g. all
+     * connections of one provider.
+     */
+    class token_bucket {
+    public:
+
+        /** The pointer type for shared buckets */
+        typedef std::shared_ptr<token_bucket> shared_ptr;
+
+        /** ctor, creating an unlimited bucket */
+        token_bucket(void);
+
+        /** dtor */
+        ~token_bucket(void);
+
+        /**
+         * Sets the egress rate
+         *
+         * @param rate The rate in bytes per second or zero for unlimited
+         * @param burst The burst size in bytes or zero for a tenth of the
+         *              rate
+         */
+        void set_rate(uint64_t rate, uint64_t burst = 0);
+
+        /**
+         * Answer the egress rate
+         *
+         * @return The rate in bytes per second or zero for unlimited
+         */
+        inline uint64_t get_rate(void) const {
+            return this->rate;
+        }
+
+        /**
+         * Answer whether the debt of the bucket is larger than its burst
+         * size. This happens if several connections share the bucket, and
+         * images should be dropped then instead of being sent.
+         *
+         * @return True if images should not be sent now
+         */
+        bool is_over_budget(void);
+
+        /**
+         * Consumes tokens for bytes sent
+         *
+         * @param size The number of bytes sent
+         */
+        void consume(size_t size);
+
+        /**
+         * Answer the time the bucket is out of debt
+         *
+         * @return The time in performance counter milliseconds, or zero if
+         *         sending is possible right now
+         */
+        double ready_time(void);
+
+    private:
+
+        /** Refills the bucket for the time elapsed. The caller must hold 'lock'. */
+        void refill(void);
+
+        /** The rate in bytes per second, zero for unlimited */
+        uint64_t rate;
+
+        /** The burst size in bytes */
+        double burst;
+
+        /** The available tokens (negative for debt) */
+        double tokens;
+
+        /** The time of the last refill in performance counter milliseconds */
+        double last_refill;
+
+        /** The lock for the bucket state */
+        the::system::threading::critical_section lock;
+
+    };
+
+} /* end namespace rivlib */
+} /* end namespace eu_vicci */
+
+#endif /* VICCI_RIVLIB_TOKEN_BUCKET_H_INCLUDED */
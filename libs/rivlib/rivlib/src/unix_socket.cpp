@@ -0,0 +1,280 @@
+/*
+ * unix_socket.cpp
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+#include "stdafx.h"
+#include "unix_socket.h"
+
+#ifndef _WIN32
+
+#include "vislib/PeerDisconnectedException.h"
+#include "vislib/SocketException.h"
+#include "vislib/SystemException.h"
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace eu_vicci::rivlib;
+
+
+namespace {
+
+    /** The maximum number of file descriptors received with one call */
+    const size_t max_received_fds = 4;
+
+    /**
+     * Fills the socket address for a socket name
+     *
+     * @param name The socket name
+     * @param addr Receives the address
+     *
+     * @return The size of the address
+     */
+    socklen_t make_address(const std::string& name, struct sockaddr_un& addr) {
+        ::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (name.empty() || (name.length() >= sizeof(addr.sun_path))) {
+            throw vislib::net::SocketException(ENAMETOOLONG, __FILE__, __LINE__);
+        }
+        ::memcpy(addr.sun_path, name.c_str(), name.length());
+        if (name[0] == '@') {
+            // abstract names are not terminated
+            addr.sun_path[0] = '\0';
+            return static_cast<socklen_t>(offsetof(struct sockaddr_un, sun_path) + name.length());
+        }
+        return static_cast<socklen_t>(sizeof(addr));
+    }
+
+}
+
+
+/*
+ * unix_socket::listen
+ */
+SOCKET unix_socket::listen(const std::string& name) {
+    struct sockaddr_un addr;
+    socklen_t addr_len = make_address(name, addr);
+
+    SOCKET s = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (s < 0) throw vislib::net::SocketException(__FILE__, __LINE__);
+
+    int rv = ::bind(s, reinterpret_cast<struct sockaddr*>(&addr), addr_len);
+    if ((rv != 0) && (errno == EADDRINUSE) && (name[0] != '@')) {
+        // remove the file of a dead server, but never steal a live one
+        SOCKET t = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if ((t >= 0) && (::connect(t, reinterpret_cast<struct sockaddr*>(&addr), addr_len) != 0)
+                && (errno == ECONNREFUSED)) {
+            ::unlink(name.c_str());
+            rv = ::bind(s, reinterpret_cast<struct sockaddr*>(&addr), addr_len);
+        } else {
+            errno = EADDRINUSE;
+        }
+        if (t >= 0) ::close(t);
+    }
+    if ((rv != 0) || (::listen(s, SOMAXCONN) != 0)) {
+        int err = errno;
+        ::close(s);
+        throw vislib::net::SocketException(err, __FILE__, __LINE__);
+    }
+
+    return s;
+}
+
+
+/*
+ * unix_socket::connect
+ */
+SOCKET unix_socket::connect(const std::string& name) {
+    struct sockaddr_un addr;
+    socklen_t addr_len = make_address(name, addr);
+
+    SOCKET s = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (s < 0) throw vislib::net::SocketException(__FILE__, __LINE__);
+
+    int rv;
+    do {
+        rv = ::connect(s, reinterpret_cast<struct sockaddr*>(&addr), addr_len);
+    } while ((rv != 0) && (errno == EINTR));
+    if (rv != 0) {
+        int err = errno;
+        ::close(s);
+        throw vislib::net::SocketException(err, __FILE__, __LINE__);
+    }
+
+    return s;
+}
+
+
+/*
+ * unix_socket::unlink
+ */
+void unix_socket::unlink(const std::string& name) {
+    if (name.empty() || (name[0] == '@')) return;
+    ::unlink(name.c_str());
+}
+
+
+/*
+ * unix_socket::send
+ */
+size_t unix_socket::send(SOCKET socket, const vislib::net::Socket::SendBuffer *buffers,
+        size_t cnt, int fd) {
+    std::vector<struct iovec> iov(cnt);
+    for (size_t i = 0; i < cnt; ++i) {
+        iov[i].iov_base = const_cast<void*>(buffers[i].Data);
+        iov[i].iov_len = buffers[i].Size;
+    }
+
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } ctrl;
+    ::memset(&ctrl, 0, sizeof(ctrl));
+
+    struct msghdr msg;
+    ::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov.data();
+    msg.msg_iovlen = cnt;
+    msg.msg_control = ctrl.buf;
+    msg.msg_controllen = sizeof(ctrl.buf);
+
+    struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+    c->cmsg_level = SOL_SOCKET;
+    c->cmsg_type = SCM_RIGHTS;
+    c->cmsg_len = CMSG_LEN(sizeof(int));
+    ::memcpy(CMSG_DATA(c), &fd, sizeof(int));
+
+    ssize_t rv;
+    do {
+        rv = ::sendmsg(socket, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+    } while ((rv < 0) && (errno == EINTR));
+    if (rv < 0) throw vislib::net::SocketException(__FILE__, __LINE__);
+
+    return static_cast<size_t>(rv);
+}
+
+
+/*
+ * unix_socket::receive
+ */
+size_t unix_socket::receive(SOCKET socket, void *data, size_t size, std::deque<int>& fds) {
+    size_t received = 0;
+
+    while (received < size) {
+        struct iovec iov;
+        iov.iov_base = static_cast<uint8_t*>(data) + received;
+        iov.iov_len = size - received;
+
+        union {
+            struct cmsghdr align;
+            char buf[CMSG_SPACE(max_received_fds * sizeof(int))];
+        } ctrl;
+
+        struct msghdr msg;
+        ::memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = ctrl.buf;
+        msg.msg_controllen = sizeof(ctrl.buf);
+
+        ssize_t rv = ::recvmsg(socket, &msg, MSG_CMSG_CLOEXEC);
+        if (rv < 0) {
+            if (errno == EINTR) continue;
+            throw vislib::net::SocketException(__FILE__, __LINE__);
+        }
+
+        for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c != nullptr; c = CMSG_NXTHDR(&msg, c)) {
+            if ((c->cmsg_level != SOL_SOCKET) || (c->cmsg_type != SCM_RIGHTS)) continue;
+            size_t cnt = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            for (size_t i = 0; i < cnt; ++i) {
+                int fd;
+                ::memcpy(&fd, CMSG_DATA(c) + i * sizeof(int), sizeof(int));
+                fds.push_back(fd);
+            }
+        }
+
+        if (rv == 0) {
+            throw vislib::net::PeerDisconnectedException(
+                "Peer disconnected from unix socket", __FILE__, __LINE__);
+        }
+        received += static_cast<size_t>(rv);
+    }
+
+    return received;
+}
+
+
+/*
+ * unix_socket::create_memory_file
+ */
+int unix_socket::create_memory_file(const vislib::net::Socket::SendBuffer *buffers, size_t cnt) {
+    int fd = ::memfd_create("rivlib_frame", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) throw vislib::sys::SystemException(__FILE__, __LINE__);
+
+    size_t size = 0;
+    std::vector<struct iovec> iov(cnt);
+    for (size_t i = 0; i < cnt; ++i) {
+        iov[i].iov_base = const_cast<void*>(buffers[i].Data);
+        iov[i].iov_len = buffers[i].Size;
+        size += buffers[i].Size;
+    }
+
+    size_t written = 0;
+    size_t first = 0;
+    while (written < size) {
+        ssize_t rv = ::writev(fd, iov.data() + first, static_cast<int>(cnt - first));
+        if (rv < 0) {
+            if (errno == EINTR) continue;
+            int err = errno;
+            ::close(fd);
+            throw vislib::sys::SystemException(err, __FILE__, __LINE__);
+        }
+        written += static_cast<size_t>(rv);
+        // skip the completely written buffers
+        size_t skip = static_cast<size_t>(rv);
+        while ((first < cnt) && (skip >= iov[first].iov_len)) {
+            skip -= iov[first].iov_len;
+            first++;
+        }
+        if (first < cnt) {
+            iov[first].iov_base = static_cast<uint8_t*>(iov[first].iov_base) + skip;
+            iov[first].iov_len -= skip;
+        }
+    }
+
+    // the receiver can rely on the size and content of a sealed file
+    if (::fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) != 0) {
+        int err = errno;
+        ::close(fd);
+        throw vislib::sys::SystemException(err, __FILE__, __LINE__);
+    }
+
+    return fd;
+}
+
+
+/*
+ * unix_socket::unix_socket
+ */
+unix_socket::unix_socket(void) {
+    // intentionally empty
+}
+
+
+/*
+ * unix_socket::~unix_socket
+ */
+unix_socket::~unix_socket(void) {
+    // intentionally empty
+}
+
+#endif /* !_WIN32 */
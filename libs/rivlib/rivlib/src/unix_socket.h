@@ -0,0 +1,127 @@
+/*
+ * unix_socket.h
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+
+#ifndef VICCI_RIVLIB_UNIX_SOCKET_H_INCLUDED
+#define VICCI_RIVLIB_UNIX_SOCKET_H_INCLUDED
+#if (defined(_MSC_VER) && (_MSC_VER > 1000))
+#pragma once
+#endif /* (defined(_MSC_VER) && (_MSC_VER > 1000)) */
+
+#ifndef _WIN32
+
+#include "the/config.h"
+#include "the/types.h"
+#include "vislib/Socket.h"
+#include <deque>
+#include <string>
+
+
+namespace eu_vicci {
+namespace rivlib {
+
+    /**
+     * Utility class for Unix domain stream sockets and the passing of
+     * memory files along the stream.
+     *
+     * Socket names starting with '@' are abstract names, all other names
+     * are file system paths.
+     */
+    class unix_socket {
+    public:
+
+        /**
+         * Creates a listening socket
+         *
+         * @param name The socket name
+         *
+         * @return The socket handle
+         *
+         * @throws vislib::net::SocketException if the socket cannot be created
+         */
+        static SOCKET listen(const std::string& name);
+
+        /**
+         * Creates a socket connected to a listening socket
+         *
+         * @param name The socket name
+         *
+         * @return The socket handle
+         *
+         * @throws vislib::net::SocketException if the socket cannot be connected
+         */
+        static SOCKET connect(const std::string& name);
+
+        /**
+         * Removes the file system entry of a socket name. Abstract names
+         * are ignored.
+         *
+         * @param name The socket name
+         */
+        static void unlink(const std::string& name);
+
+        /**
+         * Sends data without blocking and passes a file descriptor along
+         * with the first byte
+         *
+         * @param socket The socket handle
+         * @param buffers The data to be sent
+         * @param cnt The number of buffers
+         * @param fd The file descriptor to be passed
+         *
+         * @return The number of bytes sent
+         *
+         * @throws vislib::net::SocketException if the data cannot be sent,
+         *         including EAGAIN if the socket buffer is full
+         */
+        static size_t send(SOCKET socket, const vislib::net::Socket::SendBuffer *buffers,
+            size_t cnt, int fd);
+
+        /**
+         * Receives exactly 'size' bytes and collects the passed file
+         * descriptors
+         *
+         * @param socket The socket handle
+         * @param data Receives the data
+         * @param size The number of bytes to be received
+         * @param fds Receives the passed file descriptors in order
+         *
+         * @return The number of bytes received
+         *
+         * @throws vislib::net::PeerDisconnectedException if the peer closed
+         *         the connection
+         * @throws vislib::net::SocketException if the data cannot be received
+         */
+        static size_t receive(SOCKET socket, void *data, size_t size, std::deque<int>& fds);
+
+        /**
+         * Creates a sealed memory file holding the concatenated buffers
+         *
+         * @param buffers The content of the file
+         * @param cnt The number of buffers
+         *
+         * @return The file descriptor
+         *
+         * @throws vislib::sys::SystemException if the file cannot be created
+         */
+        static int create_memory_file(const vislib::net::Socket::SendBuffer *buffers, size_t cnt);
+
+    private:
+
+        /** ctor */
+        unix_socket(void);
+
+        /** dtor */
+        ~unix_socket(void);
+
+    };
+
+} /* end namespace rivlib */
+} /* end namespace eu_vicci */
+
+#endif /* !_WIN32 */
+
+#endif /* VICCI_RIVLIB_UNIX_SOCKET_H_INCLUDED */
@@ -191,6 +191,36 @@ void uri_utility::parse_uri(const std::string& uri,
 }
 
 
+/*
+ * uri_utility::extract_query_value
+ */
+bool uri_utility::extract_query_value(std::string& query, const char *key,
+        std::string& value) {
+    std::string prefix(key);
+    prefix += "=";
+    size_t pos = 0;
+
+    while (pos < query.length()) {
+        size_t end = query.find('&', pos);
+        if (end == std::string::npos) end = query.length();
+        if (query.compare(pos, prefix.length(), prefix) == 0) {
+            value = the::text::string_utility::url_decode_astr(
+                query.substr(pos + prefix.length(), end - pos - prefix.length()));
+            // remove the pair and one separator
+            if (end < query.length()) {
+                query.erase(pos, end - pos + 1);
+            } else {
+                query.erase((pos > 0) ? (pos - 1) : 0);
+            }
+            return true;
+        }
+        pos = end + 1;
+    }
+
+    return false;
+}
+
+
 /*
  * uri_utility::uri_utility
  */
@@ -49,6 +49,18 @@ namespace rivlib {
             std::string& query,
             std::string& fragment);
 
+        /**
+         * Removes a key from a uri query and answers its value
+         *
+         * @param query The query of '&' separated 'key=value' pairs
+         * @param key The key (without '=')
+         * @param value Receives the url decoded value
+         *
+         * @return True if the key has been found
+         */
+        static bool extract_query_value(std::string& query, const char *key,
+            std::string& value);
+
     private:
 
         /** ctor */
@@ -0,0 +1,480 @@
+/*
+ * rivreactorbench.cpp
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+
+#include "stdafx.h"
+#include "rivlib/rivlib.h"
+#include "the/system/performance_counter.h"
+#include "the/system/threading/auto_lock.h"
+#include "the/system/threading/critical_section.h"
+#include "the/system/threading/event.h"
+#include "the/system/threading/thread.h"
+#include "the/text/string_builder.h"
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <tlhelp32.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else /* _WIN32 */
+#include <fstream>
+#endif /* _WIN32 */
+
+using namespace eu_vicci;
+using the::system::performance_counter;
+using namespace the::system::threading;
+
+
+namespace {
+
+    /** The id of the benchmark messages */
+    const unsigned int bench_msg_id = RIVLIB_USERMSG + 1;
+
+    /** The time the connections may take to connect in milliseconds */
+    const double connect_timeout = 10000.0;
+
+    /** The size of the image served for the churn test in pixels */
+    const unsigned int churn_image_size = 64;
+
+    /** The pixels of the image served for the churn test */
+    uint8_t churn_image[churn_image_size * churn_image_size * 3];
+
+    /** The latencies of the benchmark messages received by the provider */
+    typedef struct _latency_stats_t {
+
+        /** The number of messages received */
+        uint64_t count;
+
+        /** The sum of the latencies in milliseconds */
+        double sum_ms;
+
+        /** The largest latency in milliseconds */
+        double max_ms;
+
+    } latency_stats;
+
+    /** The statistics since the last report */
+    latency_stats stats;
+
+    /** The lock for 'stats' */
+    critical_section stats_lock;
+
+#ifndef _WIN32
+    /**
+     * Answer a numeric value of the status of the process
+     *
+     * @param key The key of the value including the colon
+     *
+     * @return The value or zero if unknown
+     */
+    long read_status_value(const char *key) {
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        size_t key_len = ::strlen(key);
+        while (std::getline(status, line)) {
+            if (line.compare(0, key_len, key) == 0) {
+                return ::atol(line.c_str() + key_len);
+            }
+        }
+        return 0;
+    }
+#endif /* !_WIN32 */
+
+    /**
+     * Answer the number of threads of the process
+     *
+     * @return The number of threads or zero if unknown
+     */
+    unsigned int count_threads(void) {
+#ifdef _WIN32
+        unsigned int cnt = 0;
+        DWORD pid = ::GetCurrentProcessId();
+        HANDLE snap = ::CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+        if (snap == INVALID_HANDLE_VALUE) return 0;
+        THREADENTRY32 te;
+        te.dwSize = sizeof(THREADENTRY32);
+        if (::Thread32First(snap, &te)) {
+            do {
+                if (te.th32OwnerProcessID == pid) cnt++;
+            } while (::Thread32Next(snap, &te));
+        }
+        ::CloseHandle(snap);
+        return cnt;
+#else /* _WIN32 */
+        return static_cast<unsigned int>(read_status_value("Threads:"));
+#endif /* _WIN32 */
+    }
+
+    /**
+     * Answer the resident memory of the process
+     *
+     * @return The resident memory in KiB or zero if unknown
+     */
+    unsigned int resident_kib(void) {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS pmc;
+        if (!::GetProcessMemoryInfo(::GetCurrentProcess(), &pmc, sizeof(pmc))) return 0;
+        return static_cast<unsigned int>(pmc.WorkingSetSize / 1024);
+#else /* _WIN32 */
+        return static_cast<unsigned int>(read_status_value("VmRSS:"));
+#endif /* _WIN32 */
+    }
+
+    /**
+     * Records the latency of a benchmark message
+     *
+     * @param id The message id
+     * @param size The size of the message body
+     * @param data The message body, i.e. the send time
+     * @param ctxt Not used
+     */
+    void on_bench_msg(unsigned int id, unsigned int size, const char *data, void *ctxt) {
+        if ((id != bench_msg_id) || (size != sizeof(double))) return;
+        double sent;
+        ::memcpy(&sent, data, sizeof(double));
+        double latency = performance_counter::query_millis() - sent;
+
+        auto_lock<critical_section> lock(stats_lock);
+        stats.count++;
+        stats.sum_ms += latency;
+        if (latency > stats.max_ms) stats.max_ms = latency;
+    }
+
+    /**
+     * Queries the data channels of the provider and selects the first
+     * image stream
+     */
+    class channel_query : public rivlib::control_connection::listener {
+    public:
+
+        /** ctor */
+        channel_query(void) : rivlib::control_connection::listener(),
+                answered(true), name(), type(0), subtype(0) {
+            // intentionally empty
+        }
+
+        /** dtor */
+        virtual ~channel_query(void) {
+            // intentionally empty
+        }
+
+        /**
+         * Queries the data channels as soon as the connection is established
+         *
+         * @param comm The calling control_connection
+         */
+        virtual void on_connected(rivlib::control_connection::ptr comm) throw() {
+            comm->send(static_cast<unsigned int>(rivlib::message_id::query_data_channels), 0, nullptr);
+        }
+
+        /**
+         * Called when the connection has been closed
+         *
+         * @param comm The calling control_connection
+         */
+        virtual void on_disconnected(rivlib::control_connection::ptr comm) throw() {
+            this->answered.set();
+        }
+
+        /**
+         * Called when the connection failed
+         *
+         * @param comm The calling control_connection
+         * @param msg The error message
+         */
+        virtual void on_error(rivlib::control_connection::ptr comm, const char *msg) throw() {
+            ::printf("Control connection error: %s\n", msg);
+            this->answered.set();
+        }
+
+        /**
+         * Selects the image stream from the data channels
+         *
+         * @param comm The calling control_connection
+         * @param id The message id
+         * @param size The message data size (in bytes)
+         * @param data The message data
+         */
+        virtual void on_msg(rivlib::control_connection::ptr comm,
+                unsigned int id, unsigned int size, const void *data) throw() {
+            if (id != static_cast<unsigned int>(rivlib::message_id::data_channels)) return;
+            const uint8_t *d = static_cast<const uint8_t*>(data);
+            size_t pos = sizeof(uint32_t);
+            uint32_t cnt = (size >= pos) ? *reinterpret_cast<const uint32_t*>(d) : 0;
+            for (uint32_t i = 0; i < cnt; ++i) {
+                if (size < pos + sizeof(uint16_t)) break;
+                uint16_t namelen = *reinterpret_cast<const uint16_t*>(d + pos);
+                pos += sizeof(uint16_t);
+                if (size < pos + namelen + 2 * sizeof(uint16_t) + sizeof(uint8_t)) break;
+                std::string n(reinterpret_cast<const char*>(d + pos), namelen);
+                pos += namelen;
+                uint16_t t = *reinterpret_cast<const uint16_t*>(d + pos);
+                uint16_t s = *reinterpret_cast<const uint16_t*>(d + pos + sizeof(uint16_t));
+                pos += 2 * sizeof(uint16_t) + sizeof(uint8_t);
+                if ((t == static_cast<uint16_t>(rivlib::data_channel_type::image_stream))
+                        && (s == static_cast<uint16_t>(rivlib::data_channel_image_stream_subtype::rgb_raw))) {
+                    this->name = n;
+                    this->type = t;
+                    this->subtype = s;
+                    break;
+                }
+            }
+            this->answered.set();
+        }
+
+        /** Set when the data channels have been answered or the connection failed */
+        event answered;
+
+        /** The name of the selected image stream or empty */
+        std::string name;
+
+        /** The type of the selected image stream */
+        uint16_t type;
+
+        /** The subtype of the selected image stream */
+        uint16_t subtype;
+
+    };
+
+    /**
+     * Runs the provider and reports the connections, threads, memory and
+     * message latencies once per second. A small image is served for the
+     * churn test.
+     *
+     * @param port The port of the ip communicator
+     * @param seconds The number of reports, or zero to run forever
+     *
+     * @return The application exit code
+     */
+    int run_provider(unsigned short port, unsigned int seconds) {
+        rivlib::core::ptr core = rivlib::core::create();
+        core->add_communicator(rivlib::ip_communicator::create(port));
+        rivlib::provider::ptr prov = rivlib::provider::create("bench");
+        core->add_provider(prov);
+        prov->add_user_message_callback(&on_bench_msg);
+        rivlib::data_binding::ptr binding = rivlib::raw_image_data_binding::create(
+            churn_image, churn_image_size, churn_image_size,
+            rivlib::image_colour_type::rgb, rivlib::image_data_type::byte,
+            rivlib::image_orientation::bottom_up, churn_image_size * 3);
+        prov->add_data_binding(binding);
+
+        ::printf("Serving riv://localhost:%u/bench\n", static_cast<unsigned int>(port));
+        ::printf("connections  streams  threads  pooled  memory [KiB]  messages  avg latency [ms]  max latency [ms]\n");
+        for (unsigned int i = 0; (seconds == 0) || (i < seconds); ++i) {
+            thread::sleep(1000);
+
+            rivlib::provider_metrics m;
+            prov->get_metrics(m);
+            latency_stats s;
+            {
+                auto_lock<critical_section> lock(stats_lock);
+                s = stats;
+                ::memset(&stats, 0, sizeof(latency_stats));
+            }
+
+            ::printf("%11u  %7u  %7u  %6u  %12u  %8u  %16.3f  %16.3f\n",
+                static_cast<unsigned int>(m.control_connections),
+                static_cast<unsigned int>(m.image_streams), count_threads(),
+                static_cast<unsigned int>(m.pooled_threads), resident_kib(),
+                static_cast<unsigned int>(s.count),
+                (s.count > 0) ? (s.sum_ms / static_cast<double>(s.count)) : 0.0,
+                s.max_ms);
+            ::fflush(stdout);
+        }
+
+        prov->remove_data_binding(binding);
+        prov->remove_user_message_callback(&on_bench_msg);
+        core->shutdown();
+        return 0;
+    }
+
+    /**
+     * Opens control connections to the provider in steps, doubling their
+     * number each step, and sends timestamped messages over all of them
+     *
+     * @param host The host running the provider
+     * @param port The port of the ip communicator
+     * @param max_conns The maximum number of connections
+     * @param msgs The number of messages per connection and step
+     *
+     * @return The application exit code
+     */
+    int run_clients(const char *host, unsigned short port, unsigned int max_conns, unsigned int msgs) {
+        the::astring uri = the::text::astring_builder::format("riv://%s:%u/bench",
+            host, static_cast<unsigned int>(port));
+        std::vector<rivlib::control_connection::ptr> conns;
+
+        ::printf("Connecting to %s\n", uri.c_str());
+        ::printf("connections  connect [ms]  send [ms]\n");
+        for (unsigned int n = 16; conns.size() < max_conns; n *= 2) {
+            if (n > max_conns) n = max_conns;
+
+            double start = performance_counter::query_millis();
+            while (conns.size() < n) {
+                rivlib::control_connection::ptr c = rivlib::control_connection::create();
+                c->connect(uri.c_str());
+                conns.push_back(c);
+            }
+
+            bool connected = false;
+            while (!connected && (performance_counter::query_millis() - start < connect_timeout)) {
+                connected = true;
+                for (size_t i = 0; connected && (i < conns.size()); ++i) {
+                    connected = (conns[i]->get_status() == rivlib::control_connection::status::connected);
+                }
+                if (!connected) thread::sleep(10);
+            }
+            double sending = performance_counter::query_millis();
+
+            if (connected) {
+                for (unsigned int j = 0; j < msgs; ++j) {
+                    for (size_t i = 0; i < conns.size(); ++i) {
+                        double now = performance_counter::query_millis();
+                        conns[i]->send(bench_msg_id, sizeof(double), &now);
+                    }
+                }
+            }
+            double done = performance_counter::query_millis();
+
+            ::printf("%11u  %12.1f  %9.1f%s\n", n, sending - start, done - sending,
+                connected ? "" : "  (connect timeout, nothing sent)");
+            ::fflush(stdout);
+
+            // let the provider report the step
+            thread::sleep(2000);
+        }
+
+        for (size_t i = 0; i < conns.size(); ++i) {
+            conns[i]->disconnect(true);
+        }
+        return 0;
+    }
+
+    /**
+     * Connects and disconnects image streams to the provider as fast as
+     * possible and reports the completed cycles once per second. The
+     * provider reports whether its threads and memory stay bounded.
+     *
+     * @param host The host running the provider
+     * @param port The port of the ip communicator
+     * @param seconds The duration of the test in seconds
+     * @param parallel The number of image streams churned in parallel
+     *
+     * @return The application exit code
+     */
+    int run_churn(const char *host, unsigned short port, unsigned int seconds, unsigned int parallel) {
+        the::astring uri = the::text::astring_builder::format("riv://%s:%u/bench",
+            host, static_cast<unsigned int>(port));
+
+        channel_query query;
+        rivlib::control_connection::ptr ctrl = rivlib::control_connection::create();
+        ctrl->add_listener(&query);
+        ctrl->connect(uri.c_str());
+        query.answered.wait(static_cast<event::timeout_type>(connect_timeout));
+        if (query.name.empty()) {
+            ::printf("No raw image stream at %s\n", uri.c_str());
+            ctrl->disconnect(true);
+            ctrl->remove_listener(&query);
+            return 1;
+        }
+        size_t len = ctrl->make_data_channel_uri(query.name.c_str(), query.type, query.subtype, nullptr, 0);
+        std::vector<char> buf(len);
+        len = ctrl->make_data_channel_uri(query.name.c_str(), query.type, query.subtype, buf.data(), len);
+        std::string stream_uri(buf.data(), len);
+
+        std::vector<rivlib::image_stream_connection::ptr> streams(parallel);
+        std::vector<double> started(parallel, 0.0);
+        unsigned int cycles = 0;
+        unsigned int failures = 0;
+
+        ::printf("Churning %u image streams to %s\n", parallel, stream_uri.c_str());
+        ::printf("cycles/s  failures/s  threads  memory [KiB]\n");
+        double start = performance_counter::query_millis();
+        double report = start + 1000.0;
+        while (performance_counter::query_millis() - start < seconds * 1000.0) {
+            for (unsigned int i = 0; i < parallel; ++i) {
+                double now = performance_counter::query_millis();
+                if (!streams[i]) {
+                    streams[i] = rivlib::image_stream_connection::create();
+                    streams[i]->connect(stream_uri.c_str());
+                    started[i] = now;
+                    continue;
+                }
+                rivlib::image_stream_connection::status st = streams[i]->get_status();
+                if (st == rivlib::image_stream_connection::status::connected) {
+                    cycles++;
+                } else if ((st == rivlib::image_stream_connection::status::not_connected)
+                        || (now - started[i] > connect_timeout)) {
+                    failures++;
+                } else {
+                    continue;
+                }
+                streams[i]->disconnect(true);
+                streams[i].reset();
+            }
+
+            double now = performance_counter::query_millis();
+            if (now >= report) {
+                ::printf("%8u  %10u  %7u  %12u\n", cycles, failures, count_threads(), resident_kib());
+                ::fflush(stdout);
+                cycles = 0;
+                failures = 0;
+                report += 1000.0;
+            }
+        }
+
+        for (unsigned int i = 0; i < parallel; ++i) {
+            if (streams[i]) streams[i]->disconnect(true);
+        }
+        ctrl->disconnect(true);
+        ctrl->remove_listener(&query);
+        return 0;
+    }
+
+}
+
+
+/**
+ * Application main entry point
+ *
+ * Run 'rivreactorbench serve' in one process and 'rivreactorbench connect'
+ * in another one. The provider reports how many threads it needs while the
+ * number of control connections grows. With 'rivreactorbench churn' the
+ * provider reports whether its threads, pooled threads and memory stay
+ * bounded while image streams connect and disconnect continuously.
+ *
+ * @param argc The number of command line arguments
+ * @param argv The command line arguments
+ *
+ * @return The application exit code
+ */
+int main(int argc, char *argv[]) {
+    if ((argc >= 2) && (::strcmp(argv[1], "serve") == 0)) {
+        unsigned short port = (argc >= 3) ? static_cast<unsigned short>(::atoi(argv[2])) : 52000;
+        unsigned int seconds = (argc >= 4) ? static_cast<unsigned int>(::atoi(argv[3])) : 0;
+        return run_provider(port, seconds);
+    }
+    if ((argc >= 3) && (::strcmp(argv[1], "churn") == 0)) {
+        unsigned short port = (argc >= 4) ? static_cast<unsigned short>(::atoi(argv[3])) : 52000;
+        unsigned int seconds = (argc >= 5) ? static_cast<unsigned int>(::atoi(argv[4])) : 60;
+        unsigned int parallel = (argc >= 6) ? static_cast<unsigned int>(::atoi(argv[5])) : 16;
+        if (parallel == 0) parallel = 1;
+        return run_churn(argv[2], port, seconds, parallel);
+    }
+    if ((argc >= 3) && (::strcmp(argv[1], "connect") == 0)) {
+        unsigned short port = (argc >= 4) ? static_cast<unsigned short>(::atoi(argv[3])) : 52000;
+        unsigned int max_conns = (argc >= 5) ? static_cast<unsigned int>(::atoi(argv[4])) : 1024;
+        unsigned int msgs = (argc >= 6) ? static_cast<unsigned int>(::atoi(argv[5])) : 10;
+        return run_clients(argv[2], port, max_conns, msgs);
+    }
+
+    ::printf("Usage: rivreactorbench serve [port] [seconds]\n"
+        "       rivreactorbench connect <host> [port] [max connections] [messages]\n"
+        "       rivreactorbench churn <host> [port] [seconds] [parallel streams]\n");
+    return 1;
+}
@@ -0,0 +1,19 @@
+/*
+ * stdafx.cpp
+ *
+ * Copyright TUD 2013
+ * Alle Rechte vorbehalten. All rights reserved
+ */
+
+#include "stdafx.h"
+
+/*
+ * Intentionally empty
+ */
+
+// stdafx.cpp : source file that includes just the standard includes
+// miniclient.pch will be the pre-compiled header
+// stdafx.obj will contain the pre-compiled type information
+
+// reference any additional headers you need in 'stdafx.h'
+// and not in this file
@@ -162,6 +162,25 @@ namespace net {
         /** Constant for specifying an infinite timeout. */
         static const UINT TIMEOUT_INFINITE;
 
+        /**
+         * The send flag requesting zero-copy transmission (MSG_ZEROCOPY), or
+         * zero if the platform does not support it.
+         */
+        static const INT FLAG_ZEROCOPY;
+
+        /**
+         * Describes one memory range of a gathering send operation.
+         */
+        typedef struct SendBuffer_t {
+
+            /** The data to be sent. The caller remains owner of the memory. */
+            const void *Data;
+
+            /** The number of bytes to be sent from 'Data'. */
+            SIZE_T Size;
+
+        } SendBuffer;
+
         /**
          * Create an invalid socket. Call Create() on the new object to create 
          * a new socket.
@@ -377,6 +396,17 @@ namespace net {
             return this->getOption(SOL_SOCKET, SO_DONTROUTE);
         }
 
+        /**
+         * Answer the native socket handle, e.g. for registering the socket
+         * with an event demultiplexer like epoll or select. The handle
+         * remains owned by the socket and must not be closed by the caller.
+         *
+         * @return The native socket handle.
+         */
+        inline SOCKET GetHandle(void) const {
+            return this->handle;
+        }
+
         /**
          * Answer whether keep-alives are sent.
          *
@@ -808,6 +838,24 @@ namespace net {
             const SIZE_T cntBytes, const INT timeout = TIMEOUT_INFINITE, 
             const INT flags = 0, const bool forceReceive = false);
 
+        /**
+         * Receives the next completion notification of zero-copy sends from
+         * the error queue of the socket. The method does not block.
+         *
+         * The completion ids are counted per socket starting at zero. All
+         * sends with ids from 'outFirst' to 'outLast' (inclusive) have been
+         * completed and their memory may be reused.
+         *
+         * @param outFirst Receives the first completed id.
+         * @param outLast  Receives the last completed id.
+         *
+         * @return true if a notification has been received, false if none
+         *         is pending or zero-copy is not supported.
+         *
+         * @throws SocketException If the operation fails.
+         */
+        bool ReceiveZeroCopyCompletion(UINT32& outFirst, UINT32& outLast);
+
         ///**
         // * Receives one object of type T to 'outData'. The method does not 
         // * return until a full object of type T has been read.
@@ -858,6 +906,41 @@ namespace net {
             const INT timeout = TIMEOUT_INFINITE, const INT flags = 0, 
             const bool forceSend = false);
 
+        /**
+         * Send the memory ranges designated by 'buffers' in this order using
+         * a single gathering send operation (sendmsg or WSASend) per call.
+         *
+         * Note that the timeout is specified for each send call. When
+         * setting the 'forceSend' flag, multiple calls might be needed to get
+         * all requested data and thus the overall timeout will be a multiple
+         * of the specified timeout.
+         *
+         * If 'flags' contains FLAG_ZEROCOPY, the memory must remain valid and
+         * unchanged until the completion has been received using
+         * ReceiveZeroCopyCompletion(). Each successful send call using 
+         * FLAG_ZEROCOPY consumes one completion id. If the kernel cannot pin
+         * the memory, the implementation falls back to copying the data.
+         *
+         * @param buffers             The memory ranges to be sent.
+         * @param cntBuffers          The number of elements in 'buffers'.
+         * @param timeout             A timeout in milliseconds. A value less 
+         *                            than 1 specifies an infinite timeout.
+         * @param flags               The flags that specify the way in which
+         *                            the call is made.
+         * @param forceSend           If this flag is set, the method will not
+         *                            return until all data have been sent.
+         * @param outCntZeroCopySends If not NULL, receives the number of 
+         *                            successful send calls which used 
+         *                            FLAG_ZEROCOPY.
+         *
+         * @return The number of bytes acutally sent.
+         *
+         * @throws SocketException If the operation fails.
+         */
+        SIZE_T Send(const SendBuffer *buffers, const SIZE_T cntBuffers,
+            const INT timeout = TIMEOUT_INFINITE, const INT flags = 0, 
+            const bool forceSend = false, UINT32 *outCntZeroCopySends = NULL);
+
         /**
          * Send a datagram of 'cntBytes' bytes from the location designated by 
          * 'data' using this socket to the socket 'toAddr'.
@@ -953,6 +1036,17 @@ namespace net {
         //    return this->Send(&data, sizeof(T), flags, true);
         //}
 
+        /**
+         * Switch the socket between blocking and non-blocking mode. Calls on
+         * a non-blocking socket which would block fail with a SocketException
+         * with the error code EWOULDBLOCK (WSAEWOULDBLOCK on Windows).
+         *
+         * @param enable true for blocking mode, false for non-blocking mode.
+         *
+         * @throws SocketException If the operation fails.
+         */
+        void SetBlocking(const bool enable);
+
         /**
          * Enable or disable transmission and receipt of broadcast messages on 
          * the socket.
@@ -1051,6 +1145,17 @@ namespace net {
             this->setOption(SOL_SOCKET, SO_OOBINLINE, enable);
         }
 
+        /**
+         * Enable or disable zero-copy transmission (SO_ZEROCOPY) for sends
+         * using FLAG_ZEROCOPY.
+         *
+         * @param enable The new activation state of the option.
+         *
+         * @return true if the option has been set, false if the platform
+         *         or the socket does not support zero-copy transmission.
+         */
+        bool SetZeroCopy(const bool enable);
+
         /**
          * Set a socket option.
          *
@@ -1359,6 +1464,29 @@ namespace net {
         SIZE_T send(const void *data, const SIZE_T cntBytes, 
             const INT flags = 0, const bool forceSend = false);
 
+        /**
+         * Send the memory ranges designated by 'buffers' using this socket.
+         *
+         * This is a blocking call!
+         *
+         * @param buffers             The memory ranges to be sent.
+         * @param cntBuffers          The number of elements in 'buffers'.
+         * @param flags               The flags that specify the way in which
+         *                            the call is made.
+         * @param forceSend           If this flag is set, the method will not
+         *                            return until all data have been sent.
+         * @param outCntZeroCopySends If not NULL, receives the number of 
+         *                            successful send calls which used 
+         *                            FLAG_ZEROCOPY.
+         *
+         * @return The number of bytes acutally sent.
+         *
+         * @throws SocketException If the operation fails.
+         */
+        SIZE_T send(const SendBuffer *buffers, const SIZE_T cntBuffers,
+            const INT flags, const bool forceSend, 
+            UINT32 *outCntZeroCopySends);
+
         /**
          * Send a datagram of 'cntBytes' bytes from the location designated by 
          * 'data' using this socket to the socket 'toAddr'.
@@ -43,6 +43,20 @@ namespace net {
             return SmartRef<TcpCommChannel>(new TcpCommChannel(flags), false);
         }
 
+        /**
+         * Create a channel for an already connected stream socket, e.g. a
+         * Unix domain socket. Unlike the channels created by Accept, no 
+         * socket options are applied, so the socket must not be of a 
+         * protocol family requiring them.
+         *
+         * The channel takes ownership of the socket.
+         *
+         * @param socket The connected socket.
+         *
+         * @return The new channel.
+         */
+        static SmartRef<TcpCommChannel> Attach(Socket& socket);
+
          /**
           * This behaviour flag disables the Nagle algorithm for send 
           * coalescing. Setting the flag has an effect on the communication
@@ -216,6 +230,30 @@ namespace net {
             const UINT timeout = TIMEOUT_INFINITE, 
             const bool forceSend = true);
 
+        /**
+         * Send the memory ranges designated by 'buffers' in this order over
+         * the communication channel using gathering send operations. This
+         * avoids copying the data into one block as well as sending small
+         * segments for each of the ranges.
+         *
+         * @param buffers    The memory ranges to be sent. The caller remains 
+         *                   owner of the memory.
+         * @param cntBuffers The number of elements in 'buffers'.
+         * @param timeout    A timeout in milliseconds. 
+         *                   Use AbstractCommChannel::TIMEOUT_INFINITE to 
+         *                   specify an infinite timeout. If the operation 
+         *                   timeouts, an exception will be thrown.
+         * @param forceSend  If the data cannot be sent at once, repeat the 
+         *                   operation until all data is sent or a step fails.
+         *
+         * @return The number of bytes acutally sent.
+         *
+         * @throws SocketException In case the operation fails.
+         */
+        SIZE_T Send(const Socket::SendBuffer *buffers, const SIZE_T cntBuffers,
+            const UINT timeout = TIMEOUT_INFINITE, 
+            const bool forceSend = true);
+
     private:
 
         /** Superclass typedef. */
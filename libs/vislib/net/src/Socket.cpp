@@ -11,10 +11,16 @@
 #define TEMP_FAILURE_RETRY(e) e
 
 #else /* _WIN32 */
+#include <fcntl.h>
 #include <poll.h>
 #include <sys/socket.h> // panagias: needed for shutdown()
 #include <unistd.h>
 #include <net/if.h>
+#include <sys/uio.h>
+#include <errno.h>
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#include <linux/errqueue.h>
+#endif /* defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) */
 
 #define SOCKET_ERROR (-1)
 #endif /* _WIN32 */
@@ -62,6 +68,16 @@ void vislib::net::Socket::Startup(void) {
 const UINT vislib::net::Socket::TIMEOUT_INFINITE = 0;
 
 
+/*
+ * vislib::net::Socket::FLAG_ZEROCOPY
+ */
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+const INT vislib::net::Socket::FLAG_ZEROCOPY = MSG_ZEROCOPY;
+#else /* defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) */
+const INT vislib::net::Socket::FLAG_ZEROCOPY = 0;
+#endif /* defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) */
+
+
 /*
  * vislib::net::Socket::~Socket
  */
@@ -617,6 +633,55 @@ SIZE_T vislib::net::Socket::Receive(SocketAddress& outFromAddr, void *outData,
 }
 
 
+/*
+ * vislib::net::Socket::ReceiveZeroCopyCompletion
+ */
+bool vislib::net::Socket::ReceiveZeroCopyCompletion(UINT32& outFirst,
+        UINT32& outLast) {
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+    char control[128];          // Buffer for the ancillary data.
+    struct msghdr msg;          // The message read from the error queue.
+    ssize_t rc = 0;             // Return value of recvmsg().
+
+    while (true) {
+        ::memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        TEMP_FAILURE_RETRY(rc = ::recvmsg(this->handle, &msg, 
+            MSG_ERRQUEUE | MSG_DONTWAIT));
+        if (rc < 0) {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                return false;
+            }
+            throw SocketException(__FILE__, __LINE__);
+        }
+
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != NULL; 
+                cm = CMSG_NXTHDR(&msg, cm)) {
+            if (((cm->cmsg_level == IPPROTO_IP) && (cm->cmsg_type == IP_RECVERR))
+                    || ((cm->cmsg_level == IPPROTO_IPV6) 
+                    && (cm->cmsg_type == IPV6_RECVERR))) {
+                struct sock_extended_err *err 
+                    = reinterpret_cast<struct sock_extended_err *>(
+                    CMSG_DATA(cm));
+                if ((err->ee_errno == 0) 
+                        && (err->ee_origin == SO_EE_ORIGIN_ZEROCOPY)) {
+                    outFirst = err->ee_info;
+                    outLast = err->ee_data;
+                    return true;
+                }
+            }
+        }
+        /* Not a zero-copy notification, continue with next one. */
+    }
+
+#else /* defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) */
+    return false;
+#endif /* defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) */
+}
+
+
 /*
  * vislib::net::Socket::Send
  */
@@ -720,6 +785,76 @@ SIZE_T vislib::net::Socket::Send(const IPEndPoint& toAddr, const void *data,
 }
 
 
+/*
+ * vislib::net::Socket::Send
+ */
+SIZE_T vislib::net::Socket::Send(const SendBuffer *buffers, 
+        const SIZE_T cntBuffers, const INT timeout, const INT flags, 
+        const bool forceSend, UINT32 *outCntZeroCopySends) {
+    int n = 0;                  // Highest descriptor in 'writeSet' + 1.
+    fd_set writeSet;            // Set of socket to check for writability.
+    struct timeval timeOut;     // Timeout for writability check.
+
+    /* Handle infinite timeout first by calling normal send operation. */
+    if (timeout < 1) {
+        return this->send(buffers, cntBuffers, flags, forceSend, 
+            outCntZeroCopySends);
+    }
+
+    /* Initialise socket set and timeout structure. */
+    FD_ZERO(&writeSet);
+    FD_SET(this->handle, &writeSet);
+
+    timeOut.tv_sec = timeout / 1000;
+    timeOut.tv_usec = (timeout % 1000) * 1000;
+
+    /* Wait for the socket to become writable. */
+#ifndef _WIN32
+    n = this->handle + 1;   // Windows does not need 'n' and will ignore it.
+#endif /* !_WIN32 */
+    if (TEMP_FAILURE_RETRY(::select(n, NULL, &writeSet, NULL, &timeOut)) 
+            == SOCKET_ERROR) {
+        throw SocketException(__FILE__, __LINE__);
+    }
+
+    if (FD_ISSET(this->handle, &writeSet)) {
+        /* Delegate to normal send operation. */
+        return this->send(buffers, cntBuffers, flags, forceSend, 
+            outCntZeroCopySends);
+
+    } else {
+        /* Signal timeout. */
+#ifdef _WIN32
+        throw SocketException(WSAETIMEDOUT, __FILE__, __LINE__);
+#else /* _WIN32 */
+        throw SocketException(ETIME, __FILE__, __LINE__);
+#endif /* _WIN32 */
+    }
+}
+
+
+/*
+ * vislib::net::Socket::SetBlocking
+ */
+void vislib::net::Socket::SetBlocking(const bool enable) {
+#ifdef _WIN32
+    u_long mode = enable ? 0 : 1;
+    if (::ioctlsocket(this->handle, FIONBIO, &mode) == SOCKET_ERROR) {
+        throw SocketException(__FILE__, __LINE__);
+    }
+#else /* _WIN32 */
+    int flags = ::fcntl(this->handle, F_GETFL, 0);
+    if (flags == -1) {
+        throw SocketException(__FILE__, __LINE__);
+    }
+    flags = enable ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK);
+    if (::fcntl(this->handle, F_SETFL, flags) == -1) {
+        throw SocketException(__FILE__, __LINE__);
+    }
+#endif /* _WIN32 */
+}
+
+
 /*
  * vislib::net::Socket::SetMulticastLoop
  */
@@ -785,6 +920,20 @@ void vislib::net::Socket::SetRcvAll(const bool enable) {
 }
 
 
+/*
+ * vislib::net::Socket::SetZeroCopy
+ */
+bool vislib::net::Socket::SetZeroCopy(const bool enable) {
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+    INT tmp = enable ? 1 : 0;
+    return (::setsockopt(this->handle, SOL_SOCKET, SO_ZEROCOPY, &tmp, 
+        sizeof(INT)) == 0);
+#else /* defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) */
+    return false;
+#endif /* defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) */
+}
+
+
 /*
  * vislib::net::Socket::Shutdown
  */
@@ -1006,7 +1155,7 @@ SIZE_T vislib::net::Socket::send(const void *data, const SIZE_T cntBytes,
 
 #else /* _WIN32 */
         TEMP_FAILURE_RETRY(lastSent = ::send(this->handle, 
-            static_cast<const char *>(data), 
+            static_cast<const char *>(data) + totalSent, 
             static_cast<int>(cntBytes - totalSent), flags));
 
         if ((lastSent >= 0) && (lastSent != SOCKET_ERROR)) {
@@ -1029,6 +1178,151 @@ SIZE_T vislib::net::Socket::send(const void *data, const SIZE_T cntBytes,
 }
 
 
+/*
+ * vislib::net::Socket::send
+ */
+SIZE_T vislib::net::Socket::send(const SendBuffer *buffers, 
+        const SIZE_T cntBuffers, const INT flags, const bool forceSend,
+        UINT32 *outCntZeroCopySends) {
+    SIZE_T cntBytes = 0;        // # of bytes to be sent.
+    SIZE_T totalSent = 0;       // # of bytes totally sent.
+    SIZE_T first = 0;           // First buffer not completely sent.
+    SIZE_T lastSent = 0;        // # of bytes sent during last call.
+#ifdef _WIN32
+    WSAOVERLAPPED overlapped;   // Overlap structure for asynchronous send().
+    WSABUF *wsaBufs = NULL;     // Buffers for WSA output.
+    DWORD wsaSent = 0;          // # of bytes sent by WSA.
+    DWORD errorCode = 0;        // WSA error during last operation.
+    DWORD inOutFlags = flags;   // Flags for WSA.
+#else /* _WIN32 */
+    struct iovec *iov = NULL;   // Buffers for sendmsg().
+    struct msghdr msg;          // Message descriptor for sendmsg().
+    ssize_t rc = 0;             // Return value of sendmsg().
+    INT curFlags = flags;       // Flags for the next call.
+#endif /* _WIN32 */
+
+    if (outCntZeroCopySends != NULL) {
+        *outCntZeroCopySends = 0;
+    }
+    for (SIZE_T i = 0; i < cntBuffers; i++) {
+        cntBytes += buffers[i].Size;
+    }
+    if (cntBytes == 0) {
+        return 0;
+    }
+
+#ifdef _WIN32
+    if ((overlapped.hEvent = ::WSACreateEvent()) == WSA_INVALID_EVENT) {
+        throw SocketException(__FILE__, __LINE__);
+    }
+
+    wsaBufs = new WSABUF[cntBuffers];
+    for (SIZE_T i = 0; i < cntBuffers; i++) {
+        wsaBufs[i].buf = const_cast<char *>(static_cast<const char *>(
+            buffers[i].Data));
+        wsaBufs[i].len = static_cast<u_long>(buffers[i].Size);
+    }
+#else /* _WIN32 */
+    iov = new struct iovec[cntBuffers];
+    for (SIZE_T i = 0; i < cntBuffers; i++) {
+        iov[i].iov_base = const_cast<void *>(buffers[i].Data);
+        iov[i].iov_len = buffers[i].Size;
+    }
+    ::memset(&msg, 0, sizeof(msg));
+#endif /* _WIN32 */
+
+    do {
+#ifdef _WIN32
+        while ((first < cntBuffers) && (wsaBufs[first].len == 0)) {
+            first++;
+        }
+
+        if (::WSASend(this->handle, wsaBufs + first, 
+                static_cast<DWORD>(cntBuffers - first), &wsaSent, flags, 
+                &overlapped, NULL) != 0) {
+            if ((errorCode = ::WSAGetLastError()) != WSA_IO_PENDING) {
+                ::WSACloseEvent(overlapped.hEvent);
+                delete[] wsaBufs;
+                throw SocketException(errorCode, __FILE__, __LINE__);
+            }
+            VLTRACE(Trace::LEVEL_VL_ANNOYINGLY_VERBOSE, "Overlapped socket I/O "
+                "pending.\n");
+            if (!::WSAGetOverlappedResult(this->handle, &overlapped, 
+                    &wsaSent, TRUE, &inOutFlags)) {
+                ::WSACloseEvent(overlapped.hEvent);
+                delete[] wsaBufs;
+                throw SocketException(__FILE__, __LINE__);
+            }
+        }
+        lastSent = static_cast<SIZE_T>(wsaSent);
+        totalSent += lastSent;
+
+        /* Skip the data sent. */
+        for (SIZE_T i = first; (i < cntBuffers) && (lastSent > 0); i++) {
+            SIZE_T s = (lastSent < wsaBufs[i].len) ? lastSent 
+                : wsaBufs[i].len;
+            wsaBufs[i].buf += s;
+            wsaBufs[i].len -= static_cast<u_long>(s);
+            lastSent -= s;
+        }
+
+#else /* _WIN32 */
+        while ((first < cntBuffers) && (iov[first].iov_len == 0)) {
+            first++;
+        }
+        msg.msg_iov = iov + first;
+        msg.msg_iovlen = cntBuffers - first;
+
+        TEMP_FAILURE_RETRY(rc = ::sendmsg(this->handle, &msg, curFlags));
+
+        if (rc >= 0) {
+            lastSent = static_cast<SIZE_T>(rc);
+            totalSent += lastSent;
+#ifdef MSG_ZEROCOPY
+            if (((curFlags & MSG_ZEROCOPY) != 0) 
+                    && (outCntZeroCopySends != NULL)) {
+                (*outCntZeroCopySends)++;
+            }
+#endif /* MSG_ZEROCOPY */
+
+            /* Skip the data sent. */
+            for (SIZE_T i = first; (i < cntBuffers) && (lastSent > 0); i++) {
+                SIZE_T s = (lastSent < iov[i].iov_len) ? lastSent 
+                    : iov[i].iov_len;
+                iov[i].iov_base = static_cast<char *>(iov[i].iov_base) + s;
+                iov[i].iov_len -= s;
+                lastSent -= s;
+            }
+
+#ifdef MSG_ZEROCOPY
+        } else if ((errno == ENOBUFS) && ((curFlags & MSG_ZEROCOPY) != 0)) {
+            /* Pinning the pages failed, fall back to copying the data. */
+            curFlags &= ~MSG_ZEROCOPY;
+            continue;
+#endif /* MSG_ZEROCOPY */
+
+        } else {
+            delete[] iov;
+            throw SocketException(__FILE__, __LINE__);
+        }
+#endif /* _WIN32 */
+
+        /* Note: Test (totalSent == 0) is for the fallback without zero-copy. */
+    } while ((forceSend || (totalSent == 0)) && (totalSent < cntBytes));
+
+#ifdef _WIN32
+    delete[] wsaBufs;
+    if (!::WSACloseEvent(overlapped.hEvent)) {
+        throw SocketException(__FILE__, __LINE__);
+    }
+#else /* _WIN32 */
+    delete[] iov;
+#endif /*_WIN32 */
+
+    return totalSent;
+}
+
+
 /*
  * vislib::net::Socket::sendTo
  */
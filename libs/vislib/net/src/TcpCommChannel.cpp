@@ -29,6 +29,18 @@ const UINT64 vislib::net::TcpCommChannel::FLAG_NODELAY = 0x00000001;
 const UINT64 vislib::net::TcpCommChannel::FLAG_REUSE_ADDRESS = 0x00000002;
 
 
+/*
+ * vislib::net::TcpCommChannel::Attach
+ */
+vislib::SmartRef<vislib::net::TcpCommChannel> 
+vislib::net::TcpCommChannel::Attach(Socket& socket) {
+    VLSTACKTRACE("TcpCommChannel::Attach", __FILE__, __LINE__);
+    SmartRef<TcpCommChannel> retval(new TcpCommChannel(0), false);
+    retval->socket = socket;
+    return retval;
+}
+
+
 /*
  * vislib::net::TcpCommChannel::Accept
  */
@@ -161,6 +173,17 @@ SIZE_T vislib::net::TcpCommChannel::Send(const void *data,
 }
 
 
+/*
+ * vislib::net::TcpCommChannel::Send
+ */
+SIZE_T vislib::net::TcpCommChannel::Send(
+        const Socket::SendBuffer *buffers, const SIZE_T cntBuffers, 
+        const UINT timeout, const bool forceSend) {
+    VLSTACKTRACE("TcpCommChannel::Send", __FILE__, __LINE__);
+    return this->socket.Send(buffers, cntBuffers, timeout, 0, forceSend);
+}
+
+
 /*
  * vislib::net::TcpCommChannel::TcpCommChannel
  */
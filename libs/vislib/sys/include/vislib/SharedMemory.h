@@ -115,12 +115,18 @@ namespace sys {
          * @param accessMode   The desired access to the shared memory.
          * @param creationMode Specifies whether to create or to open a segment.
          * @param size         Size of the shared memory segment in bytes.
+         * @param ownerOnly    If true, a segment created by the call can 
+         *                     only be opened by the user of the calling 
+         *                     process (mode 0600 on Linux). On Windows, the 
+         *                     default security descriptor of the process 
+         *                     is used in any case.
          *
          * @throws SystemException If the shared memory segment could not be
          *                         created or not be mapped.
          */
         void Open(const char *name, const AccessMode accessMode, 
-            const CreationMode creationMode, const FileSize size);
+            const CreationMode creationMode, const FileSize size,
+            const bool ownerOnly = false);
 
         /**
          * Creates a new shared memory segment or opens an existing one.
@@ -132,12 +138,18 @@ namespace sys {
          * @param accessMode   The desired access to the shared memory.
          * @param creationMode Specifies whether to create or to open a segment.
          * @param size         Size of the shared memory segment in bytes.
+         * @param ownerOnly    If true, a segment created by the call can 
+         *                     only be opened by the user of the calling 
+         *                     process (mode 0600 on Linux). On Windows, the 
+         *                     default security descriptor of the process 
+         *                     is used in any case.
          *
          * @throws SystemException If the shared memory segment could not be
          *                         created or not be mapped.
          */
         void Open(const wchar_t *name, const AccessMode accessMode, 
-            const CreationMode creationMode, const FileSize size);
+            const CreationMode creationMode, const FileSize size,
+            const bool ownerOnly = false);
 
         /**
          * Provides access to the mapped segment.
@@ -162,6 +174,9 @@ namespace sys {
 #ifndef _WIN32
         /** The default permissions assigned to the shared memory segment. */
         static const mode_t DFT_MODE;
+
+        /** The permissions of segments only accessible by their owner. */
+        static const mode_t OWNER_ONLY_MODE;
 #endif /* !_WIN32 */
 
         /**
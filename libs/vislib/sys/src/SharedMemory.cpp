@@ -11,6 +11,7 @@
 #ifndef _WIN32
 #include <sys/mman.h>
 #include <fcntl.h>
+#include <cerrno>
 #endif /* _WIN32 */
 
 #include "vislib/IllegalParamException.h"
@@ -76,7 +77,8 @@ void vislib::sys::SharedMemory::Close(void) {
     }
 
     if (this->hSharedMem != -1) {
-        if (::shm_unlink(this->name.PeekBuffer()) == -1) {
+        /* Another process may already have removed the name. */
+        if ((::shm_unlink(this->name.PeekBuffer()) == -1) && (errno != ENOENT)) {
             throw SystemException(__FILE__, __LINE__);
         }
         if (::close(this->hSharedMem) == -1) {
@@ -105,7 +107,8 @@ bool vislib::sys::SharedMemory::IsOpen(void) const {
  * vislib::sys::SharedMemory::Open
  */
 void vislib::sys::SharedMemory::Open(const char *name, const AccessMode accessMode, 
-        const CreationMode creationMode, const FileSize size) {
+        const CreationMode creationMode, const FileSize size, 
+        const bool ownerOnly) {
 #ifdef _WIN32
     DWORD protect = 0;
     DWORD access = 0;
@@ -178,7 +181,8 @@ void vislib::sys::SharedMemory::Open(const char *name, const AccessMode accessMo
     this->name = TranslateWinIpc2PosixName(name);
     VLTRACE(Trace::LEVEL_VL_INFO, "Open POSIX shared memory \"%s\"\n", 
         this->name.PeekBuffer());
-    this->hSharedMem = ::shm_open(this->name.PeekBuffer(), oflags, DFT_MODE);
+    this->hSharedMem = ::shm_open(this->name.PeekBuffer(), oflags, 
+        ownerOnly ? OWNER_ONLY_MODE : DFT_MODE);
     if (this->hSharedMem == -1) {
         throw SystemException(__FILE__, __LINE__);
     }
@@ -203,7 +207,8 @@ void vislib::sys::SharedMemory::Open(const char *name, const AccessMode accessMo
  * vislib::sys::SharedMemory::Open
  */
 void vislib::sys::SharedMemory::Open(const wchar_t *name, const AccessMode accessMode, 
-        const CreationMode creationMode, const FileSize size) {
+        const CreationMode creationMode, const FileSize size, 
+        const bool ownerOnly) {
 #ifdef _WIN32
     DWORD protect = 0;
     DWORD access = 0;
@@ -248,7 +253,7 @@ void vislib::sys::SharedMemory::Open(const wchar_t *name, const AccessMode acces
     }
 
 #else /* _WIN32 */
-    this->Open(W2A(name), accessMode, creationMode, size);
+    this->Open(W2A(name), accessMode, creationMode, size, ownerOnly);
 #endif /* _WIN32 */
 }
 
@@ -258,6 +263,12 @@ void vislib::sys::SharedMemory::Open(const wchar_t *name, const AccessMode acces
  * vislib::sys::SharedMemory::DFT_MODE
  */
 const mode_t vislib::sys::SharedMemory::DFT_MODE = 0666;
+
+
+/*
+ * vislib::sys::SharedMemory::OWNER_ONLY_MODE
+ */
+const mode_t vislib::sys::SharedMemory::OWNER_ONLY_MODE = 0600;
 #endif /* !_WIN32 */
 
 